@@ -0,0 +1,22 @@
+# - Find ZSTD
+# Find the native zstd includes and library
+# This module defines
+#  ZSTD_INCLUDE_DIR, where to find zstd.h, etc.
+#  ZSTD_LIBRARIES, the libraries needed to use zstd.
+#  ZSTD_FOUND, If false, do not try to use zstd.
+# also defined, but not for general use are
+#  ZSTD_LIBRARY, where to find the zstd library.
+
+FIND_PATH(ZSTD_INCLUDE_DIR zstd.h)
+
+SET(ZSTD_NAMES ${ZSTD_NAMES} zstd libzstd)
+FIND_LIBRARY(ZSTD_LIBRARY NAMES ${ZSTD_NAMES} )
+
+# handle the QUIETLY and REQUIRED arguments and set ZSTD_FOUND to TRUE if 
+# all listed variables are TRUE
+INCLUDE(FindPackageHandleStandardArgs)
+FIND_PACKAGE_HANDLE_STANDARD_ARGS(ZSTD DEFAULT_MSG ZSTD_LIBRARY ZSTD_INCLUDE_DIR)
+
+IF(ZSTD_FOUND)
+  SET(ZSTD_LIBRARIES ${ZSTD_LIBRARY})
+ENDIF(ZSTD_FOUND)
@@ -54,6 +54,15 @@
 #include "histogram.hxx"
 #include <algorithm>
 #include <iostream>
+#include <map>
+
+#if defined(__GXX_EXPERIMENTAL_CXX0X__) || __cplusplus >= 201103L || (defined(_MSC_VER) && _MSC_VER >= 1600)
+#  include <unordered_map>
+#  define VIGRA_ACCUMULATOR_REGION_MAP std::unordered_map
+#  define VIGRA_ACCUMULATOR_HAS_UNORDERED_MAP
+#else
+#  define VIGRA_ACCUMULATOR_REGION_MAP std::map
+#endif
 
 namespace vigra {
   
@@ -1197,7 +1206,8 @@ VIGRA_SHAPE_OF(long double)
     //  * hold an accumulator chain for global statistics
     //  * hold an array of accumulator chains (one per region) for region statistics
     //  * forward data to the appropriate chains
-    //  * allocate the region array with appropriate size
+    //  * allocate the region array with appropriate size, or (in sparse mode) create
+    //    region chains on demand and map labels to indices in the region array
     //  * store and forward activation requests
     //  * compute required number of passes as maximum from global and region accumulators
 template <class T, class GlobalAccumulators, class RegionAccumulators>
@@ -1208,6 +1218,7 @@ struct LabelDispatch
     typedef RegionAccumulators RegionAccumulatorChain;
     typedef typename LookupTag<AccumulatorEnd, RegionAccumulatorChain>::type::AccumulatorFlags ActiveFlagsType;
     typedef ArrayVector<RegionAccumulatorChain> RegionAccumulatorArray;
+    typedef VIGRA_ACCUMULATOR_REGION_MAP<MultiArrayIndex, MultiArrayIndex> RegionIndexMap;
         
     typedef LabelDispatch type;
     typedef LabelDispatch & reference;
@@ -1244,6 +1255,12 @@ struct LabelDispatch
     ActiveFlagsType active_region_accumulators_;
     CoordinateType coordinateOffset_;
     
+        // sparse mode: regions_[k] holds the statistics of label region_labels_[k]
+    bool sparse_;
+    RegionIndexMap region_index_;
+    ArrayVector<MultiArrayIndex> region_labels_;
+    MultiArrayIndex max_label_, last_label_, last_index_;
+    
     template <class IndexDefinition, class TagFound=typename IndexDefinition::Tag>
     struct LabelIndexSelector
     {
@@ -1321,7 +1338,13 @@ struct LabelDispatch
       regions_(),
       region_histogram_options_(),
       ignore_label_(-1),
-      active_region_accumulators_()
+      active_region_accumulators_(),
+      sparse_(false),
+      region_index_(),
+      region_labels_(),
+      max_label_(-1),
+      last_label_(-1),
+      last_index_(-1)
     {}
     
     LabelDispatch(LabelDispatch const & o)
@@ -1329,7 +1352,14 @@ struct LabelDispatch
       regions_(o.regions_),
       region_histogram_options_(o.region_histogram_options_),
       ignore_label_(o.ignore_label_),
-      active_region_accumulators_(o.active_region_accumulators_)
+      active_region_accumulators_(o.active_region_accumulators_),
+      coordinateOffset_(o.coordinateOffset_),
+      sparse_(o.sparse_),
+      region_index_(o.region_index_),
+      region_labels_(o.region_labels_),
+      max_label_(o.max_label_),
+      last_label_(o.last_label_),
+      last_index_(o.last_index_)
     {
         for(unsigned int k=0; k<regions_.size(); ++k)
         {
@@ -1337,24 +1367,101 @@ struct LabelDispatch
         }
     }
     
+    void setSparseLabels(bool sparse)
+    {
+        vigra_precondition(regions_.size() == 0,
+            "AccumulatorChainArray::setSparseLabels(): must be called before the first pass.");
+        sparse_ = sparse;
+    }
+    
     MultiArrayIndex maxRegionLabel() const
     {
-        return (MultiArrayIndex)regions_.size() - 1;
+        return sparse_
+                  ? max_label_
+                  : (MultiArrayIndex)regions_.size() - 1;
+    }
+    
+    MultiArrayIndex regionLabel(MultiArrayIndex k) const
+    {
+        return sparse_
+                  ? region_labels_[k]
+                  : k;
+    }
+    
+        // index of region 'label' in regions_ (a precondition fails if the
+        // region does not exist in sparse mode)
+    MultiArrayIndex regionIndex(MultiArrayIndex label) const
+    {
+        if(!sparse_)
+            return label;
+        typename RegionIndexMap::const_iterator i = region_index_.find(label);
+        vigra_precondition(i != region_index_.end(),
+            "AccumulatorChainArray: region label not found.");
+        return i->second;
+    }
+    
+    bool hasRegion(MultiArrayIndex label) const
+    {
+        return sparse_
+                  ? region_index_.find(label) != region_index_.end()
+                  : label >= 0 && label < (MultiArrayIndex)regions_.size();
     }
     
     void setMaxRegionLabel(unsigned maxlabel)
     {
-        if(maxRegionLabel() == (MultiArrayIndex)maxlabel)
+        if(sparse_ || maxRegionLabel() == (MultiArrayIndex)maxlabel)
             return;
         unsigned int oldSize = regions_.size();
         regions_.resize(maxlabel + 1);
         for(unsigned int k=oldSize; k<regions_.size(); ++k)
+            initializeRegion(k);
+    }
+    
+    void initializeRegion(MultiArrayIndex k)
+    {
+        getAccumulator<AccumulatorEnd>(regions_[k]).setGlobalAccumulator(&next_);
+        getAccumulator<AccumulatorEnd>(regions_[k]).active_accumulators_ = active_region_accumulators_;
+        regions_[k].applyHistogramOptions(region_histogram_options_);
+        regions_[k].setCoordinateOffsetImpl(coordinateOffset_);
+    }
+    
+        // index of region 'label' in regions_, the region is created if necessary
+    MultiArrayIndex findOrCreateRegion(MultiArrayIndex label)
+    {
+        if(!sparse_)
         {
-            getAccumulator<AccumulatorEnd>(regions_[k]).setGlobalAccumulator(&next_);
-            getAccumulator<AccumulatorEnd>(regions_[k]).active_accumulators_ = active_region_accumulators_;
-            regions_[k].applyHistogramOptions(region_histogram_options_);
-            regions_[k].setCoordinateOffsetImpl(coordinateOffset_);
+            if(label > maxRegionLabel())
+                setMaxRegionLabel(label);
+            return label;
         }
+        if(label == last_label_)
+            return last_index_;
+        typename RegionIndexMap::iterator i = region_index_.find(label);
+        if(i == region_index_.end())
+        {
+            MultiArrayIndex k = regions_.size();
+            regions_.push_back(RegionAccumulatorChain());
+            region_labels_.push_back(label);
+            i = region_index_.insert(std::make_pair(label, k)).first;
+            initializeRegion(k);
+            max_label_ = std::max(max_label_, label);
+        }
+        last_label_ = label;
+        last_index_ = i->second;
+        return last_index_;
+    }
+    
+        // as above, but a new region is also resized according to 't'
+    template <class U>
+    MultiArrayIndex findOrCreateRegion(MultiArrayIndex label, U const & t)
+    {
+        if(!sparse_)
+            return label;
+        MultiArrayIndex oldSize = regions_.size(),
+                        k = findOrCreateRegion(label);
+        if(k == oldSize)
+            regions_[k].resize(t);
+        return k;
     }
     
     void ignoreLabel(MultiArrayIndex l)
@@ -1387,21 +1494,42 @@ struct LabelDispatch
         next_.setCoordinateOffsetImpl(coordinateOffset_);
     }
     
+    template <class U>
+    MultiArrayIndex maxLabelOf(U const & t) const
+    {
+        static const int labelIndex = LabelIndexSelector<FindLabelIndex>::value;
+        typedef typename CoupledHandleCast<labelIndex, T>::type LabelHandle;
+        typedef typename LabelHandle::value_type LabelType;
+        typedef MultiArrayView<LabelHandle::dimensions, LabelType, StridedArrayTag> LabelArray;
+        LabelArray labelArray(t.shape(), cast<labelIndex>(t).strides(), const_cast<LabelType *>(cast<labelIndex>(t).ptr()));
+        
+        LabelType minimum, maximum;
+        labelArray.minmax(&minimum, &maximum);
+        return (MultiArrayIndex)maximum;
+    }
+    
+        // Make sure that all labels in the label array of 't' refer to an existing region.
+        // This is needed when the data are processed block by block, because resize()
+        // only determines the region count from the first block.
+    template <class U>
+    void growRegions(U const & t)
+    {
+        if(sparse_)
+            return;  // regions are created on demand
+        MultiArrayIndex maxlabel = maxLabelOf(t);
+        if(maxlabel <= maxRegionLabel())
+            return;
+        unsigned int oldSize = regions_.size();
+        setMaxRegionLabel(maxlabel);
+        for(unsigned int k=oldSize; k<regions_.size(); ++k)
+            regions_[k].resize(t);
+    }
+    
     template <class U>
     void resize(U const & t)
     {
-        if(regions_.size() == 0)
-        {
-            static const int labelIndex = LabelIndexSelector<FindLabelIndex>::value;
-            typedef typename CoupledHandleCast<labelIndex, T>::type LabelHandle;
-            typedef typename LabelHandle::value_type LabelType;
-            typedef MultiArrayView<LabelHandle::dimensions, LabelType, StridedArrayTag> LabelArray;
-            LabelArray labelArray(t.shape(), cast<labelIndex>(t).strides(), const_cast<LabelType *>(cast<labelIndex>(t).ptr()));
-            
-            LabelType minimum, maximum;
-            labelArray.minmax(&minimum, &maximum);
-            setMaxRegionLabel(maximum);
-        }
+        if(regions_.size() == 0 && !sparse_)
+            setMaxRegionLabel(maxLabelOf(t));
         next_.resize(t);
         // FIXME: only call resize when label k actually exists?
         for(unsigned int k=0; k<regions_.size(); ++k)
@@ -1411,20 +1539,22 @@ struct LabelDispatch
     template <unsigned N>
     void pass(T const & t)
     {
-        if(LabelIndexSelector<FindLabelIndex>::exec(t) != ignore_label_)
+        MultiArrayIndex label = LabelIndexSelector<FindLabelIndex>::exec(t);
+        if(label != ignore_label_)
         {
             next_.template pass<N>(t);
-            regions_[LabelIndexSelector<FindLabelIndex>::exec(t)].template pass<N>(t);
+            regions_[findOrCreateRegion(label, t)].template pass<N>(t);
         }
     }
     
     template <unsigned N>
     void pass(T const & t, double weight)
     {
-        if(LabelIndexSelector<FindLabelIndex>::exec(t) != ignore_label_)
+        MultiArrayIndex label = LabelIndexSelector<FindLabelIndex>::exec(t);
+        if(label != ignore_label_)
         {
             next_.template pass<N>(t, weight);
-            regions_[LabelIndexSelector<FindLabelIndex>::exec(t)].template pass<N>(t, weight);
+            regions_[findOrCreateRegion(label, t)].template pass<N>(t, weight);
         }
     }
     
@@ -1445,6 +1575,9 @@ struct LabelDispatch
         
         active_region_accumulators_.clear();
         RegionAccumulatorArray().swap(regions_);
+        RegionIndexMap().swap(region_index_);
+        ArrayVector<MultiArrayIndex>().swap(region_labels_);
+        max_label_ = last_label_ = last_index_ = -1;
         // FIXME: or is it better to just reset the region accumulators?
         // for(unsigned int k=0; k<regions_.size(); ++k)
             // regions_[k].reset();
@@ -1472,25 +1605,70 @@ struct LabelDispatch
     
     void mergeImpl(LabelDispatch const & o)
     {
-        for(unsigned int k=0; k<regions_.size(); ++k)
-            regions_[k].mergeImpl(o.regions_[k]);
+        if(sparse_ || o.sparse_)
+        {
+            // match regions by label
+            for(unsigned int k=0; k<o.regions_.size(); ++k)
+            {
+                MultiArrayIndex target = findOrCreateRegion(o.regionLabel(k));
+                regions_[target].mergeImpl(o.regions_[k]);
+            }
+        }
+        else
+        {
+            for(unsigned int k=0; k<regions_.size(); ++k)
+                regions_[k].mergeImpl(o.regions_[k]);
+        }
         next_.mergeImpl(o.next_);
     }
     
-    void mergeImpl(unsigned i, unsigned j)
+    void mergeImpl(MultiArrayIndex i, MultiArrayIndex j)
     {
-        regions_[i].mergeImpl(regions_[j]);
-        regions_[j].reset();
-        getAccumulator<AccumulatorEnd>(regions_[j]).active_accumulators_ = active_region_accumulators_;
+        MultiArrayIndex ki = regionIndex(i),
+                        kj = regionIndex(j);
+        regions_[ki].mergeImpl(regions_[kj]);
+        regions_[kj].reset();
+        getAccumulator<AccumulatorEnd>(regions_[kj]).active_accumulators_ = active_region_accumulators_;
     }
     
+        // labelMapping is indexed by the labels of 'o'
     template <class ArrayLike>
     void mergeImpl(LabelDispatch const & o, ArrayLike const & labelMapping)
     {
-        MultiArrayIndex newMaxLabel = std::max<MultiArrayIndex>(maxRegionLabel(), *argMax(labelMapping.begin(), labelMapping.end()));
-        setMaxRegionLabel(newMaxLabel);
-        for(unsigned int k=0; k<labelMapping.size(); ++k)
-            regions_[labelMapping[k]].mergeImpl(o.regions_[k]);
+        // 'o' may be '*this', so determine the region count before adding regions
+        MultiArrayIndex count = o.regions_.size();
+        if(!sparse_)
+        {
+            MultiArrayIndex newMaxLabel = std::max<MultiArrayIndex>(maxRegionLabel(), *argMax(labelMapping.begin(), labelMapping.end()));
+            setMaxRegionLabel(newMaxLabel);
+        }
+        for(MultiArrayIndex k=0; k<count; ++k)
+        {
+            MultiArrayIndex target = findOrCreateRegion(labelMapping[o.regionLabel(k)]);
+            regions_[target].mergeImpl(o.regions_[k]);
+        }
+        next_.mergeImpl(o.next_);
+    }
+    
+        // labelMapping is a map from the labels of 'o' (only the existing regions)
+    template <class Map>
+    void mergeMapImpl(LabelDispatch const & o, Map const & labelMapping)
+    {
+        // check the mapping first, so that nothing is merged if it is incomplete
+        MultiArrayIndex count = o.regions_.size();
+        ArrayVector<MultiArrayIndex> targets(count);
+        for(MultiArrayIndex k=0; k<count; ++k)
+        {
+            typename Map::const_iterator i = labelMapping.find(o.regionLabel(k));
+            vigra_precondition(i != labelMapping.end(),
+                "AccumulatorChainArray::merge(): region label of RHS not found in labelMapping.");
+            targets[k] = i->second;
+        }
+        for(MultiArrayIndex k=0; k<count; ++k)
+        {
+            MultiArrayIndex target = findOrCreateRegion(targets[k]);
+            regions_[target].mergeImpl(o.regions_[k]);
+        }
         next_.mergeImpl(o.next_);
     }
 };
@@ -2276,27 +2454,70 @@ class AccumulatorChainArray
         this->next_.ignoreLabel(l);
     }
     
+    /** Select sparse region storage (must be called before the first pass).
+    
+        By default, region accumulators are allocated densely for all labels 
+        from 0 to maxRegionLabel(). In sparse mode, a region accumulator is only
+        created when its label actually occurs, and labels are mapped to
+        accumulators by a hash table. This saves a lot of memory when the labels
+        are large and sparse (e.g. 64-bit labels with block offsets). Statistics are 
+        accessed as usual via <tt>get<TAG>(a, label)</tt>, but querying a label that
+        doesn't occur in the data is an error. Iterate over the existing regions like this:
+        \code
+        for(unsigned int k=0; k<a.regionCount(); ++k)
+            std::cout << a.regionLabel(k) << ": " << get<Mean>(a, a.regionLabel(k)) << "\n";
+        \endcode
+    */
+    void setSparseLabels(bool sparse = true)
+    {
+        this->next_.setSparseLabels(sparse);
+    }
+    
+    /** Check if sparse region storage is used.
+    */
+    bool sparseLabels() const
+    {
+        return this->next_.sparse_;
+    }
+    
     /** Set the maximum region label (e.g. for merging two accumulator chains).
+        Ignored in sparse mode.
     */
     void setMaxRegionLabel(unsigned label)
     {
         this->next_.setMaxRegionLabel(label);
     }
     
-    /** %Maximum region label. (equal to regionCount() - 1)
+    /** %Maximum region label. (equal to regionCount() - 1, unless sparse labels are used)
     */
     MultiArrayIndex maxRegionLabel() const
     {
         return this->next_.maxRegionLabel();
     }
     
-    /** Number of Regions. (equal to maxRegionLabel() + 1)
+    /** Number of Regions. (equal to maxRegionLabel() + 1, unless sparse labels are used,
+        where it is the number of distinct labels encountered)
     */
     unsigned int regionCount() const
     {
         return this->next_.regions_.size();
     }
     
+    /** Label of the k-th region (<tt>0 <= k < regionCount()</tt>). This is
+        just <tt>k</tt> unless sparse labels are used.
+    */
+    MultiArrayIndex regionLabel(unsigned int k) const
+    {
+        return this->next_.regionLabel(k);
+    }
+    
+    /** Check if statistics for region 'label' exist.
+    */
+    bool hasRegion(MultiArrayIndex label) const
+    {
+        return this->next_.hasRegion(label);
+    }
+    
     /** Equivalent to <tt>merge(o)</tt>.
     */
     void operator+=(AccumulatorChainArray const & o)
@@ -2306,34 +2527,54 @@ class AccumulatorChainArray
     
     /** Merge region i with region j. 
     */
-    void merge(unsigned i, unsigned j)
+    void merge(MultiArrayIndex i, MultiArrayIndex j)
     {
-        vigra_precondition(i <= maxRegionLabel() && j <= maxRegionLabel(),
+        vigra_precondition(hasRegion(i) && hasRegion(j),
             "AccumulatorChainArray::merge(): region labels out of range.");
         this->next_.mergeImpl(i, j);
     }
     
-    /** Merge with accumulator chain o. maxRegionLabel() of the two accumulators must be equal.
+    /** Merge with accumulator chain o. maxRegionLabel() of the two accumulators must be equal
+        (unless one of them uses sparse labels, where regions are matched by label).
     */
     void merge(AccumulatorChainArray const & o)
     {
-        if(maxRegionLabel() == -1)
-            setMaxRegionLabel(o.maxRegionLabel());
-        vigra_precondition(maxRegionLabel() == o.maxRegionLabel(),
-            "AccumulatorChainArray::merge(): maxRegionLabel must be equal.");
+        if(!sparseLabels() && !o.sparseLabels())
+        {
+            if(maxRegionLabel() == -1)
+                setMaxRegionLabel(o.maxRegionLabel());
+            vigra_precondition(maxRegionLabel() == o.maxRegionLabel(),
+                "AccumulatorChainArray::merge(): maxRegionLabel must be equal.");
+        }
         this->next_.mergeImpl(o.next_);
     }
 
-    /** Merge with accumulator chain o using a mapping between labels of the two accumulators. Label l of accumulator chain o is mapped to labelMapping[l]. Hence, all elements of labelMapping must be <= maxRegionLabel() and size of labelMapping must match o.regionCount().
+    /** Merge with accumulator chain o using a mapping between labels of the two accumulators. Label l of accumulator chain o is mapped to labelMapping[l]. Hence, all elements of labelMapping must be <= maxRegionLabel() and size of labelMapping must match o.maxRegionLabel()+1. If o uses sparse labels, pass a <tt>std::map</tt> or <tt>std::unordered_map</tt> instead (see below).
     */
     template <class ArrayLike>
     void merge(AccumulatorChainArray const & o, ArrayLike const & labelMapping)
     {
-        vigra_precondition(labelMapping.size() == o.regionCount(),
-            "AccumulatorChainArray::merge(): labelMapping.size() must match regionCount() of RHS.");
+        vigra_precondition((MultiArrayIndex)labelMapping.size() == o.maxRegionLabel() + 1,
+            "AccumulatorChainArray::merge(): labelMapping.size() must match maxRegionLabel()+1 of RHS.");
         this->next_.mergeImpl(o.next_, labelMapping);
     }
 
+    /** Merge with accumulator chain o using a sparse mapping between labels of the two accumulators. Label l of accumulator chain o is mapped to labelMapping[l], and every region label of o (see regionLabel()) must be a key of labelMapping. The size of the mapping thus depends on o.regionCount() rather than o.maxRegionLabel(), which is what you want with sparse labels.
+    */
+    template <class T1, class T2, class Compare, class Alloc>
+    void merge(AccumulatorChainArray const & o, std::map<T1, T2, Compare, Alloc> const & labelMapping)
+    {
+        this->next_.mergeMapImpl(o.next_, labelMapping);
+    }
+
+#ifdef VIGRA_ACCUMULATOR_HAS_UNORDERED_MAP
+    template <class T1, class T2, class Hash, class Pred, class Alloc>
+    void merge(AccumulatorChainArray const & o, std::unordered_map<T1, T2, Hash, Pred, Alloc> const & labelMapping)
+    {
+        this->next_.mergeMapImpl(o.next_, labelMapping);
+    }
+#endif
+
     /** Return names of all tags in the accumulator chain (selected statistics and their dependencies).
     */
     static ArrayVector<std::string> const & tagNames()
@@ -2715,7 +2956,7 @@ struct CastImpl<Tag, LabelDispatchTag, reference>
     template <class A>
     static reference exec(A & a, MultiArrayIndex label)
     {
-        return CastImpl<Tag, typename A::RegionAccumulatorChain::Tag, reference>::exec(a.regions_[label]);
+        return CastImpl<Tag, typename A::RegionAccumulatorChain::Tag, reference>::exec(a.regions_[a.regionIndex(label)]);
     }
 };
 
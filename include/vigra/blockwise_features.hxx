@@ -0,0 +1,449 @@
+/************************************************************************/
+/*                                                                      */
+/*                 Copyright 2015 by Ullrich Koethe                     */
+/*                                                                      */
+/*    This file is part of the VIGRA computer vision library.           */
+/*    The VIGRA Website is                                              */
+/*        http://hci.iwr.uni-heidelberg.de/vigra/                       */
+/*    Please direct questions, bug reports, and contributions to        */
+/*        ullrich.koethe@iwr.uni-heidelberg.de    or                    */
+/*        vigra@informatik.uni-hamburg.de                               */
+/*                                                                      */
+/*    Permission is hereby granted, free of charge, to any person       */
+/*    obtaining a copy of this software and associated documentation    */
+/*    files (the "Software"), to deal in the Software without           */
+/*    restriction, including without limitation the rights to use,      */
+/*    copy, modify, merge, publish, distribute, sublicense, and/or      */
+/*    sell copies of the Software, and to permit persons to whom the    */
+/*    Software is furnished to do so, subject to the following          */
+/*    conditions:                                                       */
+/*                                                                      */
+/*    The above copyright notice and this permission notice shall be    */
+/*    included in all copies or substantial portions of the             */
+/*    Software.                                                         */
+/*                                                                      */
+/*    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND    */
+/*    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES   */
+/*    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND          */
+/*    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT       */
+/*    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,      */
+/*    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING      */
+/*    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR     */
+/*    OTHER DEALINGS IN THE SOFTWARE.                                   */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef VIGRA_BLOCKWISE_FEATURES_HXX
+#define VIGRA_BLOCKWISE_FEATURES_HXX
+
+#include "accumulator.hxx"
+#include "multi_array_chunked.hxx"
+#include "multi_blockwise.hxx"
+#include "threadpool.hxx"
+
+namespace vigra {
+
+namespace acc {
+
+namespace acc_detail {
+
+    // Only region accumulator chains (i.e. those containing a LabelDispatch)
+    // have a maximum region label that must be kept consistent between chains.
+template <class NEXT>
+inline MultiArrayIndex
+maxRegionLabelOf(NEXT const &)
+{
+    return -1;
+}
+
+template <class T, class GlobalAccumulators, class RegionAccumulators>
+inline MultiArrayIndex
+maxRegionLabelOf(LabelDispatch<T, GlobalAccumulators, RegionAccumulators> const & a)
+{
+    return a.maxRegionLabel();
+}
+
+template <class NEXT>
+inline void
+extendMaxRegionLabel(NEXT &, MultiArrayIndex)
+{}
+
+template <class T, class GlobalAccumulators, class RegionAccumulators>
+inline void
+extendMaxRegionLabel(LabelDispatch<T, GlobalAccumulators, RegionAccumulators> & a,
+                     MultiArrayIndex maxlabel)
+{
+    if(maxlabel > a.maxRegionLabel())
+        a.setMaxRegionLabel(maxlabel);
+}
+
+template <class NEXT, class U>
+inline void
+growRegions(NEXT &, U const &)
+{}
+
+template <class T, class GlobalAccumulators, class RegionAccumulators, class U>
+inline void
+growRegions(LabelDispatch<T, GlobalAccumulators, RegionAccumulators> & a, U const & t)
+{
+    a.growRegions(t);
+}
+
+    // Merge the per-thread accumulator chains into 'a'.
+template <class ACCUMULATOR>
+void
+mergeAccumulatorChains(ACCUMULATOR & a, ArrayVector<ACCUMULATOR> & chains)
+{
+    MultiArrayIndex maxlabel = maxRegionLabelOf(a.next_);
+    for(unsigned int k=0; k<chains.size(); ++k)
+        maxlabel = std::max(maxlabel, maxRegionLabelOf(chains[k].next_));
+    extendMaxRegionLabel(a.next_, maxlabel);
+    for(unsigned int k=0; k<chains.size(); ++k)
+    {
+        extendMaxRegionLabel(chains[k].next_, maxlabel);
+        a.merge(chains[k]);
+    }
+}
+
+    // Split [start, end) into one contiguous range per thread. Each range is processed
+    // completely (i.e. all passes) by its own copy of 'a', and the copies are merged
+    // afterwards. The coupled iterator of the entire array provides global coordinates,
+    // so no coordinate offsets are needed.
+template <class ITERATOR, class ACCUMULATOR>
+void
+extractFeaturesParallel(ITERATOR start, ITERATOR end, ACCUMULATOR & a,
+                        ParallelOptions const & options)
+{
+    MultiArrayIndex size = end - start;
+    int nThreads = (int)std::min<MultiArrayIndex>(options.getActualNumThreads(), size);
+    if(nThreads <= 1)
+    {
+        extractFeatures(start, end, a);
+        return;
+    }
+
+    // determine the region count etc. from the entire array (as in the sequential
+    // version), so that all per-thread chains are configured identically
+    a.next_.resize(acc_detail::shapeOf(*start));
+
+    ArrayVector<ACCUMULATOR> chains(nThreads, a);
+
+    parallel_foreach(0, nThreads,
+        [&](int, int k)
+        {
+            extractFeatures(start + k*size / nThreads, start + (k+1)*size / nThreads,
+                            chains[k]);
+        },
+        options.numThreads(nThreads));
+
+    mergeAccumulatorChains(a, chains);
+}
+
+    // Process the blocks of a chunked array of the given shape. The blocks are distributed
+    // round-robin over per-thread copies of 'a', each of which processes its blocks
+    // completely (i.e. all passes). The copies are merged afterwards. The functor is
+    // called as 'f(thread_id, chain, start, stop, pass)' and must read the block
+    // [start, stop) and pass it to extractFeaturesBlock().
+template <unsigned int N, class ACCUMULATOR, class FUNCTOR>
+void
+extractFeaturesChunked(typename MultiArrayShape<N>::type const & shape,
+                       typename MultiArrayShape<N>::type const & chunkShape,
+                       ACCUMULATOR & a, BlockwiseOptions const & options,
+                       FUNCTOR && f)
+{
+    typedef typename MultiArrayShape<N>::type Shape;
+
+    Shape blockShape = vigra::detail::chunkedBlockShape<N>(options, chunkShape),
+          blocks;
+    for(unsigned int k=0; k<N; ++k)
+    {
+        if(shape[k] <= 0)
+            return;
+        blocks[k] = (shape[k] + blockShape[k] - 1) / blockShape[k];
+    }
+    MultiArrayIndex blockCount = prod(blocks);
+    int nThreads = (int)std::min<MultiArrayIndex>(options.getActualNumThreads(), blockCount);
+
+    ArrayVector<ACCUMULATOR> chains(nThreads, a);
+
+    parallel_foreach(0, nThreads,
+        [&](int thread_id, int k)
+        {
+            for(unsigned int pass=1; pass <= chains[k].passesRequired(); ++pass)
+            {
+                for(MultiArrayIndex i=k; i<blockCount; i+=nThreads)
+                {
+                    Shape b;
+                    vigra::detail::ScanOrderToCoordinate<N>::exec(i, blocks, b);
+                    Shape start = b*blockShape,
+                          stop  = min(shape, start + blockShape);
+                    f(thread_id, chains[k], start, stop, pass);
+                }
+            }
+        },
+        ParallelOptions().numThreads(nThreads));
+
+    mergeAccumulatorChains(a, chains);
+}
+
+    // Process the coupled iterator range [i, end) of a block at position 'start'.
+template <class ITERATOR, class ACCUMULATOR, class SHAPE>
+void
+extractFeaturesBlock(ITERATOR i, ITERATOR end, ACCUMULATOR & a,
+                     SHAPE const & start, unsigned int pass)
+{
+    a.setCoordinateOffset(start);
+    if(pass == 1)
+        growRegions(a.next_, *i);
+    for(; i < end; ++i)
+        a.updatePassN(*i, pass);
+}
+
+} // namespace acc_detail
+
+/** \addtogroup FeatureAccumulators
+*/
+//@{
+
+/** \brief Compute statistics of one or several arrays in parallel.
+
+    <b> Declarations:</b>
+
+    \code
+    namespace vigra { namespace acc {
+
+        // 'start' and 'end' must be random access iterators
+        template <class ITERATOR, class ACCUMULATOR>
+        void extractFeatures(ITERATOR start, ITERATOR end, ACCUMULATOR & a,
+                             ParallelOptions const & options);
+
+        template <unsigned int N, class T1, class S1,
+                  class ACCUMULATOR>
+        void extractFeatures(MultiArrayView<N, T1, S1> const & a1,
+                             ACCUMULATOR & a,
+                             ParallelOptions const & options);
+
+        template <unsigned int N, class T1, class S1,
+                                  class T2, class S2,
+                  class ACCUMULATOR>
+        void extractFeatures(MultiArrayView<N, T1, S1> const & a1,
+                             MultiArrayView<N, T2, S2> const & a2,
+                             ACCUMULATOR & a,
+                             ParallelOptions const & options);
+
+        template <unsigned int N, class T1, class S1,
+                                  class T2, class S2,
+                                  class T3, class S3,
+                  class ACCUMULATOR>
+        void extractFeatures(MultiArrayView<N, T1, S1> const & a1,
+                             MultiArrayView<N, T2, S2> const & a2,
+                             MultiArrayView<N, T3, S3> const & a3,
+                             ACCUMULATOR & a,
+                             ParallelOptions const & options);
+
+        // streaming versions for chunked arrays
+        template <unsigned int N, class T1, class ACCUMULATOR>
+        void extractFeatures(ChunkedArray<N, T1> const & a1,
+                             ACCUMULATOR & a,
+                             BlockwiseOptions const & options = BlockwiseOptions());
+
+        template <unsigned int N, class T1, class T2, class ACCUMULATOR>
+        void extractFeatures(ChunkedArray<N, T1> const & a1,
+                             ChunkedArray<N, T2> const & a2,
+                             ACCUMULATOR & a,
+                             BlockwiseOptions const & options = BlockwiseOptions());
+
+        template <unsigned int N, class T1, class T2, class T3, class ACCUMULATOR>
+        void extractFeatures(ChunkedArray<N, T1> const & a1,
+                             ChunkedArray<N, T2> const & a2,
+                             ChunkedArray<N, T3> const & a3,
+                             ACCUMULATOR & a,
+                             BlockwiseOptions const & options = BlockwiseOptions());
+    }}
+    \endcode
+
+    These functions compute the same results as the corresponding sequential
+    versions of \ref extractFeatures() (up to round-off). The data are split into
+    one part per thread, and each part is processed (in as many passes as necessary)
+    by a copy of the accumulator chain <tt>a</tt>. Afterwards, the copies are merged
+    into <tt>a</tt>, so all selected statistics must support merging (see
+    \ref FeatureAccumulators). Coordinate statistics always refer to the coordinate
+    system of the entire array. The accumulator chain must not contain data before
+    the call.
+
+    The versions for \ref ChunkedArray read one block after the other into per-thread
+    buffers, so that the arrays never need to be held in memory completely (each block
+    is read once per pass). By default, the blocks coincide with the chunks of <tt>a1</tt>. When <tt>a</tt> is an
+    \ref AccumulatorChainArray, the number of regions is increased as new labels are
+    encountered.
+
+    <b> Usage:</b>
+
+    <b>\#include</b> \<vigra/blockwise_features.hxx\><br>
+    Namespace: vigra::acc
+
+    \code
+    MultiArray<3, float> data(...);
+    MultiArray<3, UInt32> labels(...);
+
+    AccumulatorChainArray<CoupledArrays<3, float, UInt32>,
+                          Select<DataArg<1>, LabelArg<2>,
+                                 Count, Mean, Variance, RegionCenter> > a;
+
+    extractFeatures(data, labels, a, ParallelOptions().numThreads(8));
+
+    // streaming version
+    ChunkedArrayLazy<3, float> cdata(data.shape());
+    ChunkedArrayLazy<3, UInt32> clabels(data.shape());
+    ...
+    AccumulatorChainArray<CoupledArrays<3, float, UInt32>,
+                          Select<DataArg<1>, LabelArg<2>,
+                                 Count, Mean, Variance, RegionCenter> > ca;
+    extractFeatures(cdata, clabels, ca);
+    \endcode
+*/
+doxygen_overloaded_function(template <...> void extractFeatures)
+
+template <class ITERATOR, class ACCUMULATOR>
+void extractFeatures(ITERATOR start, ITERATOR end, ACCUMULATOR & a,
+                     ParallelOptions const & options)
+{
+    acc_detail::extractFeaturesParallel(start, end, a, options);
+}
+
+template <unsigned int N, class T1, class S1,
+          class ACCUMULATOR>
+void extractFeatures(MultiArrayView<N, T1, S1> const & a1,
+                     ACCUMULATOR & a,
+                     ParallelOptions const & options)
+{
+    typedef typename CoupledIteratorType<N, T1>::type Iterator;
+    Iterator start = createCoupledIterator(a1),
+             end   = start.getEndIterator();
+    acc_detail::extractFeaturesParallel(start, end, a, options);
+}
+
+template <unsigned int N, class T1, class S1,
+                          class T2, class S2,
+          class ACCUMULATOR>
+void extractFeatures(MultiArrayView<N, T1, S1> const & a1,
+                     MultiArrayView<N, T2, S2> const & a2,
+                     ACCUMULATOR & a,
+                     ParallelOptions const & options)
+{
+    typedef typename CoupledIteratorType<N, T1, T2>::type Iterator;
+    Iterator start = createCoupledIterator(a1, a2),
+             end   = start.getEndIterator();
+    acc_detail::extractFeaturesParallel(start, end, a, options);
+}
+
+template <unsigned int N, class T1, class S1,
+                          class T2, class S2,
+                          class T3, class S3,
+          class ACCUMULATOR>
+void extractFeatures(MultiArrayView<N, T1, S1> const & a1,
+                     MultiArrayView<N, T2, S2> const & a2,
+                     MultiArrayView<N, T3, S3> const & a3,
+                     ACCUMULATOR & a,
+                     ParallelOptions const & options)
+{
+    typedef typename CoupledIteratorType<N, T1, T2, T3>::type Iterator;
+    Iterator start = createCoupledIterator(a1, a2, a3),
+             end   = start.getEndIterator();
+    acc_detail::extractFeaturesParallel(start, end, a, options);
+}
+
+template <unsigned int N, class T1, class ACCUMULATOR>
+void extractFeatures(ChunkedArray<N, T1> const & a1,
+                     ACCUMULATOR & a,
+                     BlockwiseOptions const & options = BlockwiseOptions())
+{
+    typedef typename MultiArrayShape<N>::type Shape;
+    typedef typename CoupledIteratorType<N, T1>::type Iterator;
+
+    ArrayVector<MultiArray<N, T1> > buffer1(options.getActualNumThreads());
+
+    acc_detail::extractFeaturesChunked<N>(a1.shape(), a1.chunkShape(), a, options,
+        [&](int thread_id, ACCUMULATOR & chain, Shape const & start, Shape const & stop,
+            unsigned int pass)
+        {
+            MultiArray<N, T1> & b1 = buffer1[thread_id];
+            b1.reshape(stop - start);
+            a1.checkoutSubarray(start, b1);
+            Iterator i = createCoupledIterator(b1);
+            acc_detail::extractFeaturesBlock(i, i.getEndIterator(), chain, start, pass);
+        });
+}
+
+template <unsigned int N, class T1, class T2, class ACCUMULATOR>
+void extractFeatures(ChunkedArray<N, T1> const & a1,
+                     ChunkedArray<N, T2> const & a2,
+                     ACCUMULATOR & a,
+                     BlockwiseOptions const & options = BlockwiseOptions())
+{
+    typedef typename MultiArrayShape<N>::type Shape;
+    typedef typename CoupledIteratorType<N, T1, T2>::type Iterator;
+
+    vigra_precondition(a1.shape() == a2.shape(),
+        "extractFeatures(): shape mismatch between input arrays.");
+
+    ArrayVector<MultiArray<N, T1> > buffer1(options.getActualNumThreads());
+    ArrayVector<MultiArray<N, T2> > buffer2(options.getActualNumThreads());
+
+    acc_detail::extractFeaturesChunked<N>(a1.shape(), a1.chunkShape(), a, options,
+        [&](int thread_id, ACCUMULATOR & chain, Shape const & start, Shape const & stop,
+            unsigned int pass)
+        {
+            MultiArray<N, T1> & b1 = buffer1[thread_id];
+            MultiArray<N, T2> & b2 = buffer2[thread_id];
+            b1.reshape(stop - start);
+            b2.reshape(stop - start);
+            a1.checkoutSubarray(start, b1);
+            a2.checkoutSubarray(start, b2);
+            Iterator i = createCoupledIterator(b1, b2);
+            acc_detail::extractFeaturesBlock(i, i.getEndIterator(), chain, start, pass);
+        });
+}
+
+template <unsigned int N, class T1, class T2, class T3, class ACCUMULATOR>
+void extractFeatures(ChunkedArray<N, T1> const & a1,
+                     ChunkedArray<N, T2> const & a2,
+                     ChunkedArray<N, T3> const & a3,
+                     ACCUMULATOR & a,
+                     BlockwiseOptions const & options = BlockwiseOptions())
+{
+    typedef typename MultiArrayShape<N>::type Shape;
+    typedef typename CoupledIteratorType<N, T1, T2, T3>::type Iterator;
+
+    vigra_precondition(a1.shape() == a2.shape() && a1.shape() == a3.shape(),
+        "extractFeatures(): shape mismatch between input arrays.");
+
+    ArrayVector<MultiArray<N, T1> > buffer1(options.getActualNumThreads());
+    ArrayVector<MultiArray<N, T2> > buffer2(options.getActualNumThreads());
+    ArrayVector<MultiArray<N, T3> > buffer3(options.getActualNumThreads());
+
+    acc_detail::extractFeaturesChunked<N>(a1.shape(), a1.chunkShape(), a, options,
+        [&](int thread_id, ACCUMULATOR & chain, Shape const & start, Shape const & stop,
+            unsigned int pass)
+        {
+            MultiArray<N, T1> & b1 = buffer1[thread_id];
+            MultiArray<N, T2> & b2 = buffer2[thread_id];
+            MultiArray<N, T3> & b3 = buffer3[thread_id];
+            b1.reshape(stop - start);
+            b2.reshape(stop - start);
+            b3.reshape(stop - start);
+            a1.checkoutSubarray(start, b1);
+            a2.checkoutSubarray(start, b2);
+            a3.checkoutSubarray(start, b3);
+            Iterator i = createCoupledIterator(b1, b2, b3);
+            acc_detail::extractFeaturesBlock(i, i.getEndIterator(), chain, start, pass);
+        });
+}
+
+//@}
+
+} // namespace acc
+
+} // namespace vigra
+
+#endif // VIGRA_BLOCKWISE_FEATURES_HXX
@@ -0,0 +1,329 @@
+/************************************************************************/
+/*                                                                      */
+/*                 Copyright 2015 by Ullrich Koethe                     */
+/*                                                                      */
+/*    This file is part of the VIGRA computer vision library.           */
+/*    The VIGRA Website is                                              */
+/*        http://hci.iwr.uni-heidelberg.de/vigra/                       */
+/*    Please direct questions, bug reports, and contributions to        */
+/*        ullrich.koethe@iwr.uni-heidelberg.de    or                    */
+/*        vigra@informatik.uni-hamburg.de                               */
+/*                                                                      */
+/*    Permission is hereby granted, free of charge, to any person       */
+/*    obtaining a copy of this software and associated documentation    */
+/*    files (the "Software"), to deal in the Software without           */
+/*    restriction, including without limitation the rights to use,      */
+/*    copy, modify, merge, publish, distribute, sublicense, and/or      */
+/*    sell copies of the Software, and to permit persons to whom the    */
+/*    Software is furnished to do so, subject to the following          */
+/*    conditions:                                                       */
+/*                                                                      */
+/*    The above copyright notice and this permission notice shall be    */
+/*    included in all copies or substantial portions of the             */
+/*    Software.                                                         */
+/*                                                                      */
+/*    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND    */
+/*    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES   */
+/*    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND          */
+/*    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT       */
+/*    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,      */
+/*    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING      */
+/*    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR     */
+/*    OTHER DEALINGS IN THE SOFTWARE.                                   */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef VIGRA_BLOCKWISE_LABELING_HXX
+#define VIGRA_BLOCKWISE_LABELING_HXX
+
+#include "multi_array.hxx"
+#include "multi_labeling.hxx"
+#include "multi_blockwise.hxx"
+#include "union_find.hxx"
+#include "threadpool.hxx"
+
+namespace vigra {
+
+namespace detail {
+
+template <int N>
+inline void
+labelingBlockBounds(MultiArrayIndex b,
+                    TinyVector<MultiArrayIndex, N> const & shape,
+                    TinyVector<MultiArrayIndex, N> const & blockShape,
+                    TinyVector<MultiArrayIndex, N> const & blocks,
+                    TinyVector<MultiArrayIndex, N> & start,
+                    TinyVector<MultiArrayIndex, N> & stop)
+{
+    ScanOrderToCoordinate<N>::exec(b, blocks, start);
+    start *= blockShape;
+    stop = min(shape, start + blockShape);
+}
+
+    /* Label the connected components of 'data' blockwise in parallel:
+
+       1. Every block is labeled independently by the sequential algorithm,
+          resulting in local labels 1...count[b] (0 for the background).
+       2. The local label l of block b corresponds to the global index offset[b] + l
+          (where offset[] is the prefix sum of count[]). The faces of all blocks
+          are searched in parallel for neighboring points in different blocks which
+          belong to the same component, and the corresponding global indices are
+          merged in a ConcurrentUnionFindArray.
+       3. The resulting components are numbered contiguously.
+       4. All blocks are relabeled with the final labels.
+
+       Only the pixels on the block faces are visited in step 2, so that steps 1 and 4
+       (which are fully parallel) dominate the running time.
+    */
+template <unsigned int N, class T, class S1,
+                          class Label, class S2,
+          class Equal>
+Label
+labelMultiArrayBlockwiseImpl(MultiArrayView<N, T, S1> const & data,
+                             MultiArrayView<N, Label, S2> labels,
+                             NeighborhoodType neighborhood,
+                             bool hasBackground, T const & backgroundValue,
+                             BlockwiseOptions const & options,
+                             Equal const & equal)
+{
+    typedef typename MultiArrayShape<N>::type   Shape;
+    typedef GridGraph<N, undirected_tag>        Graph;
+    typedef typename Graph::OutBackArcIt        neighbor_iterator;
+
+    vigra_precondition(data.shape() == labels.shape(),
+        "labelMultiArrayBlockwise(): shape mismatch between input and output.");
+
+    Shape shape = data.shape(),
+          blockShape = options.template getBlockShapeN<N>(),
+          blocks;
+    for(unsigned int k=0; k<N; ++k)
+    {
+        if(shape[k] <= 0)
+            return 0;
+        blocks[k] = (shape[k] + blockShape[k] - 1) / blockShape[k];
+    }
+    MultiArrayIndex blockCount = prod(blocks);
+
+    // pass 1: label each block independently
+    ArrayVector<MultiArrayIndex> offsets(blockCount + 1, 0);
+    parallel_foreach((MultiArrayIndex)0, blockCount,
+        [&](int, MultiArrayIndex b)
+        {
+            Shape start, stop;
+            labelingBlockBounds(b, shape, blockShape, blocks, start, stop);
+            MultiArrayView<N, T, S1> const blockData = data.subarray(start, stop);
+            MultiArrayView<N, Label, S2> blockLabels = labels.subarray(start, stop);
+            Graph graph(stop - start, neighborhood);
+            offsets[b+1] = hasBackground
+                              ? lemon_graph::labelGraphWithBackground(graph, blockData, blockLabels,
+                                                                      backgroundValue, equal)
+                              : lemon_graph::labelGraph(graph, blockData, blockLabels, equal);
+        },
+        options);
+
+    for(MultiArrayIndex b=0; b<blockCount; ++b)
+        offsets[b+1] += offsets[b];
+    MultiArrayIndex total = offsets[blockCount];
+    vigra_precondition((MultiArrayIndex)(Label)(total + 1) == total + 1,
+        "labelMultiArrayBlockwise(): Need more labels than can be represented in the destination type.");
+
+    // pass 2: merge equivalent labels across block faces
+    Graph graph(shape, neighborhood);
+    ConcurrentUnionFindArray<Label> regions((Label)(total + 1));
+    parallel_foreach((MultiArrayIndex)0, blockCount,
+        [&](int, MultiArrayIndex b)
+        {
+            Shape start, stop;
+            labelingBlockBounds(b, shape, blockShape, blocks, start, stop);
+
+            for(unsigned int d=0; d<N; ++d)
+            {
+                for(MultiArrayIndex face = start[d]; face < stop[d]; face += std::max<MultiArrayIndex>(1, stop[d] - start[d] - 1))
+                {
+                    Shape fstart(start), fstop(stop);
+                    fstart[d] = face;
+                    fstop[d] = face + 1;
+
+                    MultiCoordinateIterator<N> i(fstop - fstart),
+                                               end = i.getEndIterator();
+                    for(; i != end; ++i)
+                    {
+                        Shape p = fstart + *i;
+                        T const & center = data[p];
+                        if(hasBackground && equal(center, backgroundValue))
+                            continue;
+                        Label pindex = (Label)(offsets[b] + labels[p]);
+
+                        for(neighbor_iterator arc(graph, p); arc != lemon::INVALID; ++arc)
+                        {
+                            Shape q = graph.target(*arc);
+                            if(allLessEqual(start, q) && allLess(q, stop))
+                                continue; // same block, already handled in pass 1
+                            if(!equal(center, data[q]))
+                                continue;
+                            Label qindex = labels[q];
+                            if(qindex != 0)
+                                qindex = (Label)(qindex + offsets[CoordinateToScanOrder<N>::exec(blocks, q / blockShape)]);
+                            regions.makeUnion(pindex, qindex);
+                        }
+                    }
+                }
+            }
+        },
+        options);
+
+    // pass 3: make the final labels contiguous
+    Label count = regions.makeContiguous();
+
+    // pass 4: write the final labels
+    parallel_foreach((MultiArrayIndex)0, blockCount,
+        [&](int, MultiArrayIndex b)
+        {
+            Shape start, stop;
+            labelingBlockBounds(b, shape, blockShape, blocks, start, stop);
+            MultiArrayView<N, Label, S2> blockLabels = labels.subarray(start, stop);
+            typename MultiArrayView<N, Label, S2>::iterator i = blockLabels.begin(),
+                                                            end = blockLabels.end();
+            for(; i != end; ++i)
+                *i = (*i == 0)
+                        ? regions.findLabel(0)
+                        : regions.findLabel((Label)(offsets[b] + *i));
+        },
+        options);
+
+    return count;
+}
+
+} // namespace detail
+
+/** \addtogroup Labeling
+*/
+//@{
+
+/********************************************************/
+/*                                                      */
+/*               labelMultiArrayBlockwise               */
+/*                                                      */
+/********************************************************/
+
+/** \brief Find the connected components of a MultiArray blockwise in parallel.
+
+    <b> Declarations:</b>
+
+    \code
+    namespace vigra {
+
+        template <unsigned int N, class T, class S1,
+                                  class Label, class S2,
+                  class EqualityFunctor = std::equal_to<T> >
+        Label
+        labelMultiArrayBlockwise(MultiArrayView<N, T, S1> const & data,
+                                 MultiArrayView<N, Label, S2> labels,
+                                 NeighborhoodType neighborhood = DirectNeighborhood,
+                                 BlockwiseOptions const & options = BlockwiseOptions(),
+                                 EqualityFunctor equal = std::equal_to<T>());
+
+        template <unsigned int N, class T, class S1,
+                                  class Label, class S2,
+                  class EqualityFunctor = std::equal_to<T> >
+        Label
+        labelMultiArrayWithBackgroundBlockwise(MultiArrayView<N, T, S1> const & data,
+                                               MultiArrayView<N, Label, S2> labels,
+                                               NeighborhoodType neighborhood = DirectNeighborhood,
+                                               T backgroundValue = T(),
+                                               BlockwiseOptions const & options = BlockwiseOptions(),
+                                               EqualityFunctor equal = std::equal_to<T>());
+    }
+    \endcode
+
+    These functions compute the same connected components as \ref labelMultiArray()
+    and \ref labelMultiArrayWithBackground() and return the same number of regions,
+    but the region labels may be assigned in a different order. The array is split
+    into blocks according to <tt>options</tt>. The blocks are labeled in parallel, the
+    labels of regions extending across block faces are merged, and the blocks are
+    finally relabeled in parallel. Since intermediate labels are unique across all
+    blocks, the label type must be able to represent the sum of the region counts
+    of all blocks.
+
+    <b> Usage:</b>
+
+    <b>\#include</b> \<vigra/blockwise_labeling.hxx\><br>
+    Namespace: vigra
+
+    \code
+    MultiArray<3, UInt8> mask(Shape3(w,h,d));
+    MultiArray<3, UInt32> labels(Shape3(w,h,d));
+
+    // find 26-connected foreground regions using blocks of size 128^3 and 8 threads
+    UInt32 max_region_label =
+        labelMultiArrayWithBackgroundBlockwise(mask, labels, IndirectNeighborhood, 0,
+                                               BlockwiseOptions().blockShape(128).numThreads(8));
+    \endcode
+*/
+doxygen_overloaded_function(template <...> unsigned int labelMultiArrayBlockwise)
+
+template <unsigned int N, class T, class S1,
+                          class Label, class S2,
+          class Equal>
+inline Label
+labelMultiArrayBlockwise(MultiArrayView<N, T, S1> const & data,
+                         MultiArrayView<N, Label, S2> labels,
+                         NeighborhoodType neighborhood,
+                         BlockwiseOptions const & options,
+                         Equal equal)
+{
+    return detail::labelMultiArrayBlockwiseImpl(data, labels, neighborhood,
+                                                false, T(), options, equal);
+}
+
+template <unsigned int N, class T, class S1,
+                          class Label, class S2>
+inline Label
+labelMultiArrayBlockwise(MultiArrayView<N, T, S1> const & data,
+                         MultiArrayView<N, Label, S2> labels,
+                         NeighborhoodType neighborhood = DirectNeighborhood,
+                         BlockwiseOptions const & options = BlockwiseOptions())
+{
+    return labelMultiArrayBlockwise(data, labels, neighborhood, options, std::equal_to<T>());
+}
+
+/** \brief Find the connected components of a MultiArray blockwise in parallel,
+     excluding the background from labeling.
+
+     See \ref labelMultiArrayBlockwise() for details.
+*/
+doxygen_overloaded_function(template <...> unsigned int labelMultiArrayWithBackgroundBlockwise)
+
+template <unsigned int N, class T, class S1,
+                          class Label, class S2,
+          class Equal>
+inline Label
+labelMultiArrayWithBackgroundBlockwise(MultiArrayView<N, T, S1> const & data,
+                                       MultiArrayView<N, Label, S2> labels,
+                                       NeighborhoodType neighborhood,
+                                       T backgroundValue,
+                                       BlockwiseOptions const & options,
+                                       Equal equal)
+{
+    return detail::labelMultiArrayBlockwiseImpl(data, labels, neighborhood,
+                                                true, backgroundValue, options, equal);
+}
+
+template <unsigned int N, class T, class S1,
+                          class Label, class S2>
+inline Label
+labelMultiArrayWithBackgroundBlockwise(MultiArrayView<N, T, S1> const & data,
+                                       MultiArrayView<N, Label, S2> labels,
+                                       NeighborhoodType neighborhood = DirectNeighborhood,
+                                       T backgroundValue = T(),
+                                       BlockwiseOptions const & options = BlockwiseOptions())
+{
+    return labelMultiArrayWithBackgroundBlockwise(data, labels, neighborhood, backgroundValue,
+                                                  options, std::equal_to<T>());
+}
+
+//@}
+
+} // namespace vigra
+
+#endif // VIGRA_BLOCKWISE_LABELING_HXX
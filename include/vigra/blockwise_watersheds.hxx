@@ -0,0 +1,572 @@
+/************************************************************************/
+/*                                                                      */
+/*                 Copyright 2015 by Ullrich Koethe                     */
+/*                                                                      */
+/*    This file is part of the VIGRA computer vision library.           */
+/*    The VIGRA Website is                                              */
+/*        http://hci.iwr.uni-heidelberg.de/vigra/                       */
+/*    Please direct questions, bug reports, and contributions to        */
+/*        ullrich.koethe@iwr.uni-heidelberg.de    or                    */
+/*        vigra@informatik.uni-hamburg.de                               */
+/*                                                                      */
+/*    Permission is hereby granted, free of charge, to any person       */
+/*    obtaining a copy of this software and associated documentation    */
+/*    files (the "Software"), to deal in the Software without           */
+/*    restriction, including without limitation the rights to use,      */
+/*    copy, modify, merge, publish, distribute, sublicense, and/or      */
+/*    sell copies of the Software, and to permit persons to whom the    */
+/*    Software is furnished to do so, subject to the following          */
+/*    conditions:                                                       */
+/*                                                                      */
+/*    The above copyright notice and this permission notice shall be    */
+/*    included in all copies or substantial portions of the             */
+/*    Software.                                                         */
+/*                                                                      */
+/*    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND    */
+/*    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES   */
+/*    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND          */
+/*    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT       */
+/*    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,      */
+/*    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING      */
+/*    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR     */
+/*    OTHER DEALINGS IN THE SOFTWARE.                                   */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef VIGRA_BLOCKWISE_WATERSHEDS_HXX
+#define VIGRA_BLOCKWISE_WATERSHEDS_HXX
+
+#include <vector>
+#include <algorithm>
+#include <utility>
+#include "multi_array.hxx"
+#include "multi_array_chunked.hxx"
+#include "multi_gridgraph.hxx"
+#include "multi_watersheds.hxx"
+#include "multi_blockwise.hxx"
+#include "union_find.hxx"
+#include "threadpool.hxx"
+
+namespace vigra {
+
+namespace blockwise_watersheds_detail {
+
+typedef unsigned short DirectionType;
+
+static const DirectionType NoDirection = NumericTraits<DirectionType>::maxConst;
+
+    /* Index (in the full neighborhood) of the lowest neighbor of 'node', or
+       'NoDirection' when 'node' is a local minimum. This is the same tie breaking
+       as in lemon_graph::graph_detail::prepareWatersheds(), but independent of the
+       node numbering, so that it can be evaluated on a subgraph.
+    */
+template <class Graph, class DataArray>
+DirectionType
+lowestNeighborDirection(Graph const & g, DataArray const & data,
+                        typename Graph::Node const & node)
+{
+    typename DataArray::value_type lowestValue = data[node];
+    DirectionType lowestDirection = NoDirection;
+    for(typename Graph::OutArcIt arc(g, node); arc != lemon::INVALID; ++arc)
+    {
+        if(data[g.target(*arc)] <= lowestValue)
+        {
+            lowestValue = data[g.target(*arc)];
+            lowestDirection = (DirectionType)arc.neighborIndex();
+        }
+    }
+    return lowestDirection;
+}
+
+    /* Call 'f(q)' for all back neighbors 'q' of 'node' that belong to the
+       same region as 'node' according to lemon_graph::graph_detail::unionFindWatersheds():
+       'q' is the lowest neighbor of 'node' or vice versa, or 'node' lies on a plateau
+       and 'q' has the same value. 'lowest(n)' must return the lowest neighbor direction
+       of node 'n' (for 'node' and its back neighbors).
+    */
+template <class Graph, class DataArray, class LowestFunctor, class FUNCTOR>
+void
+forEachMergedBackNeighbor(Graph const & g, DataArray const & data,
+                          LowestFunctor const & lowest,
+                          typename Graph::Node const & node,
+                          FUNCTOR && f)
+{
+    typedef typename Graph::OutBackArcIt neighbor_iterator;
+
+    DirectionType nodeDirection = lowest(node);
+    DirectionType maxDirection = (DirectionType)(g.maxDegree() - 1);
+    bool hasPlateauNeighbor = false;
+
+    for(neighbor_iterator arc(g, node); arc != lemon::INVALID; ++arc)
+    {
+        typename Graph::Node target = g.target(*arc);
+        DirectionType direction = (DirectionType)arc.neighborIndex();
+        if(nodeDirection == direction || lowest(target) == maxDirection - direction)
+        {
+            if(data[node] == data[target])
+                hasPlateauNeighbor = true;
+            f(target);
+        }
+    }
+
+    if(hasPlateauNeighbor)
+    {
+        // we are on a plateau => link all plateau points
+        for(neighbor_iterator arc(g, node); arc != lemon::INVALID; ++arc)
+        {
+            if(data[node] == data[g.target(*arc)])
+                f(g.target(*arc));
+        }
+    }
+}
+
+    /* Pass 1: label the watershed regions within the core [coreStart, coreStop) of
+       a block ('data' covers the core plus a halo of two pixels, clipped at the
+       array border, and 'g' is the grid graph of 'data'). 'labels' has the core
+       shape and receives the local labels 1...count, which are returned. For
+       every local label, 'firstIndex' receives the global scan-order index of its
+       first point (this determines the final label order).
+    */
+template <class Graph, class DataArray, class LabelArray, class Shape>
+typename LabelArray::value_type
+unionFindWatershedsBlock(Graph const & g, DataArray const & data,
+                         Shape const & coreStart, Shape const & coreStop,
+                         LabelArray & labels,
+                         Shape const & globalStart, Shape const & globalShape,
+                         std::vector<MultiArrayIndex> & firstIndex)
+{
+    typedef typename LabelArray::value_type LabelType;
+    enum { N = Shape::static_size };
+
+    // lowest neighbor directions of the core and its one-pixel ring
+    Shape lowestStart = max(Shape(), coreStart - Shape(1)),
+          lowestStop  = min(data.shape(), coreStop + Shape(1));
+    MultiArray<N, DirectionType> lowest(data.shape());
+    MultiCoordinateIterator<N> i(lowestStop - lowestStart),
+                               end = i.getEndIterator();
+    for(; i != end; ++i)
+        lowest[lowestStart + *i] = lowestNeighborDirection(g, data, lowestStart + *i);
+
+    UnionFindArray<LabelType> regions;
+
+    MultiCoordinateIterator<N> core(coreStop - coreStart),
+                               coreEnd = core.getEndIterator();
+    for(; core != coreEnd; ++core)
+    {
+        Shape node = coreStart + *core;
+        // define tentative label for current node
+        LabelType currentIndex = regions.nextFreeIndex();
+
+        forEachMergedBackNeighbor(g, data,
+            [&lowest](Shape const & n) { return lowest[n]; },
+            node,
+            [&](Shape const & target)
+            {
+                // neighbors outside the core are merged in pass 2
+                if(allLessEqual(coreStart, target) && allLess(target, coreStop))
+                    currentIndex = regions.makeUnion(labels[target - coreStart], currentIndex);
+            });
+
+        // set label of current node
+        labels[*core] = regions.finalizeIndex(currentIndex);
+    }
+
+    LabelType count = regions.makeContiguous();
+
+    firstIndex.assign(count + 1, -1);
+    for(core = MultiCoordinateIterator<N>(coreStop - coreStart); core != coreEnd; ++core)
+    {
+        LabelType label = regions.findLabel(labels[*core]);
+        labels[*core] = label;
+        if(firstIndex[label] < 0)
+            firstIndex[label] = detail::CoordinateToScanOrder<N>::exec(globalShape, globalStart + *core);
+    }
+    return count;
+}
+
+    /* Pass 2: merge the regions of a block's core [start, stop) with the regions of
+       neighboring blocks. 'data' starts at global coordinate 'dataStart' and covers
+       the core plus a halo of two pixels, 'g' is its grid graph. 'labels' holds the
+       local labels of pass 1 and covers the core plus a halo of one pixel, starting
+       at global coordinate 'labelsStart'.
+    */
+template <class Graph, class DataArray, class LabelArray, class Shape, class Label>
+void
+unionFindWatershedsMergeFaces(Graph const & g, DataArray const & data, Shape const & dataStart,
+                              LabelArray const & labels, Shape const & labelsStart,
+                              Shape const & start, Shape const & stop,
+                              Shape const & blockShape, Shape const & blocks,
+                              ArrayVector<MultiArrayIndex> const & offsets,
+                              ConcurrentUnionFindArray<Label> & regions)
+{
+    enum { N = Shape::static_size };
+
+    Shape coreStart = start - dataStart,
+          coreStop  = stop - dataStart;
+    MultiArrayIndex block = detail::CoordinateToScanOrder<N>::exec(blocks, start / blockShape);
+
+    for(int d=0; d<N; ++d)
+    {
+        for(MultiArrayIndex face = coreStart[d]; face < coreStop[d];
+            face += std::max<MultiArrayIndex>(1, coreStop[d] - coreStart[d] - 1))
+        {
+            Shape fstart(coreStart), fstop(coreStop);
+            fstart[d] = face;
+            fstop[d] = face + 1;
+
+            MultiCoordinateIterator<N> i(fstop - fstart),
+                                       end = i.getEndIterator();
+            for(; i != end; ++i)
+            {
+                Shape node = fstart + *i;
+                Label nodeIndex = (Label)(offsets[block] + labels[node + dataStart - labelsStart]);
+
+                forEachMergedBackNeighbor(g, data,
+                    [&](Shape const & n) { return lowestNeighborDirection(g, data, n); },
+                    node,
+                    [&](Shape const & target)
+                    {
+                        if(allLessEqual(coreStart, target) && allLess(target, coreStop))
+                            return; // same block, already merged in pass 1
+                        Shape globalTarget = target + dataStart;
+                        MultiArrayIndex targetBlock =
+                            detail::CoordinateToScanOrder<N>::exec(blocks, globalTarget / blockShape);
+                        regions.makeUnion(nodeIndex,
+                            (Label)(offsets[targetBlock] + labels[globalTarget - labelsStart]));
+                    });
+            }
+        }
+    }
+}
+
+    /* Pass 3: compute the final label of every block-local region, such that regions
+       are numbered in the order of their first point in scan order (as in the
+       sequential algorithm).
+    */
+template <class Label>
+Label
+unionFindWatershedsFinalLabels(ConcurrentUnionFindArray<Label> & regions,
+                               ArrayVector<MultiArrayIndex> const & offsets,
+                               ArrayVector<std::vector<MultiArrayIndex> > const & firstIndex,
+                               ArrayVector<Label> & mapping)
+{
+    MultiArrayIndex total = offsets.back();
+    ArrayVector<MultiArrayIndex> minIndex(total + 1, NumericTraits<MultiArrayIndex>::max());
+    for(unsigned int b=0; b<firstIndex.size(); ++b)
+    {
+        for(unsigned int l=1; l<firstIndex[b].size(); ++l)
+        {
+            Label root = regions.findIndex((Label)(offsets[b] + l));
+            minIndex[root] = std::min(minIndex[root], firstIndex[b][l]);
+        }
+    }
+
+    std::vector<std::pair<MultiArrayIndex, Label> > roots;
+    for(MultiArrayIndex k=1; k<=total; ++k)
+        if(regions.findIndex((Label)k) == (Label)k)
+            roots.push_back(std::make_pair(minIndex[k], (Label)k));
+    std::sort(roots.begin(), roots.end());
+
+    mapping.resize(total + 1);
+    mapping[0] = 0;
+    for(unsigned int k=0; k<roots.size(); ++k)
+        mapping[roots[k].second] = (Label)(k + 1);
+    for(MultiArrayIndex k=1; k<=total; ++k)
+        mapping[k] = mapping[regions.findIndex((Label)k)];
+    return (Label)roots.size();
+}
+
+    /* Block access for arrays in memory: blocks are views. */
+template <unsigned int N, class T, class S1, class Label, class S2>
+struct ArrayBlockAccess
+{
+    typedef typename MultiArrayShape<N>::type   Shape;
+    typedef MultiArrayView<N, T, S1>            DataBlock;
+    typedef MultiArrayView<N, Label, S2>        LabelBlock;
+
+    MultiArrayView<N, T, S1> data_;
+    MultiArrayView<N, Label, S2> labels_;
+
+    ArrayBlockAccess(MultiArrayView<N, T, S1> const & data,
+                     MultiArrayView<N, Label, S2> const & labels)
+    : data_(data)
+    , labels_(labels)
+    {}
+
+    DataBlock getData(Shape const & start, Shape const & stop) const
+    {
+        return data_.subarray(start, stop);
+    }
+
+    LabelBlock getLabels(Shape const & start, Shape const & stop) const
+    {
+        return labels_.subarray(start, stop);
+    }
+
+    LabelBlock newLabels(Shape const & start, Shape const & stop) const
+    {
+        return labels_.subarray(start, stop);
+    }
+
+    void commitLabels(Shape const &, LabelBlock const &) const
+    {}
+};
+
+    /* Block access for chunked arrays: blocks are checked out into
+       temporary arrays, and labels are committed back.
+    */
+template <unsigned int N, class T, class Label>
+struct ChunkedBlockAccess
+{
+    typedef typename MultiArrayShape<N>::type   Shape;
+    typedef MultiArray<N, T>                    DataBlock;
+    typedef MultiArray<N, Label>                LabelBlock;
+
+    ChunkedArray<N, T> const & data_;
+    ChunkedArray<N, Label> & labels_;
+
+    ChunkedBlockAccess(ChunkedArray<N, T> const & data,
+                       ChunkedArray<N, Label> & labels)
+    : data_(data)
+    , labels_(labels)
+    {}
+
+    DataBlock getData(Shape const & start, Shape const & stop) const
+    {
+        DataBlock res(stop - start);
+        data_.checkoutSubarray(start, res);
+        return res;
+    }
+
+    LabelBlock getLabels(Shape const & start, Shape const & stop) const
+    {
+        LabelBlock res(stop - start);
+        labels_.checkoutSubarray(start, res);
+        return res;
+    }
+
+    LabelBlock newLabels(Shape const & start, Shape const & stop) const
+    {
+        return LabelBlock(stop - start);
+    }
+
+    void commitLabels(Shape const & start, LabelBlock const & labels) const
+    {
+        labels_.commitSubarray(start, labels);
+    }
+};
+
+template <unsigned int N, class Label, class Access>
+Label
+unionFindWatershedsBlockwiseImpl(typename MultiArrayShape<N>::type const & shape,
+                                 typename MultiArrayShape<N>::type const & blockShape,
+                                 Access const & access,
+                                 NeighborhoodType neighborhood,
+                                 BlockwiseOptions const & options)
+{
+    typedef typename MultiArrayShape<N>::type   Shape;
+    typedef GridGraph<N, undirected_tag>        Graph;
+    typedef typename Access::DataBlock          DataBlock;
+    typedef typename Access::LabelBlock         LabelBlock;
+
+    vigra_precondition(gridGraphMaxDegree(N, neighborhood) < NoDirection,
+        "unionFindWatershedsBlockwise(): cannot handle nodes with degree >= 65535.");
+
+    Shape blocks;
+    for(unsigned int k=0; k<N; ++k)
+    {
+        if(shape[k] <= 0)
+            return 0;
+        blocks[k] = (shape[k] + blockShape[k] - 1) / blockShape[k];
+    }
+    MultiArrayIndex blockCount = prod(blocks);
+
+    auto blockBounds = [&](MultiArrayIndex b, Shape & start, Shape & stop)
+    {
+        detail::ScanOrderToCoordinate<N>::exec(b, blocks, start);
+        start *= blockShape;
+        stop = min(shape, start + blockShape);
+    };
+
+    // pass 1: label each block independently
+    ArrayVector<MultiArrayIndex> offsets(blockCount + 1, 0);
+    ArrayVector<std::vector<MultiArrayIndex> > firstIndex(blockCount);
+    parallel_foreach((MultiArrayIndex)0, blockCount,
+        [&](int, MultiArrayIndex b)
+        {
+            Shape start, stop;
+            blockBounds(b, start, stop);
+            Shape dataStart = max(Shape(), start - Shape(2)),
+                  dataStop  = min(shape, stop + Shape(2));
+            DataBlock data = access.getData(dataStart, dataStop);
+            LabelBlock labels = access.newLabels(start, stop);
+            Graph graph(dataStop - dataStart, neighborhood);
+            offsets[b+1] = unionFindWatershedsBlock(graph, data, start - dataStart, stop - dataStart,
+                                                    labels, start, shape, firstIndex[b]);
+            access.commitLabels(start, labels);
+        },
+        options);
+
+    for(MultiArrayIndex b=0; b<blockCount; ++b)
+        offsets[b+1] += offsets[b];
+    MultiArrayIndex total = offsets[blockCount];
+    vigra_precondition((MultiArrayIndex)(Label)(total + 1) == total + 1,
+        "unionFindWatershedsBlockwise(): Need more labels than can be represented in the destination type.");
+
+    // pass 2: merge regions across block faces
+    ConcurrentUnionFindArray<Label> regions((Label)(total + 1));
+    parallel_foreach((MultiArrayIndex)0, blockCount,
+        [&](int, MultiArrayIndex b)
+        {
+            Shape start, stop;
+            blockBounds(b, start, stop);
+            Shape dataStart   = max(Shape(), start - Shape(2)),
+                  dataStop    = min(shape, stop + Shape(2)),
+                  labelsStart = max(Shape(), start - Shape(1)),
+                  labelsStop  = min(shape, stop + Shape(1));
+            DataBlock data = access.getData(dataStart, dataStop);
+            LabelBlock labels = access.getLabels(labelsStart, labelsStop);
+            Graph graph(dataStop - dataStart, neighborhood);
+            unionFindWatershedsMergeFaces(graph, data, dataStart, labels, labelsStart,
+                                          start, stop, blockShape, blocks, offsets, regions);
+        },
+        options);
+
+    // pass 3: determine the final labels
+    ArrayVector<Label> mapping;
+    Label count = unionFindWatershedsFinalLabels(regions, offsets, firstIndex, mapping);
+
+    // pass 4: write the final labels
+    parallel_foreach((MultiArrayIndex)0, blockCount,
+        [&](int, MultiArrayIndex b)
+        {
+            Shape start, stop;
+            blockBounds(b, start, stop);
+            LabelBlock labels = access.getLabels(start, stop);
+            typename LabelBlock::iterator i = labels.begin(),
+                                          end = labels.end();
+            for(; i != end; ++i)
+                *i = mapping[offsets[b] + *i];
+            access.commitLabels(start, labels);
+        },
+        options);
+
+    return count;
+}
+
+} // namespace blockwise_watersheds_detail
+
+/** \addtogroup SeededRegionGrowing
+*/
+//@{
+
+/********************************************************/
+/*                                                      */
+/*             unionFindWatershedsBlockwise             */
+/*                                                      */
+/********************************************************/
+
+/** \brief Blockwise parallel union-find watershed segmentation.
+
+    <b> Declarations:</b>
+
+    \code
+    namespace vigra {
+        // arrays in memory
+        template <unsigned int N, class T, class S1,
+                                  class Label, class S2>
+        Label
+        unionFindWatershedsBlockwise(MultiArrayView<N, T, S1> const & data,
+                                     MultiArrayView<N, Label, S2> labels,
+                                     NeighborhoodType neighborhood = DirectNeighborhood,
+                                     BlockwiseOptions const & options = BlockwiseOptions());
+
+        // chunked arrays
+        template <unsigned int N, class T, class Label>
+        Label
+        unionFindWatershedsBlockwise(ChunkedArray<N, T> const & data,
+                                     ChunkedArray<N, Label> & labels,
+                                     NeighborhoodType neighborhood = DirectNeighborhood,
+                                     BlockwiseOptions const & options = BlockwiseOptions());
+    }
+    \endcode
+
+    Computes the same segmentation as \ref watershedsMultiArray() with
+    <tt>WatershedOptions().unionFind()</tt>, including identical region labels.
+    The array is split into blocks according to <tt>options</tt> (for chunked
+    arrays, the default block shape is the chunk shape of <tt>labels</tt>).
+    The algorithm proceeds in four passes:
+
+    <ol>
+    <li> All blocks are segmented in parallel. Each block is processed together with a
+         halo of two pixels, so that every point's lowest neighbor and the plateau
+         tie breaking of the sequential algorithm are evaluated exactly.
+    <li> The faces of all blocks are searched in parallel for neighboring points in
+         different blocks which belong to the same region. Their regions are merged in
+         a \ref ConcurrentUnionFindArray (seam stitching).
+    <li> The merged regions are numbered in scan order of their first point.
+    <li> All blocks are relabeled in parallel.
+    </ol>
+
+    Only the current block (plus halo) of each thread is held in memory, so the chunked
+    version can process arrays that do not fit into main memory. Intermediate labels are
+    unique across all blocks, so <tt>Label</tt> must be able to represent the sum of the
+    region counts of all blocks.
+
+    The region growing watershed algorithm (<tt>WatershedOptions().regionGrowing()</tt>)
+    has no blockwise counterpart: its flooding order is a global property of the
+    priority queue, so that a blockwise result could not be guaranteed to match.
+
+    <b> Usage:</b>
+
+    <b>\#include</b> \<vigra/blockwise_watersheds.hxx\><br>
+    Namespace: vigra
+
+    \code
+    ChunkedArrayHDF5<3, float> boundaries(...);
+    ChunkedArrayHDF5<3, UInt32> labels(..., boundaries.shape(), Shape3(64));
+
+    UInt32 max_region_label =
+        unionFindWatershedsBlockwise(boundaries, labels, IndirectNeighborhood,
+                                     BlockwiseOptions().numThreads(16));
+    \endcode
+*/
+doxygen_overloaded_function(template <...> unsigned int unionFindWatershedsBlockwise)
+
+template <unsigned int N, class T, class S1,
+                          class Label, class S2>
+Label
+unionFindWatershedsBlockwise(MultiArrayView<N, T, S1> const & data,
+                             MultiArrayView<N, Label, S2> labels,
+                             NeighborhoodType neighborhood = DirectNeighborhood,
+                             BlockwiseOptions const & options = BlockwiseOptions())
+{
+    vigra_precondition(data.shape() == labels.shape(),
+        "unionFindWatershedsBlockwise(): Shape mismatch between input and output.");
+
+    blockwise_watersheds_detail::ArrayBlockAccess<N, T, S1, Label, S2> access(data, labels);
+    return blockwise_watersheds_detail::unionFindWatershedsBlockwiseImpl<N, Label>(
+                 data.shape(), options.template getBlockShapeN<N>(), access, neighborhood, options);
+}
+
+template <unsigned int N, class T, class Label>
+Label
+unionFindWatershedsBlockwise(ChunkedArray<N, T> const & data,
+                             ChunkedArray<N, Label> & labels,
+                             NeighborhoodType neighborhood = DirectNeighborhood,
+                             BlockwiseOptions const & options = BlockwiseOptions())
+{
+    vigra_precondition(data.shape() == labels.shape(),
+        "unionFindWatershedsBlockwise(): Shape mismatch between input and output.");
+
+    blockwise_watersheds_detail::ChunkedBlockAccess<N, T, Label> access(data, labels);
+    return blockwise_watersheds_detail::unionFindWatershedsBlockwiseImpl<N, Label>(
+                 data.shape(), detail::chunkedBlockShape<N>(options, labels.chunkShape()),
+                 access, neighborhood, options);
+}
+
+//@}
+
+} // namespace vigra
+
+#endif // VIGRA_BLOCKWISE_WATERSHEDS_HXX
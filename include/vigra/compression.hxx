@@ -50,22 +50,63 @@ enum CompressionMethod {  DEFAULT_COMPRESSION=-2,  // use default method (depend
                           ZLIB_FAST=1, // fastest compression using zlib
                           ZLIB=6,      // zlib default compression level
                           ZLIB_BEST=9, // highest compression using zlib
-                          LZ4          // very fast LZ4 algorithm
+                          LZ4,         // very fast LZ4 algorithm
+                          ZSTD_FAST=21, // zstd level 1 (levels 1...22 map to 21...42, see zstdCompression())
+                          ZSTD=23,      // zstd default compression level 3
+                          ZSTD_BEST=39, // zstd level 19 (highest level without excessive memory use)
+                          SHUFFLE=0x100,// flag: byte-shuffle the data before compression 
+                                        // (to be combined with one of the methods above)
+                          SHUFFLE_ZLIB = SHUFFLE | ZLIB,
+                          SHUFFLE_LZ4  = SHUFFLE | LZ4,
+                          SHUFFLE_ZSTD = SHUFFLE | ZSTD
                        };
 
+/** Return the CompressionMethod for zstd compression with the given level (1...22).
+*/
+inline CompressionMethod zstdCompression(int level)
+{
+    vigra_precondition(level >= 1 && level <= 22,
+        "zstdCompression(): level must be in [1, 22].");
+    return CompressionMethod(ZSTD_FAST - 1 + level);
+}
+
+/** Add byte shuffling to the given compression method.
+
+    Shuffling reorders the data such that the first bytes of all elements come first, 
+    then all second bytes and so on. This creates long runs of similar bytes in 
+    arrays of multi-byte numbers (in particular floating point), 
+    which greatly improves the compression ratio of fast codecs like LZ4.
+*/
+inline CompressionMethod withShuffle(CompressionMethod method)
+{
+    vigra_precondition(method >= ZLIB_NONE,
+        "withShuffle(): shuffling requires an explicit compression method.");
+    return CompressionMethod(method | SHUFFLE);
+}
+
 /** Compress the source buffer.
 
-    The destination array will be resized as required.
+    The destination array will be resized as required. <tt>elementSize</tt>
+    is the size of the data type (in bytes), which is needed when <tt>method</tt>
+    includes the SHUFFLE flag.
 */
 VIGRA_EXPORT void compress(char const * source, std::size_t size, ArrayVector<char> & dest, CompressionMethod method);
 VIGRA_EXPORT void compress(char const * source, std::size_t size, std::vector<char> & dest, CompressionMethod method);
+VIGRA_EXPORT void compress(char const * source, std::size_t size, ArrayVector<char> & dest, 
+                           CompressionMethod method, std::size_t elementSize);
+VIGRA_EXPORT void compress(char const * source, std::size_t size, std::vector<char> & dest, 
+                           CompressionMethod method, std::size_t elementSize);
 
 /** Uncompress the source buffer when the uncompressed size is known.
 
-    The destination buffer must be allocated to the correct size.
+    The destination buffer must be allocated to the correct size. 
+    <tt>elementSize</tt> must be the same as during compression.
 */
 VIGRA_EXPORT void uncompress(char const * source, std::size_t srcSize, 
                              char * dest, std::size_t destSize, CompressionMethod method);
+VIGRA_EXPORT void uncompress(char const * source, std::size_t srcSize, 
+                             char * dest, std::size_t destSize, CompressionMethod method,
+                             std::size_t elementSize);
 
 
 } // namespace vigra
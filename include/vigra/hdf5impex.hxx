@@ -78,6 +78,7 @@
 #include "multi_impex.hxx"
 #include "utilities.hxx"
 #include "error.hxx"
+#include "compression.hxx"
 
 #if defined(_MSC_VER)
 #  include <io.h>
@@ -853,6 +854,44 @@ inline hid_t getH5DataType<FFTWComplex<double> >()
 }
 #endif
 
+    // Install the HDF5 filters corresponding to 'compression' in the dataset
+    // creation property list. Values 1...9 select deflate (zlib) at the 
+    // given level, as always. Otherwise, 'compression' is interpreted as a 
+    // vigra::CompressionMethod: the SHUFFLE flag maps to HDF5's built-in 
+    // shuffle filter, LZ4 and ZSTD to the registered third-party filters 
+    // (which must be available as plugins at runtime).
+inline void setHDF5CompressionFilters(hid_t plist, int compression)
+{
+    if(compression <= 0)
+        return;
+    int method = compression & ~SHUFFLE;
+    if(compression & SHUFFLE)
+        H5Pset_shuffle(plist);
+    if(method >= ZLIB_FAST && method <= ZLIB_BEST)
+    {
+        H5Pset_deflate(plist, method);
+    }
+    else if(method == LZ4)
+    {
+        H5Z_filter_t const lz4Filter = 32004;
+        vigra_precondition(H5Zfilter_avail(lz4Filter) > 0,
+            "HDF5File: LZ4 compression requires the HDF5 LZ4 filter plugin.");
+        H5Pset_filter(plist, lz4Filter, H5Z_FLAG_MANDATORY, 0, 0);
+    }
+    else if(method >= ZSTD_FAST && method < ZSTD_FAST + 22)
+    {
+        H5Z_filter_t const zstdFilter = 32015;
+        vigra_precondition(H5Zfilter_avail(zstdFilter) > 0,
+            "HDF5File: ZSTD compression requires the HDF5 zstd filter plugin.");
+        unsigned int level = method - ZSTD_FAST + 1;
+        H5Pset_filter(plist, zstdFilter, H5Z_FLAG_MANDATORY, 1, &level);
+    }
+    else
+    {
+        vigra_precondition(method == ZLIB_NONE,
+            "HDF5File: unsupported compression method.");
+    }
+}
 
 } // namespace detail
 
@@ -2078,6 +2117,10 @@ class HDF5File
             where 0 stands for no compression and 9 for maximum compression. If 
             a non-zero compression level is specified, but the chunk size is zero,
             a default chunk size will be chosen (compression always requires chunks).
+            Alternatively, <tt>compression</tt> can be a \ref vigra::CompressionMethod
+            such as <tt>SHUFFLE_ZLIB</tt> or <tt>ZSTD</tt>. The SHUFFLE flag activates
+            HDF5's shuffle filter, while LZ4 and ZSTD require the corresponding 
+            HDF5 filter plugins (IDs 32004 and 32015) at runtime.
 
             If the first character of datasetName is a "/", the path will be interpreted as absolute path,
             otherwise it will be interpreted as path relative to the current group.
@@ -2706,10 +2749,7 @@ HDF5File::createDataset(std::string datasetName,
     }
 
     // enable compression
-    if(compressionParameter > 0)
-    {
-        H5Pset_deflate(plist, compressionParameter);
-    }
+    detail::setHDF5CompressionFilters(plist, compressionParameter);
 
     //create the dataset.
     HDF5HandleShared datasetHandle(H5Dcreate(parent, setname.c_str(), 
@@ -2772,10 +2812,7 @@ void HDF5File::write_(std::string &datasetName,
     }
 
     // enable compression
-    if(compressionParameter > 0)
-    {
-        H5Pset_deflate(plist, compressionParameter);
-    }
+    detail::setHDF5CompressionFilters(plist, compressionParameter);
 
     // create dataset
     HDF5Handle datasetHandle(H5Dcreate(groupHandle, setname.c_str(), datatype, dataspace,H5P_DEFAULT, plist, H5P_DEFAULT), 
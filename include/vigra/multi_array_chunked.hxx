@@ -129,13 +129,14 @@
 #ifndef VIGRA_MULTI_ARRAY_CHUNKED_HXX
 #define VIGRA_MULTI_ARRAY_CHUNKED_HXX
 
-#include <queue>
+#include <deque>
 #include <string>
 
 #include "memory.hxx"
 #include "metaprogramming.hxx"
 #include "multi_array.hxx"
 #include "threading.hxx"
+#include "threadpool.hxx"
 #include "compression.hxx"
 
 // // FIXME: why is this needed when compiling the Python bindng,
@@ -368,6 +369,7 @@ class SharedChunkHandle
     SharedChunkHandle()
     : pointer_(0) 
     , chunk_state_()
+    , cache_stamp_(0)
     {
         chunk_state_ = chunk_uninitialized;
     }
@@ -375,6 +377,7 @@ class SharedChunkHandle
     SharedChunkHandle(SharedChunkHandle const & rhs)
     : pointer_(rhs.pointer_)
     , chunk_state_()
+    , cache_stamp_(0)
     {
         chunk_state_ = chunk_uninitialized;
     }
@@ -386,6 +389,7 @@ class SharedChunkHandle
 
     ChunkBase<N, T> * pointer_;
     mutable threading::atomic_long chunk_state_;
+    mutable threading::atomic_long cache_stamp_; // access information for the cache policy
     
   private:
     SharedChunkHandle & operator=(SharedChunkHandle const & rhs);
@@ -427,6 +431,12 @@ class ChunkedArrayBase
                                      shape_type & strides, shape_type & upper_bound, 
                                      IteratorChunkHandle<N, T> * h) const = 0;
     
+        // start loading the chunk containing 'point' in the background
+        // (only meaningful for backends that load chunks on demand)
+    virtual void prefetchForIterator(shape_type const & /* point */, 
+                                     IteratorChunkHandle<N, T> const * /* h */) const
+    {}
+    
     virtual std::string backend() const = 0;
 
     virtual shape_type chunkArrayShape() const = 0;
@@ -1269,13 +1279,31 @@ createCoupledIterator(MultiArrayView<N, T, ChunkedArrayTag> const & m)
                         P0(m.shape())));
 }
 
+    /** \brief Strategies to select the chunk to be removed when the cache of a
+        \ref ChunkedArray is full.
+        
+        <b>\#include</b> \<vigra/multi_array_chunked.hxx\> <br/>
+        Namespace: vigra
+    */
+enum ChunkCachePolicy 
+{
+    CACHE_FIFO,   ///< remove the chunk that was loaded first (default)
+    CACHE_LRU,    ///< remove the least recently used chunk (eviction costs O(log cacheSize))
+    CACHE_CLOCK   ///< second chance: like FIFO, but skip chunks used since the last visit
+};
+
 class ChunkedArrayOptions
 {
   public:
     ChunkedArrayOptions()
     : fill_value(0.0)
     , cache_max(-1)
+    , cache_max_bytes(0)
+    , cache_policy(CACHE_FIFO)
+    , prefetch_threads(2)
     , compression_method(DEFAULT_COMPRESSION)
+    , compression_threads(ParallelOptions::Auto)
+    , compression_block_size(1 << 18)
     {}
     
     ChunkedArrayOptions & fillValue(double v)
@@ -1300,6 +1328,43 @@ class ChunkedArrayOptions
         return ChunkedArrayOptions(*this).cacheMax(v);
     }
     
+        // Maximum number of bytes held by the cache (in addition to
+        // the limit on the number of chunks). Zero means 'unlimited'.
+    ChunkedArrayOptions & cacheMaxBytes(std::size_t v)
+    {
+        cache_max_bytes = v;
+        return *this;
+    }
+    
+    ChunkedArrayOptions cacheMaxBytes(std::size_t v) const
+    {
+        return ChunkedArrayOptions(*this).cacheMaxBytes(v);
+    }
+    
+    ChunkedArrayOptions & cachePolicy(ChunkCachePolicy v)
+    {
+        cache_policy = v;
+        return *this;
+    }
+    
+    ChunkedArrayOptions cachePolicy(ChunkCachePolicy v) const
+    {
+        return ChunkedArrayOptions(*this).cachePolicy(v);
+    }
+    
+        // Number of background threads used by ChunkedArray::prefetch().
+        // The threads are only started when prefetching is requested.
+    ChunkedArrayOptions & prefetchThreads(int v)
+    {
+        prefetch_threads = v;
+        return *this;
+    }
+    
+    ChunkedArrayOptions prefetchThreads(int v) const
+    {
+        return ChunkedArrayOptions(*this).prefetchThreads(v);
+    }
+    
     ChunkedArrayOptions & compression(CompressionMethod v)
     {
         compression_method = v;
@@ -1311,11 +1376,186 @@ class ChunkedArrayOptions
         return ChunkedArrayOptions(*this).compression(v);
     }
     
+        // Number of threads used by ChunkedArrayCompressed: chunks larger than
+        // compressionBlockSize() are split into blocks which are (de)compressed 
+        // in parallel, and chunks evicted from the cache are compressed in 
+        // a background thread. Zero means 'compress synchronously in a single thread'. 
+    ChunkedArrayOptions & compressionThreads(int v)
+    {
+        compression_threads = v;
+        return *this;
+    }
+    
+    ChunkedArrayOptions compressionThreads(int v) const
+    {
+        return ChunkedArrayOptions(*this).compressionThreads(v);
+    }
+    
+        // Size of the blocks (in bytes) that are compressed independently 
+        // by ChunkedArrayCompressed. Zero means 'never split chunks'.
+    ChunkedArrayOptions & compressionBlockSize(std::size_t v)
+    {
+        compression_block_size = v;
+        return *this;
+    }
+    
+    ChunkedArrayOptions compressionBlockSize(std::size_t v) const
+    {
+        return ChunkedArrayOptions(*this).compressionBlockSize(v);
+    }
+    
     double fill_value;
     int cache_max;
+    std::size_t cache_max_bytes;
+    ChunkCachePolicy cache_policy;
+    int prefetch_threads;
     CompressionMethod compression_method;
+    int compression_threads;
+    std::size_t compression_block_size;
 };
 
+namespace detail {
+
+    // The cache of loaded chunks of a ChunkedArray. Except for touch(), all
+    // functions must be called while holding the array's chunk_lock_.
+template <class Handle>
+class ChunkCache
+{
+  public:
+    struct Entry
+    {
+        Handle * handle;
+        std::size_t bytes;
+        long stamp;  // LRU: last access time known to the cache
+    };
+    
+        // LRU: orders the entries as a min-heap w.r.t. their stamps
+    struct LaterAccess
+    {
+        bool operator()(Entry const & a, Entry const & b) const
+        {
+            return a.stamp > b.stamp;
+        }
+    };
+    
+    typedef std::deque<Entry> Storage;
+    
+    explicit ChunkCache(ChunkCachePolicy policy = CACHE_FIFO)
+    : policy_(policy)
+    , bytes_(0)
+    , clock_(0)
+    {}
+    
+    std::size_t size() const
+    {
+        return entries_.size();
+    }
+    
+    std::size_t bytes() const
+    {
+        return bytes_;
+    }
+    
+    ChunkCachePolicy policy() const
+    {
+        return policy_;
+    }
+    
+        // record that a cached chunk was accessed (doesn't require the lock)
+    void touch(Handle * handle)
+    {
+        if(policy_ == CACHE_LRU)
+            handle->cache_stamp_.store(++clock_, threading::memory_order_relaxed);
+        else if(policy_ == CACHE_CLOCK)
+            handle->cache_stamp_.store(1, threading::memory_order_relaxed);
+    }
+    
+    void push(Handle * handle, std::size_t bytes)
+    {
+        Entry e = { handle, bytes, 0 };
+        bytes_ += bytes;
+        if(policy_ == CACHE_LRU)
+        {
+            touch(handle);
+            e.stamp = handle->cache_stamp_.load(threading::memory_order_relaxed);
+            entries_.push_back(e);
+            std::push_heap(entries_.begin(), entries_.end(), LaterAccess());
+        }
+        else
+        {
+            handle->cache_stamp_.store(0, threading::memory_order_relaxed);
+            entries_.push_back(e);
+        }
+    }
+    
+        // remove the next candidate for eviction from the cache
+    Entry pop()
+    {
+        typename Storage::iterator victim = entries_.begin();
+        if(policy_ == CACHE_LRU)
+        {
+            // Since touch() doesn't update the heap, the stamp in the heap may be 
+            // outdated. Such entries are re-inserted with their current stamp. 
+            // When the top entry is up-to-date, it is the least recently used one, 
+            // because stamps only increase. Thus, pop() takes amortized O(log n) time.
+            while(true)
+            {
+                long stamp = entries_.front().handle->cache_stamp_.load(threading::memory_order_relaxed);
+                std::pop_heap(entries_.begin(), entries_.end(), LaterAccess());
+                if(stamp == entries_.back().stamp)
+                    break;
+                entries_.back().stamp = stamp;
+                std::push_heap(entries_.begin(), entries_.end(), LaterAccess());
+            }
+            victim = entries_.end() - 1;
+        }
+        else if(policy_ == CACHE_CLOCK)
+        {
+            // give recently used chunks a second chance (the loop is bounded 
+            // because the reference bits are cleared along the way, unless 
+            // other threads keep setting them)
+            for(std::size_t k = 0; k < 2*entries_.size(); ++k)
+            {
+                if(entries_.front().handle->cache_stamp_.exchange(0, threading::memory_order_relaxed) == 0)
+                    break;
+                entries_.push_back(entries_.front());
+                entries_.pop_front();
+            }
+            victim = entries_.begin();
+        }
+        Entry res = *victim;
+        entries_.erase(victim);
+        bytes_ -= res.bytes;
+        return res;
+    }
+    
+        // remove all chunks which have been unloaded by other means
+    void removeUnloaded()
+    {
+        Storage remaining;
+        bytes_ = 0;
+        for(typename Storage::iterator i = entries_.begin(); i != entries_.end(); ++i)
+        {
+            if(i->handle->chunk_state_.load() >= 0)
+            {
+                remaining.push_back(*i);
+                bytes_ += i->bytes;
+            }
+        }
+        entries_.swap(remaining);
+        if(policy_ == CACHE_LRU)
+            std::make_heap(entries_.begin(), entries_.end(), LaterAccess());
+    }
+    
+  private:
+    ChunkCachePolicy policy_;
+    Storage entries_;
+    std::size_t bytes_;
+    threading::atomic_long clock_;
+};
+
+} // namespace detail
+
 /*
 The present implementation uses a memory-mapped sparse file to store the chunks.
 A sparse file is created on Linux using the O_TRUNC flag (this seems to be 
@@ -1437,7 +1677,7 @@ class ChunkedArray
     typedef ChunkBase<N, T> Chunk;
     typedef MultiArrayView<N, T, ChunkedArrayTag>                   view_type;
     typedef MultiArrayView<N, T const, ChunkedArrayTag>             const_view_type;
-    typedef std::queue<Handle*> CacheType;
+    typedef detail::ChunkCache<Handle> CacheType;
     
     static const long chunk_asleep = Handle::chunk_asleep;
     static const long chunk_uninitialized = Handle::chunk_uninitialized;
@@ -1451,12 +1691,18 @@ class ChunkedArray
     , bits_(initBitMask(this->chunk_shape_))
     , mask_(this->chunk_shape_ -shape_type(1))
     , cache_max_size_(options.cache_max)
+    , cache_max_bytes_(options.cache_max_bytes)
     , chunk_lock_(new threading::mutex())
+    , cache_(options.cache_policy)
     , fill_value_(T(options.fill_value))
     , fill_scalar_(options.fill_value)
     , handle_array_(detail::computeChunkArrayShape(shape, bits_, mask_))
-    , data_bytes_()
+    , data_bytes_(0)
     , overhead_bytes_(handle_array_.size()*sizeof(Handle))
+    , cache_hits_(0)
+    , cache_misses_(0)
+    , unloads_pending_(0)
+    , prefetch_threads_(options.prefetch_threads)
     {
         fill_value_chunk_.pointer_ = &fill_value_;
         fill_value_handle_.pointer_ = &fill_value_chunk_;
@@ -1479,6 +1725,8 @@ class ChunkedArray
     virtual ~ChunkedArray()
     {
         // std::cerr << "    final cache size: " << cacheSize() << " (max: " << cacheMaxSize() << ")\n";
+        stopPrefetching();
+        stopBackgroundUnloading();
     }
     
     int cacheSize() const
@@ -1486,6 +1734,35 @@ class ChunkedArray
         return cache_.size();
     }
     
+        // number of bytes currently held by the cache
+    std::size_t cacheBytes() const
+    {
+        return cache_.bytes();
+    }
+    
+    ChunkCachePolicy cachePolicy() const
+    {
+        return cache_.policy();
+    }
+    
+        // number of chunk requests that found the chunk already in memory
+    std::size_t cacheHits() const
+    {
+        return cache_hits_;
+    }
+    
+        // number of chunk requests that required loading the chunk
+    std::size_t cacheMisses() const
+    {
+        return cache_misses_;
+    }
+    
+    void resetCacheStatistics()
+    {
+        cache_hits_ = 0;
+        cache_misses_ = 0;
+    }
+    
     std::size_t dataBytes() const
     {
         return data_bytes_;
@@ -1575,6 +1852,14 @@ class ChunkedArray
     
     virtual bool unloadChunk(Chunk * chunk, bool destroy = false) = 0;
     
+        // Number of threads for unloading chunks evicted from the cache in the 
+        // background. Zero (the default) means that the evicting thread
+        // unloads the chunks itself.
+    virtual int backgroundUnloadThreads() const
+    {
+        return 0;
+    }
+    
     Handle * lookupHandle(shape_type const & index)
     {
         return &handle_array_[index];
@@ -1604,10 +1889,7 @@ class ChunkedArray
             unrefChunk(chunks[k]);
         
         if(cacheMaxSize() > 0)
-        {
-            threading::lock_guard<threading::mutex> guard(*chunk_lock_);
-            cleanCache(cache_.size());
-        }
+            cleanCache();
     }
     
     long acquireRef(Handle * handle) const
@@ -1655,35 +1937,48 @@ class ChunkedArray
         
         long rc = acquireRef(handle);        
         if(rc >= 0)
+        {
+            if(handle != &fill_value_handle_)
+            {
+                ++self->cache_hits_;
+                self->cache_.touch(handle);
+            }
             return handle->pointer_->pointer_;
+        }
+        if(handle != &fill_value_handle_)
+            ++self->cache_misses_;
 
-        threading::lock_guard<threading::mutex> guard(*chunk_lock_);
+        // The chunk is now in state chunk_locked, i.e. this thread has exclusive
+        // access. Other threads wanting the same chunk wait in acquireRef(), 
+        // but accesses to all other chunks proceed while we load this one.
+        T * p = 0;
         try
         {
-            T * p = self->loadChunk(&handle->pointer_, chunk_index);
+            p = self->loadChunk(&handle->pointer_, chunk_index);
             Chunk * chunk = handle->pointer_;
             if(!isConst && rc == chunk_uninitialized)
                 std::fill(p, p + prod(chunkShape(chunk_index)), this->fill_value_);
                 
             self->data_bytes_ += dataBytes(chunk);
-            
-            if(cacheMaxSize() > 0 && insertInCache)
-            {
-                // insert in queue of mapped chunks
-                self->cache_.push(handle);
-
-                // do cache management if cache is full
-                // (note that we still hold the chunk_lock_)
-                self->cleanCache(2);
-            }
-            handle->chunk_state_.store(1, threading::memory_order_release);
-            return p;
         }
         catch(...)
         {
             handle->chunk_state_.store(chunk_failed);
             throw;
         }
+        handle->chunk_state_.store(1, threading::memory_order_release);
+            
+        if(cacheMaxSize() > 0 && insertInCache)
+        {
+            {
+                // insert in queue of mapped chunks
+                threading::lock_guard<threading::mutex> guard(*chunk_lock_);
+                self->cache_.push(handle, dataBytes(handle->pointer_));
+            }
+            // do cache management if cache is full
+            self->cleanCache(2);
+        }
+        return p;
     }
     
     inline pointer 
@@ -1737,54 +2032,148 @@ class ChunkedArray
         return chunkForIteratorImpl(point, strides, upper_bound, h, true);
     }
     
-    // NOTE: This function must only be called while we hold the chunk_lock_.
-    //       This implies refcount != chunk_locked, so that race conditions are avoided.
-    long releaseChunk(Handle * handle, bool destroy = false)
+    // Try to get exclusive access to a chunk in order to unload it. This succeeds
+    // when the refcount is zero or (if destroy == true) the chunk is asleep, and 
+    // puts the chunk into state chunk_locked. 'rc' receives the old state.
+    bool lockChunkForRelease(Handle * handle, bool destroy, long & rc)
     {
-        long rc = 0;
+        rc = 0;
         bool mayUnload = handle->chunk_state_.compare_exchange_strong(rc, chunk_locked);
         if(!mayUnload && destroy)
         {
             rc = chunk_asleep;
             mayUnload = handle->chunk_state_.compare_exchange_strong(rc, chunk_locked);
         }
-        if(mayUnload)
+        return mayUnload;
+    }
+    
+    // Unload a chunk locked by lockChunkForRelease(). Since no other thread can 
+    // access the chunk, this doesn't require the chunk_lock_.
+    void unloadLockedChunk(Handle * handle, bool destroy)
+    {
+        try
+        {
+            vigra_invariant(handle != &fill_value_handle_,
+               "ChunkedArray::releaseChunk(): attempt to release fill_value_handle_.");
+            Chunk * chunk = handle->pointer_;
+            this->data_bytes_ -= dataBytes(chunk);
+            int didDestroy = unloadChunk(chunk, destroy);
+            this->data_bytes_ += dataBytes(chunk);
+            if(didDestroy)
+                handle->chunk_state_.store(chunk_uninitialized);
+            else
+                handle->chunk_state_.store(chunk_asleep);
+        }
+        catch(...)
+        {
+            handle->chunk_state_.store(chunk_failed);
+            throw;
+        }
+    }
+    
+    long releaseChunk(Handle * handle, bool destroy = false)
+    {
+        long rc = 0;
+        if(lockChunkForRelease(handle, destroy, rc))
         {
             // refcount was zero or chunk_asleep => can unload
-            try
-            {
-                vigra_invariant(handle != &fill_value_handle_,
-                   "ChunkedArray::releaseChunk(): attempt to release fill_value_handle_.");
-                Chunk * chunk = handle->pointer_;
-                this->data_bytes_ -= dataBytes(chunk);
-                int didDestroy = unloadChunk(chunk, destroy);
-                this->data_bytes_ += dataBytes(chunk);
-                if(didDestroy)
-                    handle->chunk_state_.store(chunk_uninitialized);
-                else
-                    handle->chunk_state_.store(chunk_asleep);
-            }
-            catch(...)
-            {
-                handle->chunk_state_.store(chunk_failed);
-                throw;
-            }
+            unloadLockedChunk(handle, destroy);
         }
         return rc;
     }
     
-    // NOTE: this function must only be called while we hold the chunk_lock_
+    bool cacheIsFull() const
+    {
+        return cache_.size() > cacheMaxSize() || 
+               (cache_max_bytes_ > 0 && cache_.bytes() > cache_max_bytes_);
+    }
+    
+    // Remove up to 'how_many' chunks from the cache until it fits into cacheMaxSize()
+    // and cacheMaxBytes(). The chunk to be removed is chosen by the cache policy.
+    // The cache is only locked while selecting the chunks to be removed. The chunks 
+    // are unloaded afterwards, so that other threads are not blocked by 
+    // the unloading (e.g. compression or writing to disk).
     void cleanCache(int how_many = -1)
     {
-        if(how_many == -1)
-            how_many = cache_.size();
-        for(; cache_.size() > cacheMaxSize() && how_many > 0; --how_many)
+        typedef typename CacheType::Entry Entry;
+        ArrayVector<Entry> to_unload;
+        int unload_threads = backgroundUnloadThreads();
         {
-            Handle * handle = cache_.front();
-            cache_.pop();
-            long rc = releaseChunk(handle);
-            if(rc > 0) // refcount was positive => chunk is still needed
-                cache_.push(handle);
+            threading::lock_guard<threading::mutex> guard(*chunk_lock_);
+            if(how_many == -1)
+                how_many = cache_.size();
+            for(; cacheIsFull() && how_many > 0; --how_many)
+            {
+                Entry entry = cache_.pop();
+                long rc = 0;
+                if(lockChunkForRelease(entry.handle, false, rc))
+                {
+                    to_unload.push_back(entry);
+                }
+                else if(rc > 0) // refcount was positive => chunk is still needed
+                {
+                    cache_.push(entry.handle, entry.bytes);
+                    cache_.touch(entry.handle);
+                }
+            }
+        #ifndef VIGRA_SINGLE_THREADED
+            if(unload_threads != 0 && to_unload.size() > 0 && !unload_pool_)
+                unload_pool_.reset(new ThreadPool(unload_threads));
+        #endif
+        }
+        
+    #ifndef VIGRA_SINGLE_THREADED
+        if(unload_threads != 0)
+        {
+            // The chunks remain in state chunk_locked until the background thread
+            // has unloaded them, so that concurrent accesses wait for completion.
+            // Errors are reported by waitForUnloading(). When the background thread
+            // falls behind by more than cacheMaxSize() chunks, we unload synchronously,
+            // so that memory consumption stays bounded.
+            for(unsigned int k = 0; k < to_unload.size(); ++k)
+            {
+                Handle * handle = to_unload[k].handle;
+                if(unloads_pending_.load() >= std::max<std::size_t>(1, cacheMaxSize()))
+                {
+                    unloadLockedChunk(handle, false);
+                    continue;
+                }
+                ++unloads_pending_;
+                unload_pool_->enqueue(
+                    [this, handle](int /* thread_id */)
+                    {
+                        try
+                        {
+                            this->unloadLockedChunk(handle, false);
+                        }
+                        catch(...)
+                        {
+                            --this->unloads_pending_;
+                            throw;
+                        }
+                        --this->unloads_pending_;
+                    });
+            }
+            return;
+        }
+    #endif
+        
+        unsigned int k = 0;
+        try
+        {
+            for(; k < to_unload.size(); ++k)
+                unloadLockedChunk(to_unload[k].handle, false);
+        }
+        catch(...)
+        {
+            // the remaining chunks are still loaded => give them back to the cache
+            threading::lock_guard<threading::mutex> guard(*chunk_lock_);
+            for(++k; k < to_unload.size(); ++k)
+            {
+                to_unload[k].handle->chunk_state_.store(0);
+                cache_.push(to_unload[k].handle, to_unload[k].bytes);
+            }
+            throw;
         }
     }
     
@@ -1798,6 +2187,9 @@ class ChunkedArray
     void releaseChunks(shape_type const & start, shape_type const & stop, bool destroy = false)
     {
         checkSubarrayBounds(start, stop, "ChunkedArray::releaseChunks()");
+        
+        // chunks being unloaded in the background cannot be released
+        waitForUnloading();
                            
         MultiCoordinateIterator<N> i(chunkStart(start), chunkStop(stop)),
                                    end(i.getEndIterator());
@@ -1818,13 +2210,115 @@ class ChunkedArray
         
         // remove all chunks from the cache that are asleep or unitialized
         threading::lock_guard<threading::mutex> guard(*chunk_lock_);
-        int cache_size = cache_.size();
-        for(int k=0; k < cache_size; ++k)
+        cache_.removeUnloaded();
+    }
+    
+        // Start loading all chunks overlapping the ROI [start, stop) into the cache, 
+        // using background threads (see ChunkedArrayOptions::prefetchThreads()). 
+        // The function returns immediately, and subsequent accesses to these chunks 
+        // find them in memory (unless the cache is too small to hold them). 
+        // Chunks which have never been written are not loaded.
+    void prefetch(shape_type const & start, shape_type const & stop) const
+    {
+        checkSubarrayBounds(start, stop, "ChunkedArray::prefetch()");
+        
+        shape_type chunk_start(chunkStart(start));
+        MultiCoordinateIterator<N> i(chunk_start, chunkStop(stop)),
+                                   end(i.getEndIterator());
+        for(; i != end; ++i)
+            prefetchChunk(chunk_start + *i);
+    }
+    
+        // Block until all prefetch requests issued so far are finished.
+        // If loading of a chunk failed, the exception is re-thrown here.
+    void waitForPrefetch() const
+    {
+    #ifndef VIGRA_SINGLE_THREADED
+        if(prefetch_pool_)
+            prefetch_pool_->waitFinished();
+    #endif
+    }
+    
+    virtual void prefetchForIterator(shape_type const & point, 
+                                     IteratorChunkHandle<N, T> const * h) const
+    {
+        shape_type global_point = point + h->offset_;
+        if(this->isInside(global_point))
+            prefetchChunk(chunkStart(global_point));
+    }
+    
+    void prefetchChunk(shape_type const & chunk_index) const
+    {
+        // nothing to do if the chunk is already in memory or was never written
+        long rc = handle_array_[chunk_index].chunk_state_.load();
+        if(rc >= 0 || rc == chunk_uninitialized || rc == chunk_failed)
+            return;
+    #ifndef VIGRA_SINGLE_THREADED
+        if(prefetch_threads_ != 0)
+        {
+            ChunkedArray * self = const_cast<ChunkedArray *>(this);
+            {
+                threading::lock_guard<threading::mutex> guard(*chunk_lock_);
+                if(!prefetch_pool_)
+                    self->prefetch_pool_.reset(new ThreadPool(prefetch_threads_));
+            }
+            prefetch_pool_->enqueue(
+                [self, chunk_index](int /* thread_id */)
+                {
+                    self->loadForPrefetch(chunk_index);
+                });
+            return;
+        }
+    #endif
+        const_cast<ChunkedArray *>(this)->loadForPrefetch(chunk_index);
+    }
+    
+    void loadForPrefetch(shape_type const & chunk_index)
+    {
+        Handle * handle = lookupHandle(chunk_index);
+        long rc = handle->chunk_state_.load();
+        if(rc >= 0 || rc == chunk_uninitialized || rc == chunk_failed)
+            return;
+        getChunk(handle, false, true, chunk_index);
+        unrefChunk(handle);
+    }
+    
+        // Wait until pending prefetch requests are finished. Derived classes must
+        // call this in their destructor, before the chunks are deleted.
+    void stopPrefetching()
+    {
+        try
         {
-            Handle * handle = cache_.front();
-            cache_.pop();
-            if(handle->chunk_state_.load() >= 0)
-                cache_.push(handle);
+            waitForPrefetch();
+        }
+        catch(...)
+        {
+            // errors are irrelevant now
+        }
+    }
+    
+        // Block until all chunks evicted from the cache have been unloaded
+        // by the background threads (see backgroundUnloadThreads()). If unloading 
+        // of a chunk failed, the exception is re-thrown here.
+    void waitForUnloading() const
+    {
+    #ifndef VIGRA_SINGLE_THREADED
+        if(unload_pool_)
+            unload_pool_->waitFinished();
+    #endif
+    }
+    
+        // Like stopPrefetching(), but for background unloading. Derived classes 
+        // which enable background unloading must call this in their destructor.
+    void stopBackgroundUnloading()
+    {
+        try
+        {
+            waitForUnloading();
+        }
+        catch(...)
+        {
+            // errors are irrelevant now
         }
     }
     
@@ -2025,11 +2519,21 @@ class ChunkedArray
     void setCacheMaxSize(std::size_t c)
     {
         cache_max_size_ = c;
-        if(c < cache_.size())
-        {
-            threading::lock_guard<threading::mutex> guard(*chunk_lock_);
-            cleanCache();
-        }
+        // cleanCache() checks the cache size while holding chunk_lock_
+        cleanCache();
+    }
+    
+        // maximum number of bytes held by the cache (zero means 'unlimited')
+    std::size_t cacheMaxBytes() const
+    {
+        return cache_max_bytes_;
+    }
+    
+    void setCacheMaxBytes(std::size_t c)
+    {
+        cache_max_bytes_ = c;
+        // cleanCache() checks the cache size while holding chunk_lock_
+        cleanCache();
     }
     
     iterator begin()
@@ -2097,6 +2601,7 @@ class ChunkedArray
     
     shape_type bits_, mask_;
     int cache_max_size_;
+    std::size_t cache_max_bytes_;
     VIGRA_SHARED_PTR<threading::mutex> chunk_lock_;
     CacheType cache_;
     Chunk fill_value_chunk_;
@@ -2104,7 +2609,12 @@ class ChunkedArray
     value_type fill_value_;
     double fill_scalar_;
     MultiArray<N, Handle> handle_array_;
-    std::size_t data_bytes_, overhead_bytes_; 
+    threading::atomic<std::size_t> data_bytes_, overhead_bytes_; 
+    threading::atomic<std::size_t> cache_hits_, cache_misses_, unloads_pending_;
+    int prefetch_threads_;
+#ifndef VIGRA_SINGLE_THREADED
+    VIGRA_SHARED_PTR<ThreadPool> prefetch_pool_, unload_pool_;
+#endif
 };
 
 /** Returns a CoupledScanOrderIterator to simultaneously iterate over image m1 and its coordinates. 
@@ -2345,6 +2855,7 @@ class ChunkedArrayLazy
     
     ~ChunkedArrayLazy()
     {
+        this->stopPrefetching();
         typename ChunkStorage::iterator i   = this->handle_array_.begin(), 
                                         end = this->handle_array_.end();
         for(; i != end; ++i)
@@ -2410,6 +2921,7 @@ class ChunkedArrayCompressed
         Chunk(shape_type const & shape)
         : ChunkBase<N, T>(detail::defaultStride(shape))
         , compressed_()
+        , block_ends_()
         , size_(prod(shape))
         {}
         
@@ -2430,16 +2942,56 @@ class ChunkedArrayCompressed
             detail::destroy_dealloc_n(this->pointer_, size_, alloc_);
             this->pointer_ = 0;
             compressed_.clear();
+            block_ends_.clear();
+        }
+        
+            // number of array elements in each independently compressed block
+        MultiArrayIndex blockLength(std::size_t block_size) const
+        {
+            if(block_size == 0)
+                return size_;
+            return std::max<MultiArrayIndex>(1, block_size / sizeof(T));
         }
                 
-        void compress(CompressionMethod method)
+        void compress(CompressionMethod method, 
+                      std::size_t block_size = 0, int threads = ParallelOptions::NoThreads)
         {
             if(this->pointer_ != 0)
             {
                 vigra_invariant(compressed_.size() == 0,
                     "ChunkedArrayCompressed::Chunk::compress(): compressed and uncompressed pointer are both non-zero.");
 
-                ::vigra::compress((char const *)this->pointer_, size_*sizeof(T), compressed_, method);
+                MultiArrayIndex block_length = blockLength(block_size),
+                                block_count  = (size_ + block_length - 1) / block_length;
+                if(block_count <= 1)
+                {
+                    ::vigra::compress((char const *)this->pointer_, size_*sizeof(T), compressed_, method, sizeof(T));
+                }
+                else
+                {
+                    // compress the blocks in parallel and concatenate the results
+                    ArrayVector<ArrayVector<char> > blocks(block_count);
+                    pointer data = this->pointer_;
+                    MultiArrayIndex size = size_;
+                    parallel_foreach((MultiArrayIndex)0, block_count,
+                        [&blocks, data, size, block_length, method](int /* thread_id */, MultiArrayIndex k)
+                        {
+                            MultiArrayIndex begin = k*block_length,
+                                            end   = std::min(begin + block_length, size);
+                            ::vigra::compress((char const *)(data + begin), (end - begin)*sizeof(T), 
+                                              blocks[k], method, sizeof(T));
+                        },
+                        ParallelOptions().numThreads(threads));
+                    
+                    std::size_t total = 0;
+                    block_ends_.resize(block_count);
+                    for(MultiArrayIndex k=0; k<block_count; ++k)
+                        block_ends_[k] = total += blocks[k].size();
+                    compressed_.resize(total);
+                    for(MultiArrayIndex k=0; k<block_count; ++k)
+                        std::copy(blocks[k].begin(), blocks[k].end(), 
+                                  compressed_.begin() + (block_ends_[k] - blocks[k].size()));
+                }
 
                 // std::cerr << "compression ratio: " << double(compressed_.size())/(this->size()*sizeof(T)) << "\n";
                 detail::destroy_dealloc_n(this->pointer_, size_, alloc_);
@@ -2447,7 +2999,8 @@ class ChunkedArrayCompressed
             }
         }
         
-        pointer uncompress(CompressionMethod method)
+        pointer uncompress(CompressionMethod method, 
+                           std::size_t block_size = 0, int threads = ParallelOptions::NoThreads)
         {
             if(this->pointer_ == 0)
             {
@@ -2455,8 +3008,33 @@ class ChunkedArrayCompressed
                 {
                     this->pointer_ = alloc_.allocate((typename Alloc::size_type)size_);
 
-                    ::vigra::uncompress(compressed_.data(), compressed_.size(), 
-                                        (char*)this->pointer_, size_*sizeof(T), method);
+                    if(block_ends_.size() == 0)
+                    {
+                        ::vigra::uncompress(compressed_.data(), compressed_.size(), 
+                                            (char*)this->pointer_, size_*sizeof(T), method, sizeof(T));
+                    }
+                    else
+                    {
+                        MultiArrayIndex block_length = blockLength(block_size);
+                        vigra_invariant((MultiArrayIndex)block_ends_.size() == (size_ + block_length - 1) / block_length,
+                            "ChunkedArrayCompressed::Chunk::uncompress(): block size changed after compression.");
+                        ArrayVector<std::size_t> const & block_ends = block_ends_;
+                        char const * source = compressed_.data();
+                        pointer data = this->pointer_;
+                        MultiArrayIndex size = size_;
+                        parallel_foreach((MultiArrayIndex)0, (MultiArrayIndex)block_ends_.size(),
+                            [&block_ends, source, data, size, block_length, method](int /* thread_id */, MultiArrayIndex k)
+                            {
+                                std::size_t src_begin = k == 0 ? 0 : block_ends[k-1];
+                                MultiArrayIndex begin = k*block_length,
+                                                end   = std::min(begin + block_length, size);
+                                ::vigra::uncompress(source + src_begin, block_ends[k] - src_begin,
+                                                    (char*)(data + begin), (end - begin)*sizeof(T), 
+                                                    method, sizeof(T));
+                            },
+                            ParallelOptions().numThreads(threads));
+                        block_ends_.clear();
+                    }
                     compressed_.clear();
                 }
                 else
@@ -2473,6 +3051,7 @@ class ChunkedArrayCompressed
         }
         
         ArrayVector<char> compressed_;
+        ArrayVector<std::size_t> block_ends_; // end of each block in compressed_ (empty: single block)
         MultiArrayIndex size_;
         Alloc alloc_;
         
@@ -2490,7 +3069,9 @@ class ChunkedArrayCompressed
                                     shape_type const & chunk_shape=shape_type(),
                                     ChunkedArrayOptions const & options = ChunkedArrayOptions())
     : ChunkedArray<N, T>(shape, chunk_shape, options),
-       compression_method_(options.compression_method)
+       compression_method_(options.compression_method),
+       compression_threads_(options.compression_threads),
+       compression_block_size_(options.compression_block_size)
     {
         if(compression_method_ == DEFAULT_COMPRESSION)
             compression_method_ = LZ4;
@@ -2498,6 +3079,8 @@ class ChunkedArrayCompressed
     
     ~ChunkedArrayCompressed()
     {
+        this->stopPrefetching();
+        this->stopBackgroundUnloading();
         typename ChunkStorage::iterator i   = this->handle_array_.begin(), 
                                         end = this->handle_array_.end();
         for(; i != end; ++i)
@@ -2515,7 +3098,8 @@ class ChunkedArrayCompressed
             *p = new Chunk(this->chunkShape(index));
             this->overhead_bytes_ += sizeof(Chunk);
         }
-        return static_cast<Chunk *>(*p)->uncompress(compression_method_);
+        return static_cast<Chunk *>(*p)->uncompress(compression_method_, 
+                                                    compression_block_size_, compression_threads_);
     }
     
     virtual bool unloadChunk(ChunkBase<N, T> * chunk, bool destroy)
@@ -2523,25 +3107,37 @@ class ChunkedArrayCompressed
         if(destroy)
             static_cast<Chunk *>(chunk)->deallocate();
         else
-            static_cast<Chunk *>(chunk)->compress(compression_method_);
+            static_cast<Chunk *>(chunk)->compress(compression_method_, 
+                                                  compression_block_size_, compression_threads_);
         return destroy;
     }
     
+    virtual int backgroundUnloadThreads() const
+    {
+        // a single thread suffices, because large chunks are compressed in parallel anyway
+        return compression_threads_ == ParallelOptions::NoThreads ? 0 : 1;
+    }
+    
     virtual std::string backend() const
     {
-        switch(compression_method_)
+        std::string shuffle = (compression_method_ & SHUFFLE) ? "SHUFFLE_" : "";
+        int method = compression_method_ & ~SHUFFLE;
+        switch(method)
         {
           case ZLIB:
-            return "ChunkedArrayCompressed<ZLIB>";
+            return "ChunkedArrayCompressed<" + shuffle + "ZLIB>";
           case ZLIB_NONE:
-            return "ChunkedArrayCompressed<ZLIB_NONE>";
+            return "ChunkedArrayCompressed<" + shuffle + "ZLIB_NONE>";
           case ZLIB_FAST:
-            return "ChunkedArrayCompressed<ZLIB_FAST>";
+            return "ChunkedArrayCompressed<" + shuffle + "ZLIB_FAST>";
           case ZLIB_BEST:
-            return "ChunkedArrayCompressed<ZLIB_BEST>";
+            return "ChunkedArrayCompressed<" + shuffle + "ZLIB_BEST>";
           case LZ4:
-            return "ChunkedArrayCompressed<LZ4>";
+            return "ChunkedArrayCompressed<" + shuffle + "LZ4>";
           default:
+            if(method >= ZSTD_FAST && method < ZSTD_FAST + 22)
+                return "ChunkedArrayCompressed<" + shuffle + "ZSTD" + 
+                       asString(method - ZSTD_FAST + 1) + ">";
             return "unknown";
         }
     }
@@ -2559,6 +3155,8 @@ class ChunkedArrayCompressed
     }
         
     CompressionMethod compression_method_;
+    int compression_threads_;
+    std::size_t compression_block_size_;
 };
 
 template <unsigned int N, class T>
@@ -2711,6 +3309,7 @@ class ChunkedArrayTmpFile
     
     ~ChunkedArrayTmpFile()
     {
+        this->stopPrefetching();
         typename ChunkStorage::iterator  i = this->handle_array_.begin(), 
                                          end = this->handle_array_.end();
         for(; i != end; ++i)
@@ -2734,6 +3333,8 @@ class ChunkedArrayTmpFile
             shape_type shape = this->chunkShape(index);
             std::size_t chunk_size = computeAllocSize(shape);
         #ifdef VIGRA_NO_SPARSE_FILE
+            // chunks may be loaded concurrently => serialize file resizing
+            threading::lock_guard<threading::mutex> guard(*this->chunk_lock_);
             std::size_t offset = file_size_;
             if(offset + chunk_size > file_capacity_)
             {
@@ -3072,6 +3673,8 @@ class ChunkIterator
     ChunkIterator() 
     : base_type()
     , base_type2()
+    , array_(0)
+    , prefetch_(0)
     {}
 
     ChunkIterator(array_type * array, 
@@ -3084,6 +3687,7 @@ class ChunkIterator
     , start_(start - chunk_.offset_)
     , stop_(end - chunk_.offset_)
     , chunk_shape_(chunk_shape)
+    , prefetch_(0)
     {
         getChunk();
     }
@@ -3096,20 +3700,31 @@ class ChunkIterator
     , start_(rhs.start_)
     , stop_(rhs.stop_)
     , chunk_shape_(rhs.chunk_shape_)
+    , prefetch_(rhs.prefetch_)
     {
         getChunk();
     }
 
+    ~ChunkIterator()
+    {
+        // deref the present chunk
+        if(array_)
+            array_->unrefChunk(&chunk_);
+    }
+
     ChunkIterator & operator=(ChunkIterator const & rhs)
     {
         if(this != &rhs)
         {
+            if(array_)
+                array_->unrefChunk(&chunk_);
             base_type::operator=(rhs);
             array_ = rhs.array_;
             chunk_ = rhs.chunk_;
             start_ = rhs.start_;
             stop_ = rhs.stop_;
             chunk_shape_ = rhs.chunk_shape_;
+            prefetch_ = rhs.prefetch_;
             getChunk();
         }
         return *this;
@@ -3139,15 +3754,46 @@ class ChunkIterator
     {
         return *(ChunkIterator(*this) += i);
     }
+    
+        // Load the next 'count' chunks (in iteration order) in the background
+        // whenever the iterator moves, so that they are already in the cache 
+        // when the iterator gets there. The cache should be able to hold
+        // at least 'count' + 1 chunks.
+    ChunkIterator & prefetch(int count)
+    {
+        prefetch_ = 0;
+        for(int k=1; k<=count; ++k)
+            prefetchChunk(k);
+        prefetch_ = count;
+        return *this;
+    }
+    
+    void prefetchChunk(MultiArrayIndex distance)
+    {
+        base_type ahead(*this);
+        ahead += distance;
+        if(ahead.isValid())
+            array_->prefetchForIterator(max(start_, ahead.point()*chunk_shape_), &chunk_);
+    }
 
     void getChunk()
     {
         if(array_)
         {
+            if(!this->isValid())
+            {
+                // don't hold (or load) a chunk outside of the iteration range
+                array_->unrefChunk(&chunk_);
+                this->m_ptr = 0;
+                this->m_shape = shape_type();
+                return;
+            }
             shape_type array_point = max(start_, this->point()*chunk_shape_),
                        upper_bound(SkipInitialization);
             this->m_ptr = array_->chunkForIterator(array_point, this->m_stride, upper_bound, &chunk_);
             this->m_shape = min(upper_bound, stop_) - array_point;
+            if(prefetch_ > 0)
+                prefetchChunk(prefetch_);
         }
     }
     
@@ -3252,6 +3898,7 @@ class ChunkIterator
     array_type * array_;
     Chunk chunk_;
     shape_type start_, stop_, chunk_shape_, array_point_;
+    int prefetch_;
 };
 
 } // namespace vigra
@@ -87,6 +87,8 @@ class ChunkedArrayHDF5
         
         void write(bool deallocate = true)
         {
+            // chunks are loaded concurrently, but the HDF5 library is not thread-safe
+            threading::lock_guard<threading::mutex> guard(*array_->file_lock_);
             if(this->pointer_ != 0)
             {
                 if(!array_->file_.isReadOnly())
@@ -106,6 +108,7 @@ class ChunkedArrayHDF5
         
         pointer read()
         {
+            threading::lock_guard<threading::mutex> guard(*array_->file_lock_);
             if(this->pointer_ == 0)
             {
                 this->pointer_ = alloc_.allocate(this->size());
@@ -143,7 +146,8 @@ class ChunkedArrayHDF5
       dataset_name_(dataset),
       dataset_(),
       compression_(options.compression_method),
-      alloc_(alloc)
+      alloc_(alloc),
+      file_lock_(new threading::mutex())
     {
         init(mode);
     }
@@ -157,7 +161,8 @@ class ChunkedArrayHDF5
       dataset_name_(dataset),
       dataset_(),
       compression_(options.compression_method),
-      alloc_(alloc)
+      alloc_(alloc),
+      file_lock_(new threading::mutex())
     {
         init(mode);
     }
@@ -208,9 +213,6 @@ class ChunkedArrayHDF5
             // chunks as are needed for a single array chunk.
             if(compression_ == DEFAULT_COMPRESSION)
                 compression_ = ZLIB_FAST;
-            vigra_precondition(compression_ != LZ4,
-                "ChunkedArrayHDF5(): HDF5 does not support LZ4 compression.");
-            
             vigra_precondition(this->size() > 0,
                 "ChunkedArrayHDF5(): invalid shape.");
             typename detail::HDF5TypeTraits<T>::value_type init(this->fill_scalar_);
@@ -281,6 +283,7 @@ class ChunkedArrayHDF5
     
     void closeImpl(bool force_destroy)
     {
+        this->stopPrefetching();
         flushToDiskImpl(true, force_destroy);
         file_.close();
     }
@@ -322,6 +325,7 @@ class ChunkedArrayHDF5
                 chunk->write(false);
             }
         }
+        threading::lock_guard<threading::mutex> file_guard(*file_lock_);
         file_.flushToDisk();
     }
     
@@ -382,6 +386,7 @@ class ChunkedArrayHDF5
     HDF5HandleShared dataset_;
     CompressionMethod compression_;
     Alloc alloc_;
+    VIGRA_SHARED_PTR<threading::mutex> file_lock_;
 };
 
 } // namespace vigra
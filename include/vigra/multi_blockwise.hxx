@@ -0,0 +1,1773 @@
+/************************************************************************/
+/*                                                                      */
+/*                 Copyright 2015 by Ullrich Koethe                     */
+/*                                                                      */
+/*    This file is part of the VIGRA computer vision library.           */
+/*    The VIGRA Website is                                              */
+/*        http://hci.iwr.uni-heidelberg.de/vigra/                       */
+/*    Please direct questions, bug reports, and contributions to        */
+/*        ullrich.koethe@iwr.uni-heidelberg.de    or                    */
+/*        vigra@informatik.uni-hamburg.de                               */
+/*                                                                      */
+/*    Permission is hereby granted, free of charge, to any person       */
+/*    obtaining a copy of this software and associated documentation    */
+/*    files (the "Software"), to deal in the Software without           */
+/*    restriction, including without limitation the rights to use,      */
+/*    copy, modify, merge, publish, distribute, sublicense, and/or      */
+/*    sell copies of the Software, and to permit persons to whom the    */
+/*    Software is furnished to do so, subject to the following          */
+/*    conditions:                                                       */
+/*                                                                      */
+/*    The above copyright notice and this permission notice shall be    */
+/*    included in all copies or substantial portions of the             */
+/*    Software.                                                         */
+/*                                                                      */
+/*    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND    */
+/*    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES   */
+/*    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND          */
+/*    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT       */
+/*    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,      */
+/*    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING      */
+/*    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR     */
+/*    OTHER DEALINGS IN THE SOFTWARE.                                   */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef VIGRA_MULTI_BLOCKWISE_HXX
+#define VIGRA_MULTI_BLOCKWISE_HXX
+
+#include <cmath>
+#include "multi_array.hxx"
+#include "multi_array_chunked.hxx"
+#include "multi_convolution.hxx"
+#include "multi_distance.hxx"
+#include "threadpool.hxx"
+
+namespace vigra {
+
+/** \addtogroup ParallelProcessing
+*/
+//@{
+
+    /** \brief Option object for blockwise parallel algorithms.
+
+        In addition to the options of \ref ParallelOptions, this object
+        determines the shape of the blocks the array is split into. The
+        block shape can be given for all dimensions at once (a single number)
+        or per axis. When no block shape is given, blocks of about 2<sup>18</sup>
+        elements are used (e.g. 512<sup>2</sup> in 2D and 64<sup>3</sup> in 3D).
+
+        <b>\#include</b> \<vigra/multi_blockwise.hxx\><br>
+        Namespace: vigra
+    */
+class BlockwiseOptions
+: public ParallelOptions
+{
+  public:
+    BlockwiseOptions()
+    : ParallelOptions()
+    , block_shape_()
+    {}
+
+        /** Use blocks of shape <tt>s</tt> (the size of <tt>s</tt> must match the
+            array dimension, or <tt>s</tt> must contain a single value).
+        */
+    BlockwiseOptions & blockShape(ArrayVector<MultiArrayIndex> const & s)
+    {
+        block_shape_ = s;
+        return *this;
+    }
+
+    template <int N>
+    BlockwiseOptions & blockShape(TinyVector<MultiArrayIndex, N> const & s)
+    {
+        block_shape_ = ArrayVector<MultiArrayIndex>(s.begin(), s.end());
+        return *this;
+    }
+
+        /** Use blocks of shape <tt>(s, s, ..., s)</tt>.
+        */
+    BlockwiseOptions & blockShape(MultiArrayIndex s)
+    {
+        block_shape_ = ArrayVector<MultiArrayIndex>(1, s);
+        return *this;
+    }
+
+    BlockwiseOptions & numThreads(int n)
+    {
+        ParallelOptions::numThreads(n);
+        return *this;
+    }
+
+        /** Get the block shape as specified by the user (empty if unspecified).
+        */
+    ArrayVector<MultiArrayIndex> const & getBlockShape() const
+    {
+        return block_shape_;
+    }
+
+        /** Get the block shape for an N-dimensional array, resolving defaults.
+        */
+    template <int N>
+    TinyVector<MultiArrayIndex, N> getBlockShapeN() const
+    {
+        TinyVector<MultiArrayIndex, N> res;
+        if(block_shape_.size() == 0)
+        {
+            res = std::max<MultiArrayIndex>(1, (MultiArrayIndex)std::floor(std::pow(262144.0, 1.0 / N) + 0.5));
+        }
+        else if(block_shape_.size() == 1)
+        {
+            res = block_shape_[0];
+        }
+        else
+        {
+            vigra_precondition(block_shape_.size() == (unsigned int)N,
+                "BlockwiseOptions::getBlockShapeN(): dimension mismatch between block shape and array.");
+            std::copy(block_shape_.begin(), block_shape_.end(), res.begin());
+        }
+        for(int k=0; k<N; ++k)
+            vigra_precondition(res[k] > 0,
+                "BlockwiseOptions::getBlockShapeN(): block shape must be positive.");
+        return res;
+    }
+
+  private:
+    ArrayVector<MultiArrayIndex> block_shape_;
+};
+
+    /** \brief Option object for blockwise parallel convolution.
+
+        Combines \ref ConvolutionOptions (scales, step size, window size, ROI)
+        with \ref BlockwiseOptions (block shape, number of threads). Passing this object
+        instead of a plain <tt>ConvolutionOptions</tt> to one of the filters in
+        multi_blockwise.hxx selects the blockwise parallel implementation.
+        Since the setters of <tt>ConvolutionOptions</tt> return the base class,
+        the object should be configured in separate statements:
+
+        \code
+        BlockwiseConvolutionOptions<3> opt;
+        opt.stepSize(1.0, 1.0, 3.5);
+        opt.blockShape(Shape3(128, 128, 32)).numThreads(8);
+        gaussianSmoothMultiArray(src, dest, 2.0, opt);
+        \endcode
+
+        <b>\#include</b> \<vigra/multi_blockwise.hxx\><br>
+        Namespace: vigra
+    */
+template <unsigned int N>
+class BlockwiseConvolutionOptions
+: public ConvolutionOptions<N>
+, public BlockwiseOptions
+{
+  public:
+    BlockwiseConvolutionOptions()
+    {}
+
+    BlockwiseConvolutionOptions(ConvolutionOptions<N> const & opt)
+    : ConvolutionOptions<N>(opt)
+    {}
+};
+
+namespace detail {
+
+    /* Call 'f(threadId, start, stop)' for all blocks of an array of the given shape.
+    */
+template <int N, class FUNCTOR>
+void
+blockwiseForeach(TinyVector<MultiArrayIndex, N> const & shape,
+                 TinyVector<MultiArrayIndex, N> const & blockShape,
+                 FUNCTOR && f,
+                 ParallelOptions const & options)
+{
+    typedef TinyVector<MultiArrayIndex, N> Shape;
+
+    Shape blocks;
+    for(int k=0; k<N; ++k)
+    {
+        if(shape[k] <= 0)
+            return;
+        blocks[k] = (shape[k] + blockShape[k] - 1) / blockShape[k];
+    }
+
+    parallel_foreach((MultiArrayIndex)0, prod(blocks),
+        [&](int thread_id, MultiArrayIndex i)
+        {
+            Shape b;
+            detail::ScanOrderToCoordinate<N>::exec(i, blocks, b);
+            Shape start = b*blockShape,
+                  stop  = min(shape, start + blockShape);
+            f(thread_id, start, stop);
+        },
+        options);
+}
+
+template <class KernelIterator>
+void
+checkBlockwiseBorderTreatment(KernelIterator kit, int N, const char * function_name)
+{
+    for(int k=0; k<N; ++k, ++kit)
+    {
+        BorderTreatmentMode b = kit->borderTreatment();
+        vigra_precondition(b != BORDER_TREATMENT_WRAP && b != BORDER_TREATMENT_AVOID,
+            std::string(function_name) +
+            "(): blockwise convolution does not support BORDER_TREATMENT_WRAP and BORDER_TREATMENT_AVOID.");
+    }
+}
+
+    /* Compute the region of 'src' that influences the result in [start, stop).
+    */
+template <int N, class KernelIterator>
+void
+blockwiseHalo(TinyVector<MultiArrayIndex, N> const & shape, KernelIterator kit,
+              TinyVector<MultiArrayIndex, N> const & start, TinyVector<MultiArrayIndex, N> const & stop,
+              TinyVector<MultiArrayIndex, N> & hstart, TinyVector<MultiArrayIndex, N> & hstop)
+{
+    for(int k=0; k<N; ++k, ++kit)
+    {
+        hstart[k] = std::max<MultiArrayIndex>(0, start[k] - kit->right());
+        hstop[k]  = std::min<MultiArrayIndex>(shape[k], stop[k] - kit->left());
+    }
+}
+
+    /* Compute the separable convolution of 'src' in the region [start, stop) and write
+       it to 'dest' (whose shape must be 'stop - start'). The borders of 'src' are
+       treated as array borders, all other data needed for the block is read from 'src'.
+       The result is bit-identical to the corresponding part of
+       separableConvolveMultiArray(src, dest, kit): intermediate results are kept in
+       the same temporary type, the axes are processed in the same order, and
+       convolveLine() performs the same operations for every output element.
+    */
+template <unsigned int N, class T1, class S1,
+                          class T2, class S2,
+          class KernelIterator>
+void
+separableConvolveBlock(MultiArrayView<N, T1, S1> const & src,
+                       MultiArrayView<N, T2, S2> dest,
+                       KernelIterator kit,
+                       typename MultiArrayShape<N>::type const & start,
+                       typename MultiArrayShape<N>::type const & stop)
+{
+    typedef typename MultiArrayShape<N>::type Shape;
+    typedef typename NumericTraits<T2>::RealPromote TmpType;
+    typedef typename AccessorTraits<TmpType>::default_accessor TmpAccessor;
+    typedef typename MultiArrayView<N, T1, S1>::const_traverser SrcTraverser;
+    typedef typename MultiArray<N, TmpType>::traverser TmpTraverser;
+    typedef MultiArrayNavigator<SrcTraverser, N> SNavigator;
+    typedef MultiArrayNavigator<TmpTraverser, N> TNavigator;
+
+    vigra_precondition(dest.shape() == stop - start,
+        "separableConvolveBlock(): shape mismatch between block and output.");
+
+    Shape hstart, hstop;
+    blockwiseHalo(src.shape(), kit, start, stop, hstart, hstop);
+
+    MultiArray<N, TmpType> tmp(hstop - hstart);
+    TmpAccessor acc;
+
+    // core region of the block relative to the halo
+    Shape cstart = start - hstart,
+          cstop  = stop - hstart;
+
+    {
+        // first dimension: read from the source
+        MultiArrayView<N, T1, S1> const s = src.subarray(hstart, hstop);
+        SNavigator snav(s.traverser_begin(), s.shape(), 0);
+        TNavigator tnav(tmp.traverser_begin(), tmp.shape(), 0);
+
+        ArrayVector<TmpType> line(s.shape(0));
+
+        for( ; snav.hasMore(); snav++, tnav++ )
+        {
+            copyLine(snav.begin(), snav.end(), typename AccessorTraits<T1>::default_const_accessor(),
+                     line.begin(), acc);
+            convolveLine(srcIterRange(line.begin(), line.end(), acc),
+                         destIter(tnav.begin() + cstart[0], acc),
+                         kernel1d( *kit ), (int)cstart[0], (int)cstop[0]);
+        }
+        ++kit;
+    }
+
+    // further dimensions: only the block core of the already processed
+    // dimensions is needed
+    Shape lstart, lstop(tmp.shape());
+    lstart[0] = cstart[0];
+    lstop[0] = cstop[0];
+    for(unsigned int d = 1; d < N; ++d, ++kit)
+    {
+        TNavigator tnav(tmp.traverser_begin(), lstart, lstop, d);
+
+        convolveLinesInPlace(tnav, acc, (int)tmp.shape(d), *kit,
+                             (int)cstart[d], (int)cstop[d]);
+        lstart[d] = cstart[d];
+        lstop[d] = cstop[d];
+    }
+
+    copyMultiArray(srcMultiArrayRange(tmp.subarray(cstart, cstop)), destMultiArray(dest));
+}
+
+template <unsigned int N>
+void
+blockwiseROI(ConvolutionOptions<N> const & opt,
+             typename MultiArrayShape<N>::type const & srcShape,
+             typename MultiArrayShape<N>::type const & destShape,
+             typename MultiArrayShape<N>::type & roiStart,
+             const char * function_name)
+{
+    typedef typename MultiArrayShape<N>::type Shape;
+    if(opt.to_point != Shape())
+    {
+        Shape from = opt.from_point, to = opt.to_point;
+        detail::RelativeToAbsoluteCoordinate<N-1>::exec(srcShape, from);
+        detail::RelativeToAbsoluteCoordinate<N-1>::exec(srcShape, to);
+        vigra_precondition(destShape == (to - from),
+            std::string(function_name) + "(): shape mismatch between ROI and output.");
+        roiStart = from;
+    }
+    else
+    {
+        vigra_precondition(srcShape == destShape,
+            std::string(function_name) + "(): shape mismatch between input and output.");
+        roiStart = Shape();
+    }
+}
+
+template <unsigned int N, class T1, class S1,
+                          class T2, class S2,
+          class KernelIterator>
+void
+blockwiseSeparableConvolve(MultiArrayView<N, T1, S1> const & source,
+                           MultiArrayView<N, T2, S2> dest,
+                           KernelIterator kit,
+                           typename MultiArrayShape<N>::type const & roiStart,
+                           BlockwiseOptions const & options,
+                           const char * function_name)
+{
+    typedef typename MultiArrayShape<N>::type Shape;
+
+    checkBlockwiseBorderTreatment(kit, N, function_name);
+
+    blockwiseForeach(dest.shape(), options.template getBlockShapeN<N>(),
+        [&](int, Shape const & start, Shape const & stop)
+        {
+            separableConvolveBlock(source, dest.subarray(start, stop), kit,
+                                   roiStart + start, roiStart + stop);
+        },
+        options);
+}
+
+} // namespace detail
+
+/********************************************************/
+/*                                                      */
+/*        blockwise separableConvolveMultiArray         */
+/*                                                      */
+/********************************************************/
+
+/** \brief Blockwise parallel separable convolution of a multi-dimensional array.
+
+    <b> Declarations:</b>
+
+    \code
+    namespace vigra {
+        template <unsigned int N, class T1, class S1,
+                                  class T2, class S2,
+                  class KernelIterator>
+        void
+        separableConvolveMultiArray(MultiArrayView<N, T1, S1> const & source,
+                                    MultiArrayView<N, T2, S2> dest,
+                                    KernelIterator kit,
+                                    BlockwiseConvolutionOptions<N> const & opt);
+
+        template <unsigned int N, class T1, class S1,
+                                  class T2, class S2,
+                  class T>
+        void
+        separableConvolveMultiArray(MultiArrayView<N, T1, S1> const & source,
+                                    MultiArrayView<N, T2, S2> dest,
+                                    Kernel1D<T> const & kernel,
+                                    BlockwiseConvolutionOptions<N> const & opt);
+    }
+    \endcode
+
+    The destination is split into blocks according to <tt>opt.getBlockShapeN<N>()</tt>.
+    Every block is extended by a halo of the kernel radius (clipped at the array border),
+    convolved independently on the threads of the global thread pool, and only
+    the core of the block is written to <tt>dest</tt>. This requires only a temporary
+    of block size per thread instead of a full-size temporary. The result is
+    bit-identical to the sequential \ref separableConvolveMultiArray(). When the
+    computation is restricted to a ROI via <tt>opt.subarray()</tt>, the result is
+    bit-identical to the corresponding part of the full-array result (the sequential
+    ROI algorithm may process the axes in a different order and thus differ
+    by rounding errors). The kernels' border treatment
+    must not be <tt>BORDER_TREATMENT_WRAP</tt> or <tt>BORDER_TREATMENT_AVOID</tt>.
+    <tt>source</tt> and <tt>dest</tt> must not overlap.
+
+    <b> Usage:</b>
+
+    <b>\#include</b> \<vigra/multi_blockwise.hxx\><br/>
+    Namespace: vigra
+
+    \code
+    MultiArray<3, float> source(shape), dest(shape);
+    Kernel1D<double> gauss;
+    gauss.initGaussian(2.0);
+
+    BlockwiseConvolutionOptions<3> opt;
+    opt.blockShape(64).numThreads(8);
+    separableConvolveMultiArray(source, dest, gauss, opt);
+    \endcode
+*/
+doxygen_overloaded_function(template <...> void separableConvolveMultiArray)
+
+template <unsigned int N, class T1, class S1,
+                          class T2, class S2,
+          class KernelIterator>
+void
+separableConvolveMultiArray(MultiArrayView<N, T1, S1> const & source,
+                            MultiArrayView<N, T2, S2> dest,
+                            KernelIterator kit,
+                            BlockwiseConvolutionOptions<N> const & opt)
+{
+    typename MultiArrayShape<N>::type roiStart;
+    detail::blockwiseROI(opt, source.shape(), dest.shape(), roiStart, "separableConvolveMultiArray");
+    detail::blockwiseSeparableConvolve(source, dest, kit, roiStart, opt, "separableConvolveMultiArray");
+}
+
+template <unsigned int N, class T1, class S1,
+                          class T2, class S2,
+          class T>
+inline void
+separableConvolveMultiArray(MultiArrayView<N, T1, S1> const & source,
+                            MultiArrayView<N, T2, S2> dest,
+                            Kernel1D<T> const & kernel,
+                            BlockwiseConvolutionOptions<N> const & opt)
+{
+    ArrayVector<Kernel1D<T> > kernels(N, kernel);
+    separableConvolveMultiArray(source, dest, kernels.begin(), opt);
+}
+
+/********************************************************/
+/*                                                      */
+/*          blockwise gaussianSmoothMultiArray          */
+/*                                                      */
+/********************************************************/
+
+/** \brief Blockwise parallel Gaussian smoothing of a multi-dimensional array.
+
+    <b> Declarations:</b>
+
+    \code
+    namespace vigra {
+        template <unsigned int N, class T1, class S1,
+                                  class T2, class S2>
+        void
+        gaussianSmoothMultiArray(MultiArrayView<N, T1, S1> const & source,
+                                 MultiArrayView<N, T2, S2> dest,
+                                 BlockwiseConvolutionOptions<N> const & opt);
+
+        template <unsigned int N, class T1, class S1,
+                                  class T2, class S2>
+        void
+        gaussianSmoothMultiArray(MultiArrayView<N, T1, S1> const & source,
+                                 MultiArrayView<N, T2, S2> dest,
+                                 double sigma,
+                                 BlockwiseConvolutionOptions<N> opt);
+    }
+    \endcode
+
+    Same as the sequential \ref gaussianSmoothMultiArray(), but the array is processed
+    in blocks in parallel (see the blockwise \ref separableConvolveMultiArray() for
+    details). The halo of each block is derived from the Gaussian's radius, i.e. it
+    takes <tt>ConvolutionOptions::filterWindowSize()</tt> into account.
+
+    <b> Usage:</b>
+
+    <b>\#include</b> \<vigra/multi_blockwise.hxx\><br/>
+    Namespace: vigra
+
+    \code
+    MultiArray<3, float> source(shape), dest(shape);
+    gaussianSmoothMultiArray(source, dest, 2.0, BlockwiseConvolutionOptions<3>());
+    \endcode
+*/
+doxygen_overloaded_function(template <...> void gaussianSmoothMultiArray)
+
+template <unsigned int N, class T1, class S1,
+                          class T2, class S2>
+void
+gaussianSmoothMultiArray(MultiArrayView<N, T1, S1> const & source,
+                         MultiArrayView<N, T2, S2> dest,
+                         BlockwiseConvolutionOptions<N> const & opt)
+{
+    static const char * function_name = "gaussianSmoothMultiArray";
+
+    typename MultiArrayShape<N>::type roiStart;
+    detail::blockwiseROI(opt, source.shape(), dest.shape(), roiStart, function_name);
+
+    typename ConvolutionOptions<N>::ScaleIterator params = opt.scaleParams();
+    ArrayVector<Kernel1D<double> > kernels(N);
+    for (unsigned int dim = 0; dim < N; ++dim, ++params)
+        kernels[dim].initGaussian(params.sigma_scaled(function_name), 1.0, opt.window_ratio);
+
+    detail::blockwiseSeparableConvolve(source, dest, kernels.begin(), roiStart, opt, function_name);
+}
+
+template <unsigned int N, class T1, class S1,
+                          class T2, class S2>
+inline void
+gaussianSmoothMultiArray(MultiArrayView<N, T1, S1> const & source,
+                         MultiArrayView<N, T2, S2> dest,
+                         double sigma,
+                         BlockwiseConvolutionOptions<N> opt)
+{
+    opt.stdDev(sigma);
+    gaussianSmoothMultiArray(source, dest, opt);
+}
+
+/********************************************************/
+/*                                                      */
+/*         blockwise gaussianGradientMultiArray         */
+/*                                                      */
+/********************************************************/
+
+namespace detail {
+
+template <unsigned int N, class KernelType>
+void
+gaussianGradientKernels(ConvolutionOptions<N> const & opt,
+                        ArrayVector<ArrayVector<Kernel1D<KernelType> > > & kernels,
+                        const char * function_name)
+{
+    typedef typename ConvolutionOptions<N>::ScaleIterator ParamType;
+
+    ParamType params = opt.scaleParams();
+    ParamType params2(params);
+
+    ArrayVector<Kernel1D<KernelType> > plain_kernels(N);
+    for (unsigned int dim = 0; dim < N; ++dim, ++params)
+    {
+        double sigma = params.sigma_scaled(function_name);
+        plain_kernels[dim].initGaussian(sigma, 1.0, opt.window_ratio);
+    }
+
+    kernels.resize(N, plain_kernels);
+    for (unsigned int dim = 0; dim < N; ++dim, ++params2)
+    {
+        kernels[dim][dim].initGaussianDerivative(params2.sigma_scaled(), 1, 1.0, opt.window_ratio);
+        detail::scaleKernel(kernels[dim][dim], 1.0 / params2.step_size());
+    }
+}
+
+template <unsigned int N, class KernelType>
+void
+hessianOfGaussianKernels(ConvolutionOptions<N> const & opt,
+                         ArrayVector<ArrayVector<Kernel1D<KernelType> > > & kernels)
+{
+    typedef typename ConvolutionOptions<N>::ScaleIterator ParamType;
+
+    ParamType params_init = opt.scaleParams();
+
+    ArrayVector<Kernel1D<KernelType> > plain_kernels(N);
+    ParamType params(params_init);
+    for (unsigned int dim = 0; dim < N; ++dim, ++params)
+    {
+        double sigma = params.sigma_scaled("hessianOfGaussianMultiArray");
+        plain_kernels[dim].initGaussian(sigma, 1.0, opt.window_ratio);
+    }
+
+    kernels.resize(N*(N+1)/2, plain_kernels);
+    ParamType params_i(params_init);
+    for (unsigned int b=0, i=0; i<N; ++i, ++params_i)
+    {
+        ParamType params_j(params_i);
+        for (unsigned int j=i; j<N; ++j, ++b, ++params_j)
+        {
+            if(i == j)
+            {
+                kernels[b][i].initGaussianDerivative(params_i.sigma_scaled(), 2, 1.0, opt.window_ratio);
+            }
+            else
+            {
+                kernels[b][i].initGaussianDerivative(params_i.sigma_scaled(), 1, 1.0, opt.window_ratio);
+                kernels[b][j].initGaussianDerivative(params_j.sigma_scaled(), 1, 1.0, opt.window_ratio);
+            }
+            detail::scaleKernel(kernels[b][i], 1 / params_i.step_size());
+            detail::scaleKernel(kernels[b][j], 1 / params_j.step_size());
+        }
+    }
+}
+
+    /* Apply several kernel sets to the same input, writing the region [start, stop)
+       to the channels of 'dest'.
+    */
+template <unsigned int N, class T1, class S1,
+                          class T2, int M, class S2,
+          class KernelType>
+void
+multiChannelConvolveBlock(MultiArrayView<N, T1, S1> const & src,
+                          MultiArrayView<N, TinyVector<T2, M>, S2> dest,
+                          ArrayVector<ArrayVector<Kernel1D<KernelType> > > const & kernels,
+                          typename MultiArrayShape<N>::type const & start,
+                          typename MultiArrayShape<N>::type const & stop)
+{
+    for(int c=0; c<M; ++c)
+        separableConvolveBlock(src, dest.bindElementChannel(c), kernels[c].begin(), start, stop);
+}
+
+template <unsigned int N, class T1, class S1,
+                          class T2, int M, class S2,
+          class KernelType>
+void
+blockwiseMultiChannelConvolve(MultiArrayView<N, T1, S1> const & source,
+                              MultiArrayView<N, TinyVector<T2, M>, S2> dest,
+                              ArrayVector<ArrayVector<Kernel1D<KernelType> > > const & kernels,
+                              typename MultiArrayShape<N>::type const & roiStart,
+                              BlockwiseOptions const & options,
+                              const char * function_name)
+{
+    typedef typename MultiArrayShape<N>::type Shape;
+
+    for(int c=0; c<M; ++c)
+        checkBlockwiseBorderTreatment(kernels[c].begin(), N, function_name);
+
+    blockwiseForeach(dest.shape(), options.template getBlockShapeN<N>(),
+        [&](int, Shape const & start, Shape const & stop)
+        {
+            multiChannelConvolveBlock(source, dest.subarray(start, stop), kernels,
+                                      roiStart + start, roiStart + stop);
+        },
+        options);
+}
+
+} // namespace detail
+
+/** \brief Blockwise parallel Gaussian gradient of a multi-dimensional array.
+
+    <b> Declarations:</b>
+
+    \code
+    namespace vigra {
+        template <unsigned int N, class T1, class S1,
+                                  class T2, class S2>
+        void
+        gaussianGradientMultiArray(MultiArrayView<N, T1, S1> const & source,
+                                   MultiArrayView<N, TinyVector<T2, int(N)>, S2> dest,
+                                   BlockwiseConvolutionOptions<N> const & opt);
+
+        template <unsigned int N, class T1, class S1,
+                                  class T2, class S2>
+        void
+        gaussianGradientMultiArray(MultiArrayView<N, T1, S1> const & source,
+                                   MultiArrayView<N, TinyVector<T2, int(N)>, S2> dest,
+                                   double sigma,
+                                   BlockwiseConvolutionOptions<N> opt);
+    }
+    \endcode
+
+    Same as the sequential \ref gaussianGradientMultiArray(), but the array is processed
+    in blocks in parallel. All gradient components of a block are computed by the same
+    thread, so that the source block is read while it is still in cache.
+    The result is bit-identical to the sequential version.
+
+    <b>\#include</b> \<vigra/multi_blockwise.hxx\><br/>
+    Namespace: vigra
+*/
+doxygen_overloaded_function(template <...> void gaussianGradientMultiArray)
+
+template <unsigned int N, class T1, class S1,
+                          class T2, class S2>
+void
+gaussianGradientMultiArray(MultiArrayView<N, T1, S1> const & source,
+                           MultiArrayView<N, TinyVector<T2, int(N)>, S2> dest,
+                           BlockwiseConvolutionOptions<N> const & opt)
+{
+    typedef typename NumericTraits<T2>::RealPromote KernelType;
+    static const char * function_name = "gaussianGradientMultiArray";
+
+    typename MultiArrayShape<N>::type roiStart;
+    detail::blockwiseROI(opt, source.shape(), dest.shape(), roiStart, function_name);
+
+    ArrayVector<ArrayVector<Kernel1D<KernelType> > > kernels;
+    detail::gaussianGradientKernels(opt, kernels, function_name);
+
+    detail::blockwiseMultiChannelConvolve(source, dest, kernels, roiStart, opt, function_name);
+}
+
+template <unsigned int N, class T1, class S1,
+                          class T2, class S2>
+inline void
+gaussianGradientMultiArray(MultiArrayView<N, T1, S1> const & source,
+                           MultiArrayView<N, TinyVector<T2, int(N)>, S2> dest,
+                           double sigma,
+                           BlockwiseConvolutionOptions<N> opt)
+{
+    opt.stdDev(sigma);
+    gaussianGradientMultiArray(source, dest, opt);
+}
+
+/********************************************************/
+/*                                                      */
+/*        blockwise hessianOfGaussianMultiArray         */
+/*                                                      */
+/********************************************************/
+
+/** \brief Blockwise parallel Hessian of Gaussian of a multi-dimensional array.
+
+    <b> Declarations:</b>
+
+    \code
+    namespace vigra {
+        template <unsigned int N, class T1, class S1,
+                                  class T2, class S2>
+        void
+        hessianOfGaussianMultiArray(MultiArrayView<N, T1, S1> const & source,
+                                    MultiArrayView<N, TinyVector<T2, int(N*(N+1)/2)>, S2> dest,
+                                    BlockwiseConvolutionOptions<N> const & opt);
+
+        template <unsigned int N, class T1, class S1,
+                                  class T2, class S2>
+        void
+        hessianOfGaussianMultiArray(MultiArrayView<N, T1, S1> const & source,
+                                    MultiArrayView<N, TinyVector<T2, int(N*(N+1)/2)>, S2> dest,
+                                    double sigma,
+                                    BlockwiseConvolutionOptions<N> opt);
+    }
+    \endcode
+
+    Same as the sequential \ref hessianOfGaussianMultiArray(), but the array is processed
+    in blocks in parallel. The result is bit-identical to the sequential version.
+
+    <b>\#include</b> \<vigra/multi_blockwise.hxx\><br/>
+    Namespace: vigra
+*/
+doxygen_overloaded_function(template <...> void hessianOfGaussianMultiArray)
+
+template <unsigned int N, class T1, class S1,
+                          class T2, class S2>
+void
+hessianOfGaussianMultiArray(MultiArrayView<N, T1, S1> const & source,
+                            MultiArrayView<N, TinyVector<T2, int(N*(N+1)/2)>, S2> dest,
+                            BlockwiseConvolutionOptions<N> const & opt)
+{
+    typedef typename NumericTraits<T2>::RealPromote KernelType;
+    static const char * function_name = "hessianOfGaussianMultiArray";
+
+    typename MultiArrayShape<N>::type roiStart;
+    detail::blockwiseROI(opt, source.shape(), dest.shape(), roiStart, function_name);
+
+    ArrayVector<ArrayVector<Kernel1D<KernelType> > > kernels;
+    detail::hessianOfGaussianKernels(opt, kernels);
+
+    detail::blockwiseMultiChannelConvolve(source, dest, kernels, roiStart, opt, function_name);
+}
+
+template <unsigned int N, class T1, class S1,
+                          class T2, class S2>
+inline void
+hessianOfGaussianMultiArray(MultiArrayView<N, T1, S1> const & source,
+                            MultiArrayView<N, TinyVector<T2, int(N*(N+1)/2)>, S2> dest,
+                            double sigma,
+                            BlockwiseConvolutionOptions<N> opt)
+{
+    opt.stdDev(sigma);
+    hessianOfGaussianMultiArray(source, dest, opt);
+}
+
+/********************************************************/
+/*                                                      */
+/*         blockwise structureTensorMultiArray          */
+/*                                                      */
+/********************************************************/
+
+namespace detail {
+
+template <unsigned int N, class KernelType>
+void
+structureTensorKernels(ConvolutionOptions<N> const & opt,
+                       ArrayVector<ArrayVector<Kernel1D<KernelType> > > & innerKernels,
+                       ArrayVector<Kernel1D<double> > & outerKernels,
+                       const char * function_name)
+{
+    typedef typename MultiArrayShape<N>::type Shape;
+
+    // the sequential version computes the gradient on the entire array
+    ConvolutionOptions<N> innerOptions = opt;
+    innerOptions.subarray(Shape(), Shape());
+    ConvolutionOptions<N> outerOptions = opt.outerOptions();
+
+    gaussianGradientKernels(innerOptions, innerKernels, function_name);
+    for(unsigned int c=0; c<N; ++c)
+        checkBlockwiseBorderTreatment(innerKernels[c].begin(), N, function_name);
+
+    typename ConvolutionOptions<N>::ScaleIterator params = outerOptions.scaleParams();
+    outerKernels.resize(N);
+    for (unsigned int dim = 0; dim < N; ++dim, ++params)
+        outerKernels[dim].initGaussian(params.sigma_scaled(function_name), 1.0, opt.window_ratio);
+}
+
+    /* Compute the structure tensor of 'src' in the region [start, stop). The gradient
+       is computed in the block plus the halo of the outer kernel.
+    */
+template <unsigned int N, class T1, class S1,
+                          class T2, int M, class S2,
+          class KernelType>
+void
+structureTensorBlock(MultiArrayView<N, T1, S1> const & src,
+                     MultiArrayView<N, TinyVector<T2, M>, S2> dest,
+                     ArrayVector<ArrayVector<Kernel1D<KernelType> > > const & innerKernels,
+                     ArrayVector<Kernel1D<double> > const & outerKernels,
+                     typename MultiArrayShape<N>::type const & start,
+                     typename MultiArrayShape<N>::type const & stop)
+{
+    typedef typename MultiArrayShape<N>::type Shape;
+    typedef TinyVector<T2, M> DestType;
+    typedef TinyVector<KernelType, (int)N> GradientVector;
+
+    Shape gstart, gstop;
+    blockwiseHalo(src.shape(), outerKernels.begin(), start, stop, gstart, gstop);
+
+    MultiArray<N, GradientVector> gradient(gstop - gstart);
+    for(unsigned int c=0; c<N; ++c)
+        separableConvolveBlock(src, gradient.bindElementChannel(c),
+                               innerKernels[c].begin(), gstart, gstop);
+
+    MultiArray<N, DestType> gradientTensor(gstop - gstart);
+    transformMultiArray(srcMultiArrayRange(gradient), destMultiArray(gradientTensor),
+                        StructurTensorFunctor<N, DestType>());
+
+    // the borders of 'gradientTensor' are either array borders, or
+    // far enough away from the block
+    separableConvolveBlock(gradientTensor, dest, outerKernels.begin(),
+                           start - gstart, stop - gstart);
+}
+
+} // namespace detail
+
+/** \brief Blockwise parallel structure tensor of a multi-dimensional array.
+
+    <b> Declarations:</b>
+
+    \code
+    namespace vigra {
+        template <unsigned int N, class T1, class S1,
+                                  class T2, class S2>
+        void
+        structureTensorMultiArray(MultiArrayView<N, T1, S1> const & source,
+                                  MultiArrayView<N, TinyVector<T2, int(N*(N+1)/2)>, S2> dest,
+                                  BlockwiseConvolutionOptions<N> const & opt);
+
+        template <unsigned int N, class T1, class S1,
+                                  class T2, class S2>
+        void
+        structureTensorMultiArray(MultiArrayView<N, T1, S1> const & source,
+                                  MultiArrayView<N, TinyVector<T2, int(N*(N+1)/2)>, S2> dest,
+                                  double innerScale, double outerScale,
+                                  BlockwiseConvolutionOptions<N> opt);
+    }
+    \endcode
+
+    Same as the sequential \ref structureTensorMultiArray(), but the array is processed
+    in blocks in parallel. For each block, the gradient is computed in the block
+    extended by the radius of the outer (smoothing) kernel, so that the halo is the sum of
+    the inner and outer kernel radii. Only the scalar-valued source is currently supported.
+    The result is bit-identical to the sequential version.
+
+    <b>\#include</b> \<vigra/multi_blockwise.hxx\><br/>
+    Namespace: vigra
+*/
+doxygen_overloaded_function(template <...> void structureTensorMultiArray)
+
+template <unsigned int N, class T1, class S1,
+                          class T2, class S2>
+void
+structureTensorMultiArray(MultiArrayView<N, T1, S1> const & source,
+                          MultiArrayView<N, TinyVector<T2, int(N*(N+1)/2)>, S2> dest,
+                          BlockwiseConvolutionOptions<N> const & opt)
+{
+    typedef typename MultiArrayShape<N>::type Shape;
+    typedef typename NumericTraits<T2>::RealPromote KernelType;
+    static const char * function_name = "structureTensorMultiArray";
+
+    Shape roiStart;
+    detail::blockwiseROI(opt, source.shape(), dest.shape(), roiStart, function_name);
+
+    ArrayVector<ArrayVector<Kernel1D<KernelType> > > innerKernels;
+    ArrayVector<Kernel1D<double> > outerKernels;
+    detail::structureTensorKernels(opt, innerKernels, outerKernels, function_name);
+
+    detail::blockwiseForeach(dest.shape(), opt.template getBlockShapeN<N>(),
+        [&](int, Shape const & start, Shape const & stop)
+        {
+            detail::structureTensorBlock(source, dest.subarray(start, stop),
+                                         innerKernels, outerKernels,
+                                         roiStart + start, roiStart + stop);
+        },
+        opt);
+}
+
+template <unsigned int N, class T1, class S1,
+                          class T2, class S2>
+inline void
+structureTensorMultiArray(MultiArrayView<N, T1, S1> const & source,
+                          MultiArrayView<N, TinyVector<T2, int(N*(N+1)/2)>, S2> dest,
+                          double innerScale, double outerScale,
+                          BlockwiseConvolutionOptions<N> opt)
+{
+    opt.innerScale(innerScale).outerScale(outerScale);
+    structureTensorMultiArray(source, dest, opt);
+}
+
+/********************************************************/
+/*                                                      */
+/*           blockwise filters for ChunkedArray         */
+/*                                                      */
+/********************************************************/
+
+namespace detail {
+
+    /* Unless the user specified a block shape, blocks of chunked arrays coincide
+       with the chunks of the destination, so that every thread writes its own chunks.
+    */
+template <unsigned int N>
+typename MultiArrayShape<N>::type
+chunkedBlockShape(BlockwiseOptions const & options,
+                  typename MultiArrayShape<N>::type const & chunkShape)
+{
+    if(options.getBlockShape().size() == 0)
+        return chunkShape;
+    return options.template getBlockShapeN<N>();
+}
+
+    /* Call 'f(src, res, start, stop)' for all blocks of the chunked array 'dest'.
+       'src' holds a copy of the region [hstart, hstop) of 'source' as determined by
+       'halo(bstart, bstop, hstart, hstop)', [start, stop) is the position of the
+       block relative to 'src', and 'res' is committed to 'dest' afterwards.
+       Only chunks in the cache and the chunks currently copied are held in memory.
+    */
+template <unsigned int N, class T1, class T2, class HALO, class FUNCTOR>
+void
+chunkedBlockwiseForeach(ChunkedArray<N, T1> const & source,
+                        ChunkedArray<N, T2> & dest,
+                        typename MultiArrayShape<N>::type const & roiStart,
+                        BlockwiseOptions const & options,
+                        HALO halo, FUNCTOR f)
+{
+    typedef typename MultiArrayShape<N>::type Shape;
+
+    blockwiseForeach(dest.shape(), chunkedBlockShape<N>(options, dest.chunkShape()),
+        [&](int, Shape const & start, Shape const & stop)
+        {
+            Shape bstart = roiStart + start,
+                  bstop  = roiStart + stop,
+                  hstart, hstop;
+            halo(bstart, bstop, hstart, hstop);
+
+            MultiArray<N, T1> src(hstop - hstart);
+            source.checkoutSubarray(hstart, src);
+            MultiArray<N, T2> res(stop - start);
+            f(src, res, bstart - hstart, bstop - hstart);
+            dest.commitSubarray(start, res);
+        },
+        options);
+}
+
+template <unsigned int N, class KernelIterator>
+struct BlockwiseHalo
+{
+    typedef typename MultiArrayShape<N>::type Shape;
+
+    BlockwiseHalo(Shape const & shape, KernelIterator kit)
+    : shape_(shape)
+    , kit_(kit)
+    {}
+
+    void operator()(Shape const & start, Shape const & stop, Shape & hstart, Shape & hstop) const
+    {
+        blockwiseHalo(shape_, kit_, start, stop, hstart, hstop);
+    }
+
+    Shape shape_;
+    KernelIterator kit_;
+};
+
+    /* Union of the halos of several kernel sets.
+    */
+template <unsigned int N, class KernelType>
+struct MultiChannelBlockwiseHalo
+{
+    typedef typename MultiArrayShape<N>::type Shape;
+
+    MultiChannelBlockwiseHalo(Shape const & shape,
+                              ArrayVector<ArrayVector<Kernel1D<KernelType> > > const & kernels)
+    : shape_(shape)
+    , kernels_(kernels)
+    {}
+
+    void operator()(Shape const & start, Shape const & stop, Shape & hstart, Shape & hstop) const
+    {
+        hstart = start;
+        hstop  = stop;
+        for(unsigned int c=0; c<kernels_.size(); ++c)
+        {
+            Shape s, e;
+            blockwiseHalo(shape_, kernels_[c].begin(), start, stop, s, e);
+            hstart = min(hstart, s);
+            hstop  = max(hstop, e);
+        }
+    }
+
+    Shape shape_;
+    ArrayVector<ArrayVector<Kernel1D<KernelType> > > const & kernels_;
+};
+
+template <unsigned int N>
+struct NoBlockwiseHalo
+{
+    typedef typename MultiArrayShape<N>::type Shape;
+
+    void operator()(Shape const & start, Shape const & stop, Shape & hstart, Shape & hstop) const
+    {
+        hstart = start;
+        hstop  = stop;
+    }
+};
+
+template <unsigned int N, class T1, class T2, class KernelIterator>
+void
+chunkedSeparableConvolve(ChunkedArray<N, T1> const & source,
+                         ChunkedArray<N, T2> & dest,
+                         KernelIterator kit,
+                         BlockwiseConvolutionOptions<N> const & opt,
+                         const char * function_name)
+{
+    typedef typename MultiArrayShape<N>::type Shape;
+
+    Shape roiStart;
+    blockwiseROI(opt, source.shape(), dest.shape(), roiStart, function_name);
+    checkBlockwiseBorderTreatment(kit, N, function_name);
+
+    chunkedBlockwiseForeach(source, dest, roiStart, opt,
+        BlockwiseHalo<N, KernelIterator>(source.shape(), kit),
+        [&](MultiArray<N, T1> const & src, MultiArray<N, T2> & res,
+            Shape const & start, Shape const & stop)
+        {
+            separableConvolveBlock(src, res, kit, start, stop);
+        });
+}
+
+template <unsigned int N, class T1, class T2, int M, class KernelType>
+void
+chunkedMultiChannelConvolve(ChunkedArray<N, T1> const & source,
+                            ChunkedArray<N, TinyVector<T2, M> > & dest,
+                            ArrayVector<ArrayVector<Kernel1D<KernelType> > > const & kernels,
+                            BlockwiseConvolutionOptions<N> const & opt,
+                            const char * function_name)
+{
+    typedef typename MultiArrayShape<N>::type Shape;
+
+    Shape roiStart;
+    blockwiseROI(opt, source.shape(), dest.shape(), roiStart, function_name);
+
+    for(int c=0; c<M; ++c)
+        checkBlockwiseBorderTreatment(kernels[c].begin(), N, function_name);
+
+    chunkedBlockwiseForeach(source, dest, roiStart, opt,
+        MultiChannelBlockwiseHalo<N, KernelType>(source.shape(), kernels),
+        [&](MultiArray<N, T1> const & src, MultiArray<N, TinyVector<T2, M> > & res,
+            Shape const & start, Shape const & stop)
+        {
+            multiChannelConvolveBlock(src, res, kernels, start, stop);
+        });
+}
+
+} // namespace detail
+
+/** \brief Blockwise parallel filters for arrays that are too large for main memory.
+
+    <b> Declarations:</b>
+
+    \code
+    namespace vigra {
+        template <unsigned int N, class T1, class T2, class KernelIterator>
+        void
+        separableConvolveMultiArray(ChunkedArray<N, T1> const & source,
+                                    ChunkedArray<N, T2> & dest,
+                                    KernelIterator kit,
+                                    BlockwiseConvolutionOptions<N> const & opt);
+
+        template <unsigned int N, class T1, class T2, class T>
+        void
+        separableConvolveMultiArray(ChunkedArray<N, T1> const & source,
+                                    ChunkedArray<N, T2> & dest,
+                                    Kernel1D<T> const & kernel,
+                                    BlockwiseConvolutionOptions<N> const & opt);
+
+        template <unsigned int N, class T1, class T2>
+        void
+        gaussianSmoothMultiArray(ChunkedArray<N, T1> const & source,
+                                 ChunkedArray<N, T2> & dest,
+                                 double sigma,
+                                 BlockwiseConvolutionOptions<N> opt = BlockwiseConvolutionOptions<N>());
+
+        template <unsigned int N, class T1, class T2>
+        void
+        gaussianGradientMultiArray(ChunkedArray<N, T1> const & source,
+                                   ChunkedArray<N, TinyVector<T2, int(N)> > & dest,
+                                   double sigma,
+                                   BlockwiseConvolutionOptions<N> opt = BlockwiseConvolutionOptions<N>());
+
+        template <unsigned int N, class T1, class T2>
+        void
+        hessianOfGaussianMultiArray(ChunkedArray<N, T1> const & source,
+                                    ChunkedArray<N, TinyVector<T2, int(N*(N+1)/2)> > & dest,
+                                    double sigma,
+                                    BlockwiseConvolutionOptions<N> opt = BlockwiseConvolutionOptions<N>());
+
+        template <unsigned int N, class T1, class T2>
+        void
+        structureTensorMultiArray(ChunkedArray<N, T1> const & source,
+                                  ChunkedArray<N, TinyVector<T2, int(N*(N+1)/2)> > & dest,
+                                  double innerScale, double outerScale,
+                                  BlockwiseConvolutionOptions<N> opt = BlockwiseConvolutionOptions<N>());
+    }
+    \endcode
+
+    (The variants without the scale parameters, taking the scales from <tt>opt</tt>,
+    exist as well.) These functions work like the blockwise filters for
+    \ref vigra::MultiArrayView, but read from and write to \ref vigra::ChunkedArray
+    objects (e.g. <tt>ChunkedArrayCompressed</tt>, <tt>ChunkedArrayTmpFile</tt> or
+    <tt>ChunkedArrayHDF5</tt>), so that the data never need to be loaded completely.
+    Unless a block shape is specified in <tt>opt</tt>, the blocks coincide with the
+    chunks of <tt>dest</tt>. Each thread copies one block plus its halo from
+    <tt>source</tt>, filters it, and commits the result to <tt>dest</tt>, so that
+    memory consumption is bounded by the chunk caches of the two arrays (see
+    <tt>ChunkedArrayOptions::cacheMax()</tt>) plus one block and halo per thread.
+    The results are bit-identical to the sequential algorithms on the corresponding
+    \ref vigra::MultiArray. <tt>source</tt> and <tt>dest</tt> must be different arrays.
+
+    <b> Usage:</b>
+
+    <b>\#include</b> \<vigra/multi_blockwise.hxx\><br/>
+    Namespace: vigra
+
+    \code
+    ChunkedArrayHDF5<3, float> source(file, "data", HDF5File::ReadOnly);
+    ChunkedArrayCompressed<3, float> dest(source.shape());
+
+    BlockwiseConvolutionOptions<3> opt;
+    opt.numThreads(8);
+    gaussianSmoothMultiArray(source, dest, 2.0, opt);
+    \endcode
+*/
+doxygen_overloaded_function(template <...> void gaussianSmoothMultiArray)
+
+template <unsigned int N, class T1, class T2, class KernelIterator>
+void
+separableConvolveMultiArray(ChunkedArray<N, T1> const & source,
+                            ChunkedArray<N, T2> & dest,
+                            KernelIterator kit,
+                            BlockwiseConvolutionOptions<N> const & opt)
+{
+    detail::chunkedSeparableConvolve(source, dest, kit, opt, "separableConvolveMultiArray");
+}
+
+template <unsigned int N, class T1, class T2, class T>
+inline void
+separableConvolveMultiArray(ChunkedArray<N, T1> const & source,
+                            ChunkedArray<N, T2> & dest,
+                            Kernel1D<T> const & kernel,
+                            BlockwiseConvolutionOptions<N> const & opt)
+{
+    ArrayVector<Kernel1D<T> > kernels(N, kernel);
+    separableConvolveMultiArray(source, dest, kernels.begin(), opt);
+}
+
+template <unsigned int N, class T1, class T2>
+void
+gaussianSmoothMultiArray(ChunkedArray<N, T1> const & source,
+                         ChunkedArray<N, T2> & dest,
+                         BlockwiseConvolutionOptions<N> const & opt)
+{
+    static const char * function_name = "gaussianSmoothMultiArray";
+
+    typename ConvolutionOptions<N>::ScaleIterator params = opt.scaleParams();
+    ArrayVector<Kernel1D<double> > kernels(N);
+    for (unsigned int dim = 0; dim < N; ++dim, ++params)
+        kernels[dim].initGaussian(params.sigma_scaled(function_name), 1.0, opt.window_ratio);
+
+    detail::chunkedSeparableConvolve(source, dest, kernels.begin(), opt, function_name);
+}
+
+template <unsigned int N, class T1, class T2>
+inline void
+gaussianSmoothMultiArray(ChunkedArray<N, T1> const & source,
+                         ChunkedArray<N, T2> & dest,
+                         double sigma,
+                         BlockwiseConvolutionOptions<N> opt = BlockwiseConvolutionOptions<N>())
+{
+    opt.stdDev(sigma);
+    gaussianSmoothMultiArray(source, dest, opt);
+}
+
+template <unsigned int N, class T1, class T2>
+void
+gaussianGradientMultiArray(ChunkedArray<N, T1> const & source,
+                           ChunkedArray<N, TinyVector<T2, int(N)> > & dest,
+                           BlockwiseConvolutionOptions<N> const & opt)
+{
+    typedef typename NumericTraits<T2>::RealPromote KernelType;
+    static const char * function_name = "gaussianGradientMultiArray";
+
+    ArrayVector<ArrayVector<Kernel1D<KernelType> > > kernels;
+    detail::gaussianGradientKernels(opt, kernels, function_name);
+
+    detail::chunkedMultiChannelConvolve(source, dest, kernels, opt, function_name);
+}
+
+template <unsigned int N, class T1, class T2>
+inline void
+gaussianGradientMultiArray(ChunkedArray<N, T1> const & source,
+                           ChunkedArray<N, TinyVector<T2, int(N)> > & dest,
+                           double sigma,
+                           BlockwiseConvolutionOptions<N> opt = BlockwiseConvolutionOptions<N>())
+{
+    opt.stdDev(sigma);
+    gaussianGradientMultiArray(source, dest, opt);
+}
+
+template <unsigned int N, class T1, class T2>
+void
+hessianOfGaussianMultiArray(ChunkedArray<N, T1> const & source,
+                            ChunkedArray<N, TinyVector<T2, int(N*(N+1)/2)> > & dest,
+                            BlockwiseConvolutionOptions<N> const & opt)
+{
+    typedef typename NumericTraits<T2>::RealPromote KernelType;
+
+    ArrayVector<ArrayVector<Kernel1D<KernelType> > > kernels;
+    detail::hessianOfGaussianKernels(opt, kernels);
+
+    detail::chunkedMultiChannelConvolve(source, dest, kernels, opt, "hessianOfGaussianMultiArray");
+}
+
+template <unsigned int N, class T1, class T2>
+inline void
+hessianOfGaussianMultiArray(ChunkedArray<N, T1> const & source,
+                            ChunkedArray<N, TinyVector<T2, int(N*(N+1)/2)> > & dest,
+                            double sigma,
+                            BlockwiseConvolutionOptions<N> opt = BlockwiseConvolutionOptions<N>())
+{
+    opt.stdDev(sigma);
+    hessianOfGaussianMultiArray(source, dest, opt);
+}
+
+template <unsigned int N, class T1, class T2>
+void
+structureTensorMultiArray(ChunkedArray<N, T1> const & source,
+                          ChunkedArray<N, TinyVector<T2, int(N*(N+1)/2)> > & dest,
+                          BlockwiseConvolutionOptions<N> const & opt)
+{
+    typedef typename MultiArrayShape<N>::type Shape;
+    typedef TinyVector<T2, int(N*(N+1)/2)> DestType;
+    typedef typename NumericTraits<T2>::RealPromote KernelType;
+    static const char * function_name = "structureTensorMultiArray";
+
+    Shape roiStart;
+    detail::blockwiseROI(opt, source.shape(), dest.shape(), roiStart, function_name);
+
+    ArrayVector<ArrayVector<Kernel1D<KernelType> > > innerKernels;
+    ArrayVector<Kernel1D<double> > outerKernels;
+    detail::structureTensorKernels(opt, innerKernels, outerKernels, function_name);
+
+    // the halo is the sum of the outer kernel's and the gradient kernels' radii
+    detail::BlockwiseHalo<N, ArrayVector<Kernel1D<double> >::const_iterator>
+                                     outerHalo(source.shape(), outerKernels.begin());
+    detail::MultiChannelBlockwiseHalo<N, KernelType> innerHalo(source.shape(), innerKernels);
+
+    detail::chunkedBlockwiseForeach(source, dest, roiStart, opt,
+        [&](Shape const & start, Shape const & stop, Shape & hstart, Shape & hstop)
+        {
+            Shape gstart, gstop;
+            outerHalo(start, stop, gstart, gstop);
+            innerHalo(gstart, gstop, hstart, hstop);
+        },
+        [&](MultiArray<N, T1> const & src, MultiArray<N, DestType> & res,
+            Shape const & start, Shape const & stop)
+        {
+            detail::structureTensorBlock(src, res, innerKernels, outerKernels, start, stop);
+        });
+}
+
+template <unsigned int N, class T1, class T2>
+inline void
+structureTensorMultiArray(ChunkedArray<N, T1> const & source,
+                          ChunkedArray<N, TinyVector<T2, int(N*(N+1)/2)> > & dest,
+                          double innerScale, double outerScale,
+                          BlockwiseConvolutionOptions<N> opt = BlockwiseConvolutionOptions<N>())
+{
+    opt.innerScale(innerScale).outerScale(outerScale);
+    structureTensorMultiArray(source, dest, opt);
+}
+
+/********************************************************/
+/*                                                      */
+/*      parallel separableMultiDistSquared              */
+/*                                                      */
+/********************************************************/
+
+namespace detail {
+
+    /* Per-thread scratch memory of the parabola pass: the current line
+       (to enable in-place operation) and the stack of parabolas.
+    */
+template <class T>
+struct DistParabolaScratch
+{
+    typedef typename NumericTraits<T>::RealPromote TmpType;
+
+    ArrayVector<TmpType> line;
+    std::vector<DistParabolaStackEntry<TmpType> > stack;
+};
+
+    /* Apply the parabola pass to all lines of 'block' along axis 'd'.
+    */
+template <unsigned int N, class T, class S>
+void
+distParabolaBlock(MultiArrayView<N, T, S> block, unsigned int d, double sigma,
+                  DistParabolaScratch<T> & scratch)
+{
+    typedef typename DistParabolaScratch<T>::TmpType TmpType;
+    typedef MultiArrayNavigator<typename MultiArrayView<N, T, S>::traverser, N> Navigator;
+
+    scratch.line.resize(block.shape(d));
+    for(Navigator nav(block.traverser_begin(), block.shape(), d); nav.hasMore(); nav++)
+    {
+        copyLine(nav.begin(), nav.end(), typename AccessorTraits<T>::default_const_accessor(),
+                 scratch.line.begin(), typename AccessorTraits<TmpType>::default_accessor());
+        distParabola(srcIterRange(scratch.line.begin(), scratch.line.end(),
+                                  typename AccessorTraits<TmpType>::default_const_accessor()),
+                     destIter(nav.begin(), typename AccessorTraits<T>::default_accessor()),
+                     sigma, scratch.stack);
+    }
+}
+
+    /* Shape of the blocks used for the parabola pass along axis 'd': the blocks
+       span the entire axis 'd', and the outer remaining axes are shrunk such that
+       a block has about the same number of elements as the blocks in 'options'.
+       This keeps enough independent blocks to feed all threads, while the lines
+       of a block stay adjacent in memory.
+    */
+template <unsigned int N>
+TinyVector<MultiArrayIndex, int(N)>
+distParabolaBlockShape(TinyVector<MultiArrayIndex, int(N)> const & shape,
+                       unsigned int d,
+                       BlockwiseOptions const & options)
+{
+    TinyVector<MultiArrayIndex, int(N)> blockShape = min(shape, options.template getBlockShapeN<N>());
+    MultiArrayIndex size = prod(blockShape);
+    blockShape[d] = shape[d];
+    for(int k=N-1; k>=0; --k)
+    {
+        MultiArrayIndex current = prod(blockShape);
+        if(current <= size)
+            break;
+        if(k == (int)d)
+            continue;
+        blockShape[k] = std::max<MultiArrayIndex>(1, blockShape[k] * size / current);
+    }
+    return blockShape;
+}
+
+    /* Threshold 'source' into 'work' (objects get the value 'maxDist') and
+       apply the parabola pass along all axes in parallel.
+    */
+template <unsigned int N, class T1, class S1, class T2, class S2, class Array>
+void
+parallelDistSquared(MultiArrayView<N, T1, S1> const & source,
+                    MultiArrayView<N, T2, S2> work,
+                    bool background, T2 maxDist,
+                    Array const & pixelPitch,
+                    BlockwiseOptions const & options)
+{
+    typedef typename MultiArrayShape<N>::type Shape;
+    using namespace vigra::functor;
+
+    T1 zero = NumericTraits<T1>::zero();
+    T2 rzero = T2(0);
+
+    blockwiseForeach(work.shape(), options.template getBlockShapeN<N>(),
+        [&](int, Shape const & start, Shape const & stop)
+        {
+            if(background == true)
+                transformMultiArray(source.subarray(start, stop), work.subarray(start, stop),
+                                    ifThenElse( Arg1() == Param(zero), Param(maxDist), Param(rzero) ));
+            else
+                transformMultiArray(source.subarray(start, stop), work.subarray(start, stop),
+                                    ifThenElse( Arg1() != Param(zero), Param(maxDist), Param(rzero) ));
+        },
+        options);
+
+    ArrayVector<DistParabolaScratch<T2> > scratch(std::max(1, options.getActualNumThreads()));
+    for(unsigned int d=0; d<N; ++d)
+    {
+        blockwiseForeach(work.shape(), distParabolaBlockShape<N>(work.shape(), d, options),
+            [&](int thread_id, Shape const & start, Shape const & stop)
+            {
+                distParabolaBlock(work.subarray(start, stop), d, pixelPitch[d], scratch[thread_id]);
+            },
+            options);
+    }
+}
+
+} // namespace detail
+
+/** \brief Parallel Euclidean distance transform of multi-dimensional arrays.
+
+    <b> Declarations:</b>
+
+    \code
+    namespace vigra {
+        template <unsigned int N, class T1, class S1,
+                                  class T2, class S2, class Array>
+        void
+        separableMultiDistSquared(MultiArrayView<N, T1, S1> const & source,
+                                  MultiArrayView<N, T2, S2> dest,
+                                  bool background,
+                                  Array const & pixelPitch,
+                                  BlockwiseOptions const & options);
+
+        template <unsigned int N, class T1, class S1,
+                                  class T2, class S2>
+        void
+        separableMultiDistSquared(MultiArrayView<N, T1, S1> const & source,
+                                  MultiArrayView<N, T2, S2> dest,
+                                  bool background,
+                                  BlockwiseOptions const & options);
+
+        // likewise for separableMultiDistance()
+    }
+    \endcode
+
+    Same as the sequential \ref separableMultiDistSquared() and \ref separableMultiDistance()
+    (including support for anisotropic <tt>pixelPitch</tt>), but the lines of each
+    dimension pass are distributed over the threads of the thread pool. To keep the
+    memory access local, the array is split into columns that span the entire axis of
+    the current pass and have about the size of the blocks given in <tt>options</tt>.
+    Each thread reuses its own line and parabola buffers for all its lines, so that
+    no memory is allocated per line. The results are bit-identical to the sequential
+    algorithms.
+
+    <b> Usage:</b>
+
+    <b>\#include</b> \<vigra/multi_blockwise.hxx\><br/>
+    Namespace: vigra
+
+    \code
+    Shape3 shape(width, height, depth);
+    MultiArray<3, UInt8> source(shape);
+    MultiArray<3, float> dest(shape);
+    ...
+    // compute the distance of all background voxels to the nearest object
+    // on 8 threads, with anisotropic voxel size
+    separableMultiDistance(source, dest, false, TinyVector<double, 3>(1.0, 1.0, 2.5),
+                           BlockwiseOptions().numThreads(8));
+    \endcode
+*/
+doxygen_overloaded_function(template <...> void separableMultiDistSquared)
+
+template <unsigned int N, class T1, class S1,
+                          class T2, class S2, class Array>
+void
+separableMultiDistSquared(MultiArrayView<N, T1, S1> const & source,
+                          MultiArrayView<N, T2, S2> dest,
+                          bool background,
+                          Array const & pixelPitch,
+                          BlockwiseOptions const & options)
+{
+    typedef typename MultiArrayShape<N>::type Shape;
+    typedef typename NumericTraits<T2>::RealPromote Real;
+
+    vigra_precondition(source.shape() == dest.shape(),
+        "separableMultiDistSquared(): shape mismatch between input and output.");
+
+    double dmax = 0.0;
+    bool pixelPitchIsReal = false;
+    for(unsigned int k=0; k<N; ++k)
+    {
+        if(int(pixelPitch[k]) != pixelPitch[k])
+            pixelPitchIsReal = true;
+        dmax += sq(pixelPitch[k]*dest.shape(k));
+    }
+
+    if(dmax > NumericTraits<T2>::toRealPromote(NumericTraits<T2>::max())
+       || pixelPitchIsReal) // need a temporary array to avoid overflows
+    {
+        MultiArray<N, Real> tmp(dest.shape());
+        detail::parallelDistSquared(source, tmp, background, (Real)dmax, pixelPitch, options);
+        detail::blockwiseForeach(dest.shape(), options.template getBlockShapeN<N>(),
+            [&](int, Shape const & start, Shape const & stop)
+            {
+                copyMultiArray(tmp.subarray(start, stop), dest.subarray(start, stop));
+            },
+            options);
+    }
+    else        // work directly on the destination array
+    {
+        detail::parallelDistSquared(source, dest, background, T2(std::ceil(dmax)), pixelPitch, options);
+    }
+}
+
+template <unsigned int N, class T1, class S1,
+                          class T2, class S2>
+inline void
+separableMultiDistSquared(MultiArrayView<N, T1, S1> const & source,
+                          MultiArrayView<N, T2, S2> dest,
+                          bool background,
+                          BlockwiseOptions const & options)
+{
+    ArrayVector<double> pixelPitch(N, 1.0);
+    separableMultiDistSquared(source, dest, background, pixelPitch, options);
+}
+
+template <unsigned int N, class T1, class S1,
+                          class T2, class S2, class Array>
+void
+separableMultiDistance(MultiArrayView<N, T1, S1> const & source,
+                       MultiArrayView<N, T2, S2> dest,
+                       bool background,
+                       Array const & pixelPitch,
+                       BlockwiseOptions const & options)
+{
+    typedef typename MultiArrayShape<N>::type Shape;
+    using namespace vigra::functor;
+
+    separableMultiDistSquared(source, dest, background, pixelPitch, options);
+
+    // Finally, calculate the square root of the distances
+    detail::blockwiseForeach(dest.shape(), options.template getBlockShapeN<N>(),
+        [&](int, Shape const & start, Shape const & stop)
+        {
+            transformMultiArray(dest.subarray(start, stop), dest.subarray(start, stop), sqrt(Arg1()));
+        },
+        options);
+}
+
+template <unsigned int N, class T1, class S1,
+                          class T2, class S2>
+inline void
+separableMultiDistance(MultiArrayView<N, T1, S1> const & source,
+                       MultiArrayView<N, T2, S2> dest,
+                       bool background,
+                       BlockwiseOptions const & options)
+{
+    ArrayVector<double> pixelPitch(N, 1.0);
+    separableMultiDistance(source, dest, background, pixelPitch, options);
+}
+
+/********************************************************/
+/*                                                      */
+/*      separableMultiDistSquared for ChunkedArray      */
+/*                                                      */
+/********************************************************/
+
+namespace detail {
+
+    /* Call 'f(thread_id, start, stop)' in parallel for all blocks of the given shape
+       that span the entire axis 'd'.
+    */
+template <unsigned int N, class FUNCTOR>
+void
+chunkedColumnForeach(typename MultiArrayShape<N>::type const & shape,
+                     typename MultiArrayShape<N>::type const & chunkShape,
+                     unsigned int d,
+                     BlockwiseOptions const & options,
+                     FUNCTOR f)
+{
+    typedef typename MultiArrayShape<N>::type Shape;
+
+    Shape blockShape = chunkedBlockShape<N>(options, chunkShape);
+    blockShape[d] = shape[d];
+    blockwiseForeach(shape, blockShape, f, options);
+}
+
+    /* Same algorithm as separableMultiDistSquared(), but the array is processed in
+       columns of chunks, one dimension after the other. 'work' holds the
+       intermediate results (and finally the squared distances).
+    */
+template <unsigned int N, class T1, class T2, class Array>
+void
+chunkedDistSquared(ChunkedArray<N, T1> const & source,
+                   ChunkedArray<N, T2> & work,
+                   bool background, T2 maxDist,
+                   Array const & pixelPitch,
+                   BlockwiseOptions const & options)
+{
+    typedef typename MultiArrayShape<N>::type Shape;
+    using namespace vigra::functor;
+
+    T1 zero = NumericTraits<T1>::zero();
+    T2 rzero = T2(0);
+
+    ArrayVector<DistParabolaScratch<T2> > scratch(std::max(1, options.getActualNumThreads()));
+    for(unsigned int d=0; d<N; ++d)
+    {
+        chunkedColumnForeach<N>(work.shape(), work.chunkShape(), d, options,
+            [&](int thread_id, Shape const & start, Shape const & stop)
+            {
+                MultiArray<N, T2> block(stop - start);
+                if(d == 0)
+                {
+                    // threshold the values so all objects have infinity value in the beginning
+                    MultiArray<N, T1> src(stop - start);
+                    source.checkoutSubarray(start, src);
+                    if(background == true)
+                        transformMultiArray(srcMultiArrayRange(src), destMultiArray(block),
+                                  ifThenElse( Arg1() == Param(zero), Param(maxDist), Param(rzero) ));
+                    else
+                        transformMultiArray(srcMultiArrayRange(src), destMultiArray(block),
+                                  ifThenElse( Arg1() != Param(zero), Param(maxDist), Param(rzero) ));
+                }
+                else
+                {
+                    work.checkoutSubarray(start, block);
+                }
+                distParabolaBlock(block, d, pixelPitch[d], scratch[thread_id]);
+                work.commitSubarray(start, block);
+            });
+    }
+}
+
+} // namespace detail
+
+/** \brief Euclidean distance transform of arrays that are too large for main memory.
+
+    <b> Declarations:</b>
+
+    \code
+    namespace vigra {
+        template <unsigned int N, class T1, class T2, class Array>
+        void
+        separableMultiDistSquared(ChunkedArray<N, T1> const & source,
+                                  ChunkedArray<N, T2> & dest,
+                                  bool background,
+                                  Array const & pixelPitch,
+                                  BlockwiseOptions const & options = BlockwiseOptions());
+
+        template <unsigned int N, class T1, class T2>
+        void
+        separableMultiDistSquared(ChunkedArray<N, T1> const & source,
+                                  ChunkedArray<N, T2> & dest,
+                                  bool background,
+                                  BlockwiseOptions const & options = BlockwiseOptions());
+
+        // likewise for separableMultiDistance()
+    }
+    \endcode
+
+    Same as the sequential \ref separableMultiDistSquared() and \ref separableMultiDistance(),
+    but for \ref vigra::ChunkedArray. The separable algorithm is applied one dimension
+    after the other. For dimension <tt>d</tt>, the array is split into columns that span
+    the entire axis <tt>d</tt> and coincide with the chunks of <tt>dest</tt> in all other
+    dimensions (or with the block shape given in <tt>options</tt>). The columns are
+    processed in parallel, and each thread only needs memory for its current column.
+    Intermediate results are stored in <tt>dest</tt>. When <tt>dest</tt>'s value type
+    cannot represent them (because of overflow or non-integer pixel pitch), they are
+    kept in a temporary <tt>ChunkedArrayTmpFile</tt> instead, using the cache size
+    of <tt>dest</tt>. The results are bit-identical to the sequential algorithms.
+
+    <b>\#include</b> \<vigra/multi_blockwise.hxx\><br/>
+    Namespace: vigra
+*/
+doxygen_overloaded_function(template <...> void separableMultiDistSquared)
+
+template <unsigned int N, class T1, class T2, class Array>
+void
+separableMultiDistSquared(ChunkedArray<N, T1> const & source,
+                          ChunkedArray<N, T2> & dest,
+                          bool background,
+                          Array const & pixelPitch,
+                          BlockwiseOptions const & options = BlockwiseOptions())
+{
+    typedef typename NumericTraits<T2>::RealPromote Real;
+
+    vigra_precondition(source.shape() == dest.shape(),
+        "separableMultiDistSquared(): shape mismatch between input and output.");
+
+    double dmax = 0.0;
+    bool pixelPitchIsReal = false;
+    for(unsigned int k=0; k<N; ++k)
+    {
+        if(int(pixelPitch[k]) != pixelPitch[k])
+            pixelPitchIsReal = true;
+        dmax += sq(pixelPitch[k]*dest.shape(k));
+    }
+
+    if(dmax > NumericTraits<T2>::toRealPromote(NumericTraits<T2>::max())
+       || pixelPitchIsReal) // need a temporary array to avoid overflows
+    {
+        ChunkedArrayTmpFile<N, Real> tmp(dest.shape(), dest.chunkShape(),
+                                         ChunkedArrayOptions().cacheMax(dest.cacheMaxSize()));
+        detail::chunkedDistSquared(source, tmp, background, (Real)dmax, pixelPitch, options);
+        detail::chunkedBlockwiseForeach(tmp, dest, typename MultiArrayShape<N>::type(), options,
+            detail::NoBlockwiseHalo<N>(),
+            [](MultiArray<N, Real> const & src, MultiArray<N, T2> & res,
+               typename MultiArrayShape<N>::type const &, typename MultiArrayShape<N>::type const &)
+            {
+                copyMultiArray(srcMultiArrayRange(src), destMultiArray(res));
+            });
+    }
+    else        // work directly on the destination array
+    {
+        detail::chunkedDistSquared(source, dest, background, T2(std::ceil(dmax)), pixelPitch, options);
+    }
+}
+
+template <unsigned int N, class T1, class T2>
+inline void
+separableMultiDistSquared(ChunkedArray<N, T1> const & source,
+                          ChunkedArray<N, T2> & dest,
+                          bool background,
+                          BlockwiseOptions const & options = BlockwiseOptions())
+{
+    ArrayVector<double> pixelPitch(N, 1.0);
+    separableMultiDistSquared(source, dest, background, pixelPitch, options);
+}
+
+template <unsigned int N, class T1, class T2, class Array>
+void
+separableMultiDistance(ChunkedArray<N, T1> const & source,
+                       ChunkedArray<N, T2> & dest,
+                       bool background,
+                       Array const & pixelPitch,
+                       BlockwiseOptions const & options = BlockwiseOptions())
+{
+    using namespace vigra::functor;
+
+    separableMultiDistSquared(source, dest, background, pixelPitch, options);
+
+    // Finally, calculate the square root of the distances
+    detail::chunkedBlockwiseForeach(dest, dest, typename MultiArrayShape<N>::type(), options,
+        detail::NoBlockwiseHalo<N>(),
+        [](MultiArray<N, T2> const & src, MultiArray<N, T2> & res,
+           typename MultiArrayShape<N>::type const &, typename MultiArrayShape<N>::type const &)
+        {
+            transformMultiArray(srcMultiArrayRange(src), destMultiArray(res), sqrt(Arg1()));
+        });
+}
+
+template <unsigned int N, class T1, class T2>
+inline void
+separableMultiDistance(ChunkedArray<N, T1> const & source,
+                       ChunkedArray<N, T2> & dest,
+                       bool background,
+                       BlockwiseOptions const & options = BlockwiseOptions())
+{
+    ArrayVector<double> pixelPitch(N, 1.0);
+    separableMultiDistance(source, dest, background, pixelPitch, options);
+}
+
+//@}
+
+} // namespace vigra
+
+#endif // VIGRA_MULTI_BLOCKWISE_HXX
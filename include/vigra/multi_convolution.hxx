@@ -491,6 +491,99 @@ class ConvolutionOptions
 namespace detail
 {
 
+/********************************************************/
+/*                                                      */
+/*                 convolveLinesInPlace                 */
+/*                                                      */
+/********************************************************/
+
+    // generic version: copy each line to a temporary and call convolveLine()
+template <class Navigator, class Accessor, class T>
+void
+convolveLinesInPlace(Navigator & nav, Accessor a, int w,
+                     Kernel1D<T> const & kernel, int start, int stop,
+                     VigraFalseType)
+{
+    typedef typename NumericTraits<typename Accessor::value_type>::RealPromote TmpType;
+    typedef typename AccessorTraits<TmpType>::default_accessor TmpAccessor;
+
+    ArrayVector<TmpType> tmp(w);
+    TmpAccessor acc;
+
+    for( ; nav.hasMore(); nav++ )
+    {
+         // first copy source to tmp since convolveLine() cannot work in-place
+         copyLine(nav.begin(), nav.end(), a, tmp.begin(), acc);
+
+         convolveLine(srcIterRange(tmp.begin(), tmp.end(), acc),
+                      destIter( nav.begin() + start, a ),
+                      kernel1d( kernel ), start, stop);
+    }
+}
+
+    // SIMD-friendly version: gather groups of adjacent lines into an interleaved
+    // temporary, so that the innermost loop runs across lines even when the lines
+    // are strided (i.e. for all but the first dimension)
+template <class Navigator, class Accessor, class T>
+void
+convolveLinesInPlace(Navigator & nav, Accessor a, int w,
+                     Kernel1D<T> const & kernel, int start, int stop,
+                     VigraTrueType)
+{
+    typedef typename Accessor::value_type DestType;
+    typedef typename NumericTraits<DestType>::RealPromote TmpType;
+    typedef typename AccessorTraits<TmpType>::default_accessor TmpAccessor;
+    typedef typename PromoteTraits<TmpType, T>::Promote SumType;
+    typedef typename Navigator::iterator LineIterator;
+    enum { LineCount = 16 };
+
+    if(!isVectorizableBorderTreatment(kernel.borderTreatment()))
+    {
+        convolveLinesInPlace(nav, a, w, kernel, start, stop, VigraFalseType());
+        return;
+    }
+    vigra_precondition(w >= std::max(kernel.right(), -kernel.left()) + 1,
+                 "convolveLine(): kernel longer than line.\n");
+
+    ArrayVector<TmpType> tmp(w*LineCount);
+    ArrayVector<SumType> res((stop - start)*LineCount);
+    LineIterator lines[LineCount];
+    TmpAccessor acc;
+
+    while(nav.hasMore())
+    {
+        int n = 0;
+        for(; n < LineCount && nav.hasMore(); ++n, nav++)
+            lines[n] = nav.begin();
+
+        typename ArrayVector<TmpType>::iterator t = tmp.begin();
+        for(int i = 0; i < w; ++i)
+            for(int b = 0; b < n; ++b, ++t)
+                acc.set(a(lines[b], i), t);
+
+        internalConvolveLinesInterleaved(tmp.begin(), w, n, res.begin(),
+                                         kernel.center(), kernel.left(), kernel.right(),
+                                         kernel.borderTreatment(), start, stop);
+
+        typename ArrayVector<SumType>::iterator r = res.begin();
+        for(int i = start; i < stop; ++i)
+            for(int b = 0; b < n; ++b, ++r)
+                a.set(RequiresExplicitCast<DestType>::cast(*r), lines[b], i);
+    }
+}
+
+    // Convolve all lines of 'nav' in place and write the results for [start, stop)
+    // ('w' is the line length).
+template <class Navigator, class Accessor, class T>
+inline void
+convolveLinesInPlace(Navigator & nav, Accessor a, int w,
+                     Kernel1D<T> const & kernel, int start, int stop)
+{
+    typedef typename NumericTraits<typename Accessor::value_type>::RealPromote TmpType;
+    convolveLinesInPlace(nav, a, w, kernel, start, stop,
+                         typename IsVectorizableConvolution<TmpType, T>::type());
+}
+
 /********************************************************/
 /*                                                      */
 /*        internalSeparableConvolveMultiArray           */
@@ -539,17 +632,7 @@ internalSeparableConvolveMultiArrayTmp(
     {
         DNavigator dnav( di, shape, d );
 
-        tmp.resize( shape[d] );
-
-        for( ; dnav.hasMore(); dnav++ )
-        {
-             // first copy source to tmp since convolveLine() cannot work in-place
-             copyLine(dnav.begin(), dnav.end(), dest, tmp.begin(), acc);
-
-             convolveLine(srcIterRange(tmp.begin(), tmp.end(), acc),
-                          destIter( dnav.begin(), dest ),
-                          kernel1d( *kit ) );
-        }
+        convolveLinesInPlace(dnav, dest, shape[d], *kit, 0, shape[d]);
     }
 }
 
@@ -1362,7 +1445,7 @@ gaussianSmoothMultiArray(MultiArrayView<N, T1, S1> const & source,
                   class T2, class S2>
         void
         gaussianGradientMultiArray(MultiArrayView<N, T1, S1> const & source,
-                                   MultiArrayView<N, TinyVector<T2, N>, S2> dest,
+                                   MultiArrayView<N, TinyVector<T2, int(N)>, S2> dest,
                                    double sigma,
                                    ConvolutionOptions<N> opt = ConvolutionOptions<N>());
 
@@ -1371,7 +1454,7 @@ gaussianSmoothMultiArray(MultiArrayView<N, T1, S1> const & source,
                                   class T2, class S2>
         void
         gaussianGradientMultiArray(MultiArrayView<N, T1, S1> const & source,
-                                   MultiArrayView<N, TinyVector<T2, N>, S2> dest,
+                                   MultiArrayView<N, TinyVector<T2, int(N)>, S2> dest,
                                    ConvolutionOptions<N> opt);
     }
     \endcode
@@ -1517,7 +1600,7 @@ template <unsigned int N, class T1, class S1,
                           class T2, class S2>
 inline void
 gaussianGradientMultiArray(MultiArrayView<N, T1, S1> const & source,
-                           MultiArrayView<N, TinyVector<T2, N>, S2> dest,
+                           MultiArrayView<N, TinyVector<T2, int(N)>, S2> dest,
                            ConvolutionOptions<N> opt )
 {
     if(opt.to_point != typename MultiArrayShape<N>::type())
@@ -1541,7 +1624,7 @@ template <unsigned int N, class T1, class S1,
           class T2, class S2>
 inline void
 gaussianGradientMultiArray(MultiArrayView<N, T1, S1> const & source,
-                           MultiArrayView<N, TinyVector<T2, N>, S2> dest,
+                           MultiArrayView<N, TinyVector<T2, int(N)>, S2> dest,
                            double sigma,
                            ConvolutionOptions<N> opt = ConvolutionOptions<N>())
 {
@@ -1686,7 +1769,7 @@ gaussianGradientMagnitude(MultiArrayView<N+1, Multiband<T1>, S1> const & src,
                                   class T2, class S2>
         void
         symmetricGradientMultiArray(MultiArrayView<N, T1, S1> const & source,
-                                    MultiArrayView<N, TinyVector<T2, N>, S2> dest,
+                                    MultiArrayView<N, TinyVector<T2, int(N)>, S2> dest,
                                     ConvolutionOptions<N> opt = ConvolutionOptions<N>());
     }
     \endcode
@@ -1801,7 +1884,7 @@ template <unsigned int N, class T1, class S1,
                           class T2, class S2>
 inline void
 symmetricGradientMultiArray(MultiArrayView<N, T1, S1> const & source,
-                            MultiArrayView<N, TinyVector<T2, N>, S2> dest,
+                            MultiArrayView<N, TinyVector<T2, int(N)>, S2> dest,
                             ConvolutionOptions<N> opt = ConvolutionOptions<N>())
 {
     if(opt.to_point != typename MultiArrayShape<N>::type())
@@ -2089,14 +2172,14 @@ laplacianOfGaussianMultiArray(MultiArrayView<N, T1, S1> const & source,
         template <unsigned int N, class T1, class S1,
                                   class T2, class S2>
         void 
-        gaussianDivergenceMultiArray(MultiArrayView<N, TinyVector<T1, N>, S1> const & vectorField,
+        gaussianDivergenceMultiArray(MultiArrayView<N, TinyVector<T1, int(N)>, S1> const & vectorField,
                                      MultiArrayView<N, T2, S2> divergence,
                                      ConvolutionOptions<N> const & opt);
                                      
         template <unsigned int N, class T1, class S1,
                                   class T2, class S2>
         void 
-        gaussianDivergenceMultiArray(MultiArrayView<N, TinyVector<T1, N>, S1> const & vectorField,
+        gaussianDivergenceMultiArray(MultiArrayView<N, TinyVector<T1, int(N)>, S1> const & vectorField,
                                      MultiArrayView<N, T2, S2> divergence,
                                      double sigma,
                                      ConvolutionOptions<N> opt = ConvolutionOptions<N>());
@@ -2189,7 +2272,7 @@ gaussianDivergenceMultiArray(Iterator vectorField, Iterator vectorFieldEnd,
 template <unsigned int N, class T1, class S1,
                           class T2, class S2>
 inline void 
-gaussianDivergenceMultiArray(MultiArrayView<N, TinyVector<T1, N>, S1> const & vectorField,
+gaussianDivergenceMultiArray(MultiArrayView<N, TinyVector<T1, int(N)>, S1> const & vectorField,
                              MultiArrayView<N, T2, S2> divergence,
                              ConvolutionOptions<N> const & opt)
 {
@@ -2203,7 +2286,7 @@ gaussianDivergenceMultiArray(MultiArrayView<N, TinyVector<T1, N>, S1> const & ve
 template <unsigned int N, class T1, class S1,
                           class T2, class S2>
 inline void 
-gaussianDivergenceMultiArray(MultiArrayView<N, TinyVector<T1, N>, S1> const & vectorField,
+gaussianDivergenceMultiArray(MultiArrayView<N, TinyVector<T1, int(N)>, S1> const & vectorField,
                              MultiArrayView<N, T2, S2> divergence,
                              double sigma,
                              ConvolutionOptions<N> opt = ConvolutionOptions<N>())
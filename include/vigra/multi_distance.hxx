@@ -73,10 +73,13 @@ struct DistParabolaStackEntry
 /*                                                      */
 /********************************************************/
 
+    // '_stack' is a scratch buffer that can be reused across lines to avoid
+    // repeated allocations. Its contents on entry are irrelevant.
 template <class SrcIterator, class SrcAccessor,
           class DestIterator, class DestAccessor >
 void distParabola(SrcIterator is, SrcIterator iend, SrcAccessor sa,
-                  DestIterator id, DestAccessor da, double sigma )
+                  DestIterator id, DestAccessor da, double sigma,
+                  std::vector<DistParabolaStackEntry<typename SrcAccessor::value_type> > & _stack)
 {
     // We assume that the data in the input is distance squared and treat it as such
     double w = iend - is;
@@ -88,7 +91,7 @@ void distParabola(SrcIterator is, SrcIterator iend, SrcAccessor sa,
     
     typedef typename SrcAccessor::value_type SrcType;
     typedef DistParabolaStackEntry<SrcType> Influence;
-    std::vector<Influence> _stack;
+    _stack.clear();
     _stack.push_back(Influence(sa(is), 0.0, 0.0, w));
     
     ++is;
@@ -132,6 +135,15 @@ void distParabola(SrcIterator is, SrcIterator iend, SrcAccessor sa,
     }
 }
 
+template <class SrcIterator, class SrcAccessor,
+          class DestIterator, class DestAccessor >
+inline void distParabola(SrcIterator is, SrcIterator iend, SrcAccessor sa,
+                         DestIterator id, DestAccessor da, double sigma )
+{
+    std::vector<DistParabolaStackEntry<typename SrcAccessor::value_type> > _stack;
+    distParabola(is, iend, sa, id, da, sigma, _stack);
+}
+
 template <class SrcIterator, class SrcAccessor,
           class DestIterator, class DestAccessor>
 inline void distParabola(triple<SrcIterator, SrcIterator, SrcAccessor> src,
@@ -141,6 +153,16 @@ inline void distParabola(triple<SrcIterator, SrcIterator, SrcAccessor> src,
                  dest.first, dest.second, sigma);
 }
 
+template <class SrcIterator, class SrcAccessor,
+          class DestIterator, class DestAccessor, class Stack>
+inline void distParabola(triple<SrcIterator, SrcIterator, SrcAccessor> src,
+                         pair<DestIterator, DestAccessor> dest, double sigma,
+                         Stack & _stack)
+{
+    distParabola(src.first, src.second, src.third,
+                 dest.first, dest.second, sigma, _stack);
+}
+
 /********************************************************/
 /*                                                      */
 /*        internalSeparableMultiArrayDistTmp            */
@@ -163,6 +185,8 @@ void internalSeparableMultiArrayDistTmp(
     
     // temporary array to hold the current line to enable in-place operation
     ArrayVector<TmpType> tmp( shape[0] );
+    // scratch buffer of the parabola pass, reused for all lines
+    std::vector<DistParabolaStackEntry<TmpType> > stack;
 
     typedef MultiArrayNavigator<SrcIterator, N> SNavigator;
     typedef MultiArrayNavigator<DestIterator, N> DNavigator;
@@ -188,7 +212,7 @@ void internalSeparableMultiArrayDistTmp(
 
             detail::distParabola( srcIterRange(tmp.begin(), tmp.end(),
                           typename AccessorTraits<TmpType>::default_const_accessor()),
-                          destIter( dnav.begin(), dest ), sigmas[0] );
+                          destIter( dnav.begin(), dest ), sigmas[0], stack );
     }
     
     // operate on further dimensions
@@ -207,7 +231,7 @@ void internalSeparableMultiArrayDistTmp(
 
              detail::distParabola( srcIterRange(tmp.begin(), tmp.end(),
                            typename AccessorTraits<TmpType>::default_const_accessor()),
-                           destIter( dnav.begin(), dest ), sigmas[d] );
+                           destIter( dnav.begin(), dest ), sigmas[d], stack );
         }
     }
     if(invert) transformMultiArray( di, shape, dest, di, dest, -Arg1());
@@ -61,6 +61,7 @@
 #include "multi_convolution.hxx"
 #include "error.hxx"
 #include "threading.hxx"
+#include "threadpool.hxx"
 #include "gaussians.hxx"
 
 namespace vigra{
@@ -876,11 +877,9 @@ void nonLocalMean1Run(
 
 
 
-        typedef threading::thread  ThreadType;
         typedef threading::mutex   MutexType;
 
         MutexType estimateMutex;
-        //typedef boost::thread ThreadType;
 
         const size_t nThreads =  param.nThreads_;
         MultiArray<1,int> progress = MultiArray<1,int>(typename  MultiArray<1,int>::difference_type(nThreads));
@@ -892,8 +891,6 @@ void nonLocalMean1Run(
                 smoothPolicy, param, nThreads, estimateMutex,progress)
         );
 
-        // thread ptr
-        std::vector<ThreadType *> threadPtrs(nThreads);
         for(size_t i=0; i<nThreads; ++i){
             ThreadObjectType & threadObj = threadObjects[i];
             threadObj.setThreadIndex(i);
@@ -901,14 +898,15 @@ void nonLocalMean1Run(
             lastAxisRange[0]=(i * image.shape(DIM-1)) / nThreads;
             lastAxisRange[1]=((i+1) * image.shape(DIM-1)) / nThreads;
             threadObj.setRange(lastAxisRange);
-            // this will start the threads and cal operator() 
-            // of the threadObjects
-            threadPtrs[i] = new ThreadType(threadObjects[i]);
         }
-        for(size_t i=0; i<nThreads; ++i)
-            threadPtrs[i]->join();
-        for(size_t i=0; i<nThreads; ++i)
-            delete threadPtrs[i];
+        // run the thread objects on the global thread pool
+        // (calls operator() of each thread object)
+        parallel_foreach(threadObjects.begin(), threadObjects.end(),
+            [](int, ThreadObjectType & threadObj)
+            {
+                threadObj();
+            },
+            ParallelOptions().numThreads((int)nThreads));
 
     }   // MULTI THREAD CODE ENDS HERE
     ///////////////////////////////////////////////////////////////
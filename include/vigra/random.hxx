@@ -42,6 +42,7 @@
 #include "array_vector.hxx"
 
 #include <ctime>
+#include <algorithm>
 
     // includes to get the current process and thread IDs
     // to be used for automated seeding
@@ -184,6 +185,15 @@ struct RandomState<TT800>
             state_[i] = seeds[i];
     }
 
+        // degree of the characteristic polynomial of the state transition
+    static const UInt32 Degree = 800;
+
+        // the linear recurrence x[k+N] = next(x[k], x[k+1], x[k+M])
+    static UInt32 next(UInt32 x0, UInt32, UInt32 xm)
+    {
+        return xm ^ (x0 >> 1) ^ ((x0 & 1U) ? 0x8ebfd028U : 0x0U);
+    }
+
   protected:  
 
     UInt32 get() const
@@ -248,6 +258,15 @@ struct RandomState<MT19937>
         seed(19650218U, *this);
     }
 
+        // degree of the characteristic polynomial of the state transition
+    static const UInt32 Degree = 19937;
+
+        // the linear recurrence x[k+N] = next(x[k], x[k+1], x[k+M])
+    static UInt32 next(UInt32 x0, UInt32 x1, UInt32 xm)
+    {
+        return xm ^ twiddle(x0, x1);
+    }
+
   protected:  
 
     UInt32 get() const
@@ -307,6 +326,323 @@ void RandomState<MT19937>::generateNumbers() const
     current_ = 0;
 }
 
+    /* Jump-ahead for the twister generators.
+
+       The state transition T of both generators is linear over GF(2). If phi
+       is the characteristic polynomial of T, advancing the generator by J steps
+       is equivalent to evaluating p(T) with p = x^J mod phi. phi is determined
+       once per engine from the generator output (Berlekamp-Massey), and p(T) is
+       evaluated by Horner's scheme on a sliding window of N state words.
+    */
+typedef ArrayVector<UInt64> GF2Polynomial;
+
+inline std::size_t gf2Words(std::size_t bits)
+{
+    return (bits + 63) / 64;
+}
+
+inline bool gf2Bit(GF2Polynomial const & p, std::size_t i)
+{
+    return ((p[i >> 6] >> (i & 63)) & 1) != 0;
+}
+
+inline void gf2SetBit(GF2Polynomial & p, std::size_t i)
+{
+    p[i >> 6] |= UInt64(1) << (i & 63);
+}
+
+    // 64 bits of 'p' starting at bit 'i' ('p' must have a padding word)
+inline UInt64 gf2Extract(GF2Polynomial const & p, std::size_t i)
+{
+    std::size_t q = i >> 6, r = i & 63;
+    return r == 0
+              ? p[q]
+              : (p[q] >> r) | (p[q+1] << (64 - r));
+}
+
+    // dst += src * x^shift, truncated to the size of 'dst'
+inline void gf2AddShifted(GF2Polynomial & dst, GF2Polynomial const & src, std::size_t shift)
+{
+    std::size_t q = shift >> 6, r = shift & 63;
+    for(std::size_t i = 0; i < src.size() && i + q < dst.size(); ++i)
+    {
+        if(src[i] == 0)
+            continue;
+        if(r == 0)
+        {
+            dst[i+q] ^= src[i];
+        }
+        else
+        {
+            dst[i+q] ^= src[i] << r;
+            if(i + q + 1 < dst.size())
+                dst[i+q+1] ^= src[i] >> (64 - r);
+        }
+    }
+}
+
+inline int gf2Parity(UInt64 x)
+{
+    x ^= x >> 32;
+    x ^= x >> 16;
+    x ^= x >> 8;
+    x ^= x >> 4;
+    x ^= x >> 2;
+    x ^= x >> 1;
+    return static_cast<int>(x & 1);
+}
+
+    // the last N words x[t], ..., x[t+N-1] of a generator sequence, stored circularly
+template <RandomEngineTag EngineTag>
+struct RandomStateWindow
+{
+    typedef RandomState<EngineTag> Engine;
+    static const UInt32 N = Engine::N, M = Engine::M;
+
+    UInt32 words_[N];
+    UInt32 head_;
+
+    RandomStateWindow()
+    : head_(0)
+    {
+        std::fill(words_, words_ + N, 0u);
+    }
+
+    explicit RandomStateWindow(Engine const & engine)
+    : head_(0)
+    {
+        std::copy(engine.state_, engine.state_ + N, words_);
+        for(UInt32 k = 0; k < engine.current_; ++k)
+            step();
+    }
+
+    UInt32 operator[](UInt32 k) const
+    {
+        k += head_;
+        return words_[k < N ? k : k - N];
+    }
+
+    void step()
+    {
+        UInt32 h1 = head_ + 1 < N ? head_ + 1 : head_ + 1 - N,
+               hm = head_ + M < N ? head_ + M : head_ + M - N;
+        words_[head_] = Engine::next(words_[head_], words_[h1], words_[hm]);
+        head_ = h1;
+    }
+
+    RandomStateWindow & operator^=(RandomStateWindow const & o)
+    {
+        for(UInt32 k = 0; k < N; ++k)
+            words_[k] ^= o[k < head_ ? k + N - head_ : k - head_];
+        return *this;
+    }
+};
+
+template <RandomEngineTag EngineTag>
+class RandomJumpPolynomials
+{
+  public:
+    typedef RandomState<EngineTag> Engine;
+    static const std::size_t D = Engine::Degree;
+
+        // phi and the reduction table are computed on first use
+    static RandomJumpPolynomials const & get()
+    {
+        static const RandomJumpPolynomials instance;
+        return instance;
+    }
+
+        // x^e mod phi
+    GF2Polynomial power(UInt64 e) const
+    {
+        GF2Polynomial res(gf2Words(D), 0);
+        if(e < D)
+        {
+            gf2SetBit(res, static_cast<std::size_t>(e));
+            return res;
+        }
+        int bit = 63;
+        while(((e >> bit) & 1) == 0)
+            --bit;
+        res[0] = 1;
+        for(; bit >= 0; --bit)
+        {
+            square(res);
+            if((e >> bit) & 1)
+                multiplyByX(res);
+        }
+        return res;
+    }
+
+  private:
+    RandomJumpPolynomials()
+    : phi_(gf2Words(D + 1), 0)
+    {
+        computeCharacteristicPolynomial();
+        computeReductionTable();
+    }
+
+    void computeCharacteristicPolynomial()
+    {
+        // least significant bits of 2*D consecutive generator words,
+        // stored in reverse order to make the discrepancy a dot product
+        const std::size_t n2 = 2 * D;
+        GF2Polynomial s(gf2Words(n2) + 1, 0);
+        {
+            Engine engine;
+            RandomStateWindow<EngineTag> window(engine);
+            for(UInt32 k = 0; k < Engine::N; ++k)
+                window.step();
+            for(std::size_t k = 0; k < n2; ++k, window.step())
+                if(window[0] & 1)
+                    gf2SetBit(s, n2 - 1 - k);
+        }
+
+        // Berlekamp-Massey
+        GF2Polynomial c(gf2Words(n2) + 1, 0), b(c), t;
+        c[0] = b[0] = 1;
+        std::size_t L = 0, m = 1;
+        for(std::size_t n = 0; n < n2; ++n, ++m)
+        {
+            int d = 0;
+            for(std::size_t w = 0; w <= L / 64; ++w)
+            {
+                UInt64 mask = (w == L / 64 && (L & 63) != 63)
+                                  ? (UInt64(1) << ((L & 63) + 1)) - 1
+                                  : ~UInt64(0);
+                d ^= gf2Parity(c[w] & mask & gf2Extract(s, n2 - 1 - n + 64 * w));
+            }
+            if(d == 0)
+                continue;
+            if(2 * L <= n)
+            {
+                t = c;
+                gf2AddShifted(c, b, m);
+                L = n + 1 - L;
+                b.swap(t);
+                m = 0;
+            }
+            else
+            {
+                gf2AddShifted(c, b, m);
+            }
+        }
+        vigra_invariant(L == D,
+            "RandomNumberGenerator::jumpAhead(): unexpected degree of the characteristic polynomial.");
+
+        // phi is the reciprocal of the connection polynomial
+        for(std::size_t i = 0; i <= D; ++i)
+            if(gf2Bit(c, D - i))
+                gf2SetBit(phi_, i);
+    }
+
+        // table_[v] = v*x^D + (v*x^D mod phi) for all bytes v, so that adding
+        // table_[v] * x^k clears the byte v at bit position D+k
+    void computeReductionTable()
+    {
+        const std::size_t words = gf2Words(D + 8) + 1;
+        table_.resize(256, GF2Polynomial(words, 0));
+        for(std::size_t j = 0; j < 8; ++j)
+        {
+            // phi * x^j with all higher bits j' > j already cleared by lower multiples
+            GF2Polynomial r(words, 0);
+            gf2AddShifted(r, phi_, j);
+            for(std::size_t i = j; i-- > 0;)
+                if(gf2Bit(r, D + i))
+                    gf2AddShifted(r, table_[std::size_t(1) << i], 0);
+            table_[std::size_t(1) << j] = r;
+        }
+        for(std::size_t v = 1; v < 256; ++v)
+        {
+            if((v & (v - 1)) == 0)
+                continue;
+            std::size_t low = v & (~v + 1);
+            table_[v] = table_[low];
+            gf2AddShifted(table_[v], table_[v ^ low], 0);
+        }
+    }
+
+        // reduce 'p' (of degree <= degreeBound) modulo phi in place
+    void reduce(GF2Polynomial & p, std::size_t degreeBound) const
+    {
+        std::size_t top = degreeBound;
+        while(top >= D)
+        {
+            std::size_t lo = top >= D + 7 ? top - 7 : D;
+            std::size_t v = static_cast<std::size_t>(gf2Extract(p, lo) & ((UInt64(1) << (top - lo + 1)) - 1));
+            if(v != 0)
+                gf2AddShifted(p, table_[v], lo - D);
+            if(lo == D)
+                break;
+            top = lo - 1;
+        }
+        p.resize(gf2Words(D));
+        if(D & 63)
+            p.back() &= (UInt64(1) << (D & 63)) - 1;
+    }
+
+    void square(GF2Polynomial & p) const
+    {
+        GF2Polynomial sq(2 * gf2Words(D) + 1, 0);
+        for(std::size_t i = 0; i < p.size(); ++i)
+        {
+            sq[2*i]   = spread(static_cast<UInt32>(p[i]));
+            sq[2*i+1] = spread(static_cast<UInt32>(p[i] >> 32));
+        }
+        reduce(sq, 2 * D - 2);
+        p.swap(sq);
+    }
+
+    void multiplyByX(GF2Polynomial & p) const
+    {
+        p.push_back(0);
+        for(std::size_t i = p.size() - 1; i > 0; --i)
+            p[i] = (p[i] << 1) | (p[i-1] >> 63);
+        p[0] <<= 1;
+        if(gf2Bit(p, D))
+            gf2AddShifted(p, phi_, 0);
+        p.resize(gf2Words(D));
+    }
+
+        // interleave the bits of 'x' with zeros
+    static UInt64 spread(UInt32 x)
+    {
+        UInt64 r = x;
+        r = (r | (r << 16)) & 0x0000FFFF0000FFFFULL;
+        r = (r | (r << 8))  & 0x00FF00FF00FF00FFULL;
+        r = (r | (r << 4))  & 0x0F0F0F0F0F0F0F0FULL;
+        r = (r | (r << 2))  & 0x3333333333333333ULL;
+        r = (r | (r << 1))  & 0x5555555555555555ULL;
+        return r;
+    }
+
+    GF2Polynomial phi_;
+    ArrayVector<GF2Polynomial> table_;
+};
+
+template <RandomEngineTag EngineTag>
+void jumpAhead(RandomState<EngineTag> & engine, UInt64 steps)
+{
+    if(steps == 0)
+        return;
+
+    // Bring the window into the range of T (the MT19937 default state is
+    // not), where phi(T) vanishes, and jump the remaining steps - 1.
+    RandomStateWindow<EngineTag> window(engine), acc;
+    window.step();
+    GF2Polynomial p = RandomJumpPolynomials<EngineTag>::get().power(steps - 1);
+
+    for(std::size_t i = RandomJumpPolynomials<EngineTag>::D; i-- > 0;)
+    {
+        acc.step();
+        if(gf2Bit(p, i))
+            acc ^= window;
+    }
+    for(UInt32 k = 0; k < RandomState<EngineTag>::N; ++k)
+        engine.state_[k] = acc[k];
+    engine.current_ = 0;
+}
+
 } // namespace detail
 
 
@@ -448,6 +784,35 @@ class RandomNumberGenerator
         normalCachedValid_ = false;
     }
 
+        /** Advance the generator as if <tt>uniformInt()</tt> had been called 
+            \a steps times.
+            
+            The jump takes O(log(steps)) polynomial multiplications instead of 
+            O(steps) calls. This is used to split a single random sequence into 
+            non-overlapping streams, e.g. one per thread:
+            
+            \code
+            std::vector<RandomMT19937> streams(threadCount, RandomMT19937(seed));
+            for(std::size_t k = 1; k < streams.size(); ++k)
+            {
+                streams[k] = streams[k-1];
+                streams[k].jumpAhead(UInt64(1) << 40);
+            }
+            \endcode
+            
+            The characteristic polynomial of the generator is computed on the first 
+            call and cached, so that the first jump is considerably more expensive 
+            than subsequent ones.
+            
+            Note that <tt>uniformInt(beyond)</tt>, <tt>uniform()</tt> etc. may consume 
+            more than one number per call.
+        */
+    void jumpAhead(UInt64 steps)
+    {
+        detail::jumpAhead(*this, steps);
+        normalCachedValid_ = false;
+    }
+
         /** Return a uniformly distributed integer random number in [0, 2<sup>32</sup>).
             
             That is, 0 &lt;= i &lt; 2<sup>32</sup>. 
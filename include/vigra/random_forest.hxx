@@ -40,6 +40,7 @@
 #include <iostream>
 #include <algorithm>
 #include <map>
+#include <vector>
 #include <set>
 #include <list>
 #include <numeric>
@@ -60,6 +61,10 @@
 #include "random_forest/rf_online_prediction_set.hxx"
 #include "random_forest/rf_earlystopping.hxx"
 #include "random_forest/rf_ridge_split.hxx"
+#include "random_forest/rf_histogram_split.hxx"
+#include "random_forest/rf_flat_forest.hxx"
+#include "random_forest/rf_incremental.hxx"
+#include "threadpool.hxx"
 
 #include <vigra/random_forest/features.hxx>
 
@@ -81,14 +86,93 @@ namespace detail
 
 
 /* \brief sampling option factory function
+ *
+ * With RF_EXTERNAL stratification, the classes are drawn in proportion
+ * to the given class weights.
  */
-inline SamplerOptions make_sampler_opt ( RandomForestOptions     & RF_opt)
+inline SamplerOptions make_sampler_opt ( RandomForestOptions     & RF_opt,
+                                         ArrayVector<double> const & class_weights = ArrayVector<double>())
 {
     SamplerOptions return_opt;
     return_opt.withReplacement(RF_opt.sample_with_replacement_);
     return_opt.stratified(RF_opt.stratification_method_ == RF_EQUAL);
+    if(RF_opt.stratification_method_ == RF_EXTERNAL)
+        return_opt.stratumWeights(class_weights);
     return return_opt;
 }
+
+/* \brief per-tree state of RandomForest::learn()
+ *
+ * Each tree draws its bootstrap sample and its split candidates from its
+ * own random number generator, so that trees can be learned independently.
+ * The index buffers of the sampler are allocated once and are reused
+ * by every tree that is subsequently learned with the same state object.
+ */
+template <class Random_t, class StackEntry_t>
+struct RFTreeLearnState
+{
+    Random_t                            random;
+    UniformIntRandomFunctor<Random_t>   randint;
+    Sampler<Random_t>                   sampler;
+    VIGRA_UNIQUE_PTR<StackEntry_t>      stack_entry;
+
+    template <class Iterator>
+    RFTreeLearnState(Iterator strataBegin, Iterator strataEnd,
+                     SamplerOptions const & opt)
+    : random(0u),
+      randint(random),
+      sampler(strataBegin, strataEnd, opt, &random)
+    {}
+
+        // prepare the sample and the root region for a new tree
+    void init(UInt32 seed, int class_count)
+    {
+        random.seed(seed);
+        sampler.reset();
+        sampler.sample();
+        stack_entry.reset(new StackEntry_t(sampler.sampledIndices().begin(),
+                                           sampler.sampledIndices().end(),
+                                           class_count));
+        stack_entry->set_oob_range(sampler.oobIndices().begin(),
+                                   sampler.oobIndices().end());
+    }
+};
+
+#ifndef VIGRA_SINGLE_THREADED
+
+/* \brief visitor wrapper that serializes the split callbacks of trees
+ * which are learned concurrently
+ */
+template <class Visitor>
+class RFSerializedVisitor
+{
+  public:
+    RFSerializedVisitor(Visitor & visitor, threading::mutex & mutex)
+    : visitor_(visitor),
+      mutex_(mutex)
+    {}
+
+    template<class Tree, class Split, class Region, class Feature_t, class Label_t>
+    void visit_after_split( Tree          & tree,
+                            Split         & split,
+                            Region        & parent,
+                            Region        & leftChild,
+                            Region        & rightChild,
+                            Feature_t     & features,
+                            Label_t       & labels)
+    {
+        threading::lock_guard<threading::mutex> lock(mutex_);
+        visitor_.visit_after_split(tree, split, parent, leftChild, rightChild,
+                                   features, labels);
+    }
+
+  private:
+    Visitor & visitor_;
+    threading::mutex & mutex_;
+};
+
+#endif // VIGRA_SINGLE_THREADED
+
 }//namespace detail
 
 /** Random Forest class
@@ -168,12 +252,15 @@ class RandomForest
     ProblemSpec_t                               ext_param_;
     /*mutable ArrayVector<int>                    tree_indices_;*/
     rf::visitors::OnlineLearnVisitor            online_visitor_;
+    // per-tree leaf statistics of incrementalLearn()
+    ArrayVector<detail::RFTreeStatistics>       incremental_statistics_;
 
 
     void reset()
     {
         ext_param_.clear();
         trees_.clear();
+        incremental_statistics_.clear();
     }
 
   public:
@@ -413,6 +500,44 @@ class RandomForest
     }
 
 
+    /**\brief add new training examples to a learned forest
+     *
+     * In contrast to onlineLearn(), the old training data are not needed:
+     * every tree only keeps the class histograms of the leaves reached by
+     * new samples, together with the histograms of a few random split 
+     * candidates per leaf. Each new sample updates the leaf it falls into, 
+     * and a leaf is split as soon as it has seen enough new samples and a 
+     * candidate split is sufficiently informative. The cost of an update
+     * thus only depends on the number of new samples and the tree depth.
+     * See IncrementalLearningOptions for the parameters.
+     *
+     * \param features  a N x M matrix containing the N new samples.
+     * \param labels    a N x 1 matrix of labels. Each label must be one 
+     *                  of the classes the forest was learned with.
+     * \param options   options for the update.
+     * \param random    RandomNumberGenerator to be used.
+     *
+     * The trees are updated in parallel according to 
+     * RandomForestOptions::n_threads(). Since every tree draws its 
+     * random numbers from its own generator, the result does not depend 
+     * on the number of threads. Leaf statistics are kept across calls, 
+     * and are discarded when the forest is learned anew.
+     */
+    template <class U, class C1, class U2, class C2, class Random_t>
+    void incrementalLearn(MultiArrayView<2, U, C1>  const & features,
+                          MultiArrayView<2, U2, C2> const & labels,
+                          IncrementalLearningOptions const & options,
+                          Random_t const & random);
+
+    template <class U, class C1, class U2, class C2>
+    void incrementalLearn(MultiArrayView<2, U, C1>  const & features,
+                          MultiArrayView<2, U2, C2> const & labels,
+                          IncrementalLearningOptions const & options = IncrementalLearningOptions())
+    {
+        RandomNumberGenerator<> rnd = RandomNumberGenerator<>(RandomSeed);
+        incrementalLearn(features, labels, options, rnd);
+    }
+
     /**\name Learning
      * Following functions differ in the degree of customization
      * allowed
@@ -803,6 +928,7 @@ void RandomForest<LabelType, PreprocessorTag>::onlineLearn(  MultiArrayView<2,U,
 {
     online_visitor_.activate();
     online_visitor_.adjust_thresholds=adjust_thresholds;
+    incremental_statistics_.clear();
 
     using namespace rf;
     //typedefs
@@ -926,6 +1052,48 @@ void RandomForest<LabelType, PreprocessorTag>::onlineLearn(  MultiArrayView<2,U,
     online_visitor_.deactivate();
 }
 
+template <class LabelType, class PreprocessorTag>
+template <class U, class C1, class U2, class C2, class Random_t>
+void RandomForest<LabelType, PreprocessorTag>::incrementalLearn(MultiArrayView<2, U, C1>  const & features,
+                                                                MultiArrayView<2, U2, C2> const & labels,
+                                                                IncrementalLearningOptions const & options,
+                                                                Random_t const & random)
+{
+    vigra_precondition(trees_.size() > 0,
+        "RandomForest::incrementalLearn(): the forest must be learned first.");
+    vigra_precondition(features.shape(0) == labels.shape(0),
+        "RandomForest::incrementalLearn(): number of samples and labels differ.");
+    vigra_precondition(columnCount(features) == ext_param_.column_count_,
+        "RandomForest::incrementalLearn(): wrong number of feature columns.");
+
+    int sample_count = static_cast<int>(features.shape(0));
+    ArrayVector<Int32> classes(sample_count);
+    for(int k = 0; k < sample_count; ++k)
+    {
+        classes[k] = std::find(ext_param_.classes.begin(), ext_param_.classes.end(), labels(k, 0))
+                         - ext_param_.classes.begin();
+        vigra_precondition(classes[k] < ext_param_.class_count_,
+            "RandomForest::incrementalLearn(): unknown label.");
+    }
+
+    // every tree gets its own random number generator, seeded in tree order
+    int tree_count = static_cast<int>(trees_.size());
+    ArrayVector<UInt32> tree_seeds(tree_count);
+    for(int ii = 0; ii < tree_count; ++ii)
+        tree_seeds[ii] = random();
+    incremental_statistics_.resize(tree_count);
+
+    parallel_foreach(0, tree_count,
+        [&](int /* thread_id */, int ii)
+        {
+            RandomMT19937 tree_random(tree_seeds[ii]);
+            detail::rfIncrementalUpdate(trees_[ii], incremental_statistics_[ii],
+                                        features, classes, ext_param_.class_weights_,
+                                        options, tree_random);
+        },
+        ParallelOptions().numThreads(options_.n_threads_));
+}
+
 template<class LabelType, class PreprocessorTag>
 template<class U,class C1,
     class U2, class C2,
@@ -993,7 +1161,7 @@ void RandomForest<LabelType, PreprocessorTag>::reLearnTree(MultiArrayView<2,U,C1
      */
     Sampler<Random_t > sampler(preprocessor.strata().begin(),
                                preprocessor.strata().end(),
-                               detail::make_sampler_opt(options_)
+                               detail::make_sampler_opt(options_, ext_param_.class_weights_)
                                         .sampleSize(ext_param().actual_msample_),
                                &random);
     //initialize First region/node/stack entry
@@ -1010,6 +1178,8 @@ void RandomForest<LabelType, PreprocessorTag>::reLearnTree(MultiArrayView<2,U,C1
     online_visitor_.reset_tree(treeId);
     online_visitor_.tree_id=treeId;
     trees_[treeId].reset();
+    if(treeId < static_cast<int>(incremental_statistics_.size()))
+        incremental_statistics_[treeId].clear();
     trees_[treeId]
         .learn( preprocessor.features(),
                 preprocessor.response(),
@@ -1046,9 +1216,6 @@ void RandomForest<LabelType, PreprocessorTag>::
     using namespace rf;
     //this->reset();
     //typedefs
-    typedef          UniformIntRandomFunctor<Random_t>
-                                                    RandFunctor_t;
-
     // See rf_preprocessing.hxx for more info on this
     typedef Processor<PreprocessorTag,LabelType, U, C1, U2, C2> Preprocessor_t;
 
@@ -1080,10 +1247,6 @@ void RandomForest<LabelType, PreprocessorTag>::
         online_visitor_.deactivate();
 
 
-    // Make stl compatible random functor.
-    RandFunctor_t randint(random);
-
-
     // Preprocess the data to get something the split functor can work
     // with. Also fill the ext_param structure by preprocessing
     // option parameters that could only be completely evaluated
@@ -1098,46 +1261,110 @@ void RandomForest<LabelType, PreprocessorTag>::
 
     //initialize trees.
     trees_.resize(options_.tree_count_, DecisionTree_t(ext_param_));
+    incremental_statistics_.clear();
     for (int treeIndx = 0; treeIndx < options_.tree_count_; ++treeIndx)
         trees_[treeIndx].options_ = options_;
 
-    Sampler<Random_t > sampler(preprocessor.strata().begin(),
-                               preprocessor.strata().end(),
-                               detail::make_sampler_opt(options_)
-                                        .sampleSize(ext_param().actual_msample_),
-                               &random);
+    SamplerOptions sampler_options = detail::make_sampler_opt(options_, ext_param_.class_weights_)
+                                        .sampleSize(ext_param().actual_msample_);
+    typedef detail::RFTreeLearnState<Random_t, StackEntry_t> TreeState;
 
     visitor.visit_at_beginning(*this, preprocessor);
+
+    // Every tree gets its own random number generator, seeded in tree order
+    // from 'random'. Thus, the forest doesn't depend on the number of threads.
+    int tree_count = static_cast<int>(trees_.size());
+    ArrayVector<UInt32> tree_seeds(tree_count);
+    for(int ii = 0; ii < tree_count; ++ii)
+        tree_seeds[ii] = random();
+
+    int n_threads = ParallelOptions().numThreads(options_.n_threads_).getActualNumThreads();
+
     // THE MAIN EFFING RF LOOP - YEAY DUDE!
-    
-    for(int ii = 0; ii < static_cast<int>(trees_.size()); ++ii)
+#ifndef VIGRA_SINGLE_THREADED
+    if(n_threads > 1 && tree_count > 1 && !options_.prepare_online_learning_)
     {
-        std::cout << "learning tree " << ii << "... " << std::endl;
-
-        //initialize First region/node/stack entry
-        sampler
-            .sample();  
-        StackEntry_t
-            first_stack_entry(  sampler.sampledIndices().begin(),
-                                sampler.sampledIndices().end(),
-                                ext_param_.class_count_);
-        first_stack_entry
-            .set_oob_range(     sampler.oobIndices().begin(),
-                                sampler.oobIndices().end());
-        trees_[ii]
-            .learn(             preprocessor.features(),
+        threading::mutex visitor_mutex;
+        detail::RFSerializedVisitor<IntermedVis> tree_visitor(visitor, visitor_mutex);
+
+        // finished trees whose predecessors are still being learned
+        std::map<int, VIGRA_SHARED_PTR<TreeState> > finished;
+        int next_tree = 0;
+        // states of flushed trees, ready to be reused by the next tree
+        // (at most one state per thread plus the out-of-order trees is alive)
+        std::vector<VIGRA_SHARED_PTR<TreeState> > free_states;
+
+        parallel_foreach(0, tree_count,
+            [&](int /* thread_id */, int ii)
+            {
+                VIGRA_SHARED_PTR<TreeState> state;
+                {
+                    threading::lock_guard<threading::mutex> lock(visitor_mutex);
+                    if(!free_states.empty())
+                    {
+                        state = free_states.back();
+                        free_states.pop_back();
+                    }
+                }
+                if(!state)
+                    state.reset(new TreeState(preprocessor.strata().begin(),
+                                              preprocessor.strata().end(),
+                                              sampler_options));
+                state->init(tree_seeds[ii], ext_param_.class_count_);
+                trees_[ii]
+                    .learn(     preprocessor.features(),
                                 preprocessor.response(),
-                                first_stack_entry,
+                                *state->stack_entry,
+                                split,
+                                stop,
+                                tree_visitor,
+                                state->randint);
+
+                // call visit_after_tree() in tree order, so that accumulated
+                // results (e.g. the OOB error) don't depend on the schedule
+                threading::lock_guard<threading::mutex> lock(visitor_mutex);
+                finished[ii] = state;
+                while(!finished.empty() && finished.begin()->first == next_tree)
+                {
+                    TreeState & done = *finished.begin()->second;
+                    visitor
+                        .visit_after_tree(  *this,
+                                            preprocessor,
+                                            done.sampler,
+                                            *done.stack_entry,
+                                            next_tree);
+                    free_states.push_back(finished.begin()->second);
+                    finished.erase(finished.begin());
+                    ++next_tree;
+                }
+            },
+            ParallelOptions().numThreads(n_threads));
+    }
+    else
+#endif // VIGRA_SINGLE_THREADED
+    {
+        TreeState state(preprocessor.strata().begin(),
+                        preprocessor.strata().end(),
+                        sampler_options);
+        for(int ii = 0; ii < tree_count; ++ii)
+        {
+            //initialize First region/node/stack entry
+            state.init(tree_seeds[ii], ext_param_.class_count_);
+            trees_[ii]
+                .learn(         preprocessor.features(),
+                                preprocessor.response(),
+                                *state.stack_entry,
                                 split,
                                 stop,
                                 visitor,
-                                randint);
-        visitor
-            .visit_after_tree(  *this,
-                                preprocessor,
-                                sampler,
-                                first_stack_entry,
-                                ii);
+                                state.randint);
+            visitor
+                .visit_after_tree(  *this,
+                                    preprocessor,
+                                    state.sampler,
+                                    *state.stack_entry,
+                                    ii);
+        }
     }
 
     visitor.visit_at_end(*this, preprocessor);
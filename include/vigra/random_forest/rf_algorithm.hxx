@@ -38,6 +38,7 @@
 #include "splices.hxx"
 #include <queue>
 #include <fstream>
+#include "../threadpool.hxx"
 namespace vigra
 {
  
@@ -867,85 +868,130 @@ public:
  * (See visit_after_tree() method of visitors::VariableImportance to 
  * see the basic idea. (Just that we apply the permutation not only to
  * variables but also to clusters))
+ *
+ * The permutations of the clusters (given as rows of \a vars, in the order
+ * of HClustering::iterate()) are evaluated by permute(), concurrently on
+ * options.getActualNumThreads() threads. Each cluster gets its own random
+ * number generator (seeded with seed + cluster index), and every thread
+ * permutes its own copy of the feature matrix, so that the result doesn't
+ * depend on the number of threads. Afterwards, iterating the clustering with
+ * this functor adds the importance of each cluster to its status().
  */
-template<class Iter, class DT>
+template<class Iter, class DT, class Feat_T = MultiArrayView<2, double> >
 class PermuteCluster
 {
 public:
     typedef MultiArrayShape<2>::type Shp;
-    Matrix<double> tmp_mem_;
     MultiArrayView<2, double> perm_imp;
     MultiArrayView<2, double> orig_imp;
-    Matrix<double> feats_;
-    Matrix<int>    labels_;
+    MultiArrayView<2, int>    variables;
+    ArrayVector<Int32>        oob_indices_;
+    ArrayVector<Int32>        labels_;
     const int      nPerm;
     DT const &           dt;
+    ParallelOptions      options_;
+    UInt32               seed_;
     int index;
     int oob_size;
 
-    template<class Feat_T, class Label_T>
+    template<class Label_T>
     PermuteCluster(Iter  a, 
                    Iter  b,
                    Feat_T const & feats,
                    Label_T const & labls, 
                    MultiArrayView<2, double> p_imp, 
                    MultiArrayView<2, double> o_imp, 
+                   MultiArrayView<2, int> vars, 
                    int np,
-                   DT const  & dt_)
-        :tmp_mem_(_spl(a, b).size(), feats.shape(1)),
-         perm_imp(p_imp),
+                   DT const  & dt_,
+                   ParallelOptions const & options,
+                   UInt32 seed)
+        :perm_imp(p_imp),
          orig_imp(o_imp),
-         feats_(_spl(a,b).size(), feats.shape(1)),
-         labels_(_spl(a,b).size(),1),
+         variables(vars),
+         oob_indices_(a, b),
+         labels_(b-a),
          nPerm(np),
          dt(dt_),
+         options_(options),
+         seed_(seed),
          index(0),
-         oob_size(b-a)
+         oob_size(b-a),
+         feats_(feats)
     {
-        copy_splice(_spl(a,b),
-                    _spl(feats.shape(1)),
-                    feats,
-                    feats_);
-        copy_splice(_spl(a,b),
-                    _spl(labls.shape(1)),
-                    labls,
-                    labels_);
+        for(int ii = 0; ii < oob_size; ++ii)
+            labels_[ii] = labls(oob_indices_[ii], 0);
     }
 
-    template<class Node>
-    bool operator()(Node& node)
+    /** permute the columns of every cluster together and record the
+     * number of correctly classified OOB samples in perm_imp.
+     */
+    void permute()
     {
-        tmp_mem_ = feats_;
-        RandomMT19937 random;
-        int class_count = perm_imp.shape(1) - 1;
-        //permute columns together
-        for(int kk = 0; kk < nPerm; ++kk)
-        {
-            tmp_mem_ = feats_;
-            for(int ii = 0; ii < rowCount(feats_); ++ii)
+        int class_count = perm_imp.shape(1) - 1,
+            n_threads = std::max(1, options_.getActualNumThreads());
+        std::vector<MultiArray<2, typename Feat_T::value_type> > copies(n_threads);
+
+        parallel_foreach(0, static_cast<int>(rowCount(variables)),
+            [&](int thread_id, int cluster)
             {
-                int index = random.uniformInt(rowCount(feats_) - ii) +ii;
-                for(int jj = 0; jj < node.columns_size(); ++jj)
+                if(variables(cluster, 0) == -1)
+                    return;
+
+                MultiArray<2, typename Feat_T::value_type> & tmp_mem = copies[thread_id];
+                if(tmp_mem.size() == 0)
+                    tmp_mem = feats_;
+
+                RandomMT19937 random(seed_ + cluster);
+                UniformIntRandomFunctor<RandomMT19937> randint(random);
+                ArrayVector<Int32> permutation(oob_size);
+                for(int ii = 0; ii < oob_size; ++ii)
+                    permutation[ii] = ii;
+
+                for(int kk = 0; kk < nPerm; ++kk)
                 {
-                    if(node.columns_begin()[jj] != feats_.shape(1))
-                        tmp_mem_(ii, node.columns_begin()[jj]) 
-                            = tmp_mem_(index, node.columns_begin()[jj]);
+                    for(int ii = 1; ii < oob_size; ++ii)
+                        std::swap(permutation[ii], permutation[randint(ii+1)]);
+
+                    //permute columns together
+                    for(int jj = 0; jj < columnCount(variables) && variables(cluster, jj) != -1; ++jj)
+                    {
+                        int column = variables(cluster, jj);
+                        if(column == feats_.shape(1))
+                            continue;
+                        for(int ii = 0; ii < oob_size; ++ii)
+                            tmp_mem(oob_indices_[ii], column) = feats_(oob_indices_[permutation[ii]], column);
+                    }
+
+                    for(int ii = 0; ii < oob_size; ++ii)
+                    {
+                        if(dt.predictLabel(tmp_mem, oob_indices_[ii]) == labels_[ii])
+                        {
+                            //per class
+                            ++perm_imp(cluster, labels_[ii]);
+                            //total
+                            ++perm_imp(cluster, class_count);
+                        }
+                    }
                 }
-            }
-            
-            for(int ii = 0; ii < rowCount(tmp_mem_); ++ii)
-            {
-                if(dt
-                        .predictLabel(rowVector(tmp_mem_, ii)) 
-                    ==  labels_(ii, 0))
+
+                //copy back permuted columns
+                for(int jj = 0; jj < columnCount(variables) && variables(cluster, jj) != -1; ++jj)
                 {
-                    //per class
-                    ++perm_imp(index,labels_(ii, 0));
-                    //total
-                    ++perm_imp(index, class_count);
+                    int column = variables(cluster, jj);
+                    if(column == feats_.shape(1))
+                        continue;
+                    for(int ii = 0; ii < oob_size; ++ii)
+                        tmp_mem(oob_indices_[ii], column) = feats_(oob_indices_[ii], column);
                 }
-            }
-        }
+            },
+            options_);
+    }
+
+    template<class Node>
+    bool operator()(Node& node)
+    {
+        int class_count = perm_imp.shape(1) - 1;
         double node_status  = perm_imp(index, class_count);
         node_status /= nPerm;
         node_status -= orig_imp(0, class_count);
@@ -956,6 +1002,9 @@ public:
          
         return false;
     }
+
+private:
+    Feat_T const & feats_;
 };
 
 /** Convert ClusteringTree into a list (HClustering visitor)
@@ -1080,6 +1129,7 @@ class ClusterImportanceVisitor : public visitors::VisitorBase
     int                         repetition_count_;
     bool                        in_place_;
     HClustering            &    clustering;
+    ParallelOptions             parallel_options_;
 
 
 #ifdef HasHDF5
@@ -1096,9 +1146,27 @@ class ClusterImportanceVisitor : public visitors::VisitorBase
     }
 #endif
 
-    ClusterImportanceVisitor(HClustering & clst, int rep_cnt = 10) 
-    :   repetition_count_(rep_cnt), clustering(clst)
+    /* Constructor
+     * \param options the permutations of different clusters are evaluated
+     * concurrently on options.getActualNumThreads() threads. The result
+     * doesn't depend on the number of threads.
+     */
+    ClusterImportanceVisitor(HClustering & clst, int rep_cnt = 10,
+                             ParallelOptions const & options = ParallelOptions()) 
+    :   repetition_count_(rep_cnt), clustering(clst),
+        parallel_options_(options),
+        random_(RandomSeed)
+    {}
 
+    /* Constructor
+     * \param seed seed of the random number generator for the permutations,
+     * so that the results are reproducible.
+     */
+    ClusterImportanceVisitor(HClustering & clst, int rep_cnt,
+                             ParallelOptions const & options, UInt32 seed) 
+    :   repetition_count_(rep_cnt), clustering(clst),
+        parallel_options_(options),
+        random_(seed)
     {}
 
     /** Allocate enough memory 
@@ -1123,10 +1191,7 @@ class ClusterImportanceVisitor : public visitors::VisitorBase
     }
 
     /**compute permutation based var imp. 
-     * (Only an Array of size oob_sample_count x 1 is created.
-     *  - apposed to oob_sample_count x feature_count in the other method.
-     * 
-     * \sa FieldProxy
+     * The clusters are processed in parallel, see PermuteCluster.
      */
     template<class RF, class PR, class SM, class ST>
     void after_tree_ip_impl(RF& rf, PR & pr,  SM & sm, ST & st, int index)
@@ -1134,11 +1199,7 @@ class ClusterImportanceVisitor : public visitors::VisitorBase
         typedef MultiArrayShape<2>::type Shp_t;
         Int32                   column_count = rf.ext_param_.column_count_ +1;
         Int32                   class_count  = rf.ext_param_.class_count_;  
-        
-        // remove the const cast on the features (yep , I know what I am 
-        // doing here.) data is not destroyed.
-        typename PR::Feature_t & features 
-            = const_cast<typename PR::Feature_t &>(pr.features());
+        typename PR::Feature_t const & features = pr.features();
 
         //find the oob indices of current tree. 
         ArrayVector<Int32>      oob_indices;
@@ -1168,11 +1229,6 @@ class ClusterImportanceVisitor : public visitors::VisitorBase
                     oob_indices.push_back(ii);
         }
 
-        // Random foo
-        RandomMT19937           random(RandomSeed);
-        UniformIntRandomFunctor<RandomMT19937>  
-                                randint(random);
-
         //make some space for the results
         MultiArray<2, double>
                     oob_right(Shp_t(1, class_count + 1)); 
@@ -1183,7 +1239,7 @@ class ClusterImportanceVisitor : public visitors::VisitorBase
             ++iter)
         {
             if(rf.tree(index)
-                    .predictLabel(rowVector(features, *iter)) 
+                    .predictLabel(features, *iter) 
                 ==  pr.response()(*iter, 0))
             {
                 //per class
@@ -1196,14 +1252,20 @@ class ClusterImportanceVisitor : public visitors::VisitorBase
         MultiArray<2, double>
                     perm_oob_right (Shp_t(2* column_count-1, class_count + 1)); 
         
-        PermuteCluster<ArrayVector<Int32>::iterator,typename RF::DecisionTree_t>
+        // each cluster gets a random seed, independent of the thread count
+        PermuteCluster<ArrayVector<Int32>::iterator,typename RF::DecisionTree_t,
+                       typename PR::Feature_t>
             pc(oob_indices.begin(), oob_indices.end(), 
                             pr.features(),
                             pr.response(),
                             perm_oob_right,
                             oob_right,
+                            variables,
                             repetition_count_,
-                            rf.tree(index));
+                            rf.tree(index),
+                            parallel_options_,
+                            random_());
+        pc.permute();
         clustering.iterate(pc);
 
         perm_oob_right  /=  repetition_count_;
@@ -1235,6 +1297,10 @@ class ClusterImportanceVisitor : public visitors::VisitorBase
         clustering.iterate(nrm);
         cluster_importance_ /= rf.trees_.size();
     }
+
+    private:
+
+    RandomMT19937               random_;
 };
 
 /** Perform hierarchical clustering of variables and assess importance of clusters
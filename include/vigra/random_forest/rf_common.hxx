@@ -195,6 +195,7 @@ class RandomForestOptions
     int                     tree_count_;
     int                     min_split_node_size_;
     bool                    prepare_online_learning_;
+    int                     n_threads_;
     /*\}*/
 
     // name random forest options for generating contextual features
@@ -363,7 +364,8 @@ class RandomForestOptions
         predict_weighted_(false),
         tree_count_(256),
         min_split_node_size_(1),
-        prepare_online_learning_(false)
+        prepare_online_learning_(false),
+        n_threads_(1)
     {}
 
     /**\brief specify stratification strategy
@@ -374,8 +376,10 @@ class RandomForestOptions
      * RF_EQUAL:        get equal amount of samples per class.
      * RF_PROPORTIONAL: sample proportional to fraction of class samples
      *                  in population
-     * RF_EXTERNAL:     strata_weights_ field of the ProblemSpec_t object
-     *                  has been set externally. (defunct)
+     * RF_EXTERNAL:     draw samples (with replacement) such that each class
+     *                  is chosen with probability proportional to its
+     *                  entry in the class_weights_ field of the ProblemSpec_t
+     *                  object.
      */
     RandomForestOptions & use_stratification(RF_OptionTag in)
     {
@@ -504,6 +508,25 @@ class RandomForestOptions
         return *this;
     }
 
+    /**\brief Number of threads used to learn the trees.
+     *
+     *  Trees are learned independently, each with its own random number
+     *  generator seeded from the generator passed to RandomForest::learn().
+     *  The resulting forest therefore only depends on that generator,
+     *  not on the number of threads. Visitor callbacks are serialized,
+     *  and <tt>visit_after_tree()</tt> is called in tree order.
+     *  Negative values have the same meaning as in \ref ParallelOptions
+     *  (e.g. -1 uses all available cores, 0 runs in the calling thread).
+     *  Online learning (prepare_online_learning()) always uses a single 
+     *  thread.
+     *  <br> Default: 1
+     */
+    RandomForestOptions & n_threads(int in)
+    {
+        n_threads_ = in;
+        return *this;
+    }
+
     /**\brief Number of examples required for a node to be split.
      *
      *  When the number of examples in a node is below this number,
@@ -0,0 +1,429 @@
+/************************************************************************/
+/*                                                                      */
+/*    This file is part of the VIGRA computer vision library.           */
+/*    The VIGRA Website is                                              */
+/*        http://hci.iwr.uni-heidelberg.de/vigra/                       */
+/*    Please direct questions, bug reports, and contributions to        */
+/*        ullrich.koethe@iwr.uni-heidelberg.de    or                    */
+/*        vigra@informatik.uni-hamburg.de                               */
+/*                                                                      */
+/*    Permission is hereby granted, free of charge, to any person       */
+/*    obtaining a copy of this software and associated documentation    */
+/*    files (the "Software"), to deal in the Software without           */
+/*    restriction, including without limitation the rights to use,      */
+/*    copy, modify, merge, publish, distribute, sublicense, and/or      */
+/*    sell copies of the Software, and to permit persons to whom the    */
+/*    Software is furnished to do so, subject to the following          */
+/*    conditions:                                                       */
+/*                                                                      */
+/*    The above copyright notice and this permission notice shall be    */
+/*    included in all copies or substantial portions of the             */
+/*    Software.                                                         */
+/*                                                                      */
+/*    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND    */
+/*    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES   */
+/*    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND          */
+/*    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT       */
+/*    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,      */
+/*    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING      */
+/*    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR     */
+/*    OTHER DEALINGS IN THE SOFTWARE.                                   */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef VIGRA_RF_FLAT_FOREST_HXX
+#define VIGRA_RF_FLAT_FOREST_HXX
+
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <vector>
+#include "../config.hxx"
+#include "../algorithm.hxx"
+#include "../array_vector.hxx"
+#include "../multi_array.hxx"
+#include "../numerictraits.hxx"
+#include "../threadpool.hxx"
+#include "rf_nodeproxy.hxx"
+
+namespace vigra
+{
+
+namespace detail
+{
+
+struct FlatForestIO;
+
+/* Convert a split threshold to the threshold type of a FlatRandomForest.
+ * Float thresholds are rounded up, so that 'x < threshold' gives the
+ * same answer as the original double threshold for all float 'x'.
+ */
+template <class T>
+struct FlatForestThreshold
+{
+    static T cast(double t)
+    {
+        return static_cast<T>(t);
+    }
+};
+
+template <>
+struct FlatForestThreshold<float>
+{
+    static float cast(double t)
+    {
+        float res = static_cast<float>(t);
+        if(res < t)
+            res = std::nextafter(res, std::numeric_limits<float>::infinity());
+        return res;
+    }
+};
+
+} // namespace detail
+
+/** \brief Flattened, read-only copy of a RandomForest for fast prediction.
+
+    <b>\#include</b> \<vigra/random_forest.hxx\><br>
+    Namespace: vigra
+
+    The trees of a forest are converted into a single struct-of-arrays
+    (split column, threshold, and child indices per internal node, and
+    pre-weighted class votes per leaf), where the left child of a node
+    immediately follows its parent. Prediction walks blocks of samples
+    through one tree at a time, so that the tree stays in the cache, and
+    the blocks are distributed over threads via \ref parallel_foreach().
+    The results are identical to RandomForest::predictProbabilities()
+    with the default stopping criterion.
+
+    Only forests whose internal nodes are plain threshold nodes (i.e.
+    no contextual features, see RandomForestOptions::feature_mix()) can be
+    flattened. Use \ref supports() to check this beforehand.
+
+    <tt>ThresholdType</tt> can be set to <tt>float</tt> to halve the size
+    of the threshold array. Thresholds are then rounded such that
+    predictions remain exact for <tt>float</tt> features.
+
+    Flattened forests can be saved with rf_export_binary() and loaded
+    via memory-mapping with rf_import_binary()
+    (see \<vigra/random_forest_binary_impex.hxx\>). Copies of a
+    FlatRandomForest share their (immutable) node arrays.
+
+    \code
+    RandomForest<int> rf(...);
+    rf.learn(train_features, train_labels);
+
+    FlatRandomForest<int, float> flat(rf);
+    MultiArray<2, float> probabilities(Shape2(n, rf.class_count()));
+    flat.predictProbabilities(features, probabilities, ParallelOptions().numThreads(8));
+    \endcode
+*/
+template <class LabelType = double, class ThresholdType = double>
+class FlatRandomForest
+{
+  public:
+    typedef Int32           IndexType;
+
+        /** Number of samples that are passed through a tree at once.
+        */
+    static const int        BlockSize = 64;
+
+    FlatRandomForest()
+    : column_count_(0),
+      class_count_(0),
+      tree_count_(0),
+      node_count_(0),
+      leaf_count_(0),
+      roots_(0),
+      column_(0),
+      threshold_(0),
+      leaf_votes_(0)
+    {
+        child_[0] = child_[1] = 0;
+    }
+
+        /** Flatten the trees of <tt>rf</tt>.
+
+            <tt>rf</tt> must already be trained.
+        */
+    template <class RF>
+    explicit FlatRandomForest(RF const & rf)
+    {
+        vigra_precondition(supports(rf),
+            "FlatRandomForest(): forest contains nodes other than threshold nodes on plain features.");
+
+        column_count_ = rf.column_count();
+        class_count_  = rf.class_count();
+        classes_      = rf.ext_param().classes;
+        bool weighted = rf.options().predict_weighted_;
+
+        VIGRA_SHARED_PTR<Arrays> arrays(new Arrays);
+        arrays->roots.reserve(rf.tree_count());
+        for(int k = 0; k < rf.tree_count(); ++k)
+            arrays->roots.push_back(flattenTree(rf.tree(k), weighted, *arrays));
+
+        tree_count_ = (int)arrays->roots.size();
+        node_count_ = (int)arrays->column.size();
+        leaf_count_ = (int)(arrays->leaf_votes.size() / class_count_);
+        roots_      = arrays->roots.data();
+        column_     = arrays->column.data();
+        threshold_  = arrays->threshold.data();
+        child_[0]   = arrays->child[0].data();
+        child_[1]   = arrays->child[1].data();
+        leaf_votes_ = arrays->leaf_votes.data();
+        storage_    = arrays;
+    }
+
+        /** Check if the forest can be flattened.
+        */
+    template <class RF>
+    static bool supports(RF const & rf)
+    {
+        if(rf.tree_count() == 0)
+            return false;
+        for(int k = 0; k < rf.tree_count(); ++k)
+        {
+            ArrayVector<Int32> const & topology = rf.tree(k).topology_;
+            ArrayVector<double> const & parameters = rf.tree(k).parameters_;
+            std::vector<Int32> stack(1, 2);
+            while(!stack.empty())
+            {
+                Int32 index = stack.back();
+                stack.pop_back();
+                if(topology[index] == e_ConstProbNode)
+                    continue;
+                if(topology[index] != i_ThresholdNode)
+                    return false;
+                Node<i_ThresholdNode> node(topology, parameters, index);
+                if(node.feature_type() != 0)
+                    return false;
+                stack.push_back(node.child(1));
+                stack.push_back(node.child(0));
+            }
+        }
+        return true;
+    }
+
+    int tree_count() const
+    {
+        return tree_count_;
+    }
+
+    int column_count() const
+    {
+        return column_count_;
+    }
+
+    int class_count() const
+    {
+        return class_count_;
+    }
+
+        /** Total number of internal nodes in all trees.
+        */
+    int node_count() const
+    {
+        return node_count_;
+    }
+
+        /** Total number of leaves in all trees.
+        */
+    int leaf_count() const
+    {
+        return leaf_count_;
+    }
+
+        /** \brief Predict the class probabilities of all rows of <tt>features</tt>.
+
+            <tt>features</tt> must have at least column_count() columns, and
+            <tt>prob</tt> must be a <tt>features.shape(0) x class_count()</tt> matrix.
+        */
+    template <class U, class C1, class T, class C2>
+    void predictProbabilities(MultiArrayView<2, U, C1> const & features,
+                              MultiArrayView<2, T, C2>       & prob,
+                              ParallelOptions const          & options = ParallelOptions()) const
+    {
+        vigra_precondition(rowCount(features) == rowCount(prob),
+          "FlatRandomForest::predictProbabilities():"
+            " Feature matrix and probability matrix size mismatch.");
+        vigra_precondition(columnCount(features) >= column_count_,
+          "FlatRandomForest::predictProbabilities():"
+            " Too few columns in feature matrix.");
+        vigra_precondition(columnCount(prob) == (MultiArrayIndex)class_count_,
+          "FlatRandomForest::predictProbabilities():"
+          " Probability matrix must have as many columns as there are classes.");
+
+        predictBlocks(features, options,
+            [&prob](MultiArrayIndex row, double const * votes, double totalWeight, int classCount)
+            {
+                for(int l = 0; l < classCount; ++l)
+                    prob(row, l) = detail::RequiresExplicitCast<T>::cast(votes[l] / totalWeight);
+            });
+    }
+
+        /** \brief Predict the labels of all rows of <tt>features</tt>.
+
+            <tt>labels</tt> must be a <tt>features.shape(0) x 1</tt> matrix.
+        */
+    template <class U, class C1, class T, class C2>
+    void predictLabels(MultiArrayView<2, U, C1> const & features,
+                       MultiArrayView<2, T, C2>       & labels,
+                       ParallelOptions const          & options = ParallelOptions()) const
+    {
+        vigra_precondition(features.shape(0) == labels.shape(0),
+            "FlatRandomForest::predictLabels(): Label array has wrong size.");
+        vigra_precondition(columnCount(features) >= column_count_,
+          "FlatRandomForest::predictLabels():"
+            " Too few columns in feature matrix.");
+
+        ArrayVector<LabelType> const & classes = classes_;
+        predictBlocks(features, options,
+            [&labels, &classes](MultiArrayIndex row, double const * votes, double, int classCount)
+            {
+                labels(row, 0) = detail::RequiresExplicitCast<T>::cast(
+                                     classes[argMax(votes, votes + classCount) - votes]);
+            });
+    }
+
+  private:
+    friend struct detail::FlatForestIO;
+
+        // node and leaf arrays of a forest that was flattened in memory
+        // (forests imported from a file refer to the mapped file instead)
+    struct Arrays
+    {
+        ArrayVector<IndexType>      roots;
+        ArrayVector<IndexType>      column;
+        ArrayVector<ThresholdType>  threshold;
+        ArrayVector<IndexType>      child[2];
+        ArrayVector<double>         leaf_votes;
+    };
+
+    template <class Tree>
+    IndexType flattenTree(Tree const & tree, bool weighted, Arrays & arrays)
+    {
+        ArrayVector<Int32> const & topology = tree.topology_;
+        ArrayVector<double> const & parameters = tree.parameters_;
+
+        // depth-first, so that the left child follows its parent;
+        // stack entries are (index in the tree, flat index of the parent, child slot)
+        std::vector<TinyVector<IndexType, 3> > stack;
+        stack.push_back(TinyVector<IndexType, 3>(2, -1, 0));
+        IndexType root = 0;
+        while(!stack.empty())
+        {
+            TinyVector<IndexType, 3> entry = stack.back();
+            stack.pop_back();
+
+            IndexType flat;
+            if(topology[entry[0]] == e_ConstProbNode)
+            {
+                Node<e_ConstProbNode> node(topology, parameters, entry[0]);
+                double w = node.weights();
+                // leaves are encoded as negative indices
+                flat = -1 - (IndexType)(arrays.leaf_votes.size() / class_count_);
+                for(int l = 0; l < class_count_; ++l)
+                    arrays.leaf_votes.push_back(node.prob_begin()[l] * (weighted * w + (1 - weighted)));
+            }
+            else
+            {
+                Node<i_ThresholdNode> node(topology, parameters, entry[0]);
+                flat = (IndexType)arrays.column.size();
+                arrays.column.push_back(node.column());
+                arrays.threshold.push_back(detail::FlatForestThreshold<ThresholdType>::cast(node.threshold()));
+                arrays.child[0].push_back(0);
+                arrays.child[1].push_back(0);
+                stack.push_back(TinyVector<IndexType, 3>(node.child(1), flat, 1));
+                stack.push_back(TinyVector<IndexType, 3>(node.child(0), flat, 0));
+            }
+
+            if(entry[1] < 0)
+                root = flat;
+            else
+                arrays.child[entry[2]][entry[1]] = flat;
+        }
+        return root;
+    }
+
+        // Pass blocks of rows through all trees and hand the accumulated
+        // votes of each row to 'write'.
+    template <class U, class C, class WRITE>
+    void predictBlocks(MultiArrayView<2, U, C> const & features,
+                       ParallelOptions const & options,
+                       WRITE write) const
+    {
+        MultiArrayIndex rowCount = features.shape(0);
+        if(rowCount == 0)
+            return;
+
+        vigra_precondition(tree_count() > 0,
+          "FlatRandomForest: forest is empty.");
+
+        int blockCount = (int)((rowCount + BlockSize - 1) / BlockSize);
+        int threadCount = std::max(1, options.getActualNumThreads());
+        std::vector<std::vector<double> > votes(threadCount,
+                                    std::vector<double>(BlockSize*class_count_));
+        std::vector<std::vector<IndexType> > leaves(threadCount,
+                                    std::vector<IndexType>(BlockSize));
+
+        U const * data = features.data();
+        MultiArrayIndex rowStride = features.stride(0),
+                        colStride = features.stride(1);
+
+        parallel_foreach(0, blockCount,
+            [&](int thread_id, int block)
+            {
+                MultiArrayIndex begin = (MultiArrayIndex)block*BlockSize,
+                                end   = std::min<MultiArrayIndex>(begin + BlockSize, rowCount);
+                int size = (int)(end - begin);
+                double * blockVotes = &votes[thread_id][0];
+                IndexType * blockLeaves = &leaves[thread_id][0];
+                double totalWeight[BlockSize] = { 0.0 };
+                std::fill(blockVotes, blockVotes + size*class_count_, 0.0);
+
+                for(int k = 0; k < tree_count(); ++k)
+                {
+                    for(int i = 0; i < size; ++i)
+                    {
+                        U const * row = data + (begin + i)*rowStride;
+                        IndexType node = roots_[k];
+                        while(node >= 0)
+                            node = (row[column_[node]*colStride] < threshold_[node])
+                                       ? child_[0][node]
+                                       : child_[1][node];
+                        blockLeaves[i] = -1 - node;
+                    }
+                    for(int i = 0; i < size; ++i)
+                    {
+                        double const * leaf = &leaf_votes_[blockLeaves[i]*class_count_];
+                        double * v = blockVotes + i*class_count_;
+                        for(int l = 0; l < class_count_; ++l)
+                        {
+                            v[l] += leaf[l];
+                            totalWeight[i] += leaf[l];
+                        }
+                    }
+                }
+
+                for(int i = 0; i < size; ++i)
+                    write(begin + i, blockVotes + i*class_count_, totalWeight[i], class_count_);
+            },
+            options);
+    }
+
+    int                             column_count_;
+    int                             class_count_;
+    int                             tree_count_;
+    int                             node_count_;
+    int                             leaf_count_;
+    ArrayVector<LabelType>          classes_;
+    IndexType const *               roots_;
+    IndexType const *               column_;
+    ThresholdType const *           threshold_;
+    IndexType const *               child_[2];
+    double const *                  leaf_votes_;
+    VIGRA_SHARED_PTR<void const>    storage_;   // owner of the arrays above
+};
+
+} // namespace vigra
+
+#endif // VIGRA_RF_FLAT_FOREST_HXX
@@ -0,0 +1,465 @@
+/************************************************************************/
+/*                                                                      */
+/*    This file is part of the VIGRA computer vision library.           */
+/*    The VIGRA Website is                                              */
+/*        http://hci.iwr.uni-heidelberg.de/vigra/                       */
+/*    Please direct questions, bug reports, and contributions to        */
+/*        ullrich.koethe@iwr.uni-heidelberg.de    or                    */
+/*        vigra@informatik.uni-hamburg.de                               */
+/*                                                                      */
+/*    Permission is hereby granted, free of charge, to any person       */
+/*    obtaining a copy of this software and associated documentation    */
+/*    files (the "Software"), to deal in the Software without           */
+/*    restriction, including without limitation the rights to use,      */
+/*    copy, modify, merge, publish, distribute, sublicense, and/or      */
+/*    sell copies of the Software, and to permit persons to whom the    */
+/*    Software is furnished to do so, subject to the following          */
+/*    conditions:                                                       */
+/*                                                                      */
+/*    The above copyright notice and this permission notice shall be    */
+/*    included in all copies or substantial portions of the             */
+/*    Software.                                                         */
+/*                                                                      */
+/*    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND    */
+/*    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES   */
+/*    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND          */
+/*    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT       */
+/*    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,      */
+/*    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING      */
+/*    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR     */
+/*    OTHER DEALINGS IN THE SOFTWARE.                                   */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef VIGRA_RF_HISTOGRAM_SPLIT_HXX
+#define VIGRA_RF_HISTOGRAM_SPLIT_HXX
+
+#include <algorithm>
+#include <map>
+#include <utility>
+#include "../array_vector.hxx"
+#include "../multi_array.hxx"
+#include "../sized_int.hxx"
+#include "../threading.hxx"
+#include "rf_split.hxx"
+
+namespace vigra
+{
+
+namespace detail
+{
+
+/* Quantile bins of all feature columns. They are computed once per
+ * training set and shared by all copies of a HistogramSplit.
+ */
+class HistogramSplitBins
+{
+  public:
+    HistogramSplitBins()
+    : data_(0)
+    {}
+
+        // bin 'features' unless this has already been done
+    template <class T, class C>
+    void bin(MultiArrayView<2, T, C> const & features, int binCount)
+    {
+#ifndef VIGRA_SINGLE_THREADED
+        threading::lock_guard<threading::mutex> guard(lock_);
+#endif
+        if(data_ == features.data() && codes_.shape() == features.shape())
+            return;
+
+        MultiArrayIndex rowCount = features.shape(0),
+                        columnCount = features.shape(1);
+        codes_.reshape(features.shape());
+        boundaries_.resize(columnCount);
+
+        ArrayVector<double> values(rowCount);
+        for(MultiArrayIndex c = 0; c < columnCount; ++c)
+        {
+            for(MultiArrayIndex r = 0; r < rowCount; ++r)
+                values[r] = features(r, c);
+            std::sort(values.begin(), values.end());
+
+            // place at most binCount-1 boundaries halfway between distinct
+            // values, such that the bins have roughly equal sample counts
+            ArrayVector<double> & boundaries = boundaries_[c];
+            boundaries.clear();
+            MultiArrayIndex distinct = std::unique(values.begin(), values.end()) - values.begin();
+            if(distinct <= binCount)
+            {
+                for(MultiArrayIndex k = 0; k+1 < distinct; ++k)
+                    boundaries.push_back((values[k] + values[k+1]) / 2.0);
+            }
+            else
+            {
+                for(MultiArrayIndex r = 0; r < rowCount; ++r)
+                    values[r] = features(r, c);
+                std::sort(values.begin(), values.end());
+                for(int b = 1; b < binCount; ++b)
+                {
+                    // first sample of the b-th quantile, moved to the
+                    // beginning of its run of equal values
+                    MultiArrayIndex r = (MultiArrayIndex)((double)b * rowCount / binCount);
+                    r = std::lower_bound(values.begin(), values.begin() + r, values[r]) - values.begin();
+                    if(r == 0)
+                        continue;
+                    double boundary = (values[r-1] + values[r]) / 2.0;
+                    if(boundaries.size() == 0 || boundaries.back() < boundary)
+                        boundaries.push_back(boundary);
+                }
+            }
+
+            for(MultiArrayIndex r = 0; r < rowCount; ++r)
+                codes_(r, c) = (UInt8)(std::upper_bound(boundaries.begin(), boundaries.end(),
+                                                        (double)features(r, c))
+                                         - boundaries.begin());
+        }
+        data_ = features.data();
+    }
+
+        // the code of sample 'row' in column 'column' is the number of
+        // boundaries less or equal to its feature value
+    UInt8 code(MultiArrayIndex row, MultiArrayIndex column) const
+    {
+        return codes_(row, column);
+    }
+
+    ArrayVector<double> const & boundaries(MultiArrayIndex column) const
+    {
+        return boundaries_[column];
+    }
+
+  private:
+    void const *                        data_;
+    MultiArray<2, UInt8>                codes_;
+    ArrayVector<ArrayVector<double> >   boundaries_;
+#ifndef VIGRA_SINGLE_THREADED
+    threading::mutex                    lock_;
+#endif
+};
+
+} // namespace detail
+
+/** \brief Histogram-based split functor for classification forests.
+
+    <b>\#include</b> \<vigra/random_forest.hxx\><br>
+    Namespace: vigra
+
+    Drop-in replacement for \ref GiniSplit on large training sets. On first
+    use, every feature column is mapped to at most <tt>binCount</tt> (&lt;= 256)
+    quantile bins, which are shared by all trees. Split candidates are then
+    evaluated from per-node class histograms over the bins, which takes
+    linear time in the node size instead of sorting the node's samples
+    for every candidate column. If a column has no more distinct values than
+    bins, the candidate thresholds coincide with the ones of \ref GiniSplit.
+
+    When every column is a split candidate (RandomForestOptions::features_per_node(RF_ALL)),
+    only the histograms of the smaller child are counted, and the larger
+    sibling's histograms are obtained by subtraction from the parent.
+
+    Contextual features (RandomForestOptions::feature_mix()) are not used by this
+    functor, all splits are plain thresholds on feature columns.
+
+    \code
+    RandomForest<int> rf(RandomForestOptions().tree_count(100));
+    rf.learn(features, labels, rf_default(), HistogramSplit());
+    \endcode
+*/
+class HistogramSplit
+: public SplitBase<ClassificationTag>
+{
+  public:
+    typedef SplitBase<ClassificationTag> SB;
+
+    ArrayVector<Int32>              splitColumns;
+    ArrayVector<double>             bestCurrentCounts[2];
+    double                          region_gini_;
+    double                          min_gini_;
+    int                             min_column_;
+    double                          min_threshold_;
+
+        /** Create a split functor using at most <tt>binCount</tt> bins per
+            feature column (default: 256).
+        */
+    explicit HistogramSplit(int binCount = 256)
+    : region_gini_(0.0),
+      min_gini_(0.0),
+      min_column_(0),
+      min_threshold_(0.0),
+      bin_count_(binCount)
+    {
+        vigra_precondition(binCount >= 2 && binCount <= 256,
+            "HistogramSplit(): binCount must be in [2, 256].");
+    }
+
+    double minGini() const
+    {
+        return min_gini_;
+    }
+
+    int bestSplitColumn() const
+    {
+        return min_column_;
+    }
+
+    double bestSplitThreshold() const
+    {
+        return min_threshold_;
+    }
+
+    template<class T>
+    void set_external_parameters(ProblemSpec<T> const & in)
+    {
+        SB::set_external_parameters(in);
+        int featureCount = SB::ext_param_.column_count_;
+        splitColumns.resize(featureCount);
+        for(int k = 0; k < featureCount; ++k)
+            splitColumns[k] = k;
+        class_weights_ = SB::ext_param_.class_weights_;
+        if((int)class_weights_.size() != SB::ext_param_.class_count_)
+            class_weights_.resize(SB::ext_param_.class_count_, 1.0);
+        bestCurrentCounts[0].resize(SB::ext_param_.class_count_);
+        bestCurrentCounts[1].resize(SB::ext_param_.class_count_);
+        bins_.reset(new detail::HistogramSplitBins);
+        children_.clear();
+    }
+
+    template<class T, class C, class T2, class C2, class Region, class Random>
+    int findBestSplit(MultiArrayView<2, T, C> features,
+                      MultiArrayView<2, T2, C2>  labels,
+                      Region & region,
+                      ArrayVector<Region>& childRegions,
+                      Random & randint)
+    {
+        typedef typename Region::IndexIterator IndexIterator;
+
+        detail::Correction<ClassificationTag>::exec(region, labels);
+
+        int classCount  = SB::ext_param_.class_count_;
+        int columnCount = (int)features.shape(1);
+        region_gini_ = GiniCriterion::impurity(region.classCounts(), class_weights_,
+                                               (double)region.size());
+        if(region_gini_ <= SB::ext_param_.precision_)
+        {
+            children_.erase(key(region));
+            return this->makeTerminalNode(features, labels, region, randint);
+        }
+
+        bins_->bin(features, bin_count_);
+
+        // select columns to be tried (as in ThresholdSplit)
+        for(int ii = 0; ii < SB::ext_param_.actual_mtry_; ++ii)
+            std::swap(splitColumns[ii],
+                      splitColumns[ii+ randint(columnCount - ii)]);
+
+        // with all columns as candidates, histograms are passed on to the children
+        bool subtract = SB::ext_param_.actual_mtry_ >= columnCount;
+        VIGRA_SHARED_PTR<ArrayVector<double> > hist;
+        if(subtract)
+        {
+            typename Children::iterator known = children_.find(key(region));
+            if(known != children_.end())
+            {
+                hist = known->second;
+                children_.erase(known);
+            }
+            else
+            {
+                hist.reset(new ArrayVector<double>());
+                countAll(labels, region.begin(), region.end(), columnCount, *hist);
+            }
+        }
+
+        double current_min_gini = region_gini_;
+        int    bestColumn = 0, bestBin = 0;
+        int    num2try = columnCount;
+        ArrayVector<double> columnHist(bin_count_*classCount);
+        for(int k = 0; k < num2try; ++k)
+        {
+            int column = splitColumns[k];
+            double const * h;
+            if(subtract)
+            {
+                h = &(*hist)[column*bin_count_*classCount];
+            }
+            else
+            {
+                columnHist.init(0.0);
+                for(IndexIterator i = region.begin(); i != region.end(); ++i)
+                    columnHist[bins_->code(*i, column)*classCount + (int)labels(*i, 0)] += 1.0;
+                h = columnHist.begin();
+            }
+
+            int bin = bestBinOfColumn(h, column, region.classCounts(), (double)region.size());
+            if(bin >= 0 && min_gini_ < current_min_gini)
+            {
+                current_min_gini = min_gini_;
+                bestColumn = column;
+                bestBin = bin;
+                childRegions[0].classCounts() = bestCurrentCounts[0];
+                childRegions[1].classCounts() = bestCurrentCounts[1];
+                childRegions[0].classCountsIsValid = true;
+                childRegions[1].classCountsIsValid = true;
+                num2try = SB::ext_param_.actual_mtry_;
+            }
+        }
+        min_gini_ = current_min_gini;
+
+        // did not find any suitable split
+        if(closeAtTolerance(current_min_gini, region_gini_))
+            return this->makeTerminalNode(features, labels, region, randint);
+
+        min_column_    = bestColumn;
+        min_threshold_ = bins_->boundaries(bestColumn)[bestBin];
+
+        //create a Node for output
+        Node<i_ThresholdNode>   node(SB::t_data, SB::p_data);
+        SB::node_ = node;
+        node.threshold()    = min_threshold_;
+        node.column()       = min_column_;
+        node.feature_type() = 0;
+        node.offset_x()     = 0;
+        node.offset_y()     = 0;
+        node.offset_x2()    = 0;
+        node.offset_y2()    = 0;
+
+        // partition the range according to the best column; codes <= bestBin
+        // are exactly the feature values below the threshold
+        IndexIterator bestSplit =
+            std::partition(region.begin(), region.end(), CodeBelow(*bins_, bestColumn, bestBin));
+        childRegions[0].setRange(region.begin(), bestSplit);
+        childRegions[0].rule = region.rule;
+        childRegions[0].rule.push_back(std::make_pair(1, 1.0));
+        childRegions[1].setRange(bestSplit, region.end());
+        childRegions[1].rule = region.rule;
+        childRegions[1].rule.push_back(std::make_pair(1, 1.0));
+
+        if(subtract)
+        {
+            // count the smaller child, and subtract it from the parent
+            int small = childRegions[0].size() <= childRegions[1].size() ? 0 : 1;
+            VIGRA_SHARED_PTR<ArrayVector<double> > smallHist(new ArrayVector<double>());
+            countAll(labels, childRegions[small].begin(), childRegions[small].end(),
+                     columnCount, *smallHist);
+            for(std::size_t k = 0; k < hist->size(); ++k)
+                (*hist)[k] -= (*smallHist)[k];
+            rememberChild(childRegions[small], smallHist);
+            rememberChild(childRegions[1-small], hist);
+        }
+
+        return i_ThresholdNode;
+    }
+
+  private:
+
+    typedef std::pair<void const *, std::ptrdiff_t>                 Key;
+    typedef std::map<Key, VIGRA_SHARED_PTR<ArrayVector<double> > >  Children;
+
+    class CodeBelow
+    {
+      public:
+        CodeBelow(detail::HistogramSplitBins const & bins, int column, int bin)
+        : bins_(bins), column_(column), bin_(bin)
+        {}
+
+        bool operator()(Int32 row) const
+        {
+            return bins_.code(row, column_) <= bin_;
+        }
+
+        detail::HistogramSplitBins const & bins_;
+        int column_, bin_;
+    };
+
+    template <class Region>
+    static Key key(Region & region)
+    {
+        return Key(region.size() > 0 ? (void const *)&*region.begin() : 0,
+                   (std::ptrdiff_t)region.size());
+    }
+
+        // only keep histograms of children that may be split
+    template <class Region>
+    void rememberChild(Region & region, VIGRA_SHARED_PTR<ArrayVector<double> > const & hist)
+    {
+        if(region.size() > 1 && region.classCounts().size() > 0)
+        {
+            int nonZero = 0;
+            for(std::size_t l = 0; l < region.classCounts().size(); ++l)
+                nonZero += region.classCounts()[l] > 0;
+            if(nonZero > 1)
+                children_[key(region)] = hist;
+        }
+    }
+
+        // histograms of all columns, layout [column][bin][class]
+    template <class Labels, class Iterator>
+    void countAll(Labels const & labels, Iterator begin, Iterator end,
+                  int columnCount, ArrayVector<double> & hist) const
+    {
+        int classCount = SB::ext_param_.class_count_;
+        hist.resize(columnCount*bin_count_*classCount);
+        hist.init(0.0);
+        for(int column = 0; column < columnCount; ++column)
+        {
+            double * h = &hist[column*bin_count_*classCount];
+            for(Iterator i = begin; i != end; ++i)
+                h[bins_->code(*i, column)*classCount + (int)labels(*i, 0)] += 1.0;
+        }
+    }
+
+        // Find the best split of a column from its histogram 'h'. Returns
+        // the bin whose upper boundary is the threshold, or -1 if the
+        // column can't be split.
+    int bestBinOfColumn(double const * h, int column,
+                        ArrayVector<double> const & regionCounts, double regionSize)
+    {
+        int classCount = SB::ext_param_.class_count_;
+        int boundaryCount = (int)bins_->boundaries(column).size();
+
+        left_.resize(classCount);
+        left_.init(0.0);
+        right_ = regionCounts;
+        double leftSize = 0.0, rightSize = regionSize;
+
+        int best = -1;
+        for(int b = 0; b < boundaryCount; ++b, h += classCount)
+        {
+            double binSize = 0.0;
+            for(int l = 0; l < classCount; ++l)
+            {
+                left_[l]  += h[l];
+                right_[l] -= h[l];
+                binSize   += h[l];
+            }
+            if(binSize == 0.0)
+                continue;
+            leftSize  += binSize;
+            rightSize -= binSize;
+            if(rightSize <= 0.0)
+                break;
+
+            double loss = GiniCriterion::impurity(left_, class_weights_, leftSize) +
+                          GiniCriterion::impurity(right_, class_weights_, rightSize);
+            if(best < 0 || loss < min_gini_)
+            {
+                best = b;
+                min_gini_ = loss;
+                bestCurrentCounts[0] = left_;
+                bestCurrentCounts[1] = right_;
+            }
+        }
+        return best;
+    }
+
+    int                                         bin_count_;
+    ArrayVector<double>                         class_weights_;
+    ArrayVector<double>                         left_, right_;
+    VIGRA_SHARED_PTR<detail::HistogramSplitBins> bins_;
+    Children                                    children_;
+};
+
+} // namespace vigra
+
+#endif // VIGRA_RF_HISTOGRAM_SPLIT_HXX
@@ -0,0 +1,430 @@
+/************************************************************************/
+/*                                                                      */
+/*    This file is part of the VIGRA computer vision library.           */
+/*    The VIGRA Website is                                              */
+/*        http://hci.iwr.uni-heidelberg.de/vigra/                       */
+/*    Please direct questions, bug reports, and contributions to        */
+/*        ullrich.koethe@iwr.uni-heidelberg.de    or                    */
+/*        vigra@informatik.uni-hamburg.de                               */
+/*                                                                      */
+/*    Permission is hereby granted, free of charge, to any person       */
+/*    obtaining a copy of this software and associated documentation    */
+/*    files (the "Software"), to deal in the Software without           */
+/*    restriction, including without limitation the rights to use,      */
+/*    copy, modify, merge, publish, distribute, sublicense, and/or      */
+/*    sell copies of the Software, and to permit persons to whom the    */
+/*    Software is furnished to do so, subject to the following          */
+/*    conditions:                                                       */
+/*                                                                      */
+/*    The above copyright notice and this permission notice shall be    */
+/*    included in all copies or substantial portions of the             */
+/*    Software.                                                         */
+/*                                                                      */
+/*    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND    */
+/*    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES   */
+/*    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND          */
+/*    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT       */
+/*    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,      */
+/*    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING      */
+/*    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR     */
+/*    OTHER DEALINGS IN THE SOFTWARE.                                   */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef VIGRA_RF_INCREMENTAL_HXX
+#define VIGRA_RF_INCREMENTAL_HXX
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <numeric>
+#include "../array_vector.hxx"
+#include "../multi_array.hxx"
+#include "../sized_int.hxx"
+#include "rf_nodeproxy.hxx"
+#include "rf_decisionTree.hxx"
+
+namespace vigra
+{
+
+/**\brief Options object for RandomForest::incrementalLearn().
+ *
+ * <b>usage:</b>
+ *
+ * \code
+ * IncrementalLearningOptions opt = IncrementalLearningOptions()
+ *                                      .candidate_count(20)
+ *                                      .min_split_count(50);
+ * \endcode
+ *
+ * Each leaf that receives new samples keeps its class histogram and the class
+ * histograms of <tt>candidate_count</tt> randomly chosen split candidates.
+ * A leaf is split when it has seen <tt>min_split_count</tt> new samples and the
+ * best candidate decreases the Gini impurity by at least <tt>min_gain</tt>.
+ * Thus, memory consumption is bounded by
+ * <tt>(2*candidate_count + 1) * classCount</tt> doubles per updated leaf.
+ */
+class IncrementalLearningOptions
+{
+  public:
+    int     candidate_count_;
+    double  min_split_count_;
+    double  min_gain_;
+    int     max_depth_;
+    double  poisson_lambda_;
+
+    IncrementalLearningOptions()
+    : candidate_count_(10),
+      min_split_count_(20.0),
+      min_gain_(0.02),
+      max_depth_(30),
+      poisson_lambda_(1.0)
+    {}
+
+    /**\brief Number of random split candidates per leaf. The column of each
+     * candidate is chosen at random, its threshold is the feature value of
+     * the corresponding new sample arriving at the leaf.
+     *
+     * <br> Default: 10
+     */
+    IncrementalLearningOptions & candidate_count(int in)
+    {
+        vigra_precondition(in > 0,
+            "IncrementalLearningOptions::candidate_count(): argument must be positive.");
+        candidate_count_ = in;
+        return *this;
+    }
+
+    /**\brief Number of new samples a leaf must have seen before it is split.
+     *
+     * <br> Default: 20
+     */
+    IncrementalLearningOptions & min_split_count(double in)
+    {
+        vigra_precondition(in > 0.0,
+            "IncrementalLearningOptions::min_split_count(): argument must be positive.");
+        min_split_count_ = in;
+        return *this;
+    }
+
+    /**\brief Minimal decrease of the Gini impurity required for a split.
+     *
+     * <br> Default: 0.02
+     */
+    IncrementalLearningOptions & min_gain(double in)
+    {
+        vigra_precondition(in >= 0.0,
+            "IncrementalLearningOptions::min_gain(): argument must not be negative.");
+        min_gain_ = in;
+        return *this;
+    }
+
+    /**\brief Leaves at this depth are no longer split.
+     *
+     * <br> Default: 30
+     */
+    IncrementalLearningOptions & max_depth(int in)
+    {
+        vigra_precondition(in >= 0,
+            "IncrementalLearningOptions::max_depth(): argument must not be negative.");
+        max_depth_ = in;
+        return *this;
+    }
+
+    /**\brief Each new sample is added to each tree with a Poisson(lambda)
+     * distributed multiplicity (online bagging). Set to 0 to add each sample
+     * exactly once to every tree.
+     *
+     * <br> Default: 1.0
+     */
+    IncrementalLearningOptions & poisson_lambda(double in)
+    {
+        vigra_precondition(in >= 0.0,
+            "IncrementalLearningOptions::poisson_lambda(): argument must not be negative.");
+        poisson_lambda_ = in;
+        return *this;
+    }
+};
+
+namespace detail
+{
+
+/* Sufficient statistics of a leaf that received samples in
+ * RandomForest::incrementalLearn().
+ */
+struct RFLeafStatistics
+{
+    ArrayVector<double> counts;              // class histogram of the leaf
+    ArrayVector<Int32>  columns;             // columns of the split candidates
+    ArrayVector<double> thresholds;          // only the first 'initialized' are valid
+    ArrayVector<double> left, right;         // class histograms of the candidates
+    int                 initialized;
+    double              arrived;             // weight of the new samples
+    int                 depth;
+
+    RFLeafStatistics()
+    : initialized(0),
+      arrived(0.0),
+      depth(0)
+    {}
+
+    template <class Random>
+    void init(int classCount, int columnCount, int depth_, 
+              IncrementalLearningOptions const & options, Random const & random)
+    {
+        counts.resize(classCount, 0.0);
+        columns.resize(options.candidate_count_);
+        for(int k = 0; k < options.candidate_count_; ++k)
+            columns[k] = random.uniformInt(columnCount);
+        thresholds.resize(options.candidate_count_, 0.0);
+        left.resize(options.candidate_count_*classCount, 0.0);
+        right.resize(options.candidate_count_*classCount, 0.0);
+        initialized = 0;
+        arrived = 0.0;
+        depth = depth_;
+    }
+};
+
+typedef std::map<Int32, RFLeafStatistics> RFTreeStatistics;
+
+inline double rfGiniImpurity(ArrayVector<double>::const_iterator counts, int classCount, double & total)
+{
+    total = 0.0;
+    double sq = 0.0;
+    for(int c = 0; c < classCount; ++c)
+    {
+        total += counts[c];
+        sq += counts[c]*counts[c];
+    }
+    return total > 0.0
+              ? 1.0 - sq / (total*total)
+              : 0.0;
+}
+
+    // write the class histogram 'counts' into the leaf at 'addr'
+inline void rfSetLeafCounts(DecisionTree & tree, Int32 addr,
+                            ArrayVector<double> const & counts,
+                            ArrayVector<double> const & classWeights)
+{
+    Node<e_ConstProbNode> leaf(tree.topology_, tree.parameters_, addr);
+    int classCount = leaf.prob_size();
+    bool weighted = static_cast<int>(classWeights.size()) == classCount;
+    double total = 0.0, sum = 0.0;
+    for(int c = 0; c < classCount; ++c)
+    {
+        leaf.prob_begin()[c] = weighted
+                                  ? counts[c] * classWeights[c]
+                                  : counts[c];
+        sum += leaf.prob_begin()[c];
+        total += counts[c];
+    }
+    for(int c = 0; c < classCount; ++c)
+        leaf.prob_begin()[c] = sum > 0.0
+                                  ? leaf.prob_begin()[c] / sum
+                                  : 1.0 / classCount;
+    leaf.weights() = total;
+}
+
+    // inverse of rfSetLeafCounts(): the class histogram a trained leaf was made from
+inline void rfGetLeafCounts(DecisionTree const & tree, Int32 addr,
+                            ArrayVector<double> & counts,
+                            ArrayVector<double> const & classWeights)
+{
+    Node<e_ConstProbNode> leaf(tree.topology_, tree.parameters_, addr);
+    int classCount = leaf.prob_size();
+    bool weighted = static_cast<int>(classWeights.size()) == classCount;
+    double sum = 0.0;
+    for(int c = 0; c < classCount; ++c)
+    {
+        counts[c] = leaf.prob_begin()[c];
+        if(weighted)
+            counts[c] = classWeights[c] > 0.0
+                           ? counts[c] / classWeights[c]
+                           : 0.0;
+        sum += counts[c];
+    }
+    for(int c = 0; c < classCount; ++c)
+        counts[c] = sum > 0.0
+                       ? counts[c] * leaf.weights() / sum
+                       : 0.0;
+}
+
+template <class Random>
+int rfPoisson(double lambda, Random const & random)
+{
+    if(lambda == 0.0)
+        return 1;
+    double L = std::exp(-lambda), p = random.uniform53();
+    int k = 0;
+    while(p > L)
+    {
+        ++k;
+        p *= random.uniform53();
+    }
+    return k;
+}
+
+/* Add the samples in 'features' (with class indices 'classes') to a tree.
+ * Only the leaves reached by the samples are updated. Leaves whose statistics
+ * justify a split are replaced by a threshold node with two new leaves; the old
+ * leaf becomes the left child, so that the tree only grows at its end.
+ */
+template <class U, class C, class Random>
+void rfIncrementalUpdate(DecisionTree & tree, RFTreeStatistics & statistics,
+                         MultiArrayView<2, U, C> const & features,
+                         ArrayVector<Int32> const & classes,
+                         ArrayVector<double> const & classWeights,
+                         IncrementalLearningOptions const & options,
+                         Random const & random)
+{
+    int classCount = tree.topology_[1],
+        columnCount = static_cast<int>(features.shape(1)),
+        candidateCount = options.candidate_count_;
+    float scale = 1 / static_cast<float>(tree.options_.test_scale_);
+    ArrayVector<double> both(classCount);
+
+    for(int row = 0; row < static_cast<int>(features.shape(0)); ++row)
+    {
+        int weight = rfPoisson(options.poisson_lambda_, random);
+        if(weight == 0)
+            continue;
+
+        // find the leaf and its parent
+        Int32 addr = 2, parent = -1;
+        int side = 0, depth = 0;
+        while(!tree.isLeafNode(tree.topology_[addr]))
+        {
+            vigra_precondition(tree.topology_[addr] == i_ThresholdNode,
+                "RandomForest::incrementalLearn(): only threshold nodes are supported.");
+            Node<i_ThresholdNode> node(tree.topology_, tree.parameters_, addr);
+            parent = addr;
+            addr = node.next(features, row, tree.options_.image_shape_, scale);
+            side = addr == node.child(0) ? 0 : 1;
+            ++depth;
+        }
+        vigra_precondition(tree.topology_[addr] == e_ConstProbNode,
+            "RandomForest::incrementalLearn(): only constant probability leaves are supported.");
+
+        RFTreeStatistics::iterator found = statistics.find(addr);
+        if(found == statistics.end())
+        {
+            found = statistics.insert(std::make_pair(addr, RFLeafStatistics())).first;
+            found->second.init(classCount, columnCount, depth, options, random);
+            rfGetLeafCounts(tree, addr, found->second.counts, classWeights);
+        }
+        RFLeafStatistics & leaf = found->second;
+
+        // update the leaf and the candidates
+        int label = classes[row];
+        leaf.counts[label] += weight;
+        leaf.arrived += weight;
+        if(leaf.initialized < candidateCount)
+        {
+            leaf.thresholds[leaf.initialized] = features(row, leaf.columns[leaf.initialized]);
+            ++leaf.initialized;
+        }
+        for(int k = 0; k < leaf.initialized; ++k)
+        {
+            if(features(row, leaf.columns[k]) < leaf.thresholds[k])
+                leaf.left[k*classCount + label] += weight;
+            else
+                leaf.right[k*classCount + label] += weight;
+        }
+
+        // find the best candidate if the leaf is saturated
+        int best = -1;
+        if(leaf.arrived >= options.min_split_count_ && leaf.depth < options.max_depth_)
+        {
+            double bestGain = options.min_gain_;
+            for(int k = 0; k < leaf.initialized; ++k)
+            {
+                for(int c = 0; c < classCount; ++c)
+                    both[c] = leaf.left[k*classCount + c] + leaf.right[k*classCount + c];
+                double nl, nr, n;
+                double gl = rfGiniImpurity(leaf.left.begin() + k*classCount, classCount, nl),
+                       gr = rfGiniImpurity(leaf.right.begin() + k*classCount, classCount, nr),
+                       g  = rfGiniImpurity(both.begin(), classCount, n);
+                if(nl == 0.0 || nr == 0.0)
+                    continue;
+                double gain = g - (nl*gl + nr*gr) / n;
+                if(gain >= bestGain && (best == -1 || gain > bestGain))
+                {
+                    best = k;
+                    bestGain = gain;
+                }
+            }
+        }
+
+        if(best == -1)
+        {
+            rfSetLeafCounts(tree, addr, leaf.counts, classWeights);
+            continue;
+        }
+
+        // split the leaf: children start with the candidate's histograms, the
+        // remaining counts of the leaf (the trained ones and the samples that
+        // arrived before the candidate was initialized) are divided in
+        // proportion to the candidate's split
+        RFLeafStatistics leftLeaf, rightLeaf;
+        leftLeaf.init(classCount, columnCount, leaf.depth + 1, options, random);
+        rightLeaf.init(classCount, columnCount, leaf.depth + 1, options, random);
+        double nl, nr;
+        rfGiniImpurity(leaf.left.begin() + best*classCount, classCount, nl);
+        rfGiniImpurity(leaf.right.begin() + best*classCount, classCount, nr);
+        for(int c = 0; c < classCount; ++c)
+        {
+            double l = leaf.left[best*classCount + c],
+                   r = leaf.right[best*classCount + c],
+                   rest = std::max(leaf.counts[c] - l - r, 0.0),
+                   fraction = l + r > 0.0
+                                 ? l / (l + r)
+                                 : nl / (nl + nr);
+            leftLeaf.counts[c]  = l + fraction * rest;
+            rightLeaf.counts[c] = r + (1.0 - fraction) * rest;
+        }
+        Int32 column = leaf.columns[best];
+        double threshold = leaf.thresholds[best],
+               total = std::accumulate(leaf.counts.begin(), leaf.counts.end(), 0.0);
+        statistics.erase(found);
+
+        if(parent == -1)
+        {
+            // the root must stay at address 2, rebuild the (single leaf) tree
+            tree.topology_.resize(2);
+            tree.parameters_.clear();
+        }
+        Int32 nodeAddr = tree.topology_.size();
+        {
+            Node<i_ThresholdNode> node(tree.topology_, tree.parameters_);
+            node.column() = column;
+            node.threshold() = threshold;
+            node.weights() = total;
+        }
+        if(parent == -1)
+        {
+            // the left child directly follows the new root
+            addr = tree.topology_.size();
+            Node<e_ConstProbNode> leftNode(tree.topology_, tree.parameters_);
+        }
+        Int32 rightAddr = tree.topology_.size();
+        {
+            Node<e_ConstProbNode> rightNode(tree.topology_, tree.parameters_);
+        }
+        Node<i_ThresholdNode> node(tree.topology_, tree.parameters_, nodeAddr);
+        node.child(0) = addr;
+        node.child(1) = rightAddr;
+        if(parent != -1)
+            NodeBase(tree.topology_, tree.parameters_, parent).child(side) = nodeAddr;
+
+        rfSetLeafCounts(tree, addr, leftLeaf.counts, classWeights);
+        rfSetLeafCounts(tree, rightAddr, rightLeaf.counts, classWeights);
+        statistics[addr] = leftLeaf;
+        statistics[rightAddr] = rightLeaf;
+    }
+}
+
+} // namespace detail
+
+} // namespace vigra
+
+#endif // VIGRA_RF_INCREMENTAL_HXX
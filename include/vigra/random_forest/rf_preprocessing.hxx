@@ -129,8 +129,11 @@ namespace detail
     template<unsigned int N, class T, class C>
     bool contains_nan(MultiArrayView<N, T, C> const & in)
     {
-        for(int ii = 0; ii < in.size(); ++ii)
-            if(isnan(in[ii]))
+        if(!std::numeric_limits<T>::has_quiet_NaN)
+            return false;
+        typedef typename MultiArrayView<N, T, C>::const_iterator Iterator;
+        for(Iterator i = in.begin(), end = in.end(); i != end; ++i)
+            if(isnan(*i))
                 return true;
         return false;
     }
@@ -140,12 +143,13 @@ namespace detail
     template<unsigned int N, class T, class C>
     bool contains_inf(MultiArrayView<N, T, C> const & in)
     {
-         if(!std::numeric_limits<T>::has_infinity)
-             return false;
-         for(int ii = 0; ii < in.size(); ++ii)
-            if(abs(in[ii]) == std::numeric_limits<T>::infinity())
+        if(!std::numeric_limits<T>::has_infinity)
+            return false;
+        typedef typename MultiArrayView<N, T, C>::const_iterator Iterator;
+        for(Iterator i = in.begin(), end = in.end(); i != end; ++i)
+            if(abs(*i) == std::numeric_limits<T>::infinity())
                 return true;
-         return false;
+        return false;
     }
 
 } // namespace detail
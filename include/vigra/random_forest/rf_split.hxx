@@ -1249,7 +1249,10 @@ class ThresholdSplit: public SplitBase<Tag>
 
             // ScaleInvariantDifference Features
 
-            unsigned seed = std::chrono::system_clock::now().time_since_epoch().count();
+            // seed from randint (not the clock), so that learning is reproducible
+            unsigned seed = SB::options_.feature_mix_[3] > 0
+                                ? randint(NumericTraits<Int32>::max())
+                                : 0u;
             std::default_random_engine generator(seed);
             std::normal_distribution<double> distribution(0.0,std_offset_xy);
 
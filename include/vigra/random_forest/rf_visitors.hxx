@@ -42,8 +42,12 @@
 #include <iostream>
 #include <iomanip>
 
+#include <vector>
+
 #include <vigra/multi_pointoperators.hxx>
 #include <vigra/timing.hxx>
+#include <vigra/random.hxx>
+#include <vigra/threadpool.hxx>
 
 namespace vigra
 {
@@ -1258,6 +1262,7 @@ class VariableImportanceVisitor : public VisitorBase
     MultiArray<2, double>       variable_importance_;
     int                         repetition_count_;
     bool                        in_place_;
+    ParallelOptions             parallel_options_;
 
 #ifdef HasHDF5
     void save(std::string filename, std::string prefix)
@@ -1273,10 +1278,31 @@ class VariableImportanceVisitor : public VisitorBase
      * \param rep_cnt (defautl: 10) how often should 
      * the permutation take place. Set to 1 to make calculation faster (but
      * possibly more instable)
+     * \param options the permutations of different columns are evaluated
+     * concurrently on options.getActualNumThreads() threads. The result
+     * doesn't depend on the number of threads.
      */
-    VariableImportanceVisitor(int rep_cnt = 10) 
-    :   repetition_count_(rep_cnt)
+    VariableImportanceVisitor(int rep_cnt = 10,
+                              ParallelOptions const & options = ParallelOptions()) 
+    :   repetition_count_(rep_cnt),
+        parallel_options_(options),
+#ifdef CLASSIFIER_TEST
+        random_(1)
+#else 
+        random_(RandomSeed)
+#endif
+    {}
 
+    /* Constructor
+     * \param seed seed of the random number generator for the permutations,
+     * so that the results are reproducible.
+     */
+    VariableImportanceVisitor(int rep_cnt,
+                              ParallelOptions const & options,
+                              UInt32 seed) 
+    :   repetition_count_(rep_cnt),
+        parallel_options_(options),
+        random_(seed)
     {}
 
     /** calculates impurity decrease based variable importance after every
@@ -1311,135 +1337,165 @@ class VariableImportanceVisitor : public VisitorBase
         }
     }
 
+    /* Label predicted by 'tree' for 'row' when the value in 'column' is
+     * replaced by 'value'. Only valid for trees without contextual features.
+     */
+    template<class Tree, class Features>
+    static Int32 predictLabelWithValue(Tree const & tree, Features const & features,
+                                       int row, int column, double value)
+    {
+        Int32 index = 2;
+        while(!tree.isLeafNode(tree.topology_[index]))
+        {
+            Node<i_ThresholdNode> node(tree.topology_, tree.parameters_, index);
+            double v = node.column() == column
+                          ? value
+                          : static_cast<double>(features(row, node.column()));
+            index = (v < node.threshold()) ? node.child(0) : node.child(1);
+        }
+        Node<e_ConstProbNode> leaf(tree.topology_, tree.parameters_, index);
+        return argMax(leaf.prob_begin(), leaf.prob_begin() + tree.classCount_) - leaf.prob_begin();
+    }
+
     /**compute permutation based var imp. 
-     * (Only an Array of size oob_sample_count x 1 is created.
-     *  - apposed to oob_sample_count x feature_count in the other method.
-     * 
-     * \sa FieldProxy
+     *
+     * The tree is first applied to all OOB samples, recording the columns
+     * each sample's path depends on. Permuting a column can only change the
+     * predictions of samples whose path reads this column, so only those
+     * are predicted again. Columns are processed in parallel, each with its
+     * own random number generator (seeded in column order). For trees
+     * without contextual features, the permuted value is substituted while
+     * descending the tree, so that the feature matrix is not copied at all.
+     * Otherwise, every thread permutes its own copy of the feature matrix.
      */
     template<class RF, class PR, class SM, class ST>
     void after_tree_ip_impl(RF& rf, PR & pr,  SM & sm, ST & /* st */, int index)
     {
         typedef MultiArrayShape<2>::type Shp_t;
+        typedef typename PR::FeatureWithMemory_t FeatureArray;
+
         Int32                   column_count = rf.ext_param_.column_count_;
         Int32                   class_count  = rf.ext_param_.class_count_;  
-        
-        /* This solution saves memory uptake but not multithreading
-         * compatible
-         */
-        // remove the const cast on the features (yep , I know what I am 
-        // doing here.) data is not destroyed.
-        //typename PR::Feature_t & features 
-        //    = const_cast<typename PR::Feature_t &>(pr.features());
-
-        typedef typename PR::FeatureWithMemory_t FeatureArray;
-        typedef typename FeatureArray::value_type FeatureValue;
+        typename RF::DecisionTree_t const & tree = rf.tree(index);
+        typename PR::Feature_t const & features = pr.features();
 
-        FeatureArray features = pr.features();
+        if(variable_importance_.size() == 0)
+            variable_importance_.reshape(Shp_t(column_count, class_count+2));
 
         //find the oob indices of current tree. 
         ArrayVector<Int32>      oob_indices;
-        ArrayVector<Int32>::iterator
-                                iter;
         for(int ii = 0; ii < rf.ext_param_.row_count_; ++ii)
             if(!sm.is_used()[ii])
                 oob_indices.push_back(ii);
+        int n = oob_indices.size();
+        if(n == 0)
+            return;
 
-        //create space to back up a column      
-        ArrayVector<FeatureValue>     backup_column;
-
-        // Random foo
-#ifdef CLASSIFIER_TEST
-        RandomMT19937           random(1);
-#else 
-        RandomMT19937           random(RandomSeed);
-#endif
-        UniformIntRandomFunctor<RandomMT19937>  
-                                randint(random);
-
-
-        //make some space for the results
-        MultiArray<2, double>
-                    oob_right(Shp_t(1, class_count + 1)); 
-        MultiArray<2, double>
-                    perm_oob_right (Shp_t(1, class_count + 1)); 
-            
-        
-        // get the oob success rate with the original samples
-        for(iter = oob_indices.begin(); 
-            iter != oob_indices.end(); 
-            ++iter)
+        // predict the original samples, and find the samples affected
+        // by each column
+        ArrayVector<Int32>  correct(n);
+        ArrayVector<Int32>  last_seen(column_count, -1);
+        std::vector<std::vector<Int32> > affected(column_count);
+        bool contextual = false;
+        float scale = 1 / static_cast<float>(tree.options_.test_scale_);
+        for(int jj = 0; jj < n; ++jj)
         {
-//            if(rf.tree(index)
-//                    .predictLabel(rowVector(features, *iter))
-//                    ==  pr.response()(*iter, 0))
-            if(rf.tree(index)
-                    .predictLabel(features, *iter)
-                ==  pr.response()(*iter, 0))
-
+            int row = oob_indices[jj];
+            Int32 node_index = 2;
+            while(!tree.isLeafNode(tree.topology_[node_index]))
             {
-                //per class
-                ++oob_right[pr.response()(*iter,0)];
-                //total
-                ++oob_right[class_count];
+                Node<i_ThresholdNode> node(tree.topology_, tree.parameters_, node_index);
+                // ScaleInvDiffFeatures read the scale from column 0
+                int columns[2] = { node.column(), node.feature_type() == 3 ? 0 : -1 };
+                for(int kk = 0; kk < 2; ++kk)
+                {
+                    if(columns[kk] >= 0 && last_seen[columns[kk]] != jj)
+                    {
+                        last_seen[columns[kk]] = jj;
+                        affected[columns[kk]].push_back(jj);
+                    }
+                }
+                contextual = contextual || node.feature_type() != 0;
+                node_index = node.next(features, row, tree.options_.image_shape_, scale);
             }
+            Node<e_ConstProbNode> leaf(tree.topology_, tree.parameters_, node_index);
+            Int32 label = argMax(leaf.prob_begin(), leaf.prob_begin() + class_count) - leaf.prob_begin();
+            correct[jj] = (label == pr.response()(row, 0));
         }
-        //get the oob rate after permuting the ii'th dimension.
-        for(int ii = 0; ii < column_count; ++ii)
-        {
-            perm_oob_right.init(0.0); 
-            //make backup of original column
-            backup_column.clear();
-            for(iter = oob_indices.begin(); 
-                iter != oob_indices.end(); 
-                ++iter)
+
+        // each column gets a random seed, independent of the thread count
+        UInt32 tree_seed = random_();
+
+        int n_threads = std::max(1, parallel_options_.getActualNumThreads());
+        std::vector<FeatureArray> feature_copies(contextual ? n_threads : 0);
+        MultiArray<2, double> perm_oob_delta(Shp_t(column_count, class_count + 1));
+
+        parallel_foreach(0, column_count,
+            [&](int thread_id, int ii)
             {
-                backup_column.push_back(features(*iter,ii));
-            }
-            
-            //get the oob rate after permuting the ii'th dimension.
-            for(int rr = 0; rr < repetition_count_; ++rr)
-            {               
-                //permute dimension. 
-                int n = oob_indices.size();
-                for(int jj = 1; jj < n; ++jj)
-                    std::swap(features(oob_indices[jj], ii), 
-                              features(oob_indices[randint(jj+1)], ii));
-
-                //get the oob success rate after permuting
-                for(iter = oob_indices.begin(); 
-                    iter != oob_indices.end(); 
-                    ++iter)
+                std::vector<Int32> const & samples = affected[ii];
+                if(samples.empty())
+                    return;
+
+                FeatureArray * copy = 0;
+                if(contextual)
+                {
+                    copy = &feature_copies[thread_id];
+                    if(copy->size() == 0)
+                        *copy = features;
+                }
+
+                RandomMT19937 random(tree_seed + ii);
+                UniformIntRandomFunctor<RandomMT19937> randint(random);
+                ArrayVector<Int32> permutation(n);
+                for(int jj = 0; jj < n; ++jj)
+                    permutation[jj] = jj;
+
+                for(int rr = 0; rr < repetition_count_; ++rr)
                 {
-                    if(rf.tree(index)
-                            .predictLabel(features, *iter)
-                        ==  pr.response()(*iter, 0))
+                    //permute dimension. 
+                    for(int jj = 1; jj < n; ++jj)
+                        std::swap(permutation[jj], permutation[randint(jj+1)]);
 
-//                    if(rf.tree(index)
-//                            .predictLabel(rowVector(features, *iter))
-//                        ==  pr.response()(*iter, 0))
+                    if(contextual)
                     {
-                        //per class
-                        ++perm_oob_right[pr.response()(*iter, 0)];
-                        //total
-                        ++perm_oob_right[class_count];
+                        for(int jj = 0; jj < n; ++jj)
+                            (*copy)(oob_indices[jj], ii) = features(oob_indices[permutation[jj]], ii);
+                    }
+
+                    // only the affected samples can change their prediction
+                    for(unsigned int kk = 0; kk < samples.size(); ++kk)
+                    {
+                        int jj = samples[kk],
+                            row = oob_indices[jj];
+                        Int32 label = contextual
+                            ? tree.predictLabel(*copy, row)
+                            : predictLabelWithValue(tree, features, row, ii,
+                                       static_cast<double>(features(oob_indices[permutation[jj]], ii)));
+                        int delta = (label == pr.response()(row, 0)) - correct[jj];
+                        if(delta != 0)
+                        {
+                            //per class
+                            perm_oob_delta(ii, pr.response()(row, 0)) += delta;
+                            //total
+                            perm_oob_delta(ii, class_count) += delta;
+                        }
                     }
                 }
-            }
-            
-            
-            //normalise and add to the variable_importance array.
-            perm_oob_right  /=  repetition_count_;
-            perm_oob_right -=oob_right;
-            perm_oob_right *= -1;
-            perm_oob_right      /=  oob_indices.size();
-            variable_importance_
-                .subarray(Shp_t(ii,0), 
-                          Shp_t(ii+1,class_count+1)) += perm_oob_right;
-            //copy back permuted dimension
-            for(int jj = 0; jj < int(oob_indices.size()); ++jj)
-                features(oob_indices[jj], ii) = backup_column[jj];
-        }
+
+                //copy back permuted dimension
+                if(contextual)
+                {
+                    for(int jj = 0; jj < n; ++jj)
+                        (*copy)(oob_indices[jj], ii) = features(oob_indices[jj], ii);
+                }
+            },
+            parallel_options_);
+
+        //normalise and add to the variable_importance array.
+        perm_oob_delta /= -(double)repetition_count_ * n;
+        variable_importance_.subarray(Shp_t(0, 0), Shp_t(column_count, class_count+1))
+            += perm_oob_delta;
     }
 
     /** calculate permutation based impurity after every tree has been 
@@ -1460,6 +1516,10 @@ class VariableImportanceVisitor : public VisitorBase
     {
         variable_importance_ /= rf.trees_.size();
     }
+
+    private:
+    
+    RandomMT19937               random_;
 };
 
 /** Verbose output
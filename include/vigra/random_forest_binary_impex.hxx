@@ -0,0 +1,382 @@
+/************************************************************************/
+/*                                                                      */
+/*                 Copyright 2015 by Ullrich Koethe                     */
+/*                                                                      */
+/*    This file is part of the VIGRA computer vision library.           */
+/*    The VIGRA Website is                                              */
+/*        http://hci.iwr.uni-heidelberg.de/vigra/                       */
+/*    Please direct questions, bug reports, and contributions to        */
+/*        ullrich.koethe@iwr.uni-heidelberg.de    or                    */
+/*        vigra@informatik.uni-hamburg.de                               */
+/*                                                                      */
+/*    Permission is hereby granted, free of charge, to any person       */
+/*    obtaining a copy of this software and associated documentation    */
+/*    files (the "Software"), to deal in the Software without           */
+/*    restriction, including without limitation the rights to use,      */
+/*    copy, modify, merge, publish, distribute, sublicense, and/or      */
+/*    sell copies of the Software, and to permit persons to whom the    */
+/*    Software is furnished to do so, subject to the following          */
+/*    conditions:                                                       */
+/*                                                                      */
+/*    The above copyright notice and this permission notice shall be    */
+/*    included in all copies or substantial portions of the             */
+/*    Software.                                                         */
+/*                                                                      */
+/*    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND    */
+/*    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES   */
+/*    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND          */
+/*    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT       */
+/*    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,      */
+/*    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING      */
+/*    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR     */
+/*    OTHER DEALINGS IN THE SOFTWARE.                                   */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef VIGRA_RANDOM_FOREST_BINARY_IMPEX_HXX
+#define VIGRA_RANDOM_FOREST_BINARY_IMPEX_HXX
+
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include "config.hxx"
+#include "sized_int.hxx"
+#include "random_forest.hxx"
+
+#ifdef _WIN32
+# include "windows.h"
+#else
+# include <fcntl.h>
+# include <unistd.h>
+# include <sys/stat.h>
+# include <sys/mman.h>
+#endif
+
+namespace vigra {
+
+static const char   rf_binary_magic[8] = { 'V', 'I', 'G', 'R', 'A', 'F', 'R', 'F' };
+static const UInt32 rf_binary_version  = 1;
+
+namespace detail {
+
+/* Fixed-size file header of the binary forest format. It is followed by
+ * the arrays of the flattened forest in the order given by
+ * RFBinaryLayout, each starting at a multiple of 8 bytes.
+ */
+struct RFBinaryHeader
+{
+    char   magic[8];
+    UInt32 version;
+    UInt32 byte_order;      // 0x01020304 as written by the exporting machine
+    UInt32 index_size;      // sizeof(Int32)
+    UInt32 threshold_size;  // sizeof(float) or sizeof(double)
+    Int32  column_count;
+    Int32  class_count;
+    Int32  tree_count;
+    Int32  node_count;
+    Int32  leaf_count;
+    UInt32 reserved[7];
+};
+
+/* Byte offsets of the arrays in a binary forest file.
+ */
+struct RFBinaryLayout
+{
+    enum { Classes, Roots, Column, LeftChild, RightChild, Threshold, LeafVotes, End };
+
+    std::size_t offset[End+1];
+
+    explicit RFBinaryLayout(RFBinaryHeader const & h)
+    {
+        std::size_t size[End] = {
+            h.class_count * sizeof(double),
+            h.tree_count  * sizeof(Int32),
+            h.node_count  * sizeof(Int32),
+            h.node_count  * sizeof(Int32),
+            h.node_count  * sizeof(Int32),
+            h.node_count  * (std::size_t)h.threshold_size,
+            (std::size_t)h.leaf_count * h.class_count * sizeof(double) };
+        offset[0] = sizeof(RFBinaryHeader);
+        for(int k = 0; k < End; ++k)
+            offset[k+1] = (offset[k] + size[k] + 7) & ~std::size_t(7);
+    }
+
+    std::size_t fileSize() const
+    {
+        return offset[End];
+    }
+};
+
+/* Read-only memory mapping of an entire file.
+ */
+class RFMappedFile
+{
+  public:
+    explicit RFMappedFile(std::string const & filename)
+    : data_(0),
+      size_(0)
+    {
+    #ifdef _WIN32
+        mapping_ = NULL;
+        file_ = ::CreateFile(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+                             OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if(file_ == INVALID_HANDLE_VALUE)
+            throw std::runtime_error("RFMappedFile(): unable to open file '" + filename + "'.");
+        LARGE_INTEGER size;
+        if(::GetFileSizeEx(file_, &size) && size.QuadPart > 0)
+        {
+            size_ = (std::size_t)size.QuadPart;
+            mapping_ = ::CreateFileMapping(file_, NULL, PAGE_READONLY, 0, 0, NULL);
+            if(mapping_)
+                data_ = ::MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0);
+        }
+        if(data_ == 0)
+        {
+            if(mapping_)
+                ::CloseHandle(mapping_);
+            ::CloseHandle(file_);
+            throw std::runtime_error("RFMappedFile(): unable to map file '" + filename + "'.");
+        }
+    #else
+        int file = ::open(filename.c_str(), O_RDONLY);
+        if(file == -1)
+            throw std::runtime_error("RFMappedFile(): unable to open file '" + filename + "'.");
+        struct stat info;
+        if(::fstat(file, &info) == -1 || info.st_size == 0)
+        {
+            ::close(file);
+            throw std::runtime_error("RFMappedFile(): unable to map file '" + filename + "'.");
+        }
+        size_ = (std::size_t)info.st_size;
+        data_ = ::mmap(0, size_, PROT_READ, MAP_SHARED, file, 0);
+        // the mapping remains valid after closing the file
+        ::close(file);
+        if(data_ == MAP_FAILED)
+        {
+            data_ = 0;
+            throw std::runtime_error("RFMappedFile(): mmap() failed.");
+        }
+    #endif
+    }
+
+    ~RFMappedFile()
+    {
+    #ifdef _WIN32
+        if(data_)
+            ::UnmapViewOfFile(data_);
+        ::CloseHandle(mapping_);
+        ::CloseHandle(file_);
+    #else
+        if(data_)
+            ::munmap(data_, size_);
+    #endif
+    }
+
+    char const * data() const
+    {
+        return static_cast<char const *>(data_);
+    }
+
+    std::size_t size() const
+    {
+        return size_;
+    }
+
+  private:
+    RFMappedFile(RFMappedFile const &);
+    RFMappedFile & operator=(RFMappedFile const &);
+
+  #ifdef _WIN32
+    HANDLE file_, mapping_;
+  #endif
+    void * data_;
+    std::size_t size_;
+};
+
+/* Access to the internals of FlatRandomForest for rf_export_binary()
+ * and rf_import_binary().
+ */
+struct FlatForestIO
+{
+    static void writeArray(std::ofstream & out, std::size_t & pos, std::size_t offset,
+                           void const * data, std::size_t size)
+    {
+        static const char padding[8] = { 0 };
+        out.write(padding, offset - pos);
+        out.write(static_cast<char const *>(data), size);
+        pos = offset + size;
+    }
+
+    template <class LabelType, class ThresholdType>
+    static void write(FlatRandomForest<LabelType, ThresholdType> const & rf,
+                      std::string const & filename)
+    {
+        RFBinaryHeader header;
+        std::memset(&header, 0, sizeof(header));
+        std::memcpy(header.magic, rf_binary_magic, sizeof(header.magic));
+        header.version        = rf_binary_version;
+        header.byte_order     = 0x01020304;
+        header.index_size     = sizeof(Int32);
+        header.threshold_size = sizeof(ThresholdType);
+        header.column_count   = rf.column_count_;
+        header.class_count    = rf.class_count_;
+        header.tree_count     = rf.tree_count_;
+        header.node_count     = rf.node_count_;
+        header.leaf_count     = rf.leaf_count_;
+        RFBinaryLayout layout(header);
+
+        ArrayVector<double> classes(rf.classes_.begin(), rf.classes_.end());
+
+        std::ofstream out(filename.c_str(), std::ios::binary | std::ios::trunc);
+        if(!out)
+            throw std::runtime_error("rf_export_binary(): unable to open file '" + filename + "'.");
+        std::size_t pos = 0, n = rf.node_count_;
+        writeArray(out, pos, 0, &header, sizeof(header));
+        writeArray(out, pos, layout.offset[RFBinaryLayout::Classes],
+                   classes.data(), classes.size()*sizeof(double));
+        writeArray(out, pos, layout.offset[RFBinaryLayout::Roots],
+                   rf.roots_, rf.tree_count_*sizeof(Int32));
+        writeArray(out, pos, layout.offset[RFBinaryLayout::Column],
+                   rf.column_, n*sizeof(Int32));
+        writeArray(out, pos, layout.offset[RFBinaryLayout::LeftChild],
+                   rf.child_[0], n*sizeof(Int32));
+        writeArray(out, pos, layout.offset[RFBinaryLayout::RightChild],
+                   rf.child_[1], n*sizeof(Int32));
+        writeArray(out, pos, layout.offset[RFBinaryLayout::Threshold],
+                   rf.threshold_, n*sizeof(ThresholdType));
+        writeArray(out, pos, layout.offset[RFBinaryLayout::LeafVotes],
+                   rf.leaf_votes_, (std::size_t)rf.leaf_count_*rf.class_count_*sizeof(double));
+        writeArray(out, pos, layout.fileSize(), 0, 0);
+        if(!out)
+            throw std::runtime_error("rf_export_binary(): write error in file '" + filename + "'.");
+    }
+
+    template <class LabelType, class ThresholdType>
+    static bool read(FlatRandomForest<LabelType, ThresholdType> & rf,
+                     std::string const & filename)
+    {
+        VIGRA_SHARED_PTR<RFMappedFile> file(new RFMappedFile(filename));
+        if(file->size() < sizeof(RFBinaryHeader))
+            return false;
+        RFBinaryHeader header;
+        std::memcpy(&header, file->data(), sizeof(header));
+        if(std::memcmp(header.magic, rf_binary_magic, sizeof(header.magic)) != 0)
+            return false;
+
+        vigra_precondition(header.version <= rf_binary_version,
+            "rf_import_binary(): unexpected file format version.");
+        vigra_precondition(header.byte_order == 0x01020304 && header.index_size == sizeof(Int32),
+            "rf_import_binary(): file was written on a machine with different byte order.");
+        vigra_precondition(header.threshold_size == sizeof(ThresholdType),
+            "rf_import_binary(): threshold type of the file and the forest differ.");
+        vigra_precondition(header.tree_count > 0 && header.class_count > 0 &&
+                           header.node_count >= 0 && header.leaf_count > 0,
+            "rf_import_binary(): corrupt file header.");
+        RFBinaryLayout layout(header);
+        vigra_precondition(file->size() >= layout.fileSize(),
+            "rf_import_binary(): file is truncated.");
+
+        char const * data = file->data();
+        double const * classes =
+            reinterpret_cast<double const *>(data + layout.offset[RFBinaryLayout::Classes]);
+
+        rf.column_count_ = header.column_count;
+        rf.class_count_  = header.class_count;
+        rf.tree_count_   = header.tree_count;
+        rf.node_count_   = header.node_count;
+        rf.leaf_count_   = header.leaf_count;
+        rf.classes_.resize(header.class_count);
+        for(int k = 0; k < header.class_count; ++k)
+            rf.classes_[k] = detail::RequiresExplicitCast<LabelType>::cast(classes[k]);
+        rf.roots_      = reinterpret_cast<Int32 const *>(data + layout.offset[RFBinaryLayout::Roots]);
+        rf.column_     = reinterpret_cast<Int32 const *>(data + layout.offset[RFBinaryLayout::Column]);
+        rf.child_[0]   = reinterpret_cast<Int32 const *>(data + layout.offset[RFBinaryLayout::LeftChild]);
+        rf.child_[1]   = reinterpret_cast<Int32 const *>(data + layout.offset[RFBinaryLayout::RightChild]);
+        rf.threshold_  = reinterpret_cast<ThresholdType const *>(data + layout.offset[RFBinaryLayout::Threshold]);
+        rf.leaf_votes_ = reinterpret_cast<double const *>(data + layout.offset[RFBinaryLayout::LeafVotes]);
+        rf.storage_    = file;
+        return true;
+    }
+};
+
+} // namespace detail
+
+/** \brief Save a random forest in the compact binary format for prediction.
+
+    The forest is stored in flattened form (see \ref FlatRandomForest) as a
+    single file consisting of a versioned header and one contiguous array
+    per node attribute (split column, threshold, left and right child) and
+    for the leaf votes. Such a file can be memory-mapped by
+    \ref rf_import_binary() and used for prediction right away.
+
+    The format is meant for deploying trained forests. It doesn't contain
+    the information required to continue learning (use
+    rf_export_HDF5() for that), and it is only portable between machines
+    of the same byte order. Forests with contextual features can't be
+    flattened and therefore can't be saved in this format.
+
+    <b>\#include</b> \<vigra/random_forest_binary_impex.hxx\><br>
+    Namespace: vigra
+
+    \code
+    RandomForest<int> rf;
+    rf.learn(features, labels);
+    rf_export_binary(rf, "forest.vrf");
+
+    // later, possibly in another process
+    FlatRandomForest<int> flat;
+    rf_import_binary(flat, "forest.vrf");
+    flat.predictProbabilities(test_features, probabilities);
+    \endcode
+
+    \param rf       Forest to be saved. A <tt>RandomForest</tt> is flattened first.
+    \param filename Name of the file to be (over-)written.
+*/
+template <class LabelType, class ThresholdType>
+void rf_export_binary(FlatRandomForest<LabelType, ThresholdType> const & rf,
+                      std::string const & filename)
+{
+    vigra_precondition(rf.tree_count() > 0,
+        "rf_export_binary(): forest is empty.");
+    detail::FlatForestIO::write(rf, filename);
+}
+
+template <class LabelType, class PreprocessorTag>
+void rf_export_binary(RandomForest<LabelType, PreprocessorTag> const & rf,
+                      std::string const & filename)
+{
+    rf_export_binary(FlatRandomForest<LabelType>(rf), filename);
+}
+
+/** \brief Load a forest saved by rf_export_binary() for prediction.
+
+    The file is memory-mapped read-only, and <tt>rf</tt> refers to the mapped
+    arrays directly, i.e. nothing is parsed or copied except for the class
+    labels. The mapping is released when the last copy of <tt>rf</tt> is
+    destroyed. Pages of the file are loaded lazily by the operating system
+    and are shared between all processes that map the same file.
+
+    The <tt>ThresholdType</tt> of <tt>rf</tt> must agree with the forest
+    that was exported.
+
+    <b>\#include</b> \<vigra/random_forest_binary_impex.hxx\><br>
+    Namespace: vigra
+
+    \param rf       Forest object that receives the mapped forest.
+    \param filename Name of the file to be loaded.
+
+    \return <tt>false</tt> if the file is not a binary forest file.
+    Throws <tt>std::runtime_error</tt> if the file can't be mapped, and
+    <tt>PreconditionViolation</tt> if the file is incompatible or truncated.
+*/
+template <class LabelType, class ThresholdType>
+bool rf_import_binary(FlatRandomForest<LabelType, ThresholdType> & rf,
+                      std::string const & filename)
+{
+    return detail::FlatForestIO::read(rf, filename);
+}
+
+} // namespace vigra
+
+#endif // VIGRA_RANDOM_FOREST_BINARY_IMPEX_HXX
@@ -0,0 +1,215 @@
+/************************************************************************/
+/*                                                                      */
+/*                 Copyright 2015 by Ullrich Koethe                     */
+/*                                                                      */
+/*    This file is part of the VIGRA computer vision library.           */
+/*    The VIGRA Website is                                              */
+/*        http://hci.iwr.uni-heidelberg.de/vigra/                       */
+/*    Please direct questions, bug reports, and contributions to        */
+/*        ullrich.koethe@iwr.uni-heidelberg.de    or                    */
+/*        vigra@informatik.uni-hamburg.de                               */
+/*                                                                      */
+/*    Permission is hereby granted, free of charge, to any person       */
+/*    obtaining a copy of this software and associated documentation    */
+/*    files (the "Software"), to deal in the Software without           */
+/*    restriction, including without limitation the rights to use,      */
+/*    copy, modify, merge, publish, distribute, sublicense, and/or      */
+/*    sell copies of the Software, and to permit persons to whom the    */
+/*    Software is furnished to do so, subject to the following          */
+/*    conditions:                                                       */
+/*                                                                      */
+/*    The above copyright notice and this permission notice shall be    */
+/*    included in all copies or substantial portions of the             */
+/*    Software.                                                         */
+/*                                                                      */
+/*    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND    */
+/*    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES   */
+/*    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND          */
+/*    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT       */
+/*    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,      */
+/*    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING      */
+/*    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR     */
+/*    OTHER DEALINGS IN THE SOFTWARE.                                   */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef VIGRA_RANDOM_FOREST_CHUNKED_HXX
+#define VIGRA_RANDOM_FOREST_CHUNKED_HXX
+
+#include "multi_array.hxx"
+#include "multi_array_chunked.hxx"
+#include "multi_blockwise.hxx"
+#include "random_forest.hxx"
+
+namespace vigra {
+
+namespace detail {
+
+    /* Interpret an N-D array with channels last as a 2D sample matrix
+       (one row per pixel, one column per channel). This is possible
+       without copying when the spatial axes are unstrided relative to
+       each other, e.g. for a complete chunk or a contiguous array.
+    */
+template <unsigned int N, class T, class S>
+bool
+chunkedSampleMatrix(MultiArrayView<N, T, S> const & block,
+                    MultiArrayView<2, T, StridedArrayTag> & samples)
+{
+    MultiArrayIndex count = 1;
+    for(unsigned int k = 0; k < N-1; ++k)
+    {
+        if(block.shape(k) > 1 && block.stride(k) != count*block.stride(0))
+            return false;
+        count *= block.shape(k);
+    }
+    samples = MultiArrayView<2, T, StridedArrayTag>(Shape2(count, block.shape(N-1)),
+                                                    Shape2(block.stride(0), block.stride(N-1)),
+                                                    block.data());
+    return true;
+}
+
+} // namespace detail
+
+/** \brief Predict class probabilities for all pixels of a chunked feature volume.
+
+    <b> Declarations:</b>
+
+    \code
+    namespace vigra {
+        template <unsigned int N, class T1, class T2, class LabelType, class ThresholdType>
+        void
+        predictProbabilitiesChunked(FlatRandomForest<LabelType, ThresholdType> const & rf,
+                                    ChunkedArray<N, T1> const & features,
+                                    ChunkedArray<N, T2> & probabilities,
+                                    BlockwiseOptions const & options = BlockwiseOptions());
+
+        template <unsigned int N, class T1, class T2, class LabelType, class PreprocessorTag>
+        void
+        predictProbabilitiesChunked(RandomForest<LabelType, PreprocessorTag> const & rf,
+                                    ChunkedArray<N, T1> const & features,
+                                    ChunkedArray<N, T2> & probabilities,
+                                    BlockwiseOptions const & options = BlockwiseOptions());
+    }
+    \endcode
+
+    The last axis of <tt>features</tt> holds the feature channels, and the
+    last axis of <tt>probabilities</tt> receives one probability per class,
+    i.e. <tt>features.shape(N-1) >= rf.column_count()</tt> and
+    <tt>probabilities.shape(N-1) == rf.class_count()</tt>. The other axes
+    of both arrays must agree.
+
+    The volume is processed in blocks that span all channels. By default,
+    the spatial block shape equals the chunk shape of <tt>features</tt>,
+    otherwise it is taken from <tt>options.blockShape()</tt> (which then
+    refers to the first N-1 axes). Blocks are predicted concurrently on
+    <tt>options.getActualNumThreads()</tt> threads. When a block coincides
+    with a chunk that holds all channels, the forest reads the chunk memory
+    directly, and the probabilities are likewise written directly into the
+    destination chunk when possible. Otherwise, the block is copied into a
+    temporary array. Thus, only the chunks in the cache and one block per
+    thread are held in memory at any time.
+
+    The <tt>RandomForest</tt> version converts the forest into a
+    \ref FlatRandomForest first, so that the forest must not use
+    contextual features (see FlatRandomForest::supports()).
+
+    <b>Usage:</b>
+
+    <b>\#include</b> \<vigra/random_forest_chunked.hxx\><br>
+    Namespace: vigra
+
+    \code
+    RandomForest<int> rf(...);
+    rf.learn(train_features, train_labels);
+
+    // 3D volume with 20 feature channels, chunked along the spatial axes only
+    ChunkedArrayCompressed<4, float> features(Shape4(1000, 1000, 500, 20), Shape4(64, 64, 64, 20));
+    ...
+    ChunkedArrayCompressed<4, float> probabilities(Shape4(1000, 1000, 500, rf.class_count()),
+                                                   Shape4(64, 64, 64, rf.class_count()));
+    predictProbabilitiesChunked(rf, features, probabilities, BlockwiseOptions().numThreads(8));
+    \endcode
+*/
+doxygen_overloaded_function(template <...> void predictProbabilitiesChunked)
+
+template <unsigned int N, class T1, class T2, class LabelType, class ThresholdType>
+void
+predictProbabilitiesChunked(FlatRandomForest<LabelType, ThresholdType> const & rf,
+                            ChunkedArray<N, T1> const & features,
+                            ChunkedArray<N, T2> & probabilities,
+                            BlockwiseOptions const & options = BlockwiseOptions())
+{
+    typedef typename MultiArrayShape<N>::type   Shape;
+    typedef typename MultiArrayShape<N-1>::type SpatialShape;
+
+    vigra_precondition(features.shape().dropIndex(N-1) == probabilities.shape().dropIndex(N-1),
+        "predictProbabilitiesChunked(): shape mismatch between features and probabilities.");
+    vigra_precondition(features.shape(N-1) >= rf.column_count(),
+        "predictProbabilitiesChunked(): too few feature channels.");
+    vigra_precondition(probabilities.shape(N-1) == rf.class_count(),
+        "predictProbabilitiesChunked(): probabilities must have as many channels as there are classes.");
+    vigra_precondition(!probabilities.isReadOnly(),
+        "predictProbabilitiesChunked(): probabilities array is read-only.");
+
+    SpatialShape spatialBlockShape = options.getBlockShape().size() == 0
+                                          ? features.chunkShape().dropIndex(N-1)
+                                          : options.template getBlockShapeN<N-1>();
+    Shape blockShape;
+    std::copy(spatialBlockShape.begin(), spatialBlockShape.end(), blockShape.begin());
+    blockShape[N-1] = features.shape(N-1);
+
+    MultiArrayIndex classes = probabilities.shape(N-1);
+
+    detail::blockwiseForeach(features.shape(), blockShape,
+        [&](int, Shape const & start, Shape const & stop)
+        {
+            Shape probStart(start), probStop(stop);
+            probStop[N-1] = classes;
+
+            // read the features in place if the block is a complete chunk
+            MultiArray<N, T1> featureBuffer;
+            MultiArrayView<2, T1, StridedArrayTag> samples;
+            typename ChunkedArray<N, T1>::chunk_const_iterator
+                chunk = features.chunk_begin(start, stop);
+            if(chunk->shape() != stop - start ||
+               !detail::chunkedSampleMatrix(*chunk, samples))
+            {
+                featureBuffer.reshape(stop - start);
+                features.checkoutSubarray(start, featureBuffer);
+                detail::chunkedSampleMatrix(featureBuffer, samples);
+            }
+
+            // likewise for the probabilities
+            MultiArray<N, T2> probBuffer;
+            MultiArrayView<2, T2, StridedArrayTag> prob;
+            typename ChunkedArray<N, T2>::chunk_iterator
+                probChunk = probabilities.chunk_begin(probStart, probStop);
+            bool inPlace = probChunk->shape() == probStop - probStart &&
+                           detail::chunkedSampleMatrix(*probChunk, prob);
+            if(!inPlace)
+            {
+                probBuffer.reshape(probStop - probStart);
+                detail::chunkedSampleMatrix(probBuffer, prob);
+            }
+
+            rf.predictProbabilities(samples, prob, ParallelOptions().numThreads(ParallelOptions::NoThreads));
+
+            if(!inPlace)
+                probabilities.commitSubarray(probStart, probBuffer);
+        },
+        options);
+}
+
+template <unsigned int N, class T1, class T2, class LabelType, class PreprocessorTag>
+inline void
+predictProbabilitiesChunked(RandomForest<LabelType, PreprocessorTag> const & rf,
+                            ChunkedArray<N, T1> const & features,
+                            ChunkedArray<N, T2> & probabilities,
+                            BlockwiseOptions const & options = BlockwiseOptions())
+{
+    predictProbabilitiesChunked(FlatRandomForest<LabelType>(rf), features, probabilities, options);
+}
+
+} // namespace vigra
+
+#endif // VIGRA_RANDOM_FOREST_CHUNKED_HXX
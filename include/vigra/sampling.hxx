@@ -39,6 +39,7 @@
 #include "array_vector.hxx"
 #include "random.hxx"
 #include <map>
+#include <algorithm>
 #include <memory>
 #include <cmath>
 
@@ -71,6 +72,7 @@ class SamplerOptions
     unsigned int sample_size;
     bool   sample_with_replacement;
     bool   stratified_sampling;
+    ArrayVector<double> stratum_weights;
     
     SamplerOptions()
     : sample_proportion(1.0),
@@ -146,6 +148,143 @@ class SamplerOptions
         stratified_sampling = in;
         return *this;
     }
+
+        /**\brief Draw each sample from a randomly chosen stratum, where 
+         *  stratum k is chosen with probability proportional to <tt>weights[k]</tt>.
+         *  Strata are numbered in ascending order of their labels, and elements
+         *  are drawn uniformly within a stratum. Weighted sampling requires 
+         *  sampling with replacement and replaces equal-count stratification.
+         *  The stratum is drawn in constant time by means of an AliasTable.
+         *
+         * <br> Default: empty (i.e. unweighted sampling)
+         */
+    SamplerOptions& stratumWeights(ArrayVector<double> const & weights)
+    {
+        stratum_weights = weights;
+        return *this;
+    }
+};
+
+/************************************************************/
+/*                                                          */
+/*                       AliasTable                         */
+/*                                                          */
+/************************************************************/
+
+/** \brief Draw indices from a discrete distribution in constant time.
+
+    The table is created from a sequence of non-negative weights (not necessarily 
+    normalized) in linear time (Vose's variant of Walker's alias method). Afterwards,
+    each call to <tt>operator()</tt> returns index <tt>k</tt> with probability 
+    <tt>weights[k] / sum(weights)</tt>, using one integer and one floating point 
+    random number.
+    
+    <b>Usage:</b>
+    
+    <b>\#include</b> \<vigra/sampling.hxx\><br>
+    Namespace: vigra
+    
+    \code
+    double weights[] = { 1.0, 3.0, 0.5 };
+    AliasTable table(weights, weights + 3);
+    
+    RandomMT19937 random;
+    int k = table(random);  // k == 1 with probability 3.0 / 4.5
+    \endcode
+*/
+class AliasTable
+{
+  public:
+        /** Create an empty table.
+         */
+    AliasTable()
+    {}
+
+        /** Create the table for the weights in the range <tt>[begin, end)</tt>.
+         */
+    template <class Iterator>
+    AliasTable(Iterator begin, Iterator end)
+    {
+        init(begin, end);
+    }
+
+        /** (Re-)initialize the table for the weights in the range <tt>[begin, end)</tt>.
+            The table's memory is reused when the number of weights doesn't grow.
+         */
+    template <class Iterator>
+    void init(Iterator begin, Iterator end)
+    {
+        int size = static_cast<int>(end - begin);
+        vigra_precondition(size > 0,
+            "AliasTable::init(): at least one weight required.");
+        probability_.resize(size);
+        alias_.resize(size);
+        small_.resize(size);
+
+        double sum = 0.0;
+        for(int k = 0; k < size; ++k, ++begin)
+        {
+            vigra_precondition(*begin >= 0.0,
+                "AliasTable::init(): weights must not be negative.");
+            probability_[k] = *begin;
+            sum += probability_[k];
+        }
+        vigra_precondition(sum > 0.0,
+            "AliasTable::init(): weights must not be all zero.");
+
+        // 'small_' holds the underfull bins from the front and the 
+        // overfull bins from the back
+        int small_count = 0, large_begin = size;
+        for(int k = 0; k < size; ++k)
+        {
+            probability_[k] *= size / sum;
+            alias_[k] = k;
+            if(probability_[k] < 1.0)
+                small_[small_count++] = k;
+            else
+                small_[--large_begin] = k;
+        }
+        while(small_count > 0 && large_begin < size)
+        {
+            int s = small_[--small_count],
+                l = small_[large_begin];
+            alias_[s] = l;
+            probability_[l] -= 1.0 - probability_[s];
+            if(probability_[l] < 1.0)
+            {
+                // 'l' becomes underfull, move it to the small list
+                ++large_begin;
+                small_[small_count++] = l;
+            }
+        }
+        // the remaining bins are full up to rounding errors
+        for(int k = 0; k < small_count; ++k)
+            probability_[small_[k]] = 1.0;
+        for(int k = large_begin; k < size; ++k)
+            probability_[small_[k]] = 1.0;
+    }
+
+        /** Draw an index in <tt>[0, size())</tt> from the distribution.
+         */
+    template <class Random>
+    int operator()(Random const & random) const
+    {
+        int k = static_cast<int>(random.uniformInt(size()));
+        return random.uniform() < probability_[k]
+                   ? k
+                   : alias_[k];
+    }
+
+        /** The number of indices (i.e. weights) of the distribution.
+         */
+    int size() const
+    {
+        return static_cast<int>(alias_.size());
+    }
+
+  private:
+    ArrayVector<double> probability_;
+    ArrayVector<int>    alias_, small_;
 };
 
 /************************************************************/
@@ -258,6 +397,8 @@ class Sampler
     mutable int             current_oob_count_;
     StrataIndicesType       strata_indices_;
     StrataSizesType         strata_sample_size_;
+    AliasTable              strata_table_;
+    IndexArrayType          strata_offsets_, strata_concatenated_;
     IndexArrayType          current_sample_;
     mutable IndexArrayType  current_oob_sample_;
     IsUsedArrayType         is_used_;
@@ -312,7 +453,7 @@ class Sampler
         vigra_precondition(opt.sample_with_replacement || sample_size_ <= total_count_,
           "Sampler(): Cannot draw without replacement when data size is smaller than sample count.");
           
-        vigra_precondition(!opt.stratified_sampling,
+        vigra_precondition(!opt.stratified_sampling && opt.stratum_weights.size() == 0,
           "Sampler(): Stratified sampling requested, but no strata given.");
           
         // initialize a single stratum containing all data
@@ -352,8 +493,11 @@ class Sampler
         vigra_precondition(opt.sample_with_replacement || sample_size_ <= total_count_,
           "Sampler(): Cannot draw without replacement when data size is smaller than sample count.");
           
+        vigra_precondition(opt.stratum_weights.size() == 0 || opt.sample_with_replacement,
+          "Sampler(): Weighted strata require sampling with replacement.");
+
         // copy the strata indices
-        if(opt.stratified_sampling)
+        if(opt.stratified_sampling || opt.stratum_weights.size() > 0)
         {
             for(int i = 0; strataBegin != strataEnd; ++i, ++strataBegin)
             {
@@ -367,8 +511,27 @@ class Sampler
                 strata_indices_[0][i] = i;
         }
             
-        vigra_precondition(sample_size_ >= static_cast<int>(strata_indices_.size()),
-            "Sampler(): Requested sample count must be at least as large as the number of strata.");
+        if(opt.stratum_weights.size() > 0)
+        {
+            vigra_precondition(opt.stratum_weights.size() == strata_indices_.size(),
+                "Sampler(): Number of stratum weights must equal the number of strata.");
+            strata_table_.init(opt.stratum_weights.begin(), opt.stratum_weights.end());
+            // store the strata contiguously in ascending label order
+            strata_concatenated_.reserve(total_count_);
+            strata_offsets_.push_back(0);
+            for(StrataIndicesType::iterator iter = strata_indices_.begin();
+                iter != strata_indices_.end(); ++iter)
+            {
+                strata_concatenated_.insert(strata_concatenated_.end(),
+                                            iter->second.begin(), iter->second.end());
+                strata_offsets_.push_back(strata_concatenated_.size());
+            }
+        }
+        else
+        {
+            vigra_precondition(sample_size_ >= static_cast<int>(strata_indices_.size()),
+                "Sampler(): Requested sample count must be at least as large as the number of strata.");
+        }
 
         initStrataCount();
         //this is screwing up the random forest tests.
@@ -386,6 +549,24 @@ class Sampler
          */
     void sample();
 
+        /** Restore the state after construction, so that the next call
+            to <tt>sample()</tt> gives the same result as the first call
+            on a new Sampler (provided that the random number generator
+            has been re-seeded accordingly). This allows to reuse a sampler 
+            and its memory for independent samples.
+         */
+    void reset()
+    {
+        // sampling without replacement permutes the strata
+        if(!options_.sample_with_replacement)
+        {
+            for(StrataIndicesType::iterator iter = strata_indices_.begin();
+                iter != strata_indices_.end(); ++iter)
+                std::sort(iter->second.begin(), iter->second.end());
+        }
+        current_oob_count_ = oobInvalid;
+    }
+
         /** The total number of data elements.
          */
     int totalCount() const
@@ -470,7 +651,19 @@ void Sampler<Random>::sample()
     current_oob_count_ = oobInvalid;
     is_used_.init(false);
     
-    if(options_.sample_with_replacement)
+    if(strata_table_.size() > 0)
+    {
+        // choose the stratum of each sample from the weights, and
+        // the sample uniformly within the stratum
+        for(int j = 0; j < sample_size_; ++j)
+        {
+            int k = strata_table_(random_),
+                stratum_size = strata_offsets_[k+1] - strata_offsets_[k];
+            current_sample_[j] = strata_concatenated_[strata_offsets_[k] + random_.uniformInt(stratum_size)];
+            is_used_[current_sample_[j]] = true;
+        }
+    }
+    else if(options_.sample_with_replacement)
     {
         //Go thru all strata
         int j = 0;
@@ -40,6 +40,8 @@
 #include <cmath>
 #include "utilities.hxx"
 #include "numerictraits.hxx"
+#include "metaprogramming.hxx"
+#include "accessor.hxx"
 #include "imageiteratoradapter.hxx"
 #include "bordertreatment.hxx"
 #include "gaussians.hxx"
@@ -751,6 +753,245 @@ void internalConvolveLineAvoid(SrcIterator is, SrcIterator iend, SrcAccessor sa,
     }
 }
 
+/********************************************************/
+/*                                                      */
+/*           vectorizable convolution kernels           */
+/*                                                      */
+/********************************************************/
+
+namespace detail {
+
+    // true if ITERATOR and ACCESSOR access contiguous memory of type VALUETYPE
+template <class ITERATOR, class ACCESSOR>
+struct IsContiguousStandardAccess
+{
+    typedef VigraFalseType type;
+};
+
+template <class T>
+struct IsContiguousStandardAccess<T *, StandardAccessor<T> >
+{
+    typedef VigraTrueType type;
+};
+
+template <class T>
+struct IsContiguousStandardAccess<T *, StandardValueAccessor<T> >
+{
+    typedef VigraTrueType type;
+};
+
+template <class T>
+struct IsContiguousStandardAccess<T *, StandardConstAccessor<T> >
+{
+    typedef VigraTrueType type;
+};
+
+template <class T>
+struct IsContiguousStandardAccess<T *, StandardConstValueAccessor<T> >
+{
+    typedef VigraTrueType type;
+};
+
+template <class T>
+struct IsContiguousStandardAccess<T const *, StandardConstAccessor<T> >
+{
+    typedef VigraTrueType type;
+};
+
+template <class T>
+struct IsContiguousStandardAccess<T const *, StandardConstValueAccessor<T> >
+{
+    typedef VigraTrueType type;
+};
+
+    // true if convolution of T with kernel type KT can run in SIMD registers
+template <class T, class KT>
+struct IsVectorizableConvolution
+{
+    typedef VigraFalseType type;
+};
+
+template <>
+struct IsVectorizableConvolution<float, float>
+{
+    typedef VigraTrueType type;
+};
+
+template <>
+struct IsVectorizableConvolution<float, double>
+{
+    typedef VigraTrueType type;
+};
+
+template <>
+struct IsVectorizableConvolution<double, float>
+{
+    typedef VigraTrueType type;
+};
+
+template <>
+struct IsVectorizableConvolution<double, double>
+{
+    typedef VigraTrueType type;
+};
+
+    // border treatment modes supported by the kernels below
+inline bool
+isVectorizableBorderTreatment(BorderTreatmentMode border)
+{
+    return border == BORDER_TREATMENT_REFLECT || border == BORDER_TREATMENT_REPEAT ||
+           border == BORDER_TREATMENT_WRAP    || border == BORDER_TREATMENT_ZEROPAD;
+}
+
+    // Map index 'i' outside [0, w) into the line as the internalConvolveLine*()
+    // functions do (the kernel must not be longer than the line).
+    // Returns -1 if the point does not contribute (BORDER_TREATMENT_ZEROPAD).
+inline int
+convolveLineBorderIndex(int i, int w, BorderTreatmentMode border)
+{
+    if(i < 0)
+    {
+        switch(border)
+        {
+          case BORDER_TREATMENT_WRAP:    return i + w;
+          case BORDER_TREATMENT_REFLECT: return -i;
+          case BORDER_TREATMENT_REPEAT:  return 0;
+          default:                       return -1;
+        }
+    }
+    if(i >= w)
+    {
+        switch(border)
+        {
+          case BORDER_TREATMENT_WRAP:    return i - w;
+          case BORDER_TREATMENT_REFLECT: return 2*w - 2 - i;
+          case BORDER_TREATMENT_REPEAT:  return w - 1;
+          default:                       return -1;
+        }
+    }
+    return i;
+}
+
+    // Convolve the contiguous line [is, is+w) and write the results for [start, stop)
+    // to 'id'. Points away from the border are computed in blocks, looping over
+    // the kernel outside and over the block inside, so that the compiler can use
+    // SIMD instructions without changing the order of the additions. Thus, the result
+    // is bit-identical to the generic internalConvolveLine*() functions.
+template <class T, class KernelValue,
+          class DestIterator, class DestAccessor>
+void
+internalConvolveLineContiguous(T const * is, int w,
+                               DestIterator id, DestAccessor da,
+                               KernelValue const * kernel, int kleft, int kright,
+                               BorderTreatmentMode border, int start, int stop)
+{
+    typedef typename PromoteTraits<T, KernelValue>::Promote SumType;
+    typedef typename DestAccessor::value_type DestType;
+    enum { BlockSize = 64 };
+
+    SumType sum[BlockSize];
+    int ileft  = std::max(start, kright),
+        iright = std::min(stop, w + kleft);
+
+    for(int x = start; x < stop; )
+    {
+        if(x < ileft || x >= iright)
+        {
+            SumType s = NumericTraits<SumType>::zero();
+            for(int k = kright; k >= kleft; --k)
+            {
+                int i = convolveLineBorderIndex(x - k, w, border);
+                if(i >= 0)
+                    s += kernel[k] * is[i];
+            }
+            da.set(RequiresExplicitCast<DestType>::cast(s), id);
+            ++id;
+            ++x;
+        }
+        else
+        {
+            int n = std::min<int>(BlockSize, iright - x);
+            for(int j = 0; j < n; ++j)
+                sum[j] = NumericTraits<SumType>::zero();
+            for(int k = kright; k >= kleft; --k)
+            {
+                KernelValue kv = kernel[k];
+                T const * s = is + (x - k);
+                for(int j = 0; j < n; ++j)
+                    sum[j] += kv * s[j];
+            }
+            for(int j = 0; j < n; ++j, ++id)
+                da.set(RequiresExplicitCast<DestType>::cast(sum[j]), id);
+            x += n;
+        }
+    }
+}
+
+    // Convolve 'n' interleaved lines of length 'w', i.e. element 'i' of line 'b'
+    // is src[i*n + b]. The results for [start, stop) are written to 'dest' in the same
+    // layout. The innermost loop runs across the lines, so that SIMD instructions can
+    // be used even if the lines were originally strided. Each result is bit-identical
+    // to the one of the generic internalConvolveLine*() functions.
+template <class T, class KernelValue>
+void
+internalConvolveLinesInterleaved(T const * src, int w, int n,
+                                 typename PromoteTraits<T, KernelValue>::Promote * dest,
+                                 KernelValue const * kernel, int kleft, int kright,
+                                 BorderTreatmentMode border, int start, int stop)
+{
+    typedef typename PromoteTraits<T, KernelValue>::Promote SumType;
+
+    for(int x = start; x < stop; ++x, dest += n)
+    {
+        for(int b = 0; b < n; ++b)
+            dest[b] = NumericTraits<SumType>::zero();
+        for(int k = kright; k >= kleft; --k)
+        {
+            int i = convolveLineBorderIndex(x - k, w, border);
+            if(i < 0)
+                continue;
+            KernelValue kv = kernel[k];
+            T const * s = src + i*n;
+            for(int b = 0; b < n; ++b)
+                dest[b] += kv * s[b];
+        }
+    }
+}
+
+template <class SrcIterator, class SrcAccessor,
+          class DestIterator, class DestAccessor,
+          class KernelIterator, class KernelAccessor>
+inline bool
+convolveLineVectorized(SrcIterator, SrcIterator, SrcAccessor,
+                       DestIterator, DestAccessor,
+                       KernelIterator, KernelAccessor,
+                       int, int, BorderTreatmentMode,
+                       int, int, VigraFalseType)
+{
+    return false;
+}
+
+template <class SrcIterator, class SrcAccessor,
+          class DestIterator, class DestAccessor,
+          class KernelIterator, class KernelAccessor>
+inline bool
+convolveLineVectorized(SrcIterator is, SrcIterator iend, SrcAccessor,
+                       DestIterator id, DestAccessor da,
+                       KernelIterator ik, KernelAccessor,
+                       int kleft, int kright, BorderTreatmentMode border,
+                       int start, int stop, VigraTrueType)
+{
+    if(!isVectorizableBorderTreatment(border))
+        return false;
+    int w = iend - is;
+    if(stop == 0)
+        stop = w;
+    internalConvolveLineContiguous(is, w, id, da, ik, kleft, kright, border, start, stop);
+    return true;
+}
+
+} // namespace detail
+
 /********************************************************/
 /*                                                      */
 /*         Separable convolution functions              */
@@ -917,10 +1158,17 @@ void convolveLine(SrcIterator is, SrcIterator iend, SrcAccessor sa,
         vigra_precondition(0 <= start && start < stop && stop <= w,
                         "convolveLine(): invalid subrange (start, stop).\n");
 
-    typedef typename PromoteTraits<
-            typename SrcAccessor::value_type,
-            typename KernelAccessor::value_type>::Promote SumType;
-    ArrayVector<SumType> a(iend - is); 
+    // use the SIMD-friendly implementation when the data are contiguous
+    typedef typename And<
+            typename And<typename detail::IsContiguousStandardAccess<SrcIterator, SrcAccessor>::type,
+                         typename detail::IsContiguousStandardAccess<KernelIterator, KernelAccessor>::type>::type,
+            typename detail::IsVectorizableConvolution<typename SrcAccessor::value_type,
+                                                       typename KernelAccessor::value_type>::type
+            >::type Vectorizable;
+    if(detail::convolveLineVectorized(is, iend, sa, id, da, ik, ka, kleft, kright, border,
+                                      start, stop, Vectorizable()))
+        return;
+
     switch(border)
     {
       case BORDER_TREATMENT_WRAP:
@@ -1409,7 +1657,9 @@ class Kernel1D
         {}
 
         ~InitProxy() 
-#ifndef _MSC_VER
+#if __cplusplus >= 201103L
+             noexcept(false)
+#elif !defined(_MSC_VER)
              throw(PreconditionViolation)
 #endif
         {
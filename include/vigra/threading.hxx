@@ -71,6 +71,7 @@
 #else
 #  include <thread>
 #  include <mutex>
+#  include <condition_variable>
 // #  include <shared_mutex>  // C++14
 #  include <atomic>
 #  define VIGRA_HAS_ATOMIC 1
@@ -120,6 +121,12 @@ using VIGRA_THREADING_NAMESPACE::lock;
 using VIGRA_THREADING_NAMESPACE::once_flag;
 using VIGRA_THREADING_NAMESPACE::call_once;
 
+// contents of <condition_variable>
+
+using VIGRA_THREADING_NAMESPACE::condition_variable;
+using VIGRA_THREADING_NAMESPACE::condition_variable_any;
+using VIGRA_THREADING_NAMESPACE::cv_status;
+
 // contents of <shared_mutex>
 
 // using VIGRA_THREADING_NAMESPACE::shared_mutex;   // C++14
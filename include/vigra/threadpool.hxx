@@ -0,0 +1,671 @@
+/************************************************************************/
+/*                                                                      */
+/*                 Copyright 2014-2015 by Ullrich Koethe                */
+/*                                                                      */
+/*    This file is part of the VIGRA computer vision library.           */
+/*    The VIGRA Website is                                              */
+/*        http://hci.iwr.uni-heidelberg.de/vigra/                       */
+/*    Please direct questions, bug reports, and contributions to        */
+/*        ullrich.koethe@iwr.uni-heidelberg.de    or                    */
+/*        vigra@informatik.uni-hamburg.de                               */
+/*                                                                      */
+/*    Permission is hereby granted, free of charge, to any person       */
+/*    obtaining a copy of this software and associated documentation    */
+/*    files (the "Software"), to deal in the Software without           */
+/*    restriction, including without limitation the rights to use,      */
+/*    copy, modify, merge, publish, distribute, sublicense, and/or      */
+/*    sell copies of the Software, and to permit persons to whom the    */
+/*    Software is furnished to do so, subject to the following          */
+/*    conditions:                                                       */
+/*                                                                      */
+/*    The above copyright notice and this permission notice shall be    */
+/*    included in all copies or substantial portions of the             */
+/*    Software.                                                         */
+/*                                                                      */
+/*    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND    */
+/*    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES   */
+/*    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND          */
+/*    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT       */
+/*    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,      */
+/*    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING      */
+/*    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR     */
+/*    OTHER DEALINGS IN THE SOFTWARE.                                   */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef VIGRA_THREADPOOL_HXX
+#define VIGRA_THREADPOOL_HXX
+
+#include <vector>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <type_traits>
+#include <exception>
+#include <iterator>
+#include <algorithm>
+#include <cstdlib>
+#include "config.hxx"
+#include "error.hxx"
+#include "multi_shape.hxx"
+#include "threading.hxx"
+
+/* The thread pool and parallel_foreach() require C++11 (lambdas, std::function,
+   std::exception_ptr). When VIGRA_SINGLE_THREADED is defined, ThreadPool
+   is unavailable, and parallel_foreach() executes all items sequentially
+   in the calling thread.
+*/
+
+namespace vigra {
+
+/** \addtogroup ParallelProcessing Functions and classes for parallel processing.
+*/
+//@{
+
+    /** \brief Option object for parallel algorithms.
+
+        Determines the number of threads to be used by parallel_foreach() and the
+        parallel variants of VIGRA's algorithms. The default is <tt>ParallelOptions::Auto</tt>,
+        which refers to the global default (see \ref setDefaultNumThreads()).
+
+        <b>Usage:</b>
+
+        \code
+        // use 4 threads for this call only
+        parallel_foreach(0, n, f, ParallelOptions().numThreads(4));
+
+        // use 8 threads in all subsequent calls that don't specify the number explicitly
+        ParallelOptions::setDefaultNumThreads(8);
+        \endcode
+
+        <b>\#include</b> \<vigra/threadpool.hxx\><br>
+        Namespace: vigra
+    */
+class ParallelOptions
+{
+  public:
+
+        /** Special values for the number of threads.
+        */
+    enum {
+        Auto       = -1, ///< Use the global default (initially: the number of cores).
+        Nice       = -2, ///< Use half as many threads as <tt>Auto</tt>.
+        NoThreads  =  0  ///< Execute sequentially in the calling thread.
+    };
+
+    ParallelOptions()
+    : numThreads_(Auto)
+    {}
+
+        /** Set the number of threads (or one of the special values
+            <tt>Auto</tt>, <tt>Nice</tt>, <tt>NoThreads</tt>).
+        */
+    ParallelOptions & numThreads(int n)
+    {
+        numThreads_ = n;
+        return *this;
+    }
+
+    ParallelOptions numThreads(int n) const
+    {
+        return ParallelOptions(*this).numThreads(n);
+    }
+
+        /** Get the number of threads as specified by the user.
+        */
+    int getNumThreads() const
+    {
+        return numThreads_;
+    }
+
+        /** Get the number of threads that will actually be used
+            (i.e. special values are resolved, and the result is at least 1).
+        */
+    int getActualNumThreads() const
+    {
+        return actualNumThreads(numThreads_);
+    }
+
+        /** Resolve a thread count specification into the actual number of threads.
+        */
+    static int actualNumThreads(int n)
+    {
+#ifdef VIGRA_SINGLE_THREADED
+        return 1;
+#else
+        if(n == Auto)
+            return defaultNumThreads();
+        if(n == Nice)
+            return std::max(1, defaultNumThreads() / 2);
+        return std::max(1, n);
+#endif
+    }
+
+        /** Get the global default number of threads (what <tt>Auto</tt> means).
+
+            Initially, this is the value of the environment variable
+            <tt>VIGRA_NUM_THREADS</tt> if it is set, or the number of
+            hardware threads otherwise.
+        */
+    static int defaultNumThreads()
+    {
+#ifdef VIGRA_SINGLE_THREADED
+        return 1;
+#else
+        return (int)defaultNumThreadsStorage().load();
+#endif
+    }
+
+        /** Set the global default number of threads.
+
+            Values <tt>< 1</tt> (including the special values) reset the default
+            to the number of hardware threads. Note that the size of 
+            \ref defaultThreadPool() is fixed when the pool is first used.
+        */
+    static void setDefaultNumThreads(int n)
+    {
+#ifndef VIGRA_SINGLE_THREADED
+        defaultNumThreadsStorage().store(n < 1 ? hardwareNumThreads() : n);
+#endif
+    }
+
+        /** Number of threads supported by the hardware (at least 1).
+        */
+    static int hardwareNumThreads()
+    {
+#ifdef VIGRA_SINGLE_THREADED
+        return 1;
+#else
+        return std::max(1, (int)threading::thread::hardware_concurrency());
+#endif
+    }
+
+  private:
+#ifndef VIGRA_SINGLE_THREADED
+    static threading::atomic_long & defaultNumThreadsStorage()
+    {
+        static threading::atomic_long storage(initialNumThreads());
+        return storage;
+    }
+
+    static long initialNumThreads()
+    {
+        char const * env = std::getenv("VIGRA_NUM_THREADS");
+        int n = env ? std::atoi(env) : 0;
+        return n > 0 ? n : hardwareNumThreads();
+    }
+#endif
+
+    int numThreads_;
+};
+
+#ifndef VIGRA_SINGLE_THREADED
+
+    /** \brief Work-stealing thread pool.
+
+        The pool starts a fixed number of worker threads upon construction, which
+        live until the pool is destroyed. Each worker owns a task queue. A worker
+        executes the tasks of its own queue in LIFO order (which keeps recently
+        touched data in cache) and steals the oldest tasks from other workers' queues
+        when its own queue runs empty. Tasks submitted from outside the pool are
+        distributed round-robin, tasks submitted by a worker (nested parallelism)
+        go to that worker's queue.
+
+        A task is any function object callable with the signature <tt>void(int)</tt>,
+        where the argument is the index of the executing worker in
+        <tt>[0, numThreads())</tt>. If a task throws, the first exception is
+        stored and re-thrown by \ref waitFinished().
+
+        Most users will not need to create a pool explicitly: parallel_foreach()
+        and VIGRA's parallel algorithms share a persistent global pool
+        (see \ref defaultThreadPool()), so that threads are not created anew
+        for every call.
+
+        <b>Usage:</b>
+
+        \code
+        ThreadPool pool(ParallelOptions().numThreads(4));
+        std::vector<int> res(100);
+        for(int k=0; k<100; ++k)
+            pool.enqueue([&res, k](int threadId) { res[k] = k*k; });
+        pool.waitFinished();
+        \endcode
+
+        <b>\#include</b> \<vigra/threadpool.hxx\><br>
+        Namespace: vigra
+    */
+class ThreadPool
+{
+  public:
+    typedef std::function<void(int)> Task;
+
+        /** Create a pool with <tt>options.getActualNumThreads()</tt> workers.
+        */
+    explicit ThreadPool(ParallelOptions const & options = ParallelOptions())
+    {
+        init(options.getActualNumThreads());
+    }
+
+        /** Create a pool with <tt>ParallelOptions::actualNumThreads(n)</tt> workers.
+        */
+    explicit ThreadPool(int n)
+    {
+        init(ParallelOptions::actualNumThreads(n));
+    }
+
+        /** Finish all pending tasks and join the workers.
+        */
+    ~ThreadPool()
+    {
+        {
+            threading::lock_guard<threading::mutex> lock(sleep_mutex_);
+            stop_ = true;
+        }
+        worker_condition_.notify_all();
+        for(unsigned int k=0; k<workers_.size(); ++k)
+            workers_[k].join();
+        for(unsigned int k=0; k<queues_.size(); ++k)
+            delete queues_[k];
+    }
+
+        /** Submit a task. It will be called as <tt>f(threadId)</tt>.
+        */
+    template <class F>
+    void enqueue(F && f)
+    {
+        int worker = currentWorker();
+        if(worker < 0)
+            worker = (int)((unsigned long)next_queue_.fetch_add(1) % queues_.size());
+        outstanding_.fetch_add(1);
+        {
+            threading::lock_guard<threading::mutex> lock(queues_[worker]->mutex);
+            queues_[worker]->tasks.push_back(Task(std::forward<F>(f)));
+        }
+        {
+            threading::lock_guard<threading::mutex> lock(sleep_mutex_);
+            ++pending_;
+        }
+        worker_condition_.notify_one();
+    }
+
+        /** Block until all tasks submitted so far have been executed.
+
+            If one of the tasks threw an exception, it is re-thrown here.
+            Must not be called from within a task of the same pool.
+        */
+    void waitFinished()
+    {
+        vigra_precondition(currentWorker() < 0,
+            "ThreadPool::waitFinished(): must not be called from a worker of the same pool.");
+        threading::unique_lock<threading::mutex> lock(finish_mutex_);
+        while(outstanding_.load() != 0)
+            finish_condition_.wait(lock);
+        if(exception_)
+        {
+            std::exception_ptr e = exception_;
+            exception_ = std::exception_ptr();
+            std::rethrow_exception(e);
+        }
+    }
+
+        /** Number of worker threads.
+        */
+    int numThreads() const
+    {
+        return (int)workers_.size();
+    }
+
+        /** Index of the calling thread within this pool, or -1 if the
+            calling thread is not one of the pool's workers.
+        */
+    int currentWorker() const
+    {
+        threading::thread::id id = threading::this_thread::get_id();
+        for(unsigned int k=0; k<worker_ids_.size(); ++k)
+            if(worker_ids_[k] == id)
+                return (int)k;
+        return -1;
+    }
+
+  private:
+    struct Queue
+    {
+        std::deque<Task> tasks;
+        threading::mutex mutex;
+    };
+
+    ThreadPool(ThreadPool const &);
+    ThreadPool & operator=(ThreadPool const &);
+
+    void init(int n)
+    {
+        stop_ = false;
+        pending_ = 0;
+        outstanding_.store(0);
+        next_queue_.store(0);
+        ready_.store(0);
+        for(int k=0; k<n; ++k)
+            queues_.push_back(new Queue);
+        worker_ids_.resize(n);
+        for(int k=0; k<n; ++k)
+            workers_.push_back(threading::thread(&ThreadPool::workerLoop, this, k));
+        // make sure that all workers registered their ids before tasks are submitted
+        while(ready_.load() < n)
+            threading::this_thread::yield();
+    }
+
+    bool popTask(int worker, Task & task)
+    {
+        // own queue first (LIFO), ...
+        {
+            threading::lock_guard<threading::mutex> lock(queues_[worker]->mutex);
+            if(!queues_[worker]->tasks.empty())
+            {
+                task.swap(queues_[worker]->tasks.back());
+                queues_[worker]->tasks.pop_back();
+                return true;
+            }
+        }
+        // ... then steal the oldest task of another worker (FIFO)
+        int n = (int)queues_.size();
+        for(int k=1; k<n; ++k)
+        {
+            Queue & victim = *queues_[(worker + k) % n];
+            threading::lock_guard<threading::mutex> lock(victim.mutex);
+            if(!victim.tasks.empty())
+            {
+                task.swap(victim.tasks.front());
+                victim.tasks.pop_front();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void workerLoop(int worker)
+    {
+        worker_ids_[worker] = threading::this_thread::get_id();
+        ready_.fetch_add(1);
+        Task task;
+        while(true)
+        {
+            {
+                threading::unique_lock<threading::mutex> lock(sleep_mutex_);
+                while(!stop_ && pending_ == 0)
+                    worker_condition_.wait(lock);
+                if(pending_ == 0) // stop_ is set and nothing left to do
+                    return;
+            }
+            if(!popTask(worker, task))
+            {
+                // another worker was faster
+                threading::this_thread::yield();
+                continue;
+            }
+            {
+                threading::lock_guard<threading::mutex> lock(sleep_mutex_);
+                --pending_;
+            }
+            try
+            {
+                task(worker);
+            }
+            catch(...)
+            {
+                threading::lock_guard<threading::mutex> lock(finish_mutex_);
+                if(!exception_)
+                    exception_ = std::current_exception();
+            }
+            task = Task();
+            if(outstanding_.fetch_sub(1) == 1)
+            {
+                threading::lock_guard<threading::mutex> lock(finish_mutex_);
+                finish_condition_.notify_all();
+            }
+        }
+    }
+
+    std::vector<threading::thread> workers_;
+    std::vector<threading::thread::id> worker_ids_;
+    std::vector<Queue *> queues_;
+
+    threading::mutex sleep_mutex_;
+    threading::condition_variable worker_condition_;
+    long pending_;
+    bool stop_;
+
+    threading::mutex finish_mutex_;
+    threading::condition_variable finish_condition_;
+    std::exception_ptr exception_;
+
+    threading::atomic_long outstanding_, next_queue_, ready_;
+};
+
+    /** \brief The global thread pool used by parallel_foreach() and VIGRA's parallel algorithms.
+
+        The pool is created upon first use and has
+        <tt>max(ParallelOptions::defaultNumThreads(), ParallelOptions::hardwareNumThreads()) - 1</tt> 
+        workers (at least one), because the thread calling parallel_foreach() participates 
+        in the work. Thus, a default set by <tt>VIGRA_NUM_THREADS</tt> or 
+        \ref ParallelOptions::setDefaultNumThreads() before the first parallel call 
+        is honoured. Afterwards, the pool size is fixed: thread counts exceeding the
+        pool size (plus the calling thread) still work, but the excess helper tasks
+        have to wait for a free worker and effectively don't add parallelism.
+
+        <b>\#include</b> \<vigra/threadpool.hxx\><br>
+        Namespace: vigra
+    */
+inline ThreadPool & defaultThreadPool()
+{
+    static ThreadPool pool(std::max(1, std::max(ParallelOptions::defaultNumThreads(),
+                                                ParallelOptions::hardwareNumThreads()) - 1));
+    return pool;
+}
+
+#endif // VIGRA_SINGLE_THREADED
+
+namespace detail {
+
+template <class ITER, bool IS_INTEGRAL = std::is_integral<ITER>::value>
+struct ParallelForeachItem
+{
+    typedef typename std::iterator_traits<ITER>::reference type;
+
+    static type get(ITER const & begin, MultiArrayIndex k)
+    {
+        return begin[k];
+    }
+
+    static MultiArrayIndex count(ITER const & begin, ITER const & end)
+    {
+        return (MultiArrayIndex)std::distance(begin, end);
+    }
+};
+
+template <class ITER>
+struct ParallelForeachItem<ITER, true>
+{
+    typedef ITER type;
+
+    static type get(ITER const & begin, MultiArrayIndex k)
+    {
+        return (ITER)(begin + k);
+    }
+
+    static MultiArrayIndex count(ITER const & begin, ITER const & end)
+    {
+        return end > begin ? (MultiArrayIndex)(end - begin) : 0;
+    }
+};
+
+#ifndef VIGRA_SINGLE_THREADED
+
+struct ParallelForeachState
+{
+    typedef std::function<void(int, MultiArrayIndex)> Function;
+
+    ParallelForeachState(Function const & f, MultiArrayIndex count, MultiArrayIndex chunk_size)
+    : function(f)
+    , count(count)
+    , chunk_size(chunk_size)
+    , next(0)
+    , done(0)
+    {}
+
+        // process chunks until none are left
+    void work(int thread_id)
+    {
+        while(true)
+        {
+            MultiArrayIndex begin = (MultiArrayIndex)next.fetch_add(chunk_size);
+            if(begin >= count)
+                return;
+            MultiArrayIndex end = std::min(count, begin + chunk_size);
+            try
+            {
+                if(!failed())
+                    for(MultiArrayIndex k=begin; k<end; ++k)
+                        function(thread_id, k);
+            }
+            catch(...)
+            {
+                threading::lock_guard<threading::mutex> lock(mutex);
+                if(!exception)
+                    exception = std::current_exception();
+            }
+            if(done.fetch_add(end - begin) + (end - begin) == count)
+            {
+                threading::lock_guard<threading::mutex> lock(mutex);
+                finished.notify_all();
+            }
+        }
+    }
+
+    bool failed()
+    {
+        threading::lock_guard<threading::mutex> lock(mutex);
+        return bool(exception);
+    }
+
+    void wait()
+    {
+        threading::unique_lock<threading::mutex> lock(mutex);
+        while(done.load() < count)
+            finished.wait(lock);
+        if(exception)
+            std::rethrow_exception(exception);
+    }
+
+    Function function;
+    MultiArrayIndex count, chunk_size;
+    threading::atomic_long next, done;
+    threading::mutex mutex;
+    threading::condition_variable finished;
+    std::exception_ptr exception;
+};
+
+#endif // VIGRA_SINGLE_THREADED
+
+} // namespace detail
+
+    /** \brief Apply a functor to all items of a range in parallel.
+
+        <b> Declarations:</b>
+
+        \code
+        namespace vigra {
+            // 'begin' and 'end' are either random access iterators or integers
+            template <class ITER, class F>
+            void
+            parallel_foreach(ITER begin, ITER end, F && f,
+                             ParallelOptions const & options = ParallelOptions());
+        }
+        \endcode
+
+        The functor is called as <tt>f(threadId, item)</tt>, where <tt>item</tt> is
+        <tt>*(begin+k)</tt> when <tt>ITER</tt> is an iterator, and <tt>begin+k</tt> when
+        <tt>ITER</tt> is an integer type. <tt>threadId</tt> is in
+        <tt>[0, options.getActualNumThreads())</tt> and is unique among the threads
+        that execute the present call concurrently, so that it can be used to
+        index per-thread scratch memory.
+
+        The items are split into chunks which are dynamically assigned to the
+        workers of \ref defaultThreadPool(). The calling thread participates in the
+        work (with <tt>threadId == 0</tt>), so that calls can safely be nested. The function
+        returns when all items have been processed. If <tt>f</tt> throws, the remaining
+        chunks are skipped, and the first exception is re-thrown in the calling thread.
+
+        <b> Usage:</b>
+
+        <b>\#include</b> \<vigra/threadpool.hxx\><br>
+        Namespace: vigra
+
+        \code
+        std::vector<double> data(1000000);
+        parallel_foreach(0, (int)data.size(),
+            [&data](int threadId, int k)
+            {
+                data[k] = std::sqrt((double)k);
+            });
+
+        // per-thread partial sums
+        ParallelOptions options = ParallelOptions().numThreads(4);
+        std::vector<double> sums(options.getActualNumThreads(), 0.0);
+        parallel_foreach(data.begin(), data.end(),
+            [&sums](int threadId, double v)
+            {
+                sums[threadId] += v;
+            },
+            options);
+        \endcode
+    */
+doxygen_overloaded_function(template <...> void parallel_foreach)
+
+template <class ITER, class F>
+void
+parallel_foreach(ITER begin, ITER end, F && f,
+                 ParallelOptions const & options = ParallelOptions())
+{
+    typedef detail::ParallelForeachItem<ITER> Item;
+
+    MultiArrayIndex count = Item::count(begin, end);
+    if(count == 0)
+        return;
+
+    int nThreads = (int)std::min<MultiArrayIndex>(options.getActualNumThreads(), count);
+
+#ifndef VIGRA_SINGLE_THREADED
+    if(nThreads > 1)
+    {
+        // about four chunks per thread for load balancing
+        MultiArrayIndex chunk_size = std::max<MultiArrayIndex>(1, count / (4*nThreads));
+        VIGRA_SHARED_PTR<detail::ParallelForeachState> state(
+            new detail::ParallelForeachState(
+                [&f, &begin](int thread_id, MultiArrayIndex k)
+                {
+                    f(thread_id, Item::get(begin, k));
+                },
+                count, chunk_size));
+
+        ThreadPool & pool = defaultThreadPool();
+        for(int k=1; k<nThreads; ++k)
+        {
+            // helpers that start after all chunks are taken return immediately,
+            // so we never wait for a task that didn't get a thread
+            pool.enqueue([state, k](int) { state->work(k); });
+        }
+        state->work(0);
+        state->wait();
+        return;
+    }
+#endif
+
+    for(MultiArrayIndex k=0; k<count; ++k)
+        f(0, Item::get(begin, k));
+}
+
+//@}
+
+} // namespace vigra
+
+#endif // VIGRA_THREADPOOL_HXX
@@ -39,6 +39,13 @@
 
 /*std*/
 #include <map>
+#include <vector>
+#include <algorithm>
+
+#if defined(__GXX_EXPERIMENTAL_CXX0X__) || __cplusplus >= 201103L || (defined(_MSC_VER) && _MSC_VER >= 1700)
+#  define VIGRA_HAS_CONCURRENT_UNION_FIND 1
+#  include <atomic>
+#endif
 
 /*vigra*/
 #include "config.hxx"
@@ -321,6 +328,172 @@ class UnionFindArray
     }
 };
 
+#ifdef VIGRA_HAS_CONCURRENT_UNION_FIND
+
+/** \brief Union-find array that can be modified concurrently by several threads.
+
+    <b>\#include</b> \<vigra/union_find.hxx\><br>
+    Namespace: vigra
+
+    In contrast to \ref UnionFindArray, the number of indices is fixed at construction
+    and cannot grow afterwards. All indices <tt>0...size()-1</tt> start as singleton
+    sets. findIndex(), makeUnion() and sameSet() may be called from any number of
+    threads simultaneously without external locking:
+
+    <ul>
+    <li> <b>findIndex()</b> is wait-free. It performs path compression by path halving, where
+         each parent pointer is redirected to its grandparent with an atomic compare-and-swap.
+         A failed swap is harmless, because another thread has already shortened the path.
+    <li> <b>makeUnion()</b> is lock-free. It always links the root with the larger index
+         to the root with the smaller one (union by index). A compare-and-swap ensures
+         that the linked root is still a root, otherwise the union is retried.
+    </ul>
+
+    Since links always point to smaller indices, the representative of every set is its
+    smallest index, regardless of the order in which the unions were executed. This makes
+    the final result deterministic. makeContiguous() and findLabel() are only valid
+    after all concurrent unions have finished (i.e. they must not be called while other
+    threads still modify the array).
+
+    This requires a C++11 compiler (<tt>VIGRA_HAS_CONCURRENT_UNION_FIND</tt> is defined).
+
+    <b> Usage:</b>
+
+    \code
+    ConcurrentUnionFindArray<UInt32> regions(count);
+
+    parallel_foreach(0, edges.size(),
+        [&](int, std::size_t k)
+        {
+            regions.makeUnion(edges[k].first, edges[k].second);
+        });
+
+    UInt32 max_label = regions.makeContiguous();
+    for(UInt32 k=0; k<count; ++k)
+        final_labels[k] = regions.findLabel(k);
+    \endcode
+*/
+template <class T>
+class ConcurrentUnionFindArray
+{
+    typedef std::atomic<T>          AtomicType;
+
+    std::vector<AtomicType> parents_;
+    ArrayVector<T> labels_;
+
+  public:
+        /** Create <tt>size</tt> singleton sets with indices <tt>0...size-1</tt>.
+        */
+    explicit ConcurrentUnionFindArray(T size = 0)
+    : parents_(size)
+    {
+        for(T k=0; k < size; ++k)
+            parents_[k].store(k, std::memory_order_relaxed);
+    }
+
+        /** Number of indices.
+        */
+    T size() const
+    {
+        return (T)parents_.size();
+    }
+
+        /** Find the representative (smallest index) of the set containing <tt>index</tt>.
+            Thread-safe and wait-free.
+        */
+    T findIndex(T index)
+    {
+        T parent = parents_[index].load(std::memory_order_acquire);
+        while(parent != index)
+        {
+            T grandparent = parents_[parent].load(std::memory_order_acquire);
+            if(grandparent != parent)
+            {
+                // path halving: failure just means someone else was faster
+                parents_[index].compare_exchange_weak(parent, grandparent,
+                                                      std::memory_order_release,
+                                                      std::memory_order_relaxed);
+            }
+            index = grandparent;
+            parent = parents_[index].load(std::memory_order_acquire);
+        }
+        return index;
+    }
+
+        /** Merge the sets containing <tt>i1</tt> and <tt>i2</tt> and return the
+            representative of the merged set. Thread-safe and lock-free.
+        */
+    T makeUnion(T i1, T i2)
+    {
+        while(true)
+        {
+            i1 = findIndex(i1);
+            i2 = findIndex(i2);
+            if(i1 == i2)
+                return i1;
+            if(i1 < i2)
+                std::swap(i1, i2);
+            // i1 is the larger root: try to link it to i2
+            T expected = i1;
+            if(parents_[i1].compare_exchange_strong(expected, i2,
+                                                    std::memory_order_acq_rel,
+                                                    std::memory_order_acquire))
+                return i2;
+            // i1 was linked by another thread in the meantime => retry
+        }
+    }
+
+        /** Check if <tt>i1</tt> and <tt>i2</tt> belong to the same set.
+            Thread-safe and lock-free. When other threads execute unions concurrently,
+            a negative answer may already be outdated upon return.
+        */
+    bool sameSet(T i1, T i2)
+    {
+        while(true)
+        {
+            i1 = findIndex(i1);
+            i2 = findIndex(i2);
+            if(i1 == i2)
+                return true;
+            // i1 is still a root => the sets were disjoint at this moment
+            if(parents_[i1].load(std::memory_order_acquire) == i1)
+                return false;
+        }
+    }
+
+        /** Assign contiguous labels <tt>0...count-1</tt> to the sets, ordered by their
+            representatives, and return the largest label (i.e. count-1), analogous to
+            UnionFindArray::makeContiguous(). Not thread-safe. Subsequent unions
+            are not reflected in the labels until makeContiguous() is called again.
+        */
+    T makeContiguous()
+    {
+        T count = 0;
+        labels_.resize(parents_.size());
+        for(std::size_t k=0; k<parents_.size(); ++k)
+        {
+            T root = findIndex((T)k);
+            labels_[k] = (root == (T)k)
+                             ? count++
+                             : labels_[root];  // root < k has already been labeled
+        }
+        return count - 1;
+    }
+
+        /** Return the contiguous label of the set containing <tt>index</tt>.
+            If makeContiguous() has not been called, this is the representative index.
+            Not safe when unions are executed concurrently.
+        */
+    T findLabel(T index)
+    {
+        return labels_.size() == parents_.size()
+                   ? labels_[index]
+                   : findIndex(index);
+    }
+};
+
+#endif // VIGRA_HAS_CONCURRENT_UNION_FIND
+
 } // namespace vigra
 
 #endif // VIGRA_UNION_FIND_HXX
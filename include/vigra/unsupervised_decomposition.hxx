@@ -42,6 +42,9 @@
 #include "matrix.hxx"
 #include "singular_value_decomposition.hxx"
 #include "random.hxx"
+#include "threadpool.hxx"
+#include <algorithm>
+#include <vector>
 
 namespace vigra
 {
@@ -154,8 +157,12 @@ principleComponents(MultiArrayView<2, T, C1> const & features,
 /*****************************************************************/
 
    /** \brief Option object for the \ref pLSA algorithm. 
+   
+        Since PLSAOptions is derived from \ref ParallelOptions, you can also
+        specify the number of threads (default: as many as the hardware supports).
    */
 class PLSAOptions
+: public ParallelOptions
 {
   public:
         /** Initialize all options with default values.
@@ -203,11 +210,333 @@ class PLSAOptions
         return *this;
     }
 
+        /** Number of threads to be used. The result does not depend on 
+            the number of threads.
+
+            default: <tt>ParallelOptions::Auto</tt>
+        */
+    PLSAOptions & numThreads(const int n)
+    {
+        ParallelOptions::numThreads(n);
+        return *this;
+    }
+
     double min_rel_gain;
     int max_iterations;
     bool normalized_component_weights;
 };
 
+   /** \brief Sparse non-negative matrix in compressed column format, used as input of \ref pLSA.
+   
+        The non-zero entries of column <tt>k</tt> are <tt>values(i)</tt>, located in rows 
+        <tt>rowIndices(i)</tt>, for <tt>columnStarts(k) &lt;= i &lt; columnStarts(k+1)</tt>. 
+        The row indices in a column must be distinct, but need not be sorted. The class 
+        only refers to the given arrays, it doesn't copy them.
+        
+        <b>\#include</b> \<vigra/unsupervised_decomposition.hxx\><br>
+        Namespace: vigra
+   */
+template <class T>
+class SparseColumnMatrixView
+{
+  public:
+    typedef MultiArrayView<1, MultiArrayIndex> IndexArray;
+    typedef MultiArrayView<1, T>               ValueArray;
+
+        /** Create a matrix with <tt>rows</tt> rows and <tt>columnStarts.size() - 1</tt> 
+            columns.
+        */
+    SparseColumnMatrixView(MultiArrayIndex rows,
+                           IndexArray const & columnStarts,
+                           IndexArray const & rowIndices,
+                           ValueArray const & values)
+    : rows_(rows),
+      column_starts_(columnStarts),
+      row_indices_(rowIndices),
+      values_(values)
+    {
+        vigra_precondition(columnStarts.size() >= 1 && rowIndices.size() == values.size() &&
+                           columnStarts(columnStarts.size()-1) == values.size(),
+            "SparseColumnMatrixView(): inconsistent array sizes.");
+    }
+
+    MultiArrayIndex rowCount() const
+    {
+        return rows_;
+    }
+
+    MultiArrayIndex columnCount() const
+    {
+        return column_starts_.size() - 1;
+    }
+
+    IndexArray const & columnStarts() const
+    {
+        return column_starts_;
+    }
+
+    IndexArray const & rowIndices() const
+    {
+        return row_indices_;
+    }
+
+    ValueArray const & values() const
+    {
+        return values_;
+    }
+
+  private:
+    MultiArrayIndex rows_;
+    IndexArray column_starts_, row_indices_;
+    ValueArray values_;
+};
+
+namespace detail {
+
+    /* One EM step of pLSA for a sample (i.e. column) of a dense feature matrix:
+       'fzv' is the current model of the column, 'factor' the ratio between data
+       and model. zv's column is updated (and normalized) in place, the contribution 
+       of the column to the fz update is added to 'fzUpdate', and the squared error 
+       of the current model (scaled by 'columnSum') is added to 'error'.
+    */
+template <class U, class C1, class C2, class C3>
+void
+pLSAColumnStep(MultiArrayView<2, U, C1> const & features, MultiArrayIndex v,
+               MultiArrayView<2, U, C2> const & fz, MultiArrayView<2, U, C3> zv,
+               double columnSum, U eps, Matrix<double> const & /* gram */,
+               ArrayVector<U> & fzv, ArrayVector<U> & factor, ArrayVector<double> & weights,
+               Matrix<double> & fzUpdate, double & error)
+{
+    MultiArrayIndex numFeatures = rowCount(fz), 
+                    numComponents = columnCount(fz);
+    for(MultiArrayIndex f = 0; f < numFeatures; ++f)
+        fzv[f] = U();
+    for(MultiArrayIndex k = 0; k < numComponents; ++k)
+    {
+        U z = zv(k, v);
+        for(MultiArrayIndex f = 0; f < numFeatures; ++f)
+            fzv[f] += fz(f, k) * z;
+    }
+    for(MultiArrayIndex f = 0; f < numFeatures; ++f)
+    {
+        U x = features(f, v);
+        error += sq(x - columnSum * fzv[f]);
+        factor[f] = x / (fzv[f] + eps);
+    }
+
+    double sum = 0.0;
+    for(MultiArrayIndex k = 0; k < numComponents; ++k)
+    {
+        U g = U();
+        for(MultiArrayIndex f = 0; f < numFeatures; ++f)
+            g += fz(f, k) * factor[f];
+        weights[k] = zv(k, v) * g;
+        sum += weights[k];
+        for(MultiArrayIndex f = 0; f < numFeatures; ++f)
+            fzUpdate(f, k) += factor[f] * weights[k];
+    }
+    for(MultiArrayIndex k = 0; k < numComponents; ++k)
+        zv(k, v) = sum != 0.0
+                       ? static_cast<U>(weights[k] / sum)
+                       : static_cast<U>(weights[k]);
+}
+
+    /* Same for sparse input: only the non-zero entries contribute to the
+       update, and the model's contribution to the error is obtained from
+       the Gram matrix fz^T * fz.
+    */
+template <class U, class C2, class C3>
+void
+pLSAColumnStep(SparseColumnMatrixView<U> const & features, MultiArrayIndex v,
+               MultiArrayView<2, U, C2> const & fz, MultiArrayView<2, U, C3> zv,
+               double columnSum, U eps, Matrix<double> const & gram,
+               ArrayVector<U> & fzv, ArrayVector<U> & factor, ArrayVector<double> & weights,
+               Matrix<double> & fzUpdate, double & error)
+{
+    MultiArrayIndex numComponents = columnCount(fz),
+                    begin = features.columnStarts()(v),
+                    end   = features.columnStarts()(v+1);
+
+    double modelNorm = 0.0;
+    for(MultiArrayIndex k = 0; k < numComponents; ++k)
+        for(MultiArrayIndex l = 0; l < numComponents; ++l)
+            modelNorm += zv(k, v) * gram(k, l) * zv(l, v);
+    error += sq(columnSum) * modelNorm;
+
+    for(MultiArrayIndex i = begin; i < end; ++i)
+    {
+        MultiArrayIndex f = features.rowIndices()(i);
+        U x = features.values()(i), 
+          m = U();
+        for(MultiArrayIndex k = 0; k < numComponents; ++k)
+            m += fz(f, k) * zv(k, v);
+        fzv[i-begin] = m;
+        error += x * (x - 2.0 * columnSum * m);
+        factor[i-begin] = x / (m + eps);
+    }
+
+    double sum = 0.0;
+    for(MultiArrayIndex k = 0; k < numComponents; ++k)
+    {
+        U g = U();
+        for(MultiArrayIndex i = begin; i < end; ++i)
+            g += fz(features.rowIndices()(i), k) * factor[i-begin];
+        weights[k] = zv(k, v) * g;
+        sum += weights[k];
+        for(MultiArrayIndex i = begin; i < end; ++i)
+            fzUpdate(features.rowIndices()(i), k) += factor[i-begin] * weights[k];
+    }
+    for(MultiArrayIndex k = 0; k < numComponents; ++k)
+        zv(k, v) = sum != 0.0
+                       ? static_cast<U>(weights[k] / sum)
+                       : static_cast<U>(weights[k]);
+}
+
+template <class U, class C1>
+inline double
+pLSAColumnSum(MultiArrayView<2, U, C1> const & features, MultiArrayIndex v)
+{
+    double sum = 0.0;
+    for(MultiArrayIndex f = 0; f < rowCount(features); ++f)
+        sum += features(f, v);
+    return sum;
+}
+
+template <class U>
+inline double
+pLSAColumnSum(SparseColumnMatrixView<U> const & features, MultiArrayIndex v)
+{
+    double sum = 0.0;
+    for(MultiArrayIndex i = features.columnStarts()(v); i < features.columnStarts()(v+1); ++i)
+        sum += features.values()(i);
+    return sum;
+}
+
+    // longest column, i.e. the size of the per-column buffers
+template <class U, class C1>
+inline MultiArrayIndex
+pLSAMaxColumnLength(MultiArrayView<2, U, C1> const & features)
+{
+    return rowCount(features);
+}
+
+template <class U>
+inline MultiArrayIndex
+pLSAMaxColumnLength(SparseColumnMatrixView<U> const & features)
+{
+    MultiArrayIndex res = 0;
+    for(MultiArrayIndex v = 0; v < features.columnCount(); ++v)
+        res = std::max(res, features.columnStarts()(v+1) - features.columnStarts()(v));
+    return res;
+}
+
+    /* Expectation maximization for pLSA. The samples are split into a fixed number of
+       contiguous tasks, each of which accumulates its own partial fz update and error.
+       The partial results are combined in task order, so that the result does not
+       depend on the number of threads. All buffers are allocated once.
+    */
+template <class Features, class U, class C2, class C3, class Random>
+void
+pLSAImpl(Features const & features, MultiArrayIndex numFeatures, MultiArrayIndex numSamples,
+         MultiArrayView<2, U, C2> fz, 
+         MultiArrayView<2, U, C3> zv,
+         Random const& random,
+         PLSAOptions const & options)
+{
+    using namespace linalg; // activate matrix multiplication and arithmetic functions
+
+    MultiArrayIndex numComponents = columnCount(fz);
+    vigra_precondition(numFeatures >= numComponents && numComponents >= 1,
+      "pLSA(): The number of features has to be larger or equal to the number of components in which the feature matrix is decomposed.");
+    vigra_precondition(rowCount(fz) == numFeatures,
+      "pLSA(): The output matrix fz has to be of dimension numFeatures*numComponents.");
+    vigra_precondition(columnCount(zv) == numSamples && rowCount(zv) == numComponents,
+      "pLSA(): The output matrix zv has to be of dimension numComponents*numSamples.");
+
+    // random initialization of result matrices, subsequent normalization
+    UniformRandomFunctor<Random> randf(random);
+    initMultiArray(destMultiArrayRange(fz), randf);
+    initMultiArray(destMultiArrayRange(zv), randf);
+    prepareColumns(fz, fz, UnitSum);
+    prepareColumns(zv, zv, UnitSum);
+
+    // init vars
+    double eps = 1.0/NumericTraits<U>::max(); // epsilon > 0
+    double lastChange = NumericTraits<U>::max(); // infinity
+    double err = 0;
+    double err_old;
+    int iteration = 0;
+
+    // partition of the samples
+    MultiArrayIndex taskSize = std::max<MultiArrayIndex>(64, (numSamples + 255) / 256),
+                    taskCount = (numSamples + taskSize - 1) / taskSize,
+                    columnLength = pLSAMaxColumnLength(features);
+
+    ArrayVector<double> columnSums(numSamples), taskErrors(taskCount);
+    std::vector<Matrix<double> > taskUpdates(taskCount, Matrix<double>(numFeatures, numComponents));
+    std::vector<ArrayVector<U> > fzvBuffers(taskCount, ArrayVector<U>(columnLength)),
+                                 factorBuffers(fzvBuffers);
+    std::vector<ArrayVector<double> > weightBuffers(taskCount, ArrayVector<double>(numComponents));
+    Matrix<double> fzUpdate(numFeatures, numComponents), gram(numComponents, numComponents);
+
+    parallel_foreach((MultiArrayIndex)0, taskCount,
+        [&](int /* thread_id */, MultiArrayIndex t)
+        {
+            MultiArrayIndex end = std::min(numSamples, (t+1)*taskSize);
+            for(MultiArrayIndex v = t*taskSize; v < end; ++v)
+                columnSums[v] = pLSAColumnSum(features, v);
+        },
+        options);
+
+    // expectation maximization (EM) algorithm
+    while(iteration < options.max_iterations && (lastChange > options.min_rel_gain))
+    {
+        for(MultiArrayIndex k = 0; k < numComponents; ++k)
+            for(MultiArrayIndex l = 0; l < numComponents; ++l)
+                gram(k, l) = dot(columnVector(fz, k), columnVector(fz, l));
+
+        parallel_foreach((MultiArrayIndex)0, taskCount,
+            [&](int /* thread_id */, MultiArrayIndex t)
+            {
+                taskUpdates[t].init(0.0);
+                taskErrors[t] = 0.0;
+                MultiArrayIndex end = std::min(numSamples, (t+1)*taskSize);
+                for(MultiArrayIndex v = t*taskSize; v < end; ++v)
+                    pLSAColumnStep(features, v, fz, zv, columnSums[v], (U)eps, gram,
+                                   fzvBuffers[t], factorBuffers[t], weightBuffers[t],
+                                   taskUpdates[t], taskErrors[t]);
+            },
+            options);
+
+        fzUpdate.init(0.0);
+        err_old = err;
+        err = 0.0;
+        for(MultiArrayIndex t = 0; t < taskCount; ++t)
+        {
+            fzUpdate += taskUpdates[t];
+            err += taskErrors[t];
+        }
+        for(MultiArrayIndex k = 0; k < numComponents; ++k)
+            for(MultiArrayIndex f = 0; f < numFeatures; ++f)
+                fz(f, k) = static_cast<U>(fz(f, k) * fzUpdate(f, k));
+        prepareColumns(fz, fz, UnitSum);
+
+        // check relative change in least squares model fit
+        lastChange = abs((err-err_old) / (err + eps));
+         
+        iteration += 1;
+    }
+    
+    if(!options.normalized_component_weights)
+    {
+        // undo the normalization
+        for(MultiArrayIndex k=0; k<numSamples; ++k)
+            columnVector(zv, k) *= static_cast<U>(columnSums[k]);
+    }
+}
+
+} // namespace detail
+
    /** \brief Decompose a matrix according to the pLSA algorithm. 
 
         This function implements the pLSA algorithm (probabilistic latent semantic analysis) 
@@ -242,9 +571,21 @@ class PLSAOptions
         <tt>zv</tt> encodes to what extend each topic explains the content of each 
         document.
 
-        The option object determines the iteration termination conditions and the output
-        normalization. In addition, you may pass a random number generator to pLSA()
-        which is used to create the initial solution.
+        The option object determines the iteration termination conditions, the output
+        normalization, and the number of threads. In addition, you may pass a random 
+        number generator to pLSA() which is used to create the initial solution.
+        
+        Each iteration makes a single pass over the samples, updating one column 
+        of <tt>zv</tt> at a time. No temporary matrices of the size of 
+        <tt>features</tt> are created, so that the memory overhead is only 
+        proportional to <tt>numFeatures * numComponents</tt>. The samples are 
+        processed in parallel, and the results do not depend on the number of threads.
+        The value type <tt>U</tt> may be <tt>float</tt> or <tt>double</tt>; sums
+        over samples are always accumulated in <tt>double</tt>.
+        
+        If the features are sparse (e.g. word counts), they can be passed as a
+        \ref SparseColumnMatrixView. Then, the costs per sample are proportional 
+        to the number of non-zero entries.
 
         <b>Declarations:</b>
         
@@ -267,6 +608,22 @@ class PLSAOptions
                  MultiArrayView<2, U, C2> & fz, 
                  MultiArrayView<2, U, C3> & zv,
                  PLSAOptions const & options = PLSAOptions());
+                 
+            // sparse input
+            template <class U, class C2, class C3, class Random>
+            void
+            pLSA(SparseColumnMatrixView<U> const & features,
+                 MultiArrayView<2, U, C2> fz, 
+                 MultiArrayView<2, U, C3> zv,
+                 Random const& random,
+                 PLSAOptions const & options = PLSAOptions());
+                 
+            template <class U, class C2, class C3>
+            void
+            pLSA(SparseColumnMatrixView<U> const & features,
+                 MultiArrayView<2, U, C2> fz, 
+                 MultiArrayView<2, U, C3> zv,
+                 PLSAOptions const & options = PLSAOptions());
         }
         \endcode
         
@@ -296,72 +653,8 @@ pLSA(MultiArrayView<2, U, C1> const & features,
      Random const& random,
      PLSAOptions const & options = PLSAOptions())
 {
-    using namespace linalg; // activate matrix multiplication and arithmetic functions
-
-    int numFeatures = rowCount(features);
-    int numSamples = columnCount(features);
-    int numComponents = columnCount(fz);
-    vigra_precondition(numFeatures >= numComponents && numComponents >= 1,
-      "pLSA(): The number of features has to be larger or equal to the number of components in which the feature matrix is decomposed.");
-    vigra_precondition(rowCount(fz) == numFeatures,
-      "pLSA(): The output matrix fz has to be of dimension numFeatures*numComponents.");
-    vigra_precondition(columnCount(zv) == numSamples && rowCount(zv) == numComponents,
-      "pLSA(): The output matrix zv has to be of dimension numComponents*numSamples.");
-
-    // random initialization of result matrices, subsequent normalization
-    UniformRandomFunctor<Random> randf(random);
-    initMultiArray(destMultiArrayRange(fz), randf);
-    initMultiArray(destMultiArrayRange(zv), randf);
-    prepareColumns(fz, fz, UnitSum);
-    prepareColumns(zv, zv, UnitSum);
-
-    // init vars
-    double eps = 1.0/NumericTraits<U>::max(); // epsilon > 0
-    double lastChange = NumericTraits<U>::max(); // infinity
-    double err = 0;
-    double err_old;
-    int iteration = 0;
-
-    // expectation maximization (EM) algorithm
-    Matrix<U> columnSums(1, numSamples);
-    features.sum(columnSums);
-    Matrix<U> expandedSums = ones<U>(numFeatures, 1) * columnSums;
-    
-    while(iteration < options.max_iterations && (lastChange > options.min_rel_gain))
-    {
-        Matrix<U> fzv = fz*zv;
-        
-        //if(iteration%25 == 0)
-        //{
-            //std::cout << "iteration: " << iteration << std::endl;
-            //std::cout << "last relative change: " << lastChange << std::endl;
-        //}
-
-        Matrix<U> factor = features / pointWise(fzv + (U)eps);
-        zv *= (fz.transpose() * factor);
-        fz *= (factor * zv.transpose());
-        prepareColumns(fz, fz, UnitSum);
-        prepareColumns(zv, zv, UnitSum);
-
-        // check relative change in least squares model fit
-        Matrix<U> model = expandedSums * pointWise(fzv);
-        err_old = err;
-        err = (features - model).squaredNorm();
-        //std::cout << "error: " << err << std::endl;
-        lastChange = abs((err-err_old) / (U)(err + eps));
-        //std::cout << "lastChange: " << lastChange << std::endl;
-         
-        iteration += 1;
-    }
-    //std::cout << "Terminated after " << iteration << " iterations." << std::endl;
-    //std::cout << "Last relative change was " << lastChange << "." << std::endl;
-    
-    if(!options.normalized_component_weights)
-    {
-        // undo the normalization
-        for(int k=0; k<numSamples; ++k)
-            columnVector(zv, k) *= columnSums(0, k);
-    }
+    detail::pLSAImpl(features, rowCount(features), columnCount(features), 
+                     fz, zv, random, options);
 }
 
 template <class U, class C1, class C2, class C3>
@@ -375,6 +668,29 @@ pLSA(MultiArrayView<2, U, C1> const & features,
     pLSA(features, fz, zv, generator, options);
 }
 
+template <class U, class C2, class C3, class Random>
+void
+pLSA(SparseColumnMatrixView<U> const & features,
+     MultiArrayView<2, U, C2> fz, 
+     MultiArrayView<2, U, C3> zv,
+     Random const& random,
+     PLSAOptions const & options = PLSAOptions())
+{
+    detail::pLSAImpl(features, features.rowCount(), features.columnCount(), 
+                     fz, zv, random, options);
+}
+
+template <class U, class C2, class C3>
+inline void
+pLSA(SparseColumnMatrixView<U> const & features,
+     MultiArrayView<2, U, C2> fz, 
+     MultiArrayView<2, U, C3> zv,
+     PLSAOptions const & options = PLSAOptions())
+{
+    RandomNumberGenerator<> generator(RandomSeed);
+    pLSA(features, fz, zv, generator, options);
+}
+
 //@}
 
 } // namespace vigra
@@ -41,12 +41,76 @@
 #include <zlib.h>
 #endif
 
+#ifdef HasZSTD
+#include <zstd.h>
+#endif
+
 namespace vigra {
 
+namespace {
+
+inline bool hasShuffle(CompressionMethod method)
+{
+    return method >= 0 && (method & SHUFFLE) != 0;
+}
+
+inline bool isZSTD(CompressionMethod method)
+{
+    return method >= ZSTD_FAST && method < ZSTD_FAST + 22;
+}
+
+// Transpose the buffer, interpreted as a matrix with 'elementSize' columns.
+// Trailing bytes which don't form a complete element are copied unchanged.
+void shuffleBytes(char const * source, std::size_t size, std::size_t elementSize, char * dest)
+{
+    std::size_t count = size / elementSize;
+    for(std::size_t b = 0; b < elementSize; ++b, dest += count)
+        for(std::size_t k = 0; k < count; ++k)
+            dest[k] = source[k*elementSize + b];
+    std::copy(source + count*elementSize, source + size, dest);
+}
+
+void unshuffleBytes(char const * source, std::size_t size, std::size_t elementSize, char * dest)
+{
+    std::size_t count = size / elementSize;
+    for(std::size_t b = 0; b < elementSize; ++b, source += count)
+        for(std::size_t k = 0; k < count; ++k)
+            dest[k*elementSize + b] = source[k];
+    std::copy(source, source + size - count*elementSize, dest + count*elementSize);
+}
+
+} // anonymous namespace
+
 std::size_t compressImpl(char const * source, std::size_t srcSize, 
                          ArrayVector<char> & buffer,
-                         CompressionMethod method)
+                         CompressionMethod method,
+                         std::size_t elementSize = 1)
 {
+    if(hasShuffle(method))
+    {
+        method = CompressionMethod(method & ~SHUFFLE);
+        if(elementSize > 1)
+        {
+            ArrayVector<char> shuffled(srcSize);
+            shuffleBytes(source, srcSize, elementSize, shuffled.data());
+            return compressImpl(shuffled.data(), srcSize, buffer, method);
+        }
+    }
+    
+    if(isZSTD(method))
+    {
+    #ifdef HasZSTD
+        std::size_t destSize = ::ZSTD_compressBound(srcSize);
+        buffer.resize(destSize);
+        destSize = ::ZSTD_compress(buffer.data(), destSize, source, srcSize, method - ZSTD_FAST + 1);
+        vigra_postcondition(!::ZSTD_isError(destSize), "compress(): zstd compression failed.");
+        return destSize;
+    #else
+        vigra_precondition(false, "compress(): VIGRA was compiled without ZSTD compression.");
+        return 0;
+    #endif
+    }
+
     switch(method)
     {
       case NO_COMPRESSION:
@@ -118,24 +182,61 @@ std::size_t compressImpl(char const * source, std::size_t srcSize,
     return 0;
 }
 
-void compress(char const * source, std::size_t size, ArrayVector<char> & dest, CompressionMethod method)
+void compress(char const * source, std::size_t size, ArrayVector<char> & dest, 
+              CompressionMethod method, std::size_t elementSize)
 {
     ArrayVector<char> buffer;
-    std::size_t destSize = compressImpl(source, size, buffer, method);
+    std::size_t destSize = compressImpl(source, size, buffer, method, elementSize);
     dest.resize(destSize);
     std::copy(buffer.data(), buffer.data() + destSize, dest.begin());
 }
 
-void compress(char const * source, std::size_t size, std::vector<char> & dest, CompressionMethod method)
+void compress(char const * source, std::size_t size, std::vector<char> & dest, 
+              CompressionMethod method, std::size_t elementSize)
 {
     ArrayVector<char> buffer;
-    std::size_t destSize = compressImpl(source, size, buffer, method);
+    std::size_t destSize = compressImpl(source, size, buffer, method, elementSize);
     dest.insert(dest.begin(), buffer.data(), buffer.data() + destSize);
 }
 
+void compress(char const * source, std::size_t size, ArrayVector<char> & dest, CompressionMethod method)
+{
+    compress(source, size, dest, method, 1);
+}
+
+void compress(char const * source, std::size_t size, std::vector<char> & dest, CompressionMethod method)
+{
+    compress(source, size, dest, method, 1);
+}
+
 void uncompress(char const * source, std::size_t srcSize, 
-                char * dest, std::size_t destSize, CompressionMethod method)
+                char * dest, std::size_t destSize, CompressionMethod method,
+                std::size_t elementSize)
 {
+    if(hasShuffle(method))
+    {
+        method = CompressionMethod(method & ~SHUFFLE);
+        if(elementSize > 1)
+        {
+            ArrayVector<char> shuffled(destSize);
+            uncompress(source, srcSize, shuffled.data(), destSize, method, 1);
+            unshuffleBytes(shuffled.data(), destSize, elementSize, dest);
+            return;
+        }
+    }
+    
+    if(isZSTD(method))
+    {
+    #ifdef HasZSTD
+        std::size_t res = ::ZSTD_decompress(dest, destSize, source, srcSize);
+        vigra_postcondition(!::ZSTD_isError(res) && res == destSize, 
+                            "uncompress(): zstd decompression failed.");
+    #else
+        vigra_precondition(false, "uncompress(): VIGRA was compiled without ZSTD compression.");
+    #endif
+        return;
+    }
+    
     switch(method)
     {
       case NO_COMPRESSION:
@@ -193,6 +294,12 @@ void uncompress(char const * source, std::size_t srcSize,
     }
 }
 
+void uncompress(char const * source, std::size_t srcSize, 
+                char * dest, std::size_t destSize, CompressionMethod method)
+{
+    uncompress(source, srcSize, dest, destSize, method, 1);
+}
+
 /** Uncompress a data buffer when the uncompressed size is unknown.
 
     The destination array will be resized as required.
@@ -0,0 +1,686 @@
+/************************************************************************/
+/*                                                                      */
+/*    This file is part of the VIGRA computer vision library.           */
+/*    The VIGRA Website is                                              */
+/*        http://hci.iwr.uni-heidelberg.de/vigra/                       */
+/*    Please direct questions, bug reports, and contributions to        */
+/*        ullrich.koethe@iwr.uni-heidelberg.de    or                    */
+/*        vigra@informatik.uni-hamburg.de                               */
+/*                                                                      */
+/*    Permission is hereby granted, free of charge, to any person       */
+/*    obtaining a copy of this software and associated documentation    */
+/*    files (the "Software"), to deal in the Software without           */
+/*    restriction, including without limitation the rights to use,      */
+/*    copy, modify, merge, publish, distribute, sublicense, and/or      */
+/*    sell copies of the Software, and to permit persons to whom the    */
+/*    Software is furnished to do so, subject to the following          */
+/*    conditions:                                                       */
+/*                                                                      */
+/*    The above copyright notice and this permission notice shall be    */
+/*    included in all copies or substantial portions of the             */
+/*    Software.                                                         */
+/*                                                                      */
+/*    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND    */
+/*    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES   */
+/*    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND          */
+/*    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT       */
+/*    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,      */
+/*    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING      */
+/*    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR     */
+/*    OTHER DEALINGS IN THE SOFTWARE.                                   */
+/*                                                                      */
+/************************************************************************/
+
+#include <iostream>
+#include <fstream>
+#include <cstdio>
+#include "vigra/unittest.hxx"
+#include "vigra/random_forest.hxx"
+#include "vigra/random_forest_chunked.hxx"
+#include "vigra/random_forest_binary_impex.hxx"
+
+using namespace vigra;
+
+    // counts the sampled training examples per class
+struct ClassCountVisitor
+: public rf::visitors::VisitorBase
+{
+    ArrayVector<int> counts;
+
+    ClassCountVisitor()
+    : counts(3, 0)
+    {}
+
+    template<class RF, class PR, class SM, class ST>
+    void visit_after_tree(RF &, PR & pr, SM & sm, ST &, int)
+    {
+        for(int k = 0; k < sm.sampleSize(); ++k)
+            ++counts[pr.strata()[sm[k]]];
+    }
+};
+
+struct RandomForestTest
+{
+    typedef RandomForest<int> RF;
+
+    MultiArray<2, double> features;
+    MultiArray<2, int>    labels;
+
+    RandomForestTest()
+    : features(Shape2(400, 3)),
+      labels(Shape2(400, 1))
+    {
+        for(int i = 0; i < features.shape(0); ++i)
+        {
+            features(i, 0) = i % 20;
+            features(i, 1) = i % 7;
+            features(i, 2) = (i * 13) % 17;
+            labels(i, 0) = (i % 20 < 10) ? ((i % 7 < 3) ? 1 : 2) : 0;
+        }
+    }
+
+    static RandomForestOptions options(int treeCount)
+    {
+        ArrayVector<int> featureMix(4, 0);
+        featureMix[0] = 1;
+        return RandomForestOptions().tree_count(treeCount)
+                                    .feature_mix(featureMix)
+                                    .image_shape(Shape2(20, 20))
+                                    .max_offset_x(2)
+                                    .max_offset_y(2)
+                                    .std_offset_xy(1);
+    }
+
+    static void shouldEqualForests(RF const & a, RF const & b)
+    {
+        shouldEqual(a.tree_count(), b.tree_count());
+        for(int k = 0; k < a.tree_count(); ++k)
+        {
+            shouldEqualSequence(a.tree(k).topology_.begin(), a.tree(k).topology_.end(),
+                                b.tree(k).topology_.begin());
+            shouldEqualSequence(a.tree(k).parameters_.begin(), a.tree(k).parameters_.end(),
+                                b.tree(k).parameters_.begin());
+        }
+    }
+
+    void testParallelLearning()
+    {
+        RF serial(options(16).n_threads(1));
+        rf::visitors::OOB_Error serialOOB;
+        serial.learn(features, labels, rf::visitors::create_visitor(serialOOB),
+                     rf_default(), rf_default(), RandomMT19937(42));
+
+        int threadCounts[] = { 0, 2, 3, ParallelOptions::Auto };
+        for(int k = 0; k < 4; ++k)
+        {
+            RF parallel(options(16).n_threads(threadCounts[k]));
+            rf::visitors::OOB_Error parallelOOB;
+            parallel.learn(features, labels, rf::visitors::create_visitor(parallelOOB),
+                           rf_default(), rf_default(), RandomMT19937(42));
+
+            shouldEqualForests(serial, parallel);
+            shouldEqual(serialOOB.oob_breiman, parallelOOB.oob_breiman);
+        }
+
+        MultiArray<2, int> predicted(labels.shape());
+        serial.predictLabels(features, predicted);
+        int correct = 0;
+        for(int i = 0; i < labels.shape(0); ++i)
+            correct += (predicted(i, 0) == labels(i, 0));
+        shouldEqual(correct, labels.shape(0));
+        should(serialOOB.oob_breiman < 0.1);
+
+        // a different seed results in a different forest
+        RF other(options(16).n_threads(3));
+        other.learn(features, labels, rf_default(), rf_default(), rf_default(),
+                    RandomMT19937(43));
+        bool differs = false;
+        for(int k = 0; k < other.tree_count(); ++k)
+            differs = differs || (other.tree(k).parameters_ != serial.tree(k).parameters_);
+        should(differs);
+    }
+
+    void testFeatureTypes()
+    {
+        // the features are used in place, whatever their type and layout
+        RF reference(options(8));
+        reference.learn(features, labels, rf_default(), rf_default(), rf_default(),
+                        RandomMT19937(5));
+
+        MultiArray<2, float> floatFeatures(Shape2(features.shape(1), features.shape(0)));
+        MultiArray<2, UInt8> byteFeatures(floatFeatures.shape());
+        floatFeatures.transpose() = features;
+        byteFeatures.transpose() = features;
+
+        for(int k = 0; k < 2; ++k)
+        {
+            RF floatRF(options(8).n_threads(k == 0 ? 1 : 3));
+            floatRF.learn(floatFeatures.transpose(), labels, rf_default(), rf_default(),
+                          rf_default(), RandomMT19937(5));
+            shouldEqualForests(reference, floatRF);
+
+            RF byteRF(options(8).n_threads(k == 0 ? 1 : 3));
+            byteRF.learn(byteFeatures.transpose(), labels, rf_default(), rf_default(),
+                         rf_default(), RandomMT19937(5));
+            shouldEqualForests(reference, byteRF);
+        }
+
+        // learning a second forest reuses nothing from the first
+        RF again(options(8));
+        again.learn(features, labels, rf_default(), rf_default(), rf_default(),
+                    RandomMT19937(5));
+        shouldEqualForests(reference, again);
+    }
+
+    void testWeightedStratification()
+    {
+        // RF_EXTERNAL draws the classes in proportion to the class weights
+        double weights[] = { 1.0, 0.0, 3.0 };
+        ProblemSpec<int> spec;
+        spec.class_weights(weights, weights + 3);
+
+        ClassCountVisitor serialCounts;
+        RF serial(options(8).use_stratification(RF_EXTERNAL).n_threads(1), spec);
+        serial.learn(features, labels, rf::visitors::create_visitor(serialCounts),
+                     rf_default(), rf_default(), RandomMT19937(3));
+        shouldEqual(serialCounts.counts[1], 0);
+        int total = 8 * features.shape(0);
+        shouldEqual(serialCounts.counts[0] + serialCounts.counts[2], total);
+        shouldEqualTolerance(serialCounts.counts[2] / double(total), 0.75, 0.03);
+
+        ClassCountVisitor parallelCounts;
+        RF parallel(options(8).use_stratification(RF_EXTERNAL).n_threads(3), spec);
+        parallel.learn(features, labels, rf::visitors::create_visitor(parallelCounts),
+                       rf_default(), rf_default(), RandomMT19937(3));
+        shouldEqualForests(serial, parallel);
+        shouldEqualSequence(serialCounts.counts.begin(), serialCounts.counts.end(),
+                            parallelCounts.counts.begin());
+    }
+
+    void testIncrementalLearning()
+    {
+        // trivial trees (a single leaf each) learned from a fraction of the data
+        MultiArray<2, double> fewFeatures(features.subarray(Shape2(0, 0), Shape2(60, 3)));
+        MultiArray<2, int>    fewLabels(labels.subarray(Shape2(0, 0), Shape2(60, 1)));
+        RF rf(options(8).min_split_node_size(1000).n_threads(1));
+        rf.learn(fewFeatures, fewLabels, rf_default(), rf_default(), rf_default(),
+                 RandomMT19937(7));
+
+        MultiArray<2, int> predicted(labels.shape());
+        rf.predictLabels(features, predicted);
+        int before = 0;
+        for(int i = 0; i < labels.shape(0); ++i)
+            before += (predicted(i, 0) == labels(i, 0));
+
+        // the same updates with one and several threads give identical forests
+        RF parallel(rf);
+        parallel.set_options().n_threads(3);
+        for(int k = 0; k < 4; ++k)
+        {
+            rf.incrementalLearn(features, labels, IncrementalLearningOptions(), RandomMT19937(k));
+            parallel.incrementalLearn(features, labels, IncrementalLearningOptions(), RandomMT19937(k));
+        }
+        shouldEqualForests(rf, parallel);
+
+        rf.predictLabels(features, predicted);
+        int after = 0;
+        for(int i = 0; i < labels.shape(0); ++i)
+            after += (predicted(i, 0) == labels(i, 0));
+        should(after > before);
+        should(after > 0.95 * labels.shape(0));
+
+        MultiArray<2, int> unknown(Shape2(1, 1), 5);
+        try
+        {
+            rf.incrementalLearn(features.subarray(Shape2(0, 0), Shape2(1, 3)), unknown);
+            failTest("RandomForest::incrementalLearn() failed to throw on unknown label.");
+        }
+        catch(PreconditionViolation &) {}
+    }
+
+    static double leafWeights(RF::DecisionTree_t const & tree)
+    {
+        double sum = 0.0;
+        std::vector<Int32> stack(1, 2);
+        while(!stack.empty())
+        {
+            NodeBase node(tree.topology_, tree.parameters_, stack.back());
+            stack.pop_back();
+            if(tree.isLeafNode(node.typeID()))
+            {
+                sum += node.weights();
+            }
+            else
+            {
+                stack.push_back(node.child(0));
+                stack.push_back(node.child(1));
+            }
+        }
+        return sum;
+    }
+
+    void testIncrementalSplit()
+    {
+        // trees with inner nodes that only know about column 0, so that the
+        // incremental splits (on column 1) are below the root
+        MultiArray<2, double> fewFeatures(features.subarray(Shape2(0, 0), Shape2(60, 3)));
+        MultiArray<2, int>    fewLabels(labels.subarray(Shape2(0, 0), Shape2(60, 1)));
+        for(int i = 0; i < fewLabels.shape(0); ++i)
+            if(fewLabels(i, 0) == 2)
+                fewLabels(i, 0) = 1;
+        fewLabels(59, 0) = 2;
+        RF rf(options(4).min_split_node_size(20).n_threads(1));
+        rf.learn(fewFeatures, fewLabels, rf_default(), rf_default(), rf_default(),
+                 RandomMT19937(11));
+
+        ArrayVector<double> before(rf.tree_count());
+        ArrayVector<int> sizes(rf.tree_count());
+        for(int k = 0; k < rf.tree_count(); ++k)
+        {
+            should(!rf.tree(k).isLeafNode(rf.tree(k).topology_[2]));
+            before[k] = leafWeights(rf.tree(k));
+            sizes[k] = rf.tree(k).topology_.size();
+        }
+
+        // every sample is added once, the split leaves keep their trained counts
+        rf.incrementalLearn(features, labels,
+                            IncrementalLearningOptions().poisson_lambda(0.0).min_split_count(10),
+                            RandomMT19937(1));
+        bool grown = false;
+        for(int k = 0; k < rf.tree_count(); ++k)
+        {
+            grown = grown || static_cast<int>(rf.tree(k).topology_.size()) > sizes[k];
+            shouldEqualTolerance(leafWeights(rf.tree(k)), before[k] + features.shape(0), 1e-9);
+        }
+        should(grown);
+    }
+
+    void testVariableImportance()
+    {
+        // plain and contextual features
+        ArrayVector<int> featureMix(4, 0);
+        featureMix[0] = 1;
+        featureMix[1] = 1;
+        RandomForestOptions opts[] = { options(16), options(16).feature_mix(featureMix) };
+
+        for(int o = 0; o < 2; ++o)
+        {
+            MultiArray<2, double> reference;
+            int threadCounts[] = { 1, 4, ParallelOptions::Auto };
+            for(int k = 0; k < 3; ++k)
+            {
+                RF rf(RandomForestOptions(opts[o]).n_threads(k == 0 ? 1 : 3));
+                rf::visitors::VariableImportanceVisitor importance(5,
+                                        ParallelOptions().numThreads(threadCounts[k]), 3);
+                rf.learn(features, labels, rf::visitors::create_visitor(importance),
+                         rf_default(), rf_default(), RandomMT19937(9));
+
+                MultiArray<2, double> & imp = importance.variable_importance_;
+                shouldEqual(imp.shape(), Shape2(3, rf.class_count() + 2));
+                if(k == 0)
+                {
+                    reference = imp;
+                    // the label depends on columns 0 and 1 only
+                    int total = rf.class_count();
+                    should(imp(0, total) > 0.1);
+                    should(imp(1, total) > 0.1);
+                    should(imp(2, total) < imp(0, total));
+                    should(imp(2, total) < imp(1, total));
+                    should(imp(0, total+1) > 0.0);
+                }
+                else
+                {
+                    // the gini decrease is accumulated in the order the splits are
+                    // made, which depends on the schedule when learning in parallel
+                    int permutation = rf.class_count() + 1;
+                    shouldEqualSequence(imp.subarray(Shape2(0, 0), Shape2(3, permutation)).begin(),
+                                        imp.subarray(Shape2(0, 0), Shape2(3, permutation)).end(),
+                                        reference.subarray(Shape2(0, 0), Shape2(3, permutation)).begin());
+                    shouldEqualSequenceTolerance(imp.bindOuter(permutation).begin(),
+                                                 imp.bindOuter(permutation).end(),
+                                                 reference.bindOuter(permutation).begin(), 1e-10);
+                }
+            }
+        }
+    }
+
+    void testClusterImportance()
+    {
+        // columns 0 and 1 are close, column 3 is the (unused) extra column
+        // of the clustering
+        double d[] = { 0.0, 0.1, 0.8, 0.9,
+                       0.1, 0.0, 0.8, 0.9,
+                       0.8, 0.8, 0.0, 0.9,
+                       0.9, 0.9, 0.9, 0.0 };
+        MultiArrayView<2, double> distance(Shape2(4, 4), d);
+
+        MultiArray<2, double> reference;
+        int threadCounts[] = { 1, 4, ParallelOptions::Auto };
+        for(int k = 0; k < 3; ++k)
+        {
+            rf::algorithms::HClustering linkage;
+            linkage.cluster(distance);
+            RF rf(options(8).n_threads(k == 0 ? 1 : 3));
+            rf::algorithms::ClusterImportanceVisitor importance(linkage, 3,
+                                    ParallelOptions().numThreads(threadCounts[k]), 5);
+            rf.learn(features, labels, rf::visitors::create_visitor(importance),
+                     rf_default(), rf_default(), RandomMT19937(9));
+
+            MultiArray<2, double> & imp = importance.cluster_importance_;
+            shouldEqual(imp.shape(), Shape2(7, rf.class_count() + 1));
+            if(k == 0)
+            {
+                reference = imp;
+                // the label depends on columns 0 and 1 only
+                int total = rf.class_count(), found = 0;
+                for(int ii = 0; ii < imp.shape(0); ++ii)
+                {
+                    MultiArrayView<1, int> vars = importance.variables.bindInner(ii);
+                    if(vars(0) == 0 && vars(1) == 1 && vars(2) == -1)
+                    {
+                        should(imp(ii, total) > 0.2);
+                        ++found;
+                    }
+                    if(vars(0) == 2 && vars(1) == -1)
+                    {
+                        should(imp(ii, total) < 0.1);
+                        ++found;
+                    }
+                }
+                shouldEqual(found, 2);
+            }
+            else
+            {
+                shouldEqualSequenceTolerance(imp.begin(), imp.end(), reference.begin(), 1e-10);
+            }
+        }
+    }
+
+    void testHistogramSplit()
+    {
+        // with less distinct values than bins, the histogram split considers
+        // the same partitions as GiniSplit, only the thresholds differ
+        RF_OptionTag mtry[] = { RF_SQRT, RF_ALL };
+        for(int m = 0; m < 2; ++m)
+        {
+            RF gini(options(8).features_per_node(mtry[m]));
+            gini.learn(features, labels, rf_default(), GiniSplit(), rf_default(),
+                       RandomMT19937(7));
+            RF hist(options(8).features_per_node(mtry[m]).n_threads(2));
+            hist.learn(features, labels, rf_default(), HistogramSplit(), rf_default(),
+                       RandomMT19937(7));
+
+            for(int k = 0; k < gini.tree_count(); ++k)
+                shouldEqualSequence(gini.tree(k).topology_.begin(), gini.tree(k).topology_.end(),
+                                    hist.tree(k).topology_.begin());
+
+            MultiArray<2, double> expected(Shape2(features.shape(0), gini.class_count())),
+                                  prob(expected.shape());
+            gini.predictProbabilities(features, expected);
+            hist.predictProbabilities(features, prob);
+            shouldEqualSequence(prob.begin(), prob.end(), expected.begin());
+        }
+
+        // more distinct values than bins
+        MultiArray<2, double> noisy(features);
+        RandomMT19937 random(3);
+        for(auto & v : noisy)
+            v += 0.5 * random.uniform();
+        RandomForestOptions all = options(8).features_per_node(RF_ALL);
+        RF forests[] = { RF(options(8)), RF(all), RF(all) };
+        forests[0].learn(noisy, labels, rf_default(), HistogramSplit(16), rf_default(),
+                         RandomMT19937(1));
+        forests[1].learn(noisy, labels, rf_default(), HistogramSplit(16), rf_default(),
+                         RandomMT19937(1));
+        forests[2].learn(noisy, labels, rf_default(), HistogramSplit(2), rf_default(),
+                         RandomMT19937(1));
+        for(int k = 0; k < 3; ++k)
+        {
+            MultiArray<2, int> predicted(labels.shape());
+            forests[k].predictLabels(noisy, predicted);
+            int correct = 0;
+            for(int i = 0; i < labels.shape(0); ++i)
+                correct += (predicted(i, 0) == labels(i, 0));
+            should(correct >= 0.95 * labels.shape(0));
+        }
+
+        try
+        {
+            HistogramSplit failing(257);
+            failTest("no exception thrown");
+        }
+        catch(PreconditionViolation & c)
+        {
+            std::string expected("\nPrecondition violation!\nHistogramSplit(): binCount must be in [2, 256].");
+            std::string message(c.what());
+            should(0 == expected.compare(message.substr(0,expected.size())));
+        }
+    }
+
+    void testFlatForest()
+    {
+        RF rf(options(16).n_threads(ParallelOptions::Auto));
+        rf.learn(features, labels, rf_default(), rf_default(), rf_default(),
+                 RandomMT19937(42));
+
+        should(FlatRandomForest<int>::supports(rf));
+        FlatRandomForest<int> flat(rf);
+        shouldEqual(flat.tree_count(), rf.tree_count());
+        shouldEqual(flat.class_count(), rf.class_count());
+        shouldEqual(flat.leaf_count(), flat.node_count() + flat.tree_count());
+
+        MultiArray<2, double> expected(Shape2(features.shape(0), rf.class_count())),
+                              prob(expected.shape());
+        rf.predictProbabilities(features, expected);
+
+        int threadCounts[] = { 0, 1, 4, ParallelOptions::Auto };
+        for(int k = 0; k < 4; ++k)
+        {
+            prob.init(-1.0);
+            flat.predictProbabilities(features, prob, ParallelOptions().numThreads(threadCounts[k]));
+            shouldEqualSequence(prob.begin(), prob.end(), expected.begin());
+        }
+
+        MultiArray<2, int> expectedLabels(labels.shape()), flatLabels(labels.shape());
+        rf.predictLabels(features, expectedLabels);
+        flat.predictLabels(features, flatLabels);
+        shouldEqualSequence(flatLabels.begin(), flatLabels.end(), expectedLabels.begin());
+
+        // float thresholds give identical decisions for float features
+        MultiArray<2, float> floatFeatures(features.shape());
+        for(int i = 0; i < features.shape(0); ++i)
+            for(int j = 0; j < features.shape(1); ++j)
+                floatFeatures(i, j) = (float)(features(i, j) * 0.1);
+        MultiArray<2, double> doubleFeatures(floatFeatures);
+        RF floatRF(options(16));
+        floatRF.learn(doubleFeatures, labels, rf_default(), rf_default(), rf_default(),
+                      RandomMT19937(42));
+        floatRF.predictProbabilities(doubleFeatures, expected);
+        FlatRandomForest<int, float> flatFloat(floatRF);
+        flatFloat.predictProbabilities(floatFeatures, prob);
+        shouldEqualSequence(prob.begin(), prob.end(), expected.begin());
+
+        // strided feature views are supported as well
+        MultiArray<2, double> transposed(Shape2(features.shape(1), features.shape(0)));
+        transposed = features.transpose();
+        flat.predictProbabilities(transposed.transpose(), prob);
+        rf.predictProbabilities(features, expected);
+        shouldEqualSequence(prob.begin(), prob.end(), expected.begin());
+
+        // weighted prediction
+        RF weighted(options(8).predict_weighted());
+        weighted.learn(features, labels, rf_default(), rf_default(), rf_default(),
+                       RandomMT19937(1));
+        weighted.predictProbabilities(features, expected);
+        FlatRandomForest<int>(weighted).predictProbabilities(features, prob);
+        shouldEqualSequence(prob.begin(), prob.end(), expected.begin());
+
+        // contextual features can't be flattened
+        ArrayVector<int> featureMix(4, 0);
+        featureMix[2] = 2;
+        RF contextual(options(2).feature_mix(featureMix));
+        contextual.learn(features, labels, rf_default(), rf_default(), rf_default(),
+                         RandomMT19937(1));
+        should(!FlatRandomForest<int>::supports(contextual));
+        try
+        {
+            FlatRandomForest<int> failing(contextual);
+            failTest("no exception thrown");
+        }
+        catch(PreconditionViolation & c)
+        {
+            std::string expected("\nPrecondition violation!\nFlatRandomForest(): forest contains nodes other than threshold nodes on plain features.");
+            std::string message(c.what());
+            should(0 == expected.compare(message.substr(0,expected.size())));
+        }
+    }
+
+    void testChunkedPrediction()
+    {
+        RF rf(options(16));
+        rf.learn(features, labels, rf_default(), rf_default(), rf_default(),
+                 RandomMT19937(42));
+        MultiArray<2, double> expected(Shape2(features.shape(0), rf.class_count()));
+        rf.predictProbabilities(features, expected);
+
+        // the samples are the pixels of a 20x20 image with 3 channels
+        Shape3 featureShape(20, 20, 3), probShape(20, 20, rf.class_count());
+        MultiArrayView<3, double> volume(featureShape, features.data()),
+                                  expectedVolume(probShape, expected.data());
+
+        // spatial chunks (complete chunks are predicted in place), channel
+        // chunks (blocks must be copied), and a user-defined block shape
+        Shape3 chunkShapes[] = { Shape3(8, 8, 4), Shape3(8, 8, 1), Shape3(4, 4, 4) };
+        BlockwiseOptions blockOptions[] = { BlockwiseOptions().numThreads(4),
+                                            BlockwiseOptions().numThreads(3),
+                                            BlockwiseOptions().blockShape(Shape2(5, 3)) };
+        for(int k = 0; k < 3; ++k)
+        {
+            ChunkedArrayLazy<3, double> chunkedFeatures(featureShape, chunkShapes[k]);
+            chunkedFeatures.commitSubarray(Shape3(), volume);
+            ChunkedArrayLazy<3, double> prob(probShape, chunkShapes[k]);
+
+            predictProbabilitiesChunked(rf, chunkedFeatures, prob, blockOptions[k]);
+
+            MultiArray<3, double> result(probShape);
+            prob.checkoutSubarray(Shape3(), result);
+            shouldEqualSequence(result.begin(), result.end(), expectedVolume.begin());
+        }
+
+        // float features and probabilities with a flattened forest
+        FlatRandomForest<int> flat(rf);
+        ChunkedArrayLazy<3, float> floatFeatures(featureShape, Shape3(16, 4, 4));
+        floatFeatures.commitSubarray(Shape3(), MultiArray<3, float>(volume));
+        ChunkedArrayLazy<3, float> floatProb(probShape, Shape3(16, 4, 4));
+        predictProbabilitiesChunked(flat, floatFeatures, floatProb);
+        MultiArray<3, float> floatResult(probShape);
+        floatProb.checkoutSubarray(Shape3(), floatResult);
+        for(int i = 0; i < floatResult.size(); ++i)
+            shouldEqual(floatResult[i], (float)expectedVolume[i]);
+
+        try
+        {
+            ChunkedArrayLazy<3, double> wrong(Shape3(20, 10, 3));
+            predictProbabilitiesChunked(flat, floatFeatures, wrong);
+            failTest("no exception thrown");
+        }
+        catch(PreconditionViolation & c)
+        {
+            std::string expected("\nPrecondition violation!\npredictProbabilitiesChunked(): shape mismatch between features and probabilities.");
+            std::string message(c.what());
+            should(0 == expected.compare(message.substr(0,expected.size())));
+        }
+    }
+
+    void testBinaryImpex()
+    {
+        RF rf(options(16).predict_weighted());
+        rf.learn(features, labels, rf_default(), rf_default(), rf_default(),
+                 RandomMT19937(42));
+        MultiArray<2, double> expected(Shape2(features.shape(0), rf.class_count())),
+                              prob(expected.shape());
+        rf.predictProbabilities(features, expected);
+
+        rf_export_binary(rf, "test_forest.vrf");
+        FlatRandomForest<int> imported;
+        {
+            FlatRandomForest<int> loaded;
+            should(rf_import_binary(loaded, "test_forest.vrf"));
+            // the copy keeps the file mapped
+            imported = loaded;
+        }
+        FlatRandomForest<int> flat(rf);
+        shouldEqual(imported.tree_count(), flat.tree_count());
+        shouldEqual(imported.node_count(), flat.node_count());
+        shouldEqual(imported.leaf_count(), flat.leaf_count());
+        shouldEqual(imported.column_count(), flat.column_count());
+        shouldEqual(imported.class_count(), flat.class_count());
+
+        imported.predictProbabilities(features, prob, ParallelOptions().numThreads(4));
+        shouldEqualSequence(prob.begin(), prob.end(), expected.begin());
+        MultiArray<2, int> expectedLabels(labels.shape()), importedLabels(labels.shape());
+        rf.predictLabels(features, expectedLabels);
+        imported.predictLabels(features, importedLabels);
+        shouldEqualSequence(importedLabels.begin(), importedLabels.end(), expectedLabels.begin());
+
+        // float thresholds
+        rf_export_binary(FlatRandomForest<int, float>(rf), "test_forest_float.vrf");
+        FlatRandomForest<int, float> importedFloat;
+        should(rf_import_binary(importedFloat, "test_forest_float.vrf"));
+        importedFloat.predictProbabilities(features, prob);
+        shouldEqualSequence(prob.begin(), prob.end(), expected.begin());
+
+        try
+        {
+            rf_import_binary(importedFloat, "test_forest.vrf");
+            failTest("no exception thrown");
+        }
+        catch(PreconditionViolation & c)
+        {
+            std::string expected("\nPrecondition violation!\nrf_import_binary(): threshold type of the file and the forest differ.");
+            std::string message(c.what());
+            should(0 == expected.compare(message.substr(0,expected.size())));
+        }
+
+        // other files are rejected
+        {
+            std::ofstream other("test_forest.txt");
+            other << "this is not a random forest file";
+        }
+        should(!rf_import_binary(imported, "test_forest.txt"));
+        std::remove("test_forest.txt");
+        std::remove("test_forest.vrf");
+        std::remove("test_forest_float.vrf");
+    }
+};
+
+struct RandomForestTestSuite
+: public vigra::test_suite
+{
+    RandomForestTestSuite()
+    : vigra::test_suite("RandomForestTest")
+    {
+        add(testCase(&RandomForestTest::testParallelLearning));
+        add(testCase(&RandomForestTest::testFeatureTypes));
+        add(testCase(&RandomForestTest::testWeightedStratification));
+        add(testCase(&RandomForestTest::testIncrementalLearning));
+        add(testCase(&RandomForestTest::testIncrementalSplit));
+        add(testCase(&RandomForestTest::testVariableImportance));
+        add(testCase(&RandomForestTest::testClusterImportance));
+        add(testCase(&RandomForestTest::testHistogramSplit));
+        add(testCase(&RandomForestTest::testFlatForest));
+        add(testCase(&RandomForestTest::testChunkedPrediction));
+        add(testCase(&RandomForestTest::testBinaryImpex));
+    }
+};
+
+int main(int argc, char ** argv)
+{
+    RandomForestTestSuite test;
+
+    int failed = test.run(vigra::testsToBeExecuted(argc, argv));
+
+    std::cout << test.report() << std::endl;
+
+    return (failed != 0);
+}
@@ -2136,6 +2136,65 @@ struct ConvolutionTest
         shouldEqualSequenceTolerance(res.begin(), res.end(), comp.begin(), 1e-7);
     }
     
+    template <class T>
+    void checkVectorizedConvolveLine(vigra::Kernel1D<double> k)
+    {
+        static const vigra::BorderTreatmentMode borders[] = {
+            vigra::BORDER_TREATMENT_REFLECT, vigra::BORDER_TREATMENT_REPEAT,
+            vigra::BORDER_TREATMENT_WRAP, vigra::BORDER_TREATMENT_ZEROPAD };
+        int w = 137, n = 5;
+
+        std::vector<T> src(w*n);
+        for(int i = 0; i < w*n; ++i)
+            src[i] = T(std::sin(0.37*i) + 0.01*i);
+
+        for(int b = 0; b < 4; ++b)
+        {
+            k.setBorderTreatment(borders[b]);
+            for(int start = 0; start < 8; start += 7)
+            {
+                int stop = (start == 0) ? w : w - 5;
+                std::vector<T> fast(w, T(-1)), generic(w, T(-1)), interleaved((stop-start)*n);
+
+                // raw pointers use the vectorized code path, std::vector iterators the generic one
+                vigra::convolveLine(&src[0], &src[0] + w, vigra::StandardConstValueAccessor<T>(),
+                                    &fast[0], vigra::StandardValueAccessor<T>(),
+                                    k.center(), vigra::StandardConstAccessor<double>(),
+                                    k.left(), k.right(), k.borderTreatment(), start, stop);
+                vigra::convolveLine(src.begin(), src.begin() + w, vigra::StandardConstValueAccessor<T>(),
+                                    generic.begin(), vigra::StandardValueAccessor<T>(),
+                                    k.center(), vigra::StandardConstAccessor<double>(),
+                                    k.left(), k.right(), k.borderTreatment(), start, stop);
+                shouldEqualSequence(fast.begin(), fast.end(), generic.begin());
+
+                // line 0 of the interleaved array is src[0], src[n], src[2*n], ...
+                std::vector<T> line0(w), res0(w, T(-1));
+                for(int i = 0; i < w; ++i)
+                    line0[i] = src[i*n];
+                vigra::convolveLine(line0.begin(), line0.end(), vigra::StandardConstValueAccessor<T>(),
+                                    res0.begin(), vigra::StandardValueAccessor<T>(),
+                                    k.center(), vigra::StandardConstAccessor<double>(),
+                                    k.left(), k.right(), k.borderTreatment(), start, stop);
+                std::vector<double> tmp((stop-start)*n);
+                vigra::detail::internalConvolveLinesInterleaved(&src[0], w, n, &tmp[0],
+                                    k.center(), k.left(), k.right(), k.borderTreatment(), start, stop);
+                for(int i = start; i < stop; ++i)
+                    shouldEqual(T(tmp[(i-start)*n]), res0[i-start]);
+            }
+        }
+    }
+
+    void vectorizedConvolveLineTest()
+    {
+        vigra::Kernel1D<double> k;
+        k.initGaussian(2.0);
+        checkVectorizedConvolveLine<double>(k);
+        checkVectorizedConvolveLine<float>(k);
+        k.initGaussianDerivative(1.5, 1);
+        checkVectorizedConvolveLine<double>(k);
+        checkVectorizedConvolveLine<float>(k);
+    }
+
     Image constimg, lenna, rampimg, sym_image, unsym_image;
     vigra::Kernel2D<double> sym_kernel, unsym_kernel, line_kernel;
     
@@ -2491,6 +2550,7 @@ struct ConvolutionTestSuite
         add( testCase( &ConvolutionTest::recursiveGradientTest));
         add( testCase( &ConvolutionTest::recursiveSecondDerivativeTest));
         add( testCase( &ConvolutionTest::nonlinearDiffusionTest));
+        add( testCase( &ConvolutionTest::vectorizedConvolveLineTest));
 
         add( testCase( &ResamplingConvolutionTest::testKernelsSpline));
         add( testCase( &ResamplingConvolutionTest::testKernelsGauss));
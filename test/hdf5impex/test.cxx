@@ -41,6 +41,7 @@
 #include "vigra/stdimage.hxx"
 #include "vigra/unittest.hxx"
 #include "vigra/hdf5impex.hxx"
+#include "vigra/multi_array_chunked_hdf5.hxx"
 #include "vigra/multi_array.hxx"
 #include "vigra/multi_impex.hxx"
 
@@ -1109,6 +1110,64 @@ public:
         should (in_data_4_2 == out_data_4);
     }
 
+    void testHDF5FileShuffleCompression()
+    {
+        std::string file_name( "testfile_HDF5File_shuffle.hdf5");
+
+        MultiArray<3, float> out_data(Shape3(20, 30, 40));
+        for (int i = 0; i < out_data.size(); ++i)
+            out_data[i] = std::sin(i / 100.0f);
+
+        HDF5File file (file_name, HDF5File::New);
+
+        // shuffle + deflate only needs HDF5's built-in filters
+        file.write("/shuffled", out_data, Shape3(10, 10, 10), SHUFFLE_ZLIB);
+
+        MultiArray<3, float> in_data(out_data.shape());
+        file.read("/shuffled", in_data);
+        should (in_data == out_data);
+
+        // check that both filters are installed in the right order
+        HDF5Handle plist(H5Dget_create_plist(file.getDatasetHandleShared("/shuffled")),
+                         &H5Pclose, "testHDF5FileShuffleCompression(): cannot get property list.");
+        shouldEqual(H5Pget_nfilters(plist), 2);
+        unsigned int flags = 0;
+        size_t cd_nelmts = 0;
+        shouldEqual(H5Pget_filter2(plist, 0, &flags, &cd_nelmts, 0, 0, 0, 0), H5Z_FILTER_SHUFFLE);
+        shouldEqual(H5Pget_filter2(plist, 1, &flags, &cd_nelmts, 0, 0, 0, 0), H5Z_FILTER_DEFLATE);
+
+        // LZ4 and ZSTD require third-party filter plugins
+        if(H5Zfilter_avail(32015) <= 0)
+        {
+            try
+            {
+                file.write("/zstd", out_data, Shape3(10, 10, 10), ZSTD);
+                failTest("no exception thrown");
+            }
+            catch(ContractViolation & c)
+            {
+                std::string expected("\nPrecondition violation!\nHDF5File: ZSTD compression requires the HDF5 zstd filter plugin.");
+                std::string message(c.what());
+                should(0 == expected.compare(message.substr(0,expected.size())));
+            }
+        }
+        if(H5Zfilter_avail(32004) <= 0)
+        {
+            try
+            {
+                ChunkedArrayHDF5<3, float> chunked(file, "/lz4", HDF5File::New, Shape3(20, 30, 40), 
+                                                   Shape3(16), ChunkedArrayOptions().compression(LZ4));
+                failTest("no exception thrown");
+            }
+            catch(ContractViolation & c)
+            {
+                std::string expected("\nPrecondition violation!\nHDF5File: LZ4 compression requires the HDF5 LZ4 filter plugin.");
+                std::string message(c.what());
+                should(0 == expected.compare(message.substr(0,expected.size())));
+            }
+        }
+    }
+
 
 
 
@@ -1406,6 +1465,7 @@ struct HDF5ImportExportTestSuite : public vigra::test_suite
         add(testCase(&HDF5ExportImportTest::testHDF5FileBlockAccess));
         add(testCase(&HDF5ExportImportTest::testHDF5FileChunks));
         add(testCase(&HDF5ExportImportTest::testHDF5FileCompression));
+        add(testCase(&HDF5ExportImportTest::testHDF5FileShuffleCompression));
         add(testCase(&HDF5ExportImportTest::testHDF5FileBrowsing));
         add(testCase(&HDF5ExportImportTest::testHDF5FileAttributes));
         add(testCase(&HDF5ExportImportTest::testHDF5FileTutorial));
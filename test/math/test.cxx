@@ -2801,6 +2801,43 @@ struct RandomTest
             shouldEqual(randoma(), lasta[k]);
     }
 
+    template <class Random>
+    void checkJumpAhead(Random random, unsigned int skipped, vigra::UInt64 steps)
+    {
+        for(unsigned int k=0; k<skipped; ++k)
+            random();
+        Random jumped(random);
+        jumped.jumpAhead(steps);
+        for(vigra::UInt64 k=0; k<steps; ++k)
+            random();
+        for(unsigned int k=0; k<1000; ++k)
+            shouldEqual(jumped(), random());
+    }
+
+    void testJumpAhead()
+    {
+        vigra::UInt64 steps[] = { 0, 1, 7, 396, 623, 624, 625, 799, 800, 801, 
+                                  19937, 19938, 123457 };
+        for(unsigned int k=0; k<sizeof(steps)/sizeof(steps[0]); ++k)
+        {
+            checkJumpAhead(vigra::RandomMT19937(), 0, steps[k]);
+            checkJumpAhead(vigra::RandomMT19937(0xDEADBEEF), 333, steps[k]);
+            checkJumpAhead(vigra::RandomTT800(), 0, steps[k]);
+            checkJumpAhead(vigra::RandomTT800(0xDEADBEEF), 11, steps[k]);
+        }
+
+        // long jumps compose
+        vigra::UInt64 big = vigra::UInt64(1) << 50;
+        vigra::RandomMT19937 a(42), b(42);
+        a.jumpAhead(big);
+        a.jumpAhead(big + 5);
+        b.jumpAhead(2*big);
+        for(unsigned int k=0; k<5; ++k)
+            b();
+        for(unsigned int k=0; k<1000; ++k)
+            shouldEqual(a(), b());
+    }
+
     void testRandomFunctors()
     {
         const unsigned int n = 50;
@@ -3077,6 +3114,7 @@ struct MathTestSuite
 
         add( testCase(&RandomTest::testTT800));
         add( testCase(&RandomTest::testMT19937));
+        add( testCase(&RandomTest::testJumpAhead));
         add( testCase(&RandomTest::testRandomFunctors));
 
         add( testCase(&PolygonTest::testConvexHull));
@@ -96,50 +96,55 @@ public:
     static ArrayPtr createArray(Shape3 const & shape, 
                                 Shape3 const & chunk_shape,
                                 ChunkedArrayFull<3, T> *,
-                                std::string const & = "chunked_test.h5")
+                                std::string const & = "chunked_test.h5",
+                                ChunkedArrayOptions const & options = ChunkedArrayOptions())
     {
-        return ArrayPtr(new ChunkedArrayFull<3, T>(shape, ChunkedArrayOptions().fillValue(fill_value)));
+        return ArrayPtr(new ChunkedArrayFull<3, T>(shape, options.fillValue(fill_value)));
     }
     
     static ArrayPtr createArray(Shape3 const & shape, 
                                 Shape3 const & chunk_shape,
                                 ChunkedArrayLazy<3, T> *,
-                                std::string const & = "chunked_test.h5")
+                                std::string const & = "chunked_test.h5",
+                                ChunkedArrayOptions const & options = ChunkedArrayOptions())
     {
         return ArrayPtr(new ChunkedArrayLazy<3, T>(shape, chunk_shape, 
-                                                   ChunkedArrayOptions().fillValue(fill_value)));
+                                                   options.fillValue(fill_value)));
     }
     
     static ArrayPtr createArray(Shape3 const & shape, 
                                 Shape3 const & chunk_shape,
                                 ChunkedArrayCompressed<3, T> *,
-                                std::string const & = "chunked_test.h5")
+                                std::string const & = "chunked_test.h5",
+                                ChunkedArrayOptions const & options = ChunkedArrayOptions())
     {
         return ArrayPtr(new ChunkedArrayCompressed<3, T>(shape, chunk_shape, 
-                                                         ChunkedArrayOptions().fillValue(fill_value)
-                                                                              .compression(LZ4)));
+                                                         options.fillValue(fill_value)
+                                                                .compression(LZ4)));
     }
     
 #ifdef HasHDF5
     static ArrayPtr createArray(Shape3 const & shape, 
                                 Shape3 const & chunk_shape,
                                 ChunkedArrayHDF5<3, T> *,
-                                std::string const & name = "chunked_test.h5")
+                                std::string const & name = "chunked_test.h5",
+                                ChunkedArrayOptions const & options = ChunkedArrayOptions())
     {
         HDF5File hdf5_file(name, HDF5File::New);
         return ArrayPtr(new ChunkedArrayHDF5<3, T>(hdf5_file, "test", HDF5File::New, 
                                                    shape, chunk_shape, 
-                                                   ChunkedArrayOptions().fillValue(fill_value)));
+                                                   options.fillValue(fill_value)));
     }
 #endif
     
     static ArrayPtr createArray(Shape3 const & shape, 
                                 Shape3 const & chunk_shape,
                                 ChunkedArrayTmpFile<3, T> *,
-                                std::string const & = "chunked_test.h5")
+                                std::string const & = "chunked_test.h5",
+                                ChunkedArrayOptions const & options = ChunkedArrayOptions())
     {
         return ArrayPtr(new ChunkedArrayTmpFile<3, T>(shape, chunk_shape, 
-                                                      ChunkedArrayOptions().fillValue(fill_value), ""));
+                                                      options.fillValue(fill_value), ""));
     }
     
     void test_construction ()
@@ -780,6 +785,262 @@ public:
         
         shouldEqualSequence(a->begin(), a->end(), ref.begin());
     }
+    
+    static void testMultiThreadedReadRun(BaseArray const * v, int startIndex, int d, int * go, int * errors)
+    {
+        while(*go == 0)
+            threading::this_thread::yield();
+            
+        Shape3 s = v->shape();
+        int sliceSize = s[0]*s[1];
+        
+        typename BaseArray::const_iterator bi(v->cbegin());
+        for(int k=0; k<3; ++k)
+        {
+            for(bi.setDim(2,startIndex); bi.coord(2) < s[2]; bi.addDim(2, d))
+                for(bi.setDim(1,0); bi.coord(1) < s[1]; bi.incDim(1))
+                    for(bi.setDim(0,0); bi.coord(0) < s[0]; bi.incDim(0))
+                        if(*bi != T(bi.coord(2)*sliceSize + bi.coord(1)*s[0] + bi.coord(0)))
+                            ++*errors;
+        }
+    }
+
+    void testMultiThreadedSmallCache()
+    {
+        // chunks are constantly evicted and reloaded by different threads
+        array.reset(0); // close the file if backend is HDF5
+        ArrayPtr a = createArray(Shape3(64, 64, 64), Shape3(16), (Array *)0);
+        linearSequence(a->begin(), a->end());
+        a->setCacheMaxSize(3);
+    
+        int go = 0, errors[4] = {0, 0, 0, 0};
+        
+        threading::thread t1(testMultiThreadedReadRun, a.get(), 0, 4, &go, errors);
+        threading::thread t2(testMultiThreadedReadRun, a.get(), 1, 4, &go, errors+1);
+        threading::thread t3(testMultiThreadedReadRun, a.get(), 2, 4, &go, errors+2);
+        threading::thread t4(testMultiThreadedReadRun, a.get(), 3, 4, &go, errors+3);
+     
+        go = 1;
+     
+        t4.join();
+        t3.join();
+        t2.join();
+        t1.join();
+        
+        shouldEqual(errors[0] + errors[1] + errors[2] + errors[3], 0);
+    }
+        
+    static void accessChunk(BaseArray const & a, int k)
+    {
+        MultiArray<3, T> tmp(Shape3(16));
+        a.checkoutSubarray(Shape3(0, 0, 16*k), tmp);
+    }
+
+    void testCachePolicies()
+    {
+        if(array->cacheMaxSize() == 0)
+            return; // backend doesn't use a cache
+        array.reset(0); // close the file if backend is HDF5
+
+        ChunkCachePolicy policies[3] = { CACHE_FIFO, CACHE_LRU, CACHE_CLOCK };
+        std::size_t hits[3] = { 1, 2, 2 };
+        for(int p=0; p<3; ++p)
+        {
+            // four chunks along the z-axis, but space for only two in the cache
+            ArrayPtr a = createArray(Shape3(16, 16, 64), Shape3(16), (Array *)0, "chunked_test.h5",
+                                     ChunkedArrayOptions().cacheMax(2).cachePolicy(policies[p]));
+            shouldEqual(a->cachePolicy(), policies[p]);
+            linearSequence(a->begin(), a->end());
+            a->releaseChunks(Shape3(0), a->shape());
+            shouldEqual(a->cacheSize(), 0);
+            shouldEqual(a->cacheBytes(), 0);
+            
+            a->resetCacheStatistics();
+            int order[5] = { 0, 1, 0, 2, 0 };
+            for(int k=0; k<5; ++k)
+                accessChunk(*a, order[k]);
+            shouldEqual(a->cacheSize(), 2);
+            // FIFO evicts chunk 0 before its last use, LRU and CLOCK keep it
+            shouldEqual(a->cacheHits(), hits[p]);
+            shouldEqual(a->cacheMisses(), 5 - hits[p]);
+        }
+        
+        // limit the cache by its size in bytes
+        ArrayPtr a = createArray(Shape3(16, 16, 64), Shape3(16), (Array *)0, "chunked_test.h5",
+                                 ChunkedArrayOptions().cacheMax(10));
+        linearSequence(a->begin(), a->end());
+        shouldEqual(a->cacheSize(), 4);
+        std::size_t chunkBytes = a->cacheBytes() / 4;
+        should(chunkBytes >= a->dataBytesPerChunk());
+        a->setCacheMaxBytes(2*chunkBytes + chunkBytes / 2);
+        shouldEqual(a->cacheSize(), 2);
+        for(int k=0; k<4; ++k)
+            accessChunk(*a, k);
+        shouldEqual(a->cacheSize(), 2);
+        shouldEqual(a->cacheBytes(), 2*chunkBytes);
+        
+        PlainArray ref(a->shape());
+        linearSequence(ref.begin(), ref.end());
+        shouldEqualSequence(a->cbegin(), a->cend(), ref.begin());
+    }
+        
+    void testPrefetch()
+    {
+        if(array->cacheMaxSize() == 0)
+            return; // backend doesn't unload chunks
+        array.reset(0); // close the file if backend is HDF5
+        
+        PlainArray ref(Shape3(16, 16, 64));
+        linearSequence(ref.begin(), ref.end());
+        
+        for(int threads=0; threads<3; threads+=2)
+        {
+            ArrayPtr a = createArray(ref.shape(), Shape3(16), (Array *)0, "chunked_test.h5",
+                                     ChunkedArrayOptions().cacheMax(4).prefetchThreads(threads));
+            linearSequence(a->begin(), a->end());
+            a->releaseChunks(Shape3(0), a->shape());
+            
+            // load the last three chunks in the background
+            a->resetCacheStatistics();
+            a->prefetch(Shape3(0, 0, 20), a->shape());
+            a->waitForPrefetch();
+            shouldEqual(a->cacheSize(), 3);
+            shouldEqual(a->cacheMisses(), 3);
+            shouldEqual(a->cacheHits(), 0);
+            
+            MultiArray<3, T> tmp(Shape3(16, 16, 44));
+            a->checkoutSubarray(Shape3(0, 0, 20), tmp);
+            shouldEqualSequence(tmp.begin(), tmp.end(), ref.subarray(Shape3(0, 0, 20), ref.shape()).begin());
+            shouldEqual(a->cacheMisses(), 3);
+            
+            // let the chunk iterator load the next chunks ahead of time
+            a->releaseChunks(Shape3(0), a->shape());
+            a->resetCacheStatistics();
+            {
+                typename BaseArray::chunk_const_iterator i = a->chunk_cbegin(Shape3(0), a->shape()), 
+                                                         end = a->chunk_cend(Shape3(0), a->shape());
+                for(i.prefetch(2); i != end; ++i)
+                    should(*i == ref.subarray(i.chunkStart(), i.chunkStop()));
+            }
+            a->waitForPrefetch();
+            shouldEqual(a->cacheMisses(), 4);
+        }
+    }
+    
+    void testShuffleCompression()
+    {
+        if(!IsSameType<Array, ChunkedArrayCompressed<3, T> >::value)
+            return; // only ChunkedArrayCompressed supports shuffling
+        
+        PlainArray ref(Shape3(16, 16, 64));
+        linearSequence(ref.begin(), ref.end());
+        
+        ChunkedArrayCompressed<3, T> a(ref.shape(), Shape3(16), 
+                                       ChunkedArrayOptions().compression(SHUFFLE_LZ4).cacheMax(1));
+        shouldEqual(a.backend(), "ChunkedArrayCompressed<SHUFFLE_LZ4>");
+        
+        linearSequence(a.begin(), a.end());
+        a.releaseChunks(Shape3(0), a.shape());
+        
+        MultiArray<3, T> tmp(ref.shape());
+        a.checkoutSubarray(Shape3(0), tmp);
+        shouldEqualSequence(tmp.begin(), tmp.end(), ref.begin());
+    }
+    
+    void testCompressionThreads()
+    {
+        if(!IsSameType<Array, ChunkedArrayCompressed<3, T> >::value)
+            return; // only ChunkedArrayCompressed uses compression threads
+        typedef ChunkedArrayCompressed<3, T> CompressedArray;
+        typedef typename CompressedArray::Chunk Chunk;
+        
+        PlainArray ref(Shape3(16, 16, 64));
+        linearSequence(ref.begin(), ref.end());
+        
+        for(int threads=0; threads<5; threads+=4)
+        {
+            // blocks of 1000 bytes => several blocks per chunk, the last one incomplete
+            CompressedArray a(ref.shape(), Shape3(16), 
+                              ChunkedArrayOptions().compression(LZ4)
+                                                   .cacheMax(1)
+                                                   .compressionThreads(threads)
+                                                   .compressionBlockSize(1000));
+            shouldEqual(a.backgroundUnloadThreads(), threads == 0 ? 0 : 1);
+            
+            linearSequence(a.begin(), a.end());
+            a.waitForUnloading();
+            
+            Chunk * chunk = static_cast<Chunk *>(a.handle_array_[Shape3(0, 0, 1)].pointer_);
+            should(chunk->pointer_ == 0);
+            shouldEqual(chunk->block_ends_.size(), (16*16*16*sizeof(T) + 999) / 1000);
+            
+            MultiArray<3, T> tmp(ref.shape());
+            a.checkoutSubarray(Shape3(0), tmp);
+            shouldEqualSequence(tmp.begin(), tmp.end(), ref.begin());
+            
+            a.releaseChunks(Shape3(0), a.shape());
+            tmp.init(T());
+            a.checkoutSubarray(Shape3(0), tmp);
+            shouldEqualSequence(tmp.begin(), tmp.end(), ref.begin());
+        }
+        
+        MultiArray<3, T> block(Shape3(16), T(1));
+        {
+            // block the background thread, so that we can observe the pending eviction
+            // (unlike setItem(), commitSubarray() puts the chunks into the cache)
+            CompressedArray a(ref.shape(), Shape3(16), 
+                              ChunkedArrayOptions().compression(LZ4)
+                                                   .cacheMax(1)
+                                                   .compressionThreads(4)
+                                                   .compressionBlockSize(1000));
+            a.commitSubarray(Shape3(0, 0, 0), block);
+            a.commitSubarray(Shape3(0, 0, 16), block);  // creates the unload pool
+            a.waitForUnloading();
+            
+            threading::atomic_long blocked(1);
+            a.unload_pool_->enqueue(
+                [&blocked](int)
+                {
+                    while(blocked.load() != 0)
+                        threading::this_thread::yield();
+                });
+            a.commitSubarray(Shape3(0, 0, 32), block);  // evicts chunk 1 in the background
+            BaseArray & base = a;
+            std::size_t pendingBytes = base.dataBytes();
+            shouldEqual(a.handle_array_[Shape3(0, 0, 1)].chunk_state_.load(), 
+                        (long)CompressedArray::chunk_locked);
+            shouldEqual(pendingBytes, 2*16*16*16*sizeof(T) + a.dataBytes(a.handle_array_[Shape3(0)].pointer_));
+            blocked.store(0);
+            a.waitForUnloading();
+            should(base.dataBytes() < pendingBytes);
+            shouldEqual(a.handle_array_[Shape3(0, 0, 1)].chunk_state_.load(), 
+                        (long)CompressedArray::chunk_asleep);
+        }
+        
+        {
+            // errors in the background thread are re-thrown by waitForUnloading()
+            CompressedArray a(ref.shape(), Shape3(16), 
+                              ChunkedArrayOptions().compression(CompressionMethod(99))
+                                                   .cacheMax(1)
+                                                   .compressionThreads(4));
+            a.commitSubarray(Shape3(0, 0, 0), block);
+            a.commitSubarray(Shape3(0, 0, 16), block);  // evicts chunk 0 in the background
+            try
+            {
+                a.waitForUnloading();
+                failTest("no exception thrown");
+            }
+            catch(ContractViolation & c)
+            {
+                std::string expected("\nPrecondition violation!\ncompress(): Unknown compression method.");
+                std::string message(c.what());
+                should(0 == expected.compare(message.substr(0,expected.size())));
+            }
+            shouldEqual(a.handle_array_[Shape3(0)].chunk_state_.load(), 
+                        (long)CompressedArray::chunk_failed);
+            a.waitForUnloading(); // the error is only reported once
+        }
+    }
         
     // void testIsUnstrided()
     // {
@@ -1524,6 +1785,11 @@ struct ChunkedMultiArrayTestSuite
         add( testCase( &ChunkedMultiArrayTest<Array>::test_iterator ) );
         add( testCase( &ChunkedMultiArrayTest<Array>::testChunkIterator ) );
         add( testCase( &ChunkedMultiArrayTest<Array>::testMultiThreaded ) );
+        add( testCase( &ChunkedMultiArrayTest<Array>::testMultiThreadedSmallCache ) );
+        add( testCase( &ChunkedMultiArrayTest<Array>::testCachePolicies ) );
+        add( testCase( &ChunkedMultiArrayTest<Array>::testPrefetch ) );
+        add( testCase( &ChunkedMultiArrayTest<Array>::testShuffleCompression ) );
+        add( testCase( &ChunkedMultiArrayTest<Array>::testCompressionThreads ) );
     }
     
     template <class T>
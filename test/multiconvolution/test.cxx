@@ -47,6 +47,8 @@
 #include "vigra/unittest.hxx"
 #include "vigra/multi_array.hxx"
 #include "vigra/multi_convolution.hxx"
+#include "vigra/multi_blockwise.hxx"
+#include "vigra/multi_array_chunked.hxx"
 #include "vigra/basicimageview.hxx"
 #include "vigra/convolution.hxx" 
 #include "vigra/navigator.hxx"
@@ -1297,6 +1299,290 @@ struct MultiArraySeparableConvolutionScaledTestSuite : public vigra::test_suite
 
 //--------------------------------------------------------
 
+struct BlockwiseConvolutionTest
+{
+    typedef MultiArray<3, float> Volume;
+    typedef MultiArray<3, double> DVolume;
+
+    Volume src;
+
+    BlockwiseConvolutionTest()
+    : src(Shape3(31, 27, 23))
+    {
+        for(int k=0; k<src.size(); ++k)
+            src[k] = (float)randomMT19937().uniform();
+    }
+
+    template <class Array>
+    void checkEqual(Array const & a, Array const & b)
+    {
+        shouldEqual(a.shape(), b.shape());
+        for(int k=0; k<a.size(); ++k)
+            shouldEqual(a[k], b[k]);
+    }
+
+    BlockwiseConvolutionOptions<3> options(int block)
+    {
+        BlockwiseConvolutionOptions<3> opt;
+        opt.blockShape(block).numThreads(4);
+        return opt;
+    }
+
+    void testSeparableConvolve()
+    {
+        Kernel1D<double> gauss, deriv;
+        gauss.initGaussian(1.5);
+        deriv.initGaussianDerivative(2.0, 1);
+        ArrayVector<Kernel1D<double> > kernels(3, gauss);
+        kernels[1] = deriv;
+
+        Volume ref(src.shape()), res(src.shape());
+        separableConvolveMultiArray(src, ref, kernels.begin());
+
+        int blocks[] = { 1, 5, 8, 13, 100 };
+        for(int b=0; b<5; ++b)
+        {
+            res.init(0.0f);
+            separableConvolveMultiArray(src, res, kernels.begin(), options(blocks[b]));
+            checkEqual(ref, res);
+        }
+
+        // anisotropic block shape and repeat border treatment
+        for(int k=0; k<3; ++k)
+            kernels[k].setBorderTreatment(BORDER_TREATMENT_REPEAT);
+        separableConvolveMultiArray(src, ref, kernels.begin());
+        BlockwiseConvolutionOptions<3> opt;
+        opt.blockShape(Shape3(7, 30, 4));
+        separableConvolveMultiArray(src, res, kernels.begin(), opt);
+        checkEqual(ref, res);
+
+        // double precision output works directly in the temporary
+        DVolume dref(src.shape()), dres(src.shape());
+        separableConvolveMultiArray(src, dref, gauss);
+        separableConvolveMultiArray(src, dres, gauss, options(6));
+        checkEqual(dref, dres);
+
+        kernels[0].setBorderTreatment(BORDER_TREATMENT_WRAP);
+        try
+        {
+            separableConvolveMultiArray(src, res, kernels.begin(), options(6));
+            failTest("no exception thrown");
+        }
+        catch(PreconditionViolation &) {}
+    }
+
+    void testGaussianSmoothing()
+    {
+        Volume ref(src.shape()), res(src.shape());
+
+        gaussianSmoothMultiArray(src, ref, 2.0);
+        gaussianSmoothMultiArray(src, res, 2.0, options(9));
+        checkEqual(ref, res);
+
+        // anisotropic data with a smaller filter window
+        ConvolutionOptions<3> copt;
+        copt.stepSize(1.0, 1.0, 2.5).filterWindowSize(2.0);
+        gaussianSmoothMultiArray(src, ref, 2.0, copt);
+        BlockwiseConvolutionOptions<3> opt(copt);
+        opt.blockShape(Shape3(10, 6, 5));
+        gaussianSmoothMultiArray(src, res, 2.0, opt);
+        checkEqual(ref, res);
+
+        // ROI: compare with the corresponding part of the full result
+        gaussianSmoothMultiArray(src, ref, 1.0);
+        Volume roi(Shape3(20, 10, 8));
+        opt = options(4);
+        opt.subarray(Shape3(5, 7, 9), Shape3(25, 17, 17));
+        gaussianSmoothMultiArray(src, roi, 1.0, opt);
+        checkEqual(Volume(ref.subarray(Shape3(5, 7, 9), Shape3(25, 17, 17))), roi);
+    }
+
+    void testGaussianGradient()
+    {
+        MultiArray<3, TinyVector<float, 3> > ref(src.shape()), res(src.shape());
+        gaussianGradientMultiArray(src, ref, 1.5);
+        gaussianGradientMultiArray(src, res, 1.5, options(8));
+        checkEqual(ref, res);
+    }
+
+    void testHessian()
+    {
+        MultiArray<3, TinyVector<float, 6> > ref(src.shape()), res(src.shape());
+        hessianOfGaussianMultiArray(src, ref, 1.5);
+        hessianOfGaussianMultiArray(src, res, 1.5, options(11));
+        checkEqual(ref, res);
+    }
+
+    void testStructureTensor()
+    {
+        MultiArray<3, TinyVector<float, 6> > ref(src.shape()), res(src.shape());
+        structureTensorMultiArray(src, ref, 1.0, 2.0);
+        structureTensorMultiArray(src, res, 1.0, 2.0, options(7));
+        checkEqual(ref, res);
+
+        MultiArray<2, float> src2(Shape2(60, 45));
+        for(int k=0; k<src2.size(); ++k)
+            src2[k] = (float)randomMT19937().uniform();
+        MultiArray<2, TinyVector<float, 3> > ref2(src2.shape()), res2(src2.shape());
+        structureTensorMultiArray(src2, ref2, 1.5, 3.0);
+        BlockwiseConvolutionOptions<2> opt;
+        opt.blockShape(Shape2(16, 9));
+        structureTensorMultiArray(src2, res2, 1.5, 3.0, opt);
+        checkEqual(ref2, res2);
+    }
+
+    template <class T>
+    MultiArray<3, T> checkout(ChunkedArray<3, T> const & a)
+    {
+        MultiArray<3, T> res(a.shape());
+        a.checkoutSubarray(Shape3(), res);
+        return res;
+    }
+
+    void testChunkedConvolution()
+    {
+        ChunkedArrayLazy<3, float> csrc(src.shape(), Shape3(8));
+        csrc.commitSubarray(Shape3(), src);
+
+        BlockwiseConvolutionOptions<3> opt;
+        opt.numThreads(4);
+
+        {
+            // small cache, so that chunks get compressed and reloaded
+            ChunkedArrayCompressed<3, float> cres(src.shape(), Shape3(8), ChunkedArrayOptions().cacheMax(4));
+            Volume ref(src.shape());
+            gaussianSmoothMultiArray(src, ref, 2.0);
+            gaussianSmoothMultiArray(csrc, cres, 2.0, opt);
+            checkEqual(ref, checkout(cres));
+            should(cres.cacheSize() <= 4);
+
+            // block shape different from the chunk shape
+            Kernel1D<double> deriv;
+            deriv.initGaussianDerivative(1.0, 1);
+            separableConvolveMultiArray(src, ref, deriv);
+            BlockwiseConvolutionOptions<3> opt2(opt);
+            opt2.blockShape(Shape3(5, 20, 7));
+            separableConvolveMultiArray(csrc, cres, deriv, opt2);
+            checkEqual(ref, checkout(cres));
+        }
+        {
+            MultiArray<3, TinyVector<float, 3> > ref(src.shape());
+            ChunkedArrayLazy<3, TinyVector<float, 3> > cres(src.shape(), Shape3(16));
+            gaussianGradientMultiArray(src, ref, 1.5);
+            gaussianGradientMultiArray(csrc, cres, 1.5, opt);
+            checkEqual(ref, checkout(cres));
+        }
+        {
+            MultiArray<3, TinyVector<float, 6> > ref(src.shape());
+            ChunkedArrayLazy<3, TinyVector<float, 6> > cres(src.shape(), Shape3(16));
+            hessianOfGaussianMultiArray(src, ref, 1.5);
+            hessianOfGaussianMultiArray(csrc, cres, 1.5, opt);
+            checkEqual(ref, checkout(cres));
+
+            structureTensorMultiArray(src, ref, 1.0, 2.0);
+            structureTensorMultiArray(csrc, cres, 1.0, 2.0, opt);
+            checkEqual(ref, checkout(cres));
+        }
+    }
+
+    void testChunkedDistance()
+    {
+        MultiArray<3, UInt8> mask(src.shape());
+        for(int k=0; k<src.size(); ++k)
+            mask[k] = src[k] < 0.02f ? 1 : 0;
+
+        ChunkedArrayLazy<3, UInt8> cmask(mask.shape(), Shape3(8));
+        cmask.commitSubarray(Shape3(), mask);
+
+        BlockwiseOptions opt;
+        opt.numThreads(4);
+
+        TinyVector<double, 3> pitch(1.0, 1.0, 2.0), realPitch(1.0, 1.5, 0.8);
+        for(int background=0; background<2; ++background)
+        {
+            // works directly in the destination
+            Volume ref(src.shape());
+            ChunkedArrayCompressed<3, float> cres(src.shape(), Shape3(8), ChunkedArrayOptions().cacheMax(8));
+            separableMultiDistSquared(mask, ref, background == 1, pitch);
+            separableMultiDistSquared(cmask, cres, background == 1, pitch, opt);
+            checkEqual(ref, checkout(cres));
+
+            separableMultiDistance(mask, ref, background == 1);
+            separableMultiDistance(cmask, cres, background == 1, opt);
+            checkEqual(ref, checkout(cres));
+
+            // requires a temporary array
+            separableMultiDistance(mask, ref, background == 1, realPitch);
+            separableMultiDistance(cmask, cres, background == 1, realPitch, opt);
+            checkEqual(ref, checkout(cres));
+
+            MultiArray<3, UInt8> ref8(src.shape());
+            ChunkedArrayLazy<3, UInt8> cres8(src.shape(), Shape3(16, 4, 8));
+            separableMultiDistance(mask, ref8, background == 1);
+            separableMultiDistance(cmask, cres8, background == 1, opt);
+            checkEqual(ref8, checkout(cres8));
+        }
+    }
+
+    void testParallelDistance()
+    {
+        MultiArray<3, UInt8> mask(src.shape());
+        for(int k=0; k<src.size(); ++k)
+            mask[k] = src[k] < 0.02f ? 1 : 0;
+
+        BlockwiseOptions opt;
+        opt.blockShape(Shape3(16, 8, 4)).numThreads(4);
+
+        TinyVector<double, 3> pitch(1.0, 1.0, 2.0), realPitch(1.0, 1.5, 0.8);
+        for(int background=0; background<2; ++background)
+        {
+            // works directly in the destination
+            Volume ref(src.shape()), res(src.shape());
+            separableMultiDistSquared(mask, ref, background == 1, pitch);
+            separableMultiDistSquared(mask, res, background == 1, pitch, opt);
+            checkEqual(ref, res);
+
+            separableMultiDistance(mask, ref, background == 1);
+            separableMultiDistance(mask, res, background == 1, opt);
+            checkEqual(ref, res);
+
+            // requires a temporary array
+            separableMultiDistance(mask, ref, background == 1, realPitch);
+            separableMultiDistance(mask, res, background == 1, realPitch, BlockwiseOptions().numThreads(3));
+            checkEqual(ref, res);
+
+            MultiArray<3, UInt8> ref8(src.shape()), res8(src.shape());
+            separableMultiDistance(mask, ref8, background == 1);
+            separableMultiDistance(mask, res8, background == 1, opt);
+            checkEqual(ref8, res8);
+
+            // strided views
+            separableMultiDistance(mask.transpose(), ref.transpose(), background == 1, realPitch);
+            separableMultiDistance(mask.transpose(), res.transpose(), background == 1, realPitch, opt);
+            checkEqual(ref, res);
+        }
+    }
+};
+
+struct BlockwiseConvolutionTestSuite
+: public vigra::test_suite
+{
+    BlockwiseConvolutionTestSuite()
+    : vigra::test_suite("BlockwiseConvolutionTestSuite")
+    {
+        add( testCase( &BlockwiseConvolutionTest::testSeparableConvolve ) );
+        add( testCase( &BlockwiseConvolutionTest::testGaussianSmoothing ) );
+        add( testCase( &BlockwiseConvolutionTest::testGaussianGradient ) );
+        add( testCase( &BlockwiseConvolutionTest::testHessian ) );
+        add( testCase( &BlockwiseConvolutionTest::testStructureTensor ) );
+        add( testCase( &BlockwiseConvolutionTest::testChunkedConvolution ) );
+        add( testCase( &BlockwiseConvolutionTest::testChunkedDistance ) );
+        add( testCase( &BlockwiseConvolutionTest::testParallelDistance ) );
+    }
+};
+
+//--------------------------------------------------------
+
 int main(int argc, char ** argv)
 {
     // run the multi-array separable convolution test suite
@@ -1309,5 +1595,10 @@ int main(int argc, char ** argv)
     failed += test2.run(vigra::testsToBeExecuted(argc, argv));
     std::cout << test2.report() << std::endl;
 
+    // run the blockwise parallel convolution test suite
+    BlockwiseConvolutionTestSuite test3;
+    failed += test3.run(vigra::testsToBeExecuted(argc, argv));
+    std::cout << test3.report() << std::endl;
+
     return (failed != 0);
 }
@@ -41,6 +41,8 @@
 #include <vigra/unittest.hxx>
 #include <vigra/multi_array.hxx>
 #include <vigra/accumulator.hxx>
+#include <vigra/blockwise_features.hxx>
+#include <vigra/random.hxx>
 
 namespace std {
 
@@ -1433,6 +1435,199 @@ struct AccumulatorTest
             shouldEqual(W(3, 0, 1), get<AutoRangeHistogram<3> >(c,3));
         }
     }
+
+    template <class A>
+    void checkBlockwiseFeatures(A const & a, A const & b)
+    {
+        using namespace vigra::acc;
+
+        shouldEqual(a.maxRegionLabel(), b.maxRegionLabel());
+        shouldEqual(get<Global<Count> >(a), get<Global<Count> >(b));
+        shouldEqualTolerance(get<Global<Mean> >(a), get<Global<Mean> >(b), 1e-10);
+        for(int k=0; k<=a.maxRegionLabel(); ++k)
+        {
+            shouldEqual(get<Count>(a, k), get<Count>(b, k));
+            if(get<Count>(a, k) == 0.0)
+                continue;
+            shouldEqual(get<Minimum>(a, k), get<Minimum>(b, k));
+            shouldEqual(get<Maximum>(a, k), get<Maximum>(b, k));
+            shouldEqualTolerance(get<Mean>(a, k), get<Mean>(b, k), 1e-10);
+            shouldEqualTolerance(get<Variance>(a, k), get<Variance>(b, k), 1e-10);
+            shouldEqualTolerance(get<Skewness>(a, k), get<Skewness>(b, k), 1e-8);
+            shouldEqualSequenceTolerance(get<RegionCenter>(a, k).begin(), get<RegionCenter>(a, k).end(),
+                                         get<RegionCenter>(b, k).begin(), 1e-10);
+            shouldEqual(get<Coord<Minimum> >(a, k), get<Coord<Minimum> >(b, k));
+            shouldEqual(get<Coord<Maximum> >(a, k), get<Coord<Maximum> >(b, k));
+        }
+    }
+
+
+    void testSparseLabels()
+    {
+        using namespace vigra::acc;
+
+        typedef MultiArrayShape<3>::type Shape;
+        typedef AccumulatorChainArray<CoupledArrays<3, double, int>,
+                                      Select<DataArg<1>, LabelArg<2>,
+                                             Count, Minimum, Maximum, Mean, Variance, Skewness,
+                                             RegionCenter, Coord<Minimum>, Coord<Maximum>,
+                                             Global<Count>, Global<Mean> > > Dense;
+        typedef AccumulatorChainArray<CoupledArrays<3, double, Int64>,
+                                      Select<DataArg<1>, LabelArg<2>,
+                                             Count, Minimum, Maximum, Mean, Variance, Skewness,
+                                             RegionCenter, Coord<Minimum>, Coord<Maximum>,
+                                             Global<Count>, Global<Mean> > > Sparse;
+
+        Shape shape(23, 31, 17);
+        MultiArray<3, double> data(shape);
+        MultiArray<3, int> labels(shape);
+        MultiArray<3, Int64> sparseLabels(shape);
+        MersenneTwister random;
+        for(int k=0; k<data.size(); ++k)
+        {
+            Shape p = data.scanOrderIndexToCoordinate(k);
+            data[k] = random.uniform();
+            labels[k] = p[0] / 5 + 5*(p[1] / 7) + 25*(p[2] / 4);
+            // labels with block offsets that would need terabytes in dense mode
+            sparseLabels[k] = labels[k] + (Int64(labels[k] % 3) << 40);
+        }
+
+        Dense ref;
+        extractFeatures(data, labels, ref);
+
+        Sparse a;
+        a.setSparseLabels();
+        should(a.sparseLabels());
+        extractFeatures(data, sparseLabels, a);
+
+        Sparse b;
+        b.setSparseLabels();
+        extractFeatures(data, sparseLabels, b, ParallelOptions().numThreads(3));
+
+        shouldEqual(a.regionCount(), ref.regionCount());
+        shouldEqual(a.maxRegionLabel(), (Int64(2) << 40) + 122);
+        shouldEqual(b.regionCount(), ref.regionCount());
+        shouldEqual(get<Global<Count> >(a), get<Global<Count> >(ref));
+        should(!a.hasRegion(1));
+        should(a.hasRegion(a.regionLabel(0)));
+        try
+        {
+            get<Count>(a, 1);
+            failTest("no exception thrown");
+        }
+        catch(vigra::ContractViolation & c)
+        {
+            std::string expected("\nPrecondition violation!\nAccumulatorChainArray: region label not found.");
+            std::string message(c.what());
+            should(0 == expected.compare(message.substr(0,expected.size())));
+        }
+
+        for(unsigned int k=0; k<a.regionCount(); ++k)
+        {
+            Int64 l = a.regionLabel(k);
+            int d = int(l & ((Int64(1) << 40) - 1));
+            shouldEqual(l, d + (Int64(d % 3) << 40));
+            shouldEqual(get<Count>(a, l), get<Count>(ref, d));
+            shouldEqual(get<Count>(b, l), get<Count>(ref, d));
+            shouldEqual(get<Minimum>(a, l), get<Minimum>(ref, d));
+            shouldEqual(get<Maximum>(b, l), get<Maximum>(ref, d));
+            shouldEqualTolerance(get<Mean>(a, l), get<Mean>(ref, d), 1e-14);
+            shouldEqualTolerance(get<Mean>(b, l), get<Mean>(ref, d), 1e-10);
+            shouldEqualTolerance(get<Variance>(a, l), get<Variance>(ref, d), 1e-14);
+            shouldEqualTolerance(get<Skewness>(b, l), get<Skewness>(ref, d), 1e-8);
+            shouldEqual(get<RegionCenter>(a, l), get<RegionCenter>(ref, d));
+            shouldEqual(get<Coord<Minimum> >(b, l), get<Coord<Minimum> >(ref, d));
+        }
+
+        // merge two regions
+        Int64 l0 = a.regionLabel(0), l1 = a.regionLabel(1);
+        double count = get<Count>(a, l0) + get<Count>(a, l1);
+        a.merge(l0, l1);
+        shouldEqual(get<Count>(a, l0), count);
+        shouldEqual(get<Count>(a, l1), 0.0);
+
+        // merge with a sparse label mapping: shift every region of b by one block offset
+        std::map<Int64, Int64> labelMapping;
+        for(unsigned int k=0; k<b.regionCount(); ++k)
+            labelMapping[b.regionLabel(k)] = b.regionLabel(k) + (Int64(3) << 40);
+        Sparse shifted;
+        shifted.setSparseLabels();
+        shifted.merge(b, labelMapping);
+        shouldEqual(shifted.regionCount(), b.regionCount());
+        for(unsigned int k=0; k<b.regionCount(); ++k)
+        {
+            Int64 l = b.regionLabel(k);
+            shouldEqual(get<Count>(shifted, l + (Int64(3) << 40)), get<Count>(b, l));
+            shouldEqual(get<Minimum>(shifted, l + (Int64(3) << 40)), get<Minimum>(b, l));
+        }
+
+        // all regions of the RHS must be mapped
+        labelMapping.erase(b.regionLabel(0));
+        try
+        {
+            shifted.merge(b, labelMapping);
+            failTest("no exception thrown");
+        }
+        catch(vigra::ContractViolation & c)
+        {
+            std::string expected("\nPrecondition violation!\nAccumulatorChainArray::merge(): region label of RHS not found in labelMapping.");
+            std::string message(c.what());
+            should(0 == expected.compare(message.substr(0,expected.size())));
+        }
+        shouldEqual(get<Count>(shifted, b.regionLabel(1) + (Int64(3) << 40)), get<Count>(b, b.regionLabel(1)));
+    }
+
+    void testBlockwiseFeatures()
+    {
+        using namespace vigra::acc;
+
+        typedef MultiArrayShape<3>::type Shape;
+        typedef AccumulatorChainArray<CoupledArrays<3, double, int>,
+                                      Select<DataArg<1>, LabelArg<2>,
+                                             Count, Minimum, Maximum, Mean, Variance, Skewness,
+                                             RegionCenter, Coord<Minimum>, Coord<Maximum>,
+                                             Global<Count>, Global<Mean> > > A;
+
+        Shape shape(37, 45, 29);
+        MultiArray<3, double> data(shape);
+        MultiArray<3, int> labels(shape);
+        MersenneTwister random;
+        for(int k=0; k<data.size(); ++k)
+        {
+            Shape p = data.scanOrderIndexToCoordinate(k);
+            data[k] = random.uniform();
+            // more regions at larger z, some regions don't occur
+            labels[k] = p[0] / 10 + 4*(p[1] / 8) + 24*(p[2] / 3) + 2*(p[2] / 15);
+        }
+
+        A ref;
+        extractFeatures(data, labels, ref);
+
+        {
+            A a;
+            extractFeatures(data, labels, a, ParallelOptions().numThreads(4));
+            checkBlockwiseFeatures(a, ref);
+        }
+        {
+            A a;
+            extractFeatures(data, labels, a, ParallelOptions().numThreads(1));
+            checkBlockwiseFeatures(a, ref);
+        }
+        {
+            ChunkedArrayLazy<3, double> cdata(shape, Shape(16, 8, 4));
+            ChunkedArrayLazy<3, int> clabels(shape, Shape(16, 8, 4));
+            cdata.commitSubarray(Shape(), data);
+            clabels.commitSubarray(Shape(), labels);
+
+            A a;
+            extractFeatures(cdata, clabels, a, BlockwiseOptions().numThreads(4));
+            checkBlockwiseFeatures(a, ref);
+
+            A b;
+            extractFeatures(cdata, clabels, b, BlockwiseOptions().blockShape(Shape(32, 16, 8)).numThreads(1));
+            checkBlockwiseFeatures(b, ref);
+        }
+    }
 };
 
 struct FeaturesTestSuite : public vigra::test_suite
@@ -1449,6 +1644,8 @@ struct FeaturesTestSuite : public vigra::test_suite
         add(testCase(&AccumulatorTest::testHistogram));
         add(testCase(&AccumulatorTest::testLabelDispatch));
         add(testCase(&AccumulatorTest::testIndexSpecifiers));
+        add(testCase(&AccumulatorTest::testBlockwiseFeatures));
+        add(testCase(&AccumulatorTest::testSparseLabels));
     }
 };
 
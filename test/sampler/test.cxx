@@ -70,6 +70,8 @@ struct SamplerTests
     void testStratifiedSamplingWithReplacement();
     void testSamplingWithoutReplacementChi2();
     void testSamplingWithReplacementChi2();
+    void testAliasTable();
+    void testWeightedStrataSampling();
     
     void testSamplingImpl(bool withReplacement);
     void testStratifiedSamplingImpl(bool withReplacement);
@@ -404,6 +406,123 @@ void SamplerTests::testSamplingWithReplacementChi2()
     }
 }
 
+void SamplerTests::testAliasTable()
+{
+    double weights[] = { 1.0, 0.0, 3.0, 0.5, 2.5, 1.0 };
+    int size = 6;
+    AliasTable table(weights, weights + size);
+    shouldEqual(table.size(), size);
+
+    RandomMT19937 random(42);
+    int drawCount = 60000;
+    ArrayVector<double> observed(size, 0.0);
+    for(int k = 0; k < drawCount; ++k)
+        observed[table(random)] += 1.0;
+
+    shouldEqual(observed[1], 0.0);
+    double chi_squared = 0.0;
+    for(int k = 0; k < size; ++k)
+    {
+        if(weights[k] == 0.0)
+            continue;
+        double expected = drawCount * weights[k] / 8.0;
+        chi_squared += sq(observed[k] - expected) / expected;
+    }
+    // check that we are in the 80% quantile of the expected distribution
+    shouldEqualTolerance (0, chi2CDF(4, chi_squared)-0.5, 0.4);
+
+    // a single weight and equal weights
+    double one = 2.0;
+    AliasTable single(&one, &one + 1);
+    for(int k = 0; k < 10; ++k)
+        shouldEqual(single(random), 0);
+
+    ArrayVector<double> equal(5, 1.0);
+    table.init(equal.begin(), equal.end());
+    shouldEqual(table.size(), 5);
+    ArrayVector<int> counts(5, 0);
+    for(int k = 0; k < 1000; ++k)
+        ++counts[table(random)];
+    for(int k = 0; k < 5; ++k)
+        should(counts[k] > 0);
+
+    double negative[] = { 1.0, -1.0 };
+    try
+    {
+        table.init(negative, negative + 2);
+        failTest("AliasTable::init() failed to throw on negative weights.");
+    }
+    catch(PreconditionViolation &) {}
+}
+
+void SamplerTests::testWeightedStrataSampling()
+{
+    // strata of size 10, 50, 40 with labels 3, 7, 9
+    int totalDataCount = 100;
+    ArrayVector<int> strata(totalDataCount);
+    for(int ii = 0; ii < totalDataCount; ++ii)
+        strata[ii] = ii < 10 ? 3 : ii < 60 ? 7 : 9;
+
+    ArrayVector<double> weights(3);
+    weights[0] = 2.0; weights[1] = 1.0; weights[2] = 1.0;
+
+    RandomMT19937 random(1);
+    int sampleSize = 40000;
+    Sampler<RandomMT19937> sampler(strata.begin(), strata.end(),
+        SamplerOptions().withReplacement().stratumWeights(weights).sampleSize(sampleSize), 
+        &random);
+    shouldEqual(sampler.sampleSize(), sampleSize);
+    shouldEqual(sampler.strataCount(), 3);
+    sampler.sample();
+
+    // stratum counts follow the weights, elements are uniform within each stratum
+    ArrayVector<double> strataCounts(3, 0.0), elementCounts(totalDataCount, 0.0);
+    for(int ii = 0; ii < sampleSize; ++ii)
+    {
+        int index = sampler[ii];
+        should(index >= 0 && index < totalDataCount);
+        strataCounts[strata[index] == 3 ? 0 : strata[index] == 7 ? 1 : 2] += 1.0;
+        elementCounts[index] += 1.0;
+    }
+    double chi_squared = 0.0;
+    for(int k = 0; k < 3; ++k)
+    {
+        double expected = sampleSize * weights[k] / 4.0;
+        chi_squared += sq(strataCounts[k] - expected) / expected;
+    }
+    shouldEqualTolerance (0, chi2CDF(2, chi_squared)-0.5, 0.4);
+    for(int ii = 0; ii < totalDataCount; ++ii)
+    {
+        double expected = strataCounts[strata[ii] == 3 ? 0 : strata[ii] == 7 ? 1 : 2] / 
+                          (strata[ii] == 3 ? 10 : strata[ii] == 7 ? 50 : 40);
+        shouldEqualTolerance(elementCounts[ii] / expected, 1.0, 0.25);
+    }
+    shouldEqual((int)sampler.oobIndices().size(), 0);
+
+    // reset() and re-seeding reproduce the sample
+    Sampler<RandomMT19937>::IndexArrayType first(sampler.sampledIndices());
+    random.seed(1);
+    sampler.reset();
+    sampler.sample();
+    shouldEqualSequence(first.begin(), first.end(), sampler.sampledIndices().begin());
+
+    try
+    {
+        Sampler<> s(strata.begin(), strata.end(),
+            SamplerOptions().withoutReplacement().stratumWeights(weights).sampleSize(10));
+        failTest("Sampler() failed to throw on weighted sampling without replacement.");
+    }
+    catch(PreconditionViolation &) {}
+    try
+    {
+        weights.push_back(1.0);
+        Sampler<> s(strata.begin(), strata.end(),
+            SamplerOptions().withReplacement().stratumWeights(weights).sampleSize(10));
+        failTest("Sampler() failed to throw on wrong number of stratum weights.");
+    }
+    catch(PreconditionViolation &) {}
+}
+
 struct SamplerTestSuite
 : public vigra::test_suite
 {
@@ -416,6 +535,8 @@ struct SamplerTestSuite
         add(testCase(&SamplerTests::testStratifiedSamplingWithReplacement));
         add(testCase(&SamplerTests::testSamplingWithoutReplacementChi2));
         add(testCase(&SamplerTests::testSamplingWithReplacementChi2));
+        add(testCase(&SamplerTests::testAliasTable));
+        add(testCase(&SamplerTests::testWeightedStrataSampling));
     }
 };
 
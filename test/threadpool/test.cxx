@@ -0,0 +1,228 @@
+/************************************************************************/
+/*                                                                      */
+/*                 Copyright 2014-2015 by Ullrich Koethe                */
+/*                                                                      */
+/*    This file is part of the VIGRA computer vision library.           */
+/*    The VIGRA Website is                                              */
+/*        http://hci.iwr.uni-heidelberg.de/vigra/                       */
+/*    Please direct questions, bug reports, and contributions to        */
+/*        ullrich.koethe@iwr.uni-heidelberg.de    or                    */
+/*        vigra@informatik.uni-hamburg.de                               */
+/*                                                                      */
+/*    Permission is hereby granted, free of charge, to any person       */
+/*    obtaining a copy of this software and associated documentation    */
+/*    files (the "Software"), to deal in the Software without           */
+/*    restriction, including without limitation the rights to use,      */
+/*    copy, modify, merge, publish, distribute, sublicense, and/or      */
+/*    sell copies of the Software, and to permit persons to whom the    */
+/*    Software is furnished to do so, subject to the following          */
+/*    conditions:                                                       */
+/*                                                                      */
+/*    The above copyright notice and this permission notice shall be    */
+/*    included in all copies or substantial portions of the             */
+/*    Software.                                                         */
+/*                                                                      */
+/*    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND    */
+/*    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES   */
+/*    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND          */
+/*    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT       */
+/*    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,      */
+/*    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING      */
+/*    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR     */
+/*    OTHER DEALINGS IN THE SOFTWARE.                                   */                
+/*                                                                      */
+/************************************************************************/
+
+#include <cstddef>
+
+#include <iostream>
+#include <vector>
+#include <numeric>
+#include <stdexcept>
+
+#include "vigra/unittest.hxx"
+#include "vigra/threadpool.hxx"
+
+using namespace vigra;
+
+struct ThreadPoolTest
+{
+    void testOptions()
+    {
+        shouldEqual(ParallelOptions().getNumThreads(), (int)ParallelOptions::Auto);
+        shouldEqual(ParallelOptions().numThreads(3).getActualNumThreads(), 3);
+        shouldEqual(ParallelOptions().numThreads(ParallelOptions::NoThreads).getActualNumThreads(), 1);
+        should(ParallelOptions().getActualNumThreads() >= 1);
+        should(ParallelOptions().numThreads(ParallelOptions::Nice).getActualNumThreads() >= 1);
+
+        int old = ParallelOptions::defaultNumThreads();
+        ParallelOptions::setDefaultNumThreads(5);
+        shouldEqual(ParallelOptions().getActualNumThreads(), 5);
+        shouldEqual(ParallelOptions().numThreads(ParallelOptions::Nice).getActualNumThreads(), 2);
+        ParallelOptions::setDefaultNumThreads(old);
+        shouldEqual(ParallelOptions::defaultNumThreads(), old);
+    }
+
+    void testThreadPool()
+    {
+        ThreadPool pool(ParallelOptions().numThreads(4));
+        shouldEqual(pool.numThreads(), 4);
+        shouldEqual(pool.currentWorker(), -1);
+
+        std::vector<int> res(1000, 0);
+        for(int k=0; k<1000; ++k)
+            pool.enqueue([&res, k](int thread_id)
+                         {
+                             res[k] = k*k + (thread_id >= 0 && thread_id < 4 ? 0 : 1);
+                         });
+        pool.waitFinished();
+        for(int k=0; k<1000; ++k)
+            shouldEqual(res[k], k*k);
+
+        // tasks may enqueue further tasks
+        threading::atomic_long count(0);
+        for(int k=0; k<10; ++k)
+            pool.enqueue([&pool, &count](int)
+                         {
+                             for(int j=0; j<10; ++j)
+                                 pool.enqueue([&count](int) { count.fetch_add(1); });
+                         });
+        pool.waitFinished();
+        shouldEqual(count.load(), 100);
+    }
+
+    void testThreadPoolException()
+    {
+        ThreadPool pool(2);
+        pool.enqueue([](int) { throw std::runtime_error("ThreadPoolTest"); });
+        try
+        {
+            pool.waitFinished();
+            failTest("no exception thrown");
+        }
+        catch(std::runtime_error & e)
+        {
+            shouldEqual(std::string(e.what()), std::string("ThreadPoolTest"));
+        }
+        // the pool remains usable
+        int x = 0;
+        pool.enqueue([&x](int) { x = 1; });
+        pool.waitFinished();
+        shouldEqual(x, 1);
+    }
+
+    void testParallelForeach()
+    {
+        int n = 10000;
+        std::vector<int> res(n, 0);
+        parallel_foreach(0, n,
+            [&res](int, int k)
+            {
+                res[k] += k;
+            });
+        for(int k=0; k<n; ++k)
+            shouldEqual(res[k], k);
+
+        // per-thread partial sums over an iterator range
+        ParallelOptions options = ParallelOptions().numThreads(4);
+        std::vector<long> sums(options.getActualNumThreads(), 0);
+        parallel_foreach(res.begin(), res.end(),
+            [&sums](int thread_id, int v)
+            {
+                sums[thread_id] += v;
+            },
+            options);
+        shouldEqual(std::accumulate(sums.begin(), sums.end(), 0l), (long)n*(n-1)/2);
+
+        // items can be modified through the iterator
+        parallel_foreach(res.begin(), res.end(),
+            [](int, int & v)
+            {
+                v = -v;
+            },
+            options);
+        for(int k=0; k<n; ++k)
+            shouldEqual(res[k], -k);
+
+        // sequential execution
+        std::vector<int> order;
+        parallel_foreach(0, 5,
+            [&order](int thread_id, int k)
+            {
+                order.push_back(k + thread_id);
+            },
+            ParallelOptions().numThreads(ParallelOptions::NoThreads));
+        shouldEqual(order.size(), 5u);
+        for(int k=0; k<5; ++k)
+            shouldEqual(order[k], k);
+
+        // empty range
+        parallel_foreach(5, 5, [](int, int) { throw std::runtime_error("ThreadPoolTest"); });
+    }
+
+    void testParallelForeachNested()
+    {
+        int n = 64;
+        std::vector<long> res(n, 0);
+        parallel_foreach(0, n,
+            [&res](int, int k)
+            {
+                threading::atomic_long sum(0);
+                parallel_foreach(0, 100,
+                    [&sum](int, int j)
+                    {
+                        sum.fetch_add(j);
+                    },
+                    ParallelOptions().numThreads(4));
+                res[k] = sum.load() + k;
+            },
+            ParallelOptions().numThreads(4));
+        for(int k=0; k<n; ++k)
+            shouldEqual(res[k], 4950 + k);
+    }
+
+    void testParallelForeachException()
+    {
+        try
+        {
+            parallel_foreach(0, 1000,
+                [](int, int k)
+                {
+                    if(k == 500)
+                        throw std::runtime_error("ThreadPoolTest");
+                },
+                ParallelOptions().numThreads(4));
+            failTest("no exception thrown");
+        }
+        catch(std::runtime_error & e)
+        {
+            shouldEqual(std::string(e.what()), std::string("ThreadPoolTest"));
+        }
+    }
+};
+
+struct ThreadPoolTestSuite
+: public vigra::test_suite
+{
+    ThreadPoolTestSuite()
+    : vigra::test_suite("ThreadPoolTestSuite")
+    {
+        add( testCase( &ThreadPoolTest::testOptions));
+        add( testCase( &ThreadPoolTest::testThreadPool));
+        add( testCase( &ThreadPoolTest::testThreadPoolException));
+        add( testCase( &ThreadPoolTest::testParallelForeach));
+        add( testCase( &ThreadPoolTest::testParallelForeachNested));
+        add( testCase( &ThreadPoolTest::testParallelForeachException));
+    }
+};
+
+int main(int argc, char ** argv)
+{
+    ThreadPoolTestSuite test;
+
+    int failed = test.run(vigra::testsToBeExecuted(argc, argv));
+
+    std::cout << test.report() << std::endl;
+
+    return (failed != 0);
+}
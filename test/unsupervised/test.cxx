@@ -159,6 +159,69 @@ public:
         writeHDF5(hdf5File_2, hdf5group_3, zv);
 #endif    
     }
+
+    void testPLSAVariants()
+    {
+        unsigned int numComponents = 3;
+        unsigned int numFeatures = 159;
+        unsigned int numSamples = 1024;
+
+        Matrix<double> features(numFeatures, numSamples, plsaData, ColumnMajor);
+        PLSAOptions options = PLSAOptions().normalizedComponentWeights(false)
+                                           .minimumRelativeGain(0.0)
+                                           .maximumNumberOfIterations(20);
+
+        Matrix<double> fz(Shape2(numFeatures, numComponents));
+        Matrix<double> zv(Shape2(numComponents, numSamples));
+        pLSA(features, fz, zv, RandomMT19937(1), PLSAOptions(options).numThreads(1));
+
+        // the result must not depend on the number of threads
+        Matrix<double> fz4(Shape2(numFeatures, numComponents));
+        Matrix<double> zv4(Shape2(numComponents, numSamples));
+        pLSA(features, fz4, zv4, RandomMT19937(1), PLSAOptions(options).numThreads(4));
+        shouldEqualSequence(fz.begin(), fz.end(), fz4.begin());
+        shouldEqualSequence(zv.begin(), zv.end(), zv4.begin());
+
+        // sparse input gives the same result as dense input
+        std::vector<MultiArrayIndex> starts(1, 0), rows;
+        std::vector<double> values;
+        for(unsigned int v=0; v<numSamples; ++v)
+        {
+            for(unsigned int f=0; f<numFeatures; ++f)
+            {
+                if(features(f, v) != 0.0)
+                {
+                    rows.push_back(f);
+                    values.push_back(features(f, v));
+                }
+            }
+            starts.push_back(values.size());
+        }
+        should(values.size() < numFeatures*numSamples);
+        SparseColumnMatrixView<double> sparse(numFeatures,
+            MultiArrayView<1, MultiArrayIndex>(Shape1(starts.size()), &starts[0]),
+            MultiArrayView<1, MultiArrayIndex>(Shape1(rows.size()), &rows[0]),
+            MultiArrayView<1, double>(Shape1(values.size()), &values[0]));
+
+        Matrix<double> fzs(Shape2(numFeatures, numComponents));
+        Matrix<double> zvs(Shape2(numComponents, numSamples));
+        pLSA(sparse, fzs, zvs, RandomMT19937(1), options);
+        for(unsigned int k=0; k<fz.size(); ++k)
+            shouldEqualTolerance(fzs[k], fz[k], 1e-10);
+        for(unsigned int k=0; k<zv.size(); ++k)
+            shouldEqualTolerance(zvs[k], zv[k], 1e-8);
+
+        // single precision reaches a comparable fit
+        MultiArray<2, float> featuresf(features);
+        MultiArray<2, float> fzf(Shape2(numFeatures, numComponents));
+        MultiArray<2, float> zvf(Shape2(numComponents, numSamples));
+        pLSA(featuresf, fzf, zvf, RandomMT19937(1), options);
+        Matrix<double> model = fz*zv, 
+                       modelf = Matrix<double>(fzf)*Matrix<double>(zvf);
+        double error  = (features - model).squaredNorm(),
+               errorf = (features - modelf).squaredNorm();
+        shouldEqualTolerance(errorf / error, 1.0, 1e-3);
+    }
 };
 
 
@@ -170,6 +233,7 @@ struct UnsupervisedDecompositionTestSuite : public vigra::test_suite
     {
         add(testCase(&UnsupervisedDecompositionTest::testPCADecomposition));
         add(testCase(&UnsupervisedDecompositionTest::testPLSADecomposition));
+        add(testCase(&UnsupervisedDecompositionTest::testPLSAVariants));
     }
 };
 
@@ -33,6 +33,7 @@
 /*                                                                      */
 /************************************************************************/
 
+#include <cmath>
 #include <cstddef>
 #include <iostream>
 #include <iterator>
@@ -1203,6 +1204,62 @@ struct CompressionTest
         shouldEqualSequence(data.begin(), data.end(), decompressed.begin());
     }
     
+    void testShuffle()
+    {
+        // smooth float data compress much better after byte shuffling
+        // (the size is deliberately not a multiple of sizeof(float))
+        ArrayVector<float> values(10000);
+        for(unsigned int k=0; k<values.size(); ++k)
+            values[k] = std::sin(k / 100.0f);
+        char const * source = (char const *)values.begin();
+        std::size_t size = values.size()*sizeof(float) - 3;
+
+        ArrayVector<char> plain, shuffled;
+        compress(source, size, plain, LZ4);
+        compress(source, size, shuffled, SHUFFLE_LZ4, sizeof(float));
+        shouldEqual(withShuffle(LZ4), SHUFFLE_LZ4);
+        should(shuffled.size() < plain.size());
+
+        ArrayVector<char> decompressed(size);
+        uncompress(shuffled.begin(), shuffled.size(),
+                   decompressed.begin(), decompressed.size(), SHUFFLE_LZ4, sizeof(float));
+        shouldEqualSequence(source, source+size, decompressed.begin());
+
+        ArrayVector<char> zcompressed;
+        compress(source, size, zcompressed, SHUFFLE_ZLIB, sizeof(float));
+        std::fill(decompressed.begin(), decompressed.end(), 0);
+        uncompress(zcompressed.begin(), zcompressed.size(),
+                   decompressed.begin(), decompressed.size(), SHUFFLE_ZLIB, sizeof(float));
+        shouldEqualSequence(source, source+size, decompressed.begin());
+    }
+
+    void testZSTD()
+    {
+        shouldEqual(zstdCompression(3), ZSTD);
+        ArrayVector<char> compressed;
+#ifdef HasZSTD
+        compress(data.begin(), data.size(), compressed, ZSTD);
+        should(compressed.size() < data.size());
+
+        ArrayVector<char> decompressed(data.size());
+        uncompress(compressed.begin(), compressed.size(),
+                   decompressed.begin(), decompressed.size(), ZSTD);
+        shouldEqualSequence(data.begin(), data.end(), decompressed.begin());
+#else
+        try
+        {
+            compress(data.begin(), data.size(), compressed, ZSTD);
+            failTest("no exception thrown");
+        }
+        catch(ContractViolation & c)
+        {
+            std::string expected("\nPrecondition violation!\ncompress(): VIGRA was compiled without ZSTD compression.");
+            std::string message(c.what());
+            should(0 == expected.compare(message.substr(0,expected.size())));
+        }
+#endif
+    }
+    
     void testNoCompression()
     {
         ArrayVector<char> compressed;
@@ -1241,6 +1298,8 @@ struct UtilitiesTestSuite
         add( testCase( &stringTest));
         add( testCase( &CompressionTest::testZLIB));
         add( testCase( &CompressionTest::testLZ4));
+        add( testCase( &CompressionTest::testShuffle));
+        add( testCase( &CompressionTest::testZSTD));
         add( testCase( &CompressionTest::testNoCompression));
     }
 };
@@ -40,6 +40,11 @@
 
 #include "vigra/labelvolume.hxx"
 #include "vigra/multi_labeling.hxx"
+#include "vigra/blockwise_labeling.hxx"
+#include "vigra/random.hxx"
+#include "vigra/algorithm.hxx"
+#include "vigra/union_find.hxx"
+#include "vigra/threadpool.hxx"
 
 using namespace vigra;
 
@@ -447,11 +452,117 @@ struct VolumeLabelingTest
         shouldEqualSequence(res.begin(), res.end(), out6);
     }
 
+    template <class Array>
+    void checkSameLabeling(Array const & a, Array const & b, int count)
+    {
+        // labelings must be equal up to a permutation of the labels
+        std::vector<int> atob(count+1, -1), btoa(count+1, -1);
+        for(int k=0; k<a.size(); ++k)
+        {
+            shouldEqual(a[k] == 0, b[k] == 0);
+            if(atob[a[k]] == -1)
+                atob[a[k]] = b[k];
+            if(btoa[b[k]] == -1)
+                btoa[b[k]] = a[k];
+            shouldEqual(atob[a[k]], b[k]);
+            shouldEqual(btoa[b[k]], a[k]);
+        }
+    }
+
+    void labelingBlockwiseTest()
+    {
+        MultiArray<3, int> data(Shape3(23, 17, 12));
+        MersenneTwister random;
+        for(int k=0; k<data.size(); ++k)
+            data[k] = random.uniformInt(3);
+
+        BlockwiseOptions options[] = {
+            BlockwiseOptions().blockShape(5).numThreads(4),
+            BlockwiseOptions().blockShape(Shape3(7, 4, 3)).numThreads(4),
+            BlockwiseOptions().blockShape(1).numThreads(2),
+            BlockwiseOptions().numThreads(0)
+        };
+        NeighborhoodType neighborhoods[] = { DirectNeighborhood, IndirectNeighborhood };
+
+        MultiArray<3, int> res(data.shape()), blockwise(data.shape());
+        for(int n=0; n<2; ++n)
+        {
+            for(int o=0; o<4; ++o)
+            {
+                int count = labelMultiArray(data, res, neighborhoods[n]);
+                shouldEqual(count, labelMultiArrayBlockwise(data, blockwise, neighborhoods[n], options[o]));
+                shouldEqual(count, *argMax(blockwise.begin(), blockwise.end()));
+                checkSameLabeling(res, blockwise, count);
+
+                count = labelMultiArrayWithBackground(data, res, neighborhoods[n], 1);
+                shouldEqual(count, labelMultiArrayWithBackgroundBlockwise(data, blockwise, neighborhoods[n], 1, options[o]));
+                shouldEqual(count, *argMax(blockwise.begin(), blockwise.end()));
+                checkSameLabeling(res, blockwise, count);
+            }
+        }
+
+        // custom equality functor: values 0 and 2 are considered equal
+        int count = labelMultiArray(data, res, IndirectNeighborhood, EqualParity());
+        shouldEqual(count, labelMultiArrayBlockwise(data, blockwise, IndirectNeighborhood, options[0], EqualParity()));
+        checkSameLabeling(res, blockwise, count);
+    }
+
+    struct EqualParity
+    {
+        bool operator()(int a, int b) const
+        {
+            return (a % 2) == (b % 2);
+        }
+    };
+
     IntVolume vol1, vol2, vol3;
     DoubleVolume vol4, vol5, vol6;
 };
 
 
+#ifdef VIGRA_HAS_CONCURRENT_UNION_FIND
+
+struct ConcurrentUnionFindTest
+{
+    void testSequential()
+    {
+        ConcurrentUnionFindArray<unsigned int> uf(6);
+        shouldEqual(uf.size(), 6u);
+        shouldEqual(uf.makeUnion(4, 2), 2u);
+        shouldEqual(uf.makeUnion(5, 4), 2u);
+        shouldEqual(uf.makeUnion(1, 3), 1u);
+        shouldEqual(uf.findIndex(5), 2u);
+        should(uf.sameSet(2, 5));
+        should(!uf.sameSet(1, 2));
+        shouldEqual(uf.makeContiguous(), 2u);
+        unsigned int labels[] = { 0, 1, 2, 1, 2, 2 };
+        for(unsigned int k=0; k<6; ++k)
+            shouldEqual(uf.findLabel(k), labels[k]);
+    }
+
+    void testConcurrent()
+    {
+        // connect all indices with the same residue modulo 'sets',
+        // using edges in pseudo-random order
+        int n = 100000, sets = 7;
+        ConcurrentUnionFindArray<int> cuf(n);
+        parallel_foreach(0, n,
+            [&cuf, n, sets](int, int k)
+            {
+                int j = (int)(((long long)k * 7919) % n);
+                if(j + sets < n)
+                    cuf.makeUnion(j + sets, j);
+            },
+            ParallelOptions().numThreads(4));
+        for(int k=0; k<n; ++k)
+            shouldEqual(cuf.findIndex(k), k % sets);
+        shouldEqual(cuf.makeContiguous(), sets - 1);
+        for(int k=0; k<n; ++k)
+            shouldEqual(cuf.findLabel(k), k % sets);
+    }
+};
+
+#endif // VIGRA_HAS_CONCURRENT_UNION_FIND
 
 struct VolumeLabelingTestSuite
 : public vigra::test_suite
@@ -469,6 +580,11 @@ struct VolumeLabelingTestSuite
         add( testCase( &VolumeLabelingTest::labelingTwentySixTest3));
         add( testCase( &VolumeLabelingTest::labelingTwentySixWithBackgroundTest1));
         add( testCase( &VolumeLabelingTest::labelingAllTest));
+        add( testCase( &VolumeLabelingTest::labelingBlockwiseTest));
+#ifdef VIGRA_HAS_CONCURRENT_UNION_FIND
+        add( testCase( &ConcurrentUnionFindTest::testSequential));
+        add( testCase( &ConcurrentUnionFindTest::testConcurrent));
+#endif
     }
 };
 
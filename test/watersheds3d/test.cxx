@@ -41,6 +41,8 @@
 #include "vigra/watersheds3d.hxx"
 #include "vigra/multi_array.hxx"
 #include "vigra/multi_watersheds.hxx"
+#include "vigra/blockwise_watersheds.hxx"
+#include "vigra/random.hxx"
 #include "list"
 
 #include <stdlib.h>
@@ -473,6 +475,79 @@ struct Watersheds3dTest
         shouldEqual(8, max_region_label);
         should(labelVolume == labelVolume2);
     }
+
+    template <unsigned int N, class T>
+    static void checkWatershedsBlockwise(MultiArray<N, T> const & data, BlockwiseOptions const & options)
+    {
+        NeighborhoodType neighborhoods[] = { DirectNeighborhood, IndirectNeighborhood };
+        MultiArray<N, UInt32> ref(data.shape()), res(data.shape());
+        for(int n=0; n<2; ++n)
+        {
+            ref.init(0);
+            res.init(0);
+            UInt32 count = watershedsMultiArray(data, ref, neighborhoods[n], WatershedOptions().unionFind());
+            shouldEqual(count, unionFindWatershedsBlockwise(data, res, neighborhoods[n], options));
+            should(ref == res);
+        }
+    }
+
+    void testWatershedsBlockwise()
+    {
+        Shape3 shape(23, 17, 12);
+        BlockwiseOptions options = BlockwiseOptions().blockShape(5).numThreads(4);
+
+        // two basins whose ridge is a tie across the block face between x=4 and x=5
+        MultiArray<3, int> seam(shape);
+        for(int k=0; k<seam.size(); ++k)
+        {
+            int x = (int)seam.scanOrderIndexToCoordinate(k)[0];
+            seam[k] = std::min(std::abs(x - 2), std::abs(x - 7)) + (x > 9 ? 5 : 0);
+        }
+        checkWatershedsBlockwise(seam, options);
+
+        // a minimal plateau and a ridge plateau, both spanning several blocks
+        MultiArray<3, int> plateau(shape);
+        for(int k=0; k<plateau.size(); ++k)
+        {
+            Shape3 p = plateau.scanOrderIndexToCoordinate(k);
+            int x = (int)p[0], y = (int)p[1], z = (int)p[2];
+            plateau[k] = x < 12
+                            ? 0
+                            : std::min(x - 12, 3) + (y > 8 ? 0 : std::abs(z - 6));
+        }
+        checkWatershedsBlockwise(plateau, options);
+        checkWatershedsBlockwise(plateau, BlockwiseOptions().blockShape(Shape3(7, 4, 3)).numThreads(4));
+
+        // quantized random data to create many small plateaus, with every
+        // voxel on a block face
+        MultiArray<3, int> data(shape);
+        MersenneTwister random;
+        for(int k=0; k<data.size(); ++k)
+            data[k] = random.uniformInt(6);
+        checkWatershedsBlockwise(data, options);
+        checkWatershedsBlockwise(data, BlockwiseOptions().blockShape(1).numThreads(2));
+        checkWatershedsBlockwise(data, BlockwiseOptions().numThreads(0));
+
+        // strided views and chunked arrays
+        MultiArray<3, UInt32> ref(shape), res(shape);
+        UInt32 count = watershedsMultiArray(data, ref, DirectNeighborhood, WatershedOptions().unionFind());
+        shouldEqual(count, unionFindWatershedsBlockwise(data, res.transpose().transpose(), DirectNeighborhood, options));
+        should(ref == res);
+
+        ChunkedArrayLazy<3, int> cdata(shape, Shape3(8));
+        cdata.commitSubarray(Shape3(), data);
+        ChunkedArrayLazy<3, UInt32> cres(shape, Shape3(4, 8, 4));
+        shouldEqual(count, unionFindWatershedsBlockwise(cdata, cres, DirectNeighborhood,
+                                                        BlockwiseOptions().numThreads(4)));
+        cres.checkoutSubarray(Shape3(), res);
+        should(ref == res);
+
+        // 2D
+        MultiArray<2, float> data2(Shape2(40, 31));
+        for(int k=0; k<data2.size(); ++k)
+            data2[k] = (float)random.uniformInt(4);
+        checkWatershedsBlockwise(data2, BlockwiseOptions().blockShape(6).numThreads(3));
+    }
 };
 
 
@@ -488,6 +563,7 @@ struct Watershed3DTestSuite
         add( testCase( &Watersheds3dTest::testWatersheds3dSix2));
         add( testCase( &Watersheds3dTest::testWatersheds3dGradient1));
         add( testCase( &Watersheds3dTest::testWatersheds3dGradient2));
+        add( testCase( &Watersheds3dTest::testWatershedsBlockwise));
     }
 };
 
@@ -741,12 +741,24 @@ void defineChunkedArray()
          "   ``Compression.ZLIB_NONE:``\n      ZLIB no compression (level = 0)\n"
          "   ``Compression.ZLIB_FAST:``\n      ZLIB fast compression (level = 1)\n"
          "   ``Compression.ZLIB_BEST:``\n      ZLIB best compression (level = 9)\n"
-         "   ``Compression.LZ4:``\n      LZ4 compression (very fast)\n\n")
+         "   ``Compression.LZ4:``\n      LZ4 compression (very fast)\n"
+         "   ``Compression.ZSTD_FAST:``\n      zstd fast compression (level = 1)\n"
+         "   ``Compression.ZSTD:``\n      zstd default compression (level = 3)\n"
+         "   ``Compression.ZSTD_BEST:``\n      zstd best compression (level = 19)\n"
+         "   ``Compression.SHUFFLE_ZLIB:``\n      byte shuffling followed by ZLIB\n"
+         "   ``Compression.SHUFFLE_LZ4:``\n      byte shuffling followed by LZ4\n"
+         "   ``Compression.SHUFFLE_ZSTD:``\n      byte shuffling followed by zstd\n\n")
         .value("ZLIB", vigra::ZLIB)
         .value("ZLIB_NONE", vigra::ZLIB_NONE)
         .value("ZLIB_FAST", vigra::ZLIB_FAST)
         .value("ZLIB_BEST", vigra::ZLIB_BEST)
         .value("LZ4", vigra::LZ4)
+        .value("ZSTD_FAST", vigra::ZSTD_FAST)
+        .value("ZSTD", vigra::ZSTD)
+        .value("ZSTD_BEST", vigra::ZSTD_BEST)
+        .value("SHUFFLE_ZLIB", vigra::SHUFFLE_ZLIB)
+        .value("SHUFFLE_LZ4", vigra::SHUFFLE_LZ4)
+        .value("SHUFFLE_ZSTD", vigra::SHUFFLE_ZSTD)
     ;
 
 #ifdef HasHDF5
@@ -70,7 +70,8 @@ pythonConstructRandomForest(int treeCount,
                             bool sample_with_replacement,
                             bool sample_classes_individually,
                             bool prepare_online,
-                            ArrayVector<MultiArrayIndex> const & labels = ArrayVector<MultiArrayIndex>())
+                            ArrayVector<MultiArrayIndex> const & labels = ArrayVector<MultiArrayIndex>(),
+                            int n_threads = 1)
 
 
 {
@@ -78,7 +79,8 @@ pythonConstructRandomForest(int treeCount,
     options .sample_with_replacement(sample_with_replacement)
             .tree_count(treeCount)
             .prepare_online_learning(prepare_online)
-            .min_split_node_size(min_split_node_size);
+            .min_split_node_size(min_split_node_size)
+            .n_threads(n_threads);
 
 
     if(mtry  > 0)
@@ -137,12 +139,17 @@ python::tuple
 pythonLearnRandomForestWithFeatureSelection(RandomForest<LabelType> & rf, 
                                             NumpyArray<2,FeatureType> trainData, 
                                             NumpyArray<2,LabelType> trainLabels,
-                                            UInt32 randomSeed=0)
+                                            UInt32 randomSeed=0,
+                                            python::object n_threads=python::object())
 {
     vigra_precondition(!trainData.axistags() && !trainLabels.axistags(),
                        "RandomForest.learnRFWithFeatureSelection(): training data and labels must not\n"
                        "have axistags (use 'array.view(numpy.ndarray)' to remove them).");
     
+    python::extract<int> nThreads(n_threads);
+    if(nThreads.check())
+        rf.set_options().n_threads(nThreads());
+    
     using namespace rf;
     visitors::VariableImportanceVisitor var_imp;
     visitors::OOB_Error                 oob_v;
@@ -168,12 +175,17 @@ double
 pythonLearnRandomForest(RandomForest<LabelType> & rf, 
                         NumpyArray<2,FeatureType> trainData, 
                         NumpyArray<2,LabelType> trainLabels,
-                        UInt32 randomSeed=0)
+                        UInt32 randomSeed=0,
+                        python::object n_threads=python::object())
 {
     vigra_precondition(!trainData.axistags() && !trainLabels.axistags(),
                        "RandomForest.learnRF(): training data and labels must not\n"
                        "have axistags (use 'array.view(numpy.ndarray)' to remove them).");
     
+    python::extract<int> nThreads(n_threads);
+    if(nThreads.check())
+        rf.set_options().n_threads(nThreads());
+    
     using namespace rf;
     visitors::OOB_Error oob_v;
 
@@ -359,13 +371,16 @@ void defineRandomForest()
                                                    arg("sample_with_replacement")=true,
                                                    arg("sample_classes_individually")=false,
                                                    arg("prepare_online_learning")=false,
-                                                   arg("labels")=python::list())),
+                                                   arg("labels")=python::list(),
+                                                   arg("n_threads")=1)),
              "Constructor::\n\n"
              "  RandomForest(treeCount = 255, mtry=RF_SQRT, min_split_node_size=1,\n"
              "               training_set_size=0, training_set_proportions=1.0,\n"
              "               sample_with_replacement=True, sample_classes_individually=False,\n"
-             "               prepare_online_learning=False)\n\n"
+             "               prepare_online_learning=False, labels=[], n_threads=1)\n\n"
              "'treeCount' controls the number of trees that are created.\n"
+             "'n_threads' is the number of threads used to learn the trees\n"
+             "         (-1: use all cores). The result doesn't depend on it.\n"
              "'labels' is a list specifying the permitted labels.\n"
              "         If empty (default), the labels are automatically determined\n"
              "         from the training data. A non-empty list is useful when some\n"
@@ -400,9 +415,10 @@ void defineRandomForest()
              "The output is an array containing a probability for every test sample and class.\n")
         .def("learnRF",
              registerConverters(&pythonLearnRandomForest<LabelType,float>),
-             (arg("trainData"), arg("trainLabels"), arg("randomSeed")=0),
+             (arg("trainData"), arg("trainLabels"), arg("randomSeed")=0, arg("n_threads")=object()),
              "Trains a random Forest using 'trainData' and 'trainLabels'.\n\n"
-             "and returns the OOB. See the vigra documentation for the meaning af the rest of the parameters.\n")
+             "and returns the OOB. If 'n_threads' is given, it replaces the number of\n"
+             "threads passed to the constructor. See the vigra documentation for the meaning af the rest of the parameters.\n")
         .def("reLearnTree",
              registerConverters(&pythonRFReLearnTree<LabelType,float>),
             (arg("trainData"), arg("trainLabels"), arg("treeId"),
@@ -411,7 +427,7 @@ void defineRandomForest()
              "and returns the OOB. This might be helpful in an online learning setup to improve the classifier.\n")
         .def("learnRFWithFeatureSelection",
              registerConverters(&pythonLearnRandomForestWithFeatureSelection<LabelType,float>),
-             (arg("trainData"), arg("trainLabels"), arg("randomSeed")=0),
+             (arg("trainData"), arg("trainLabels"), arg("randomSeed")=0, arg("n_threads")=object()),
              "Train a random Forest using 'trainData' and 'trainLabels'.\n\n"
              "and returns the OOB and the Variable importance"
              "See the vigra documentation for the meaning af the rest of the paremeters.\n")